@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Tokenization.hpp"
+#include "Parser.hpp"
+#include "Interpreter.hpp"
+#include "Closures.hpp"
+
+// Micro and macro benchmarks of the tokenizer, parser and interpreter.
+// Results are printed to stdout as JSON, progress to stderr.
+
+namespace {
+    struct Benchmark {
+        std::string name;
+        uint64_t items;  // Items processed by one run (tokens, statements, iterations, ...), used for throughput
+        std::function<void()> run;
+    };
+
+    struct Result {
+        std::string name;
+        uint32_t repetitions;
+        uint64_t items;
+        uint64_t minNs;
+        uint64_t medianNs;
+        uint64_t meanNs;
+    };
+
+    // Discards everything the interpreter prints
+    class NullBuffer : public std::streambuf {
+    protected:
+        int overflow(int c) override { return c; }
+        std::streamsize xsputn(const char *, std::streamsize n) override { return n; }
+    };
+
+    std::unique_ptr<std::vector<Tokenization::Token>> tokenize(const std::string &source) {
+        std::istringstream stream(source);
+        Tokenization::Tokenizer tokenizer(stream);
+        tokenizer.scanTokens();
+        return tokenizer.getTokens();
+    }
+
+    std::unique_ptr<std::vector<ExprStmt::stmt_ptr>> compile(const std::string &source) {
+        Parsing::Parser parser(tokenize(source));
+        return parser.parse();
+    }
+
+    // Set by --engine closure
+    bool closureEngine = false;
+
+    void interpret(std::vector<ExprStmt::stmt_ptr> &statements) {
+        Interpreting::Interpreter interpreter(std::cin, std::cout, 42);
+        if (closureEngine) {
+            // Compiling to closures is part of the measured run, as it is of a script run
+            Closures::Compiler compiler(interpreter);
+            for (auto &statement: statements) {
+                compiler.run(*statement);
+            }
+            return;
+        }
+        for (auto &statement: statements) {
+            interpreter.interpret(statement);
+        }
+    }
+
+    std::string repeat(const std::string &part, size_t times) {
+        std::string result;
+        result.reserve(part.size() * times);
+        for (size_t i = 0; i < times; i++) result += part;
+        return result;
+    }
+
+    // Synthetic sources
+    const std::string mixedStatements =
+            "REM Synthetic statements for tokenizer throughput\n"
+            "LET counter_value = counter_value + 12.5 * (other - 3) / 7\n"
+            "IF counter_value >= 100 AND NOT done OR flag == TRUE THEN\n"
+            "    PRINT \"Counter reached: \" + counter_value\n"
+            "ELSE\n"
+            "    TONUM input_text, parsed\n"
+            "END\n";
+
+    std::string nestedIfs(size_t depth) {
+        return repeat("IF TRUE THEN\n", depth) + "PRINT 1\n" + repeat("END\n", depth);
+    }
+
+    std::string nestedParens(size_t depth) {
+        return "PRINT " + repeat("(", depth) + "1" + repeat(" + 1)", depth) + "\n";
+    }
+
+    const std::string numericLoop =
+            "LET i = 0\n"
+            "LET sum = 0\n"
+            "WHILE i < 200000 DO\n"
+            "    LET sum = sum + i * 2 - 1\n"
+            "    LET i = i + 1\n"
+            "END\n";
+
+    const std::string stringConcat =
+            "LET i = 0\n"
+            "LET text = \"\"\n"
+            "WHILE i < 20000 DO\n"
+            "    LET text = \"item \" + i + \": \" + (i > 100) + \"\"\n"
+            "    LET i = i + 1\n"
+            "END\n";
+
+    const std::string continueLoop =
+            "LET i = 0\n"
+            "WHILE i < 20000 DO\n"
+            "    LET i = i + 1\n"
+            "    IF i > 0 THEN\n"
+            "        CONTINUE\n"
+            "    END\n"
+            "    PRINT \"never\"\n"
+            "END\n";
+
+    const std::string printLoop =
+            "LET i = 0\n"
+            "WHILE i < 20000 DO\n"
+            "    PRINT \"line \" + i\n"
+            "    LET i = i + 1\n"
+            "END\n";
+
+    const std::string arrayOps =
+            "DIM a(1000000)\n"
+            "LET i = 0\n"
+            "WHILE i < 50 DO\n"
+            "    LET a = a * 0.5 + i\n"
+            "    LET total = SUM(a) + MAX(a)\n"
+            "    LET i = i + 1\n"
+            "END\n";
+
+    const std::string mapAggregate =
+            "MAP counts\n"
+            "LET i = 0\n"
+            "WHILE i < 20000 DO\n"
+            "    RND r, 0, 1000\n"
+            "    LET key = \"key\" + r\n"
+            "    HAS found, counts, key\n"
+            "    IF found THEN\n"
+            "        GET count, counts, key\n"
+            "        PUT counts, key, count + 1\n"
+            "    ELSE\n"
+            "        PUT counts, key, 1\n"
+            "    END\n"
+            "    LET i = i + 1\n"
+            "END\n";
+
+    const std::string functionCalls =
+            "FUNCTION fib(n)\n"
+            "    IF n < 2 THEN\n"
+            "        RETURN n\n"
+            "    END\n"
+            "    RETURN CALL fib(n - 1) + CALL fib(n - 2)\n"
+            "END\n"
+            "LET result = CALL fib(20)\n";
+
+    const std::string primeCount =
+            "LET n = 2\n"
+            "LET primes = 0\n"
+            "WHILE n < 1000 DO\n"
+            "    LET d = 2\n"
+            "    LET isPrime = TRUE\n"
+            "    WHILE d * d <= n AND isPrime DO\n"
+            "        LET q = n\n"
+            "        WHILE q >= d DO\n"
+            "            LET q = q - d\n"
+            "        END\n"
+            "        IF q == 0 THEN\n"
+            "            LET isPrime = FALSE\n"
+            "        END\n"
+            "        LET d = d + 1\n"
+            "    END\n"
+            "    IF isPrime THEN\n"
+            "        LET primes = primes + 1\n"
+            "    END\n"
+            "    LET n = n + 1\n"
+            "END\n"
+            "PRINT \"Primes: \" + primes\n";
+
+    std::vector<Benchmark> makeBenchmarks() {
+        std::vector<Benchmark> benchmarks;
+
+        // Tokenizer
+        auto largeSource = std::make_shared<std::string>(repeat(mixedStatements, 20000));
+        benchmarks.push_back({"tokenize/large_synthetic", largeSource->size(), [largeSource] {
+            tokenize(*largeSource);
+        }});
+
+        // Parser, tokens are prepared outside of the measured part
+        auto addParseBenchmark = [&](std::string name, const std::string &source) {
+            auto tokens = std::make_shared<std::vector<Tokenization::Token>>(*tokenize(source));
+            benchmarks.push_back({std::move(name), tokens->size(), [tokens] {
+                Parsing::Parser parser(std::make_unique<std::vector<Tokenization::Token>>(*tokens));
+                parser.parse();
+            }});
+        };
+        addParseBenchmark("parse/long_program", repeat(mixedStatements, 20000));
+        addParseBenchmark("parse/nested_ifs", repeat(nestedIfs(200), 100));
+        addParseBenchmark("parse/nested_parens", repeat(nestedParens(200), 100));
+
+        // Interpreter, programs are parsed outside of the measured part
+        auto addInterpretBenchmark = [&](std::string name, const std::string &source, uint64_t items) {
+            std::shared_ptr<std::vector<ExprStmt::stmt_ptr>> program = compile(source);
+            benchmarks.push_back({std::move(name), items, [program] {
+                interpret(*program);
+            }});
+        };
+        addInterpretBenchmark("interpret/numeric_loop", numericLoop, 200000);
+        addInterpretBenchmark("interpret/string_concat", stringConcat, 20000);
+        addInterpretBenchmark("interpret/continue_loop", continueLoop, 20000);
+        addInterpretBenchmark("interpret/print", printLoop, 20000);
+        addInterpretBenchmark("interpret/array_ops", arrayOps, 50 * 1000000);
+        addInterpretBenchmark("interpret/map_aggregate", mapAggregate, 20000);
+        addInterpretBenchmark("interpret/function_calls", functionCalls, 21891);
+
+        // Whole pipeline
+        benchmarks.push_back({"macro/prime_count", 1, [] {
+            auto program = compile(primeCount);
+            interpret(*program);
+        }});
+        auto fibonacci = repeat("LET a = 0\nLET b = 1\nWHILE a < 1000000000 DO\n"
+                                "    PRINT a\n    LET temp = a\n    LET a = b\n    LET b = temp + b\nEND\n", 200);
+        benchmarks.push_back({"macro/fibonacci_script", 1, [fibonacci] {
+            auto program = compile(fibonacci);
+            interpret(*program);
+        }});
+
+        return benchmarks;
+    }
+
+    Result measure(Benchmark &benchmark, uint32_t repetitions) {
+        benchmark.run();  // Warm up
+
+        std::vector<uint64_t> times;
+        for (uint32_t i = 0; i < repetitions; i++) {
+            auto start = std::chrono::steady_clock::now();
+            benchmark.run();
+            auto end = std::chrono::steady_clock::now();
+            times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        }
+
+        std::sort(times.begin(), times.end());
+        uint64_t total = 0;
+        for (uint64_t time: times) total += time;
+        return {benchmark.name, repetitions, benchmark.items, times.front(), times[times.size() / 2],
+                total / times.size()};
+    }
+
+    void printJson(const std::vector<Result> &results) {
+        std::cout << "{\n  \"engine\": \"" << (closureEngine ? "closure" : "interpreter") << "\",\n  \"benchmarks\": [";
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result &r = results[i];
+            double itemsPerSecond = r.medianNs ? r.items * 1e9 / r.medianNs : 0;
+            std::cout << (i ? "," : "") << "\n    "
+                      << std::format("{{\"name\": \"{}\", \"repetitions\": {}, \"items\": {}, \"min_ns\": {}, "
+                                     "\"median_ns\": {}, \"mean_ns\": {}, \"items_per_second\": {:.1f}}}",
+                                     r.name, r.repetitions, r.items, r.minNs, r.medianNs, r.meanNs, itemsPerSecond);
+        }
+        std::cout << "\n  ]\n}" << std::endl;
+    }
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::string> args(argv, argv + argc);
+    std::string filter;
+    uint32_t repetitions = 10;
+
+    for (size_t i = 1; i < args.size(); i++) {
+        if (args[i] == "--filter" && i + 1 < args.size()) {
+            filter = args[++i];
+        } else if (args[i] == "--repetitions" && i + 1 < args.size()) {
+            repetitions = std::max(1ul, std::strtoul(args[++i].c_str(), nullptr, 10));
+        } else if (args[i] == "--engine" && i + 1 < args.size()
+                   && (args[i + 1] == "interpreter" || args[i + 1] == "closure")) {
+            closureEngine = args[++i] == "closure";
+        } else {
+            std::cerr << "Usage: " << args[0] << " [--filter <substring>] [--repetitions <n>]"
+                      << " [--engine interpreter|closure]" << std::endl;
+            return 10;
+        }
+    }
+
+    // Interpreter prints to std::cout, JSON is printed after the benchmarks finish
+    NullBuffer nullBuffer;
+    std::streambuf *coutBuffer = std::cout.rdbuf(&nullBuffer);
+
+    std::vector<Result> results;
+    for (Benchmark &benchmark: makeBenchmarks()) {
+        if (!filter.empty() && benchmark.name.find(filter) == std::string::npos) continue;
+        std::cerr << "Running " << benchmark.name << "..." << std::endl;
+        results.push_back(measure(benchmark, repetitions));
+    }
+
+    std::cout.rdbuf(coutBuffer);
+    printJson(results);
+    return 0;
+}
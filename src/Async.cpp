@@ -0,0 +1,442 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "Async.hpp"
+
+namespace Async {
+    static std::system_error systemError(const char *what) {
+        return std::system_error(errno, std::generic_category(), what);
+    }
+
+    int Session::OutputBuffer::overflow(int c) {
+        if (c != traits_type::eof()) target.push_back(static_cast<char>(c));
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize Session::OutputBuffer::xsputn(const char *s, std::streamsize n) {
+        target.append(s, n);
+        return n;
+    }
+
+    Session::Session(EventLoop &loop, std::shared_ptr<const BasicPlusPlus::Program> program, int inputFd,
+                     int outputFd, uint64_t randomSeed, const BasicPlusPlus::Limits &limits)
+        : loop(loop), program(std::move(program)), inputWatch{this, inputFd}, outputWatch{this, outputFd},
+          interpreter(noInput, outputStream, randomSeed), untilYield(EventLoop::turnStatements) {
+        interpreter.inputSuspends = true;
+        if (limits.maxSteps) interpreter.setMaxSteps(limits.maxSteps);
+        if (limits.maxMemory) interpreter.setMaxMemory(limits.maxMemory);
+        main = runProgram();
+    }
+
+    bool Session::Suspend::await_ready() const noexcept {
+        switch (wait) {
+            case Wait::LINE:
+                return session.hasLine() || session.inputEnd;
+            case Wait::DRAIN:
+                return session.pendingOutput() <= EventLoop::outputHighWater / 2 || session.outputBroken;
+            default:
+                return false;
+        }
+    }
+
+    void Session::Suspend::await_suspend(std::coroutine_handle<> handle) noexcept {
+        session.waiting = handle;
+        session.wait = wait;
+        if (wait == Wait::TURN) session.loop.schedule(session);
+    }
+
+    bool Session::hasLine() const {
+        return input.find('\n', inputRead) != std::string::npos;
+    }
+
+    // Next line without the line break, everything left at the end of input, like std::getline
+    std::string Session::takeLine() {
+        size_t end = input.find('\n', inputRead);
+        std::string line;
+        if (end == std::string::npos) {
+            line = input.substr(inputRead);
+            inputRead = input.size();
+        } else {
+            line = input.substr(inputRead, end - inputRead);
+            inputRead = end + 1;
+        }
+        // Consumed input is dropped once it is the larger part of the buffer
+        if (inputRead * 2 >= input.size()) {
+            input.erase(0, inputRead);
+            inputRead = 0;
+        }
+        return line;
+    }
+
+    Task Session::statement(ExprStmt::Stmt &stmt) {
+        interpreter.statementsExecuted++;
+        if (untilYield) untilYield--;
+        return nested(stmt);
+    }
+
+    Task Session::nested(ExprStmt::Stmt &stmt) {
+        stmt.accept(*this);
+        return std::move(dispatched);
+    }
+
+    Task Session::runProgram() {
+        for (auto &stmt: program->getStatements()) {
+            co_await statement(*stmt);
+        }
+    }
+
+    Task Session::runBlock(ExprStmt::BlockStmt &stmt) {
+        interpreter.chargeFuel(stmt);
+        for (auto &statement: stmt.statementsList) {
+            co_await this->statement(*statement);
+            if (interpreter.returning) co_return;
+        }
+    }
+
+    Task Session::runIf(ExprStmt::IfStmt &stmt) {
+        if (interpreter.condition(*stmt.conditionExpr, stmt)) {
+            co_await nested(*stmt.thenBranch);
+        } else if (stmt.elseBranch.has_value()) {
+            co_await nested(*stmt.elseBranch.value());
+        }
+    }
+
+    Task Session::runWhile(ExprStmt::WhileStmt &stmt) {
+        while (interpreter.condition(*stmt.conditionExpr, stmt)) {
+            // Control can not leave a handler by co_await, so only the exception is caught around it
+            bool broken = false;
+            try {
+                co_await nested(*stmt.thenBranch);
+            } catch (const Interpreting::Break &) {
+                broken = true;
+            } catch (const Interpreting::Continue &) {
+                // continue
+            }
+            if (broken) break;
+            if (interpreter.returning) co_return;
+            // Long loops let other sessions run
+            if (untilYield == 0) co_await Suspend{*this, Wait::TURN};
+        }
+    }
+
+    Task Session::runCall(ExprStmt::CallStmt &stmt) {
+        ExprStmt::CallExpr &call = *stmt.call;
+        Interpreting::Interpreter::CallFrame frame = interpreter.enterFunction(call);
+        try {
+            co_await nested(*call.function->body);
+        } catch (const Interpreting::Break &) {
+            interpreter.throwError("LoopControlOutsideLoop", call);
+        } catch (const Interpreting::Continue &) {
+            interpreter.throwError("LoopControlOutsideLoop", call);
+        }
+        interpreter.leaveFunction(call, frame, false);
+    }
+
+    Task Session::runInput(ExprStmt::InputStmt &stmt) {
+        Tokenization::Literal prompt = stmt.expr->accept(interpreter);
+        output += interpreter.stringify(prompt);
+        co_await Suspend{*this, Wait::LINE};
+        interpreter.variableForWrite(stmt.targetVarName) = Values::RcString(takeLine());
+    }
+
+    Task Session::waitForDrain() {
+        co_await Suspend{*this, Wait::DRAIN};
+    }
+
+    void Session::visit(ExprStmt::PrintStmt &stmt) {
+        size_t base = interpreter.printValues.size();
+        for (auto &expr: stmt.expressions) interpreter.printValues.push_back(expr->accept(interpreter));
+        interpreter.appendPrinted(output, stmt, base);
+        output += '\n';
+        if (pendingOutput() > EventLoop::outputHighWater) dispatched = waitForDrain();
+    }
+
+    void Session::visit(ExprStmt::InputStmt &stmt) { dispatched = runInput(stmt); }
+
+    void Session::visit(ExprStmt::BlockStmt &stmt) { dispatched = runBlock(stmt); }
+
+    void Session::visit(ExprStmt::IfStmt &stmt) { dispatched = runIf(stmt); }
+
+    void Session::visit(ExprStmt::WhileStmt &stmt) { dispatched = runWhile(stmt); }
+
+    void Session::visit(ExprStmt::CallStmt &stmt) { dispatched = runCall(stmt); }
+
+    // Statements that can not wait run on the interpreter
+    void Session::visit(ExprStmt::LetStmt &stmt) { stmt.accept(interpreter); }
+
+    void Session::visit(ExprStmt::ArrayLetStmt &stmt) { stmt.accept(interpreter); }
+
+    void Session::visit(ExprStmt::DimStmt &stmt) { stmt.accept(interpreter); }
+
+    void Session::visit(ExprStmt::MapStmt &stmt) { stmt.accept(interpreter); }
+
+    void Session::visit(ExprStmt::PutStmt &stmt) { stmt.accept(interpreter); }
+
+    void Session::visit(ExprStmt::GetStmt &stmt) { stmt.accept(interpreter); }
+
+    void Session::visit(ExprStmt::ToNumStmt &stmt) { stmt.accept(interpreter); }
+
+    void Session::visit(ExprStmt::ToStrStmt &stmt) { stmt.accept(interpreter); }
+
+    void Session::visit(ExprStmt::RndStmt &stmt) { stmt.accept(interpreter); }
+
+    void Session::visit(ExprStmt::ParallelForStmt &stmt) { stmt.accept(interpreter); }
+
+    void Session::visit(ExprStmt::FunctionStmt &stmt) { stmt.accept(interpreter); }
+
+    void Session::visit(ExprStmt::ReturnStmt &stmt) { stmt.accept(interpreter); }
+
+    void Session::visit(ExprStmt::ContinueStmt &stmt) { stmt.accept(interpreter); }
+
+    void Session::visit(ExprStmt::BreakStmt &stmt) { stmt.accept(interpreter); }
+
+    void Session::visit(ExprStmt::OpenStmt &stmt) { stmt.accept(interpreter); }
+
+    void Session::visit(ExprStmt::ReadLineStmt &stmt) { stmt.accept(interpreter); }
+
+    void Session::visit(ExprStmt::WriteStmt &stmt) { stmt.accept(interpreter); }
+
+    void Session::visit(ExprStmt::CloseStmt &stmt) { stmt.accept(interpreter); }
+
+    EventLoop::EventLoop() {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (epollFd < 0) throw systemError("epoll_create1");
+    }
+
+    EventLoop::~EventLoop() {
+        while (!sessions.empty()) close(*sessions.begin()->second);
+        closedSessions.clear();
+        if (listenWatch.fd >= 0) ::close(listenWatch.fd);
+        ::close(epollFd);
+    }
+
+    void EventLoop::addSession(int inputFd, int outputFd, std::shared_ptr<const BasicPlusPlus::Program> program,
+                               uint64_t randomSeed, const BasicPlusPlus::Limits &limits) {
+        for (int fd: {inputFd, outputFd}) {
+            int flags = fcntl(fd, F_GETFL);
+            if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) throw systemError("fcntl");
+        }
+        auto session = std::make_unique<Session>(*this, std::move(program), inputFd, outputFd, randomSeed, limits);
+        Session &added = *session;
+        sessions.emplace(&added, std::move(session));
+        updateInterest(added);
+        schedule(added);
+    }
+
+    void EventLoop::listen(const std::string &socketPath, std::shared_ptr<const BasicPlusPlus::Program> program,
+                           uint64_t randomSeed, const BasicPlusPlus::Limits &limits) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (socketPath.size() >= sizeof(address.sun_path)) {
+            throw std::system_error(std::make_error_code(std::errc::filename_too_long), "listen");
+        }
+        std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) throw systemError("socket");
+        // Socket left by a previous run is replaced, any other file is not
+        struct stat existing{};
+        if (stat(socketPath.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode)) unlink(socketPath.c_str());
+        if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || ::listen(fd, SOMAXCONN) < 0) {
+            std::system_error error = systemError("bind");
+            ::close(fd);
+            throw error;
+        }
+
+        listenWatch.fd = fd;
+        listenProgram = std::move(program);
+        listenSeed = randomSeed;
+        listenLimits = limits;
+        watch(listenWatch, EPOLLIN);
+    }
+
+    void EventLoop::schedule(Session &session) {
+        if (session.queued) return;
+        session.queued = true;
+        ready.push_back(&session);
+    }
+
+    void EventLoop::acceptConnections() {
+        while (true) {
+            int fd = accept4(listenWatch.fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR) continue;
+                // EAGAIN when all pending connections were accepted, other errors are the failed connection's own
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+                if (errno == EMFILE || errno == ENFILE) return;
+                continue;
+            }
+            addSession(fd, fd, listenProgram, listenSeed++, listenLimits);
+        }
+    }
+
+    void EventLoop::readInput(Session &session) {
+        char buffer[16384];
+        while (!session.inputEnd) {
+            ssize_t count = read(session.inputWatch.fd, buffer, sizeof(buffer));
+            if (count > 0) {
+                session.input.append(buffer, count);
+                if (session.input.size() - session.inputRead >= inputHighWater && session.hasLine()) break;
+            } else if (count < 0 && errno == EINTR) {
+                continue;
+            } else if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            } else {
+                // End of input, a read error ends it too
+                session.inputEnd = true;
+            }
+        }
+        if (session.wait == Session::Wait::LINE && (session.hasLine() || session.inputEnd)) schedule(session);
+        updateInterest(session);
+    }
+
+    void EventLoop::writeOutput(Session &session) {
+        while (session.pendingOutput() > 0 && !session.outputBroken) {
+            const char *data = session.output.data() + session.outputWritten;
+            // send does not raise SIGPIPE when the peer is gone, other descriptors than sockets use write
+            ssize_t count = send(session.outputWatch.fd, data, session.pendingOutput(), MSG_NOSIGNAL);
+            if (count < 0 && errno == ENOTSOCK) count = write(session.outputWatch.fd, data, session.pendingOutput());
+            if (count >= 0) {
+                session.outputWritten += count;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            } else if (errno != EINTR) {
+                session.outputBroken = true;
+            }
+        }
+        if (session.pendingOutput() == 0) {
+            session.output.clear();
+            session.outputWritten = 0;
+        }
+
+        // Nobody reads the output of a broken session, so it is not run further
+        if (session.outputBroken || (session.finished && session.pendingOutput() == 0)) {
+            close(session);
+            return;
+        }
+        if (session.wait == Session::Wait::DRAIN && session.pendingOutput() <= outputHighWater / 2) schedule(session);
+        updateInterest(session);
+    }
+
+    void EventLoop::resume(Session &session) {
+        session.untilYield = turnStatements;
+        session.wait = Session::Wait::NONE;
+        if (session.waiting) {
+            std::exchange(session.waiting, nullptr).resume();
+        } else {
+            session.main.resume();
+        }
+
+        if (session.main.done()) {
+            session.finished = true;
+            try {
+                session.main.rethrow();
+            } catch (const Interpreting::InterpreterError &) {
+                session.output += "[line " + std::to_string(session.interpreter.getErrorLine()) +
+                                  "] Interpreter error: " + session.interpreter.getErrorMessage() + "\n";
+            } catch (const std::exception &e) {
+                session.output += std::string("Unexpected exception: ") + e.what() + "\n";
+            }
+        }
+        writeOutput(session);
+    }
+
+    void EventLoop::watch(Watch &watch, uint32_t events) {
+        if (watch.events == events) return;
+        epoll_event event{};
+        event.events = events;
+        event.data.ptr = &watch;
+        // Descriptors are added with no events when the session is created, see updateInterest
+        if (epoll_ctl(epollFd, EPOLL_CTL_MOD, watch.fd, &event) < 0) {
+            if (errno != ENOENT || epoll_ctl(epollFd, EPOLL_CTL_ADD, watch.fd, &event) < 0) throw systemError("epoll_ctl");
+        }
+        watch.events = events;
+    }
+
+    void EventLoop::updateInterest(Session &session) {
+        bool reading = !session.inputEnd && !session.finished &&
+                       (session.input.size() - session.inputRead < inputHighWater || !session.hasLine());
+        uint32_t inputEvents = reading ? static_cast<uint32_t>(EPOLLIN) : 0u;
+        uint32_t outputEvents = session.pendingOutput() > 0 ? static_cast<uint32_t>(EPOLLOUT) : 0u;
+
+        if (session.inputWatch.fd == session.outputWatch.fd) {
+            // Hang up is reported even without events, so a finished input stops being watched only with the output
+            watch(session.inputWatch, inputEvents | outputEvents | (session.inputEnd ? 0u : static_cast<uint32_t>(EPOLLRDHUP)));
+            return;
+        }
+        if (session.inputEnd) {
+            if (session.inputWatch.events != 0) epoll_ctl(epollFd, EPOLL_CTL_DEL, session.inputWatch.fd, nullptr);
+            session.inputWatch.events = 0;
+        } else {
+            watch(session.inputWatch, inputEvents | EPOLLRDHUP);
+        }
+        watch(session.outputWatch, outputEvents | EPOLLRDHUP);
+    }
+
+    void EventLoop::close(Session &session) {
+        session.closed = true;
+        std::erase(ready, &session);
+        int inputFd = session.inputWatch.fd;
+        int outputFd = session.outputWatch.fd;
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, inputFd, nullptr);
+        ::close(inputFd);
+        if (outputFd != inputFd) {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, outputFd, nullptr);
+            ::close(outputFd);
+        }
+
+        auto found = sessions.find(&session);
+        closedSessions.push_back(std::move(found->second));
+        sessions.erase(found);
+    }
+
+    void EventLoop::run() {
+        epoll_event events[64];
+        while (!sessions.empty() || listenWatch.fd >= 0) {
+            // Sessions scheduled while these run wait for the next round, after pending events
+            for (size_t count = ready.size(); count > 0 && !ready.empty(); count--) {
+                Session &session = *ready.front();
+                ready.pop_front();
+                session.queued = false;
+                resume(session);
+            }
+            closedSessions.clear();
+            if (sessions.empty() && listenWatch.fd < 0) break;
+
+            int count = epoll_wait(epollFd, events, std::size(events), ready.empty() ? -1 : 0);
+            if (count < 0) {
+                if (errno == EINTR) continue;
+                throw systemError("epoll_wait");
+            }
+            for (int i = 0; i < count; i++) {
+                Watch &watch = *static_cast<Watch *>(events[i].data.ptr);
+                if (!watch.session) {
+                    acceptConnections();
+                    continue;
+                }
+                Session &session = *watch.session;
+                if (session.closed) continue;
+
+                uint32_t flags = events[i].events;
+                bool isInput = &watch == &session.inputWatch;
+                bool isOutput = &watch == &session.outputWatch || session.inputWatch.fd == session.outputWatch.fd;
+                if (isInput && !session.inputEnd && (flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+                    readInput(session);
+                }
+                if (isOutput && (flags & (EPOLLOUT | EPOLLHUP | EPOLLERR))) {
+                    // Hang up of the output fails the write, which closes the session
+                    if ((flags & (EPOLLHUP | EPOLLERR)) && session.pendingOutput() == 0) session.outputBroken = true;
+                    writeOutput(session);
+                }
+            }
+            closedSessions.clear();
+        }
+    }
+}
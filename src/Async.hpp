@@ -0,0 +1,284 @@
+#ifndef BASICPLUSPLUS_ASYNC_HPP
+#define BASICPLUSPLUS_ASYNC_HPP
+
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "BasicPlusPlus.hpp"
+#include "Interpreter.hpp"
+
+// Many programs multiplexed on one thread. Statements that can wait (INPUT, PRINT when the peer does not read)
+// and the control flow around them run as C++20 coroutines, so a waiting program keeps only its coroutine frames
+// and variables, no thread. Everything else runs synchronously on the program's Interpreter.
+namespace Async {
+    // Lazily started coroutine. Awaiting it runs it to the end and rethrows its exception.
+    // Empty task (no coroutine) is ready immediately, it is returned for statements that completed synchronously.
+    class Task {
+    public:
+        struct promise_type {
+            std::coroutine_handle<> continuation = std::noop_coroutine();
+            std::exception_ptr exception;
+
+            Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+
+            std::suspend_always initial_suspend() noexcept { return {}; }
+
+            auto final_suspend() noexcept {
+                struct FinalAwaiter {
+                    bool await_ready() noexcept { return false; }
+
+                    std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                        return handle.promise().continuation;
+                    }
+
+                    void await_resume() noexcept {}
+                };
+                return FinalAwaiter{};
+            }
+
+            void return_void() {}
+
+            void unhandled_exception() { exception = std::current_exception(); }
+        };
+
+    private:
+        std::coroutine_handle<promise_type> handle;
+
+    public:
+        Task() = default;
+
+        explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+        Task(Task &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+        Task &operator=(Task &&other) noexcept {
+            if (this != &other) {
+                if (handle) handle.destroy();
+                handle = std::exchange(other.handle, nullptr);
+            }
+            return *this;
+        }
+
+        ~Task() {
+            if (handle) handle.destroy();
+        }
+
+        bool done() const { return !handle || handle.done(); }
+
+        // Starts or continues the coroutine from outside of any coroutine
+        void resume() { handle.resume(); }
+
+        // Rethrows exception of finished coroutine
+        void rethrow() const {
+            if (handle && handle.promise().exception) std::rethrow_exception(handle.promise().exception);
+        }
+
+        bool await_ready() const noexcept { return !handle; }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+            handle.promise().continuation = awaiting;
+            return handle;
+        }
+
+        void await_resume() const { rethrow(); }
+    };
+
+    class EventLoop;
+    class Session;
+
+    // File descriptor registered in the event loop, the listening socket has no session
+    struct Watch {
+        Session *session;
+        int fd;
+        uint32_t events = 0;
+    };
+
+    // One run of a program reading input from and writing output to file descriptors.
+    // Implements the statement visitor only to pick how each statement runs.
+    class Session : private ExprStmt::AbstractStmtVisitor {
+    private:
+        friend class EventLoop;
+
+        // Appends everything written to the session output buffer
+        class OutputBuffer : public std::streambuf {
+        private:
+            std::string &target;
+        protected:
+            int overflow(int c) override;
+            std::streamsize xsputn(const char *s, std::streamsize n) override;
+        public:
+            explicit OutputBuffer(std::string &target) : target(target) {}
+        };
+
+        enum class Wait { NONE, LINE, DRAIN, TURN };
+
+        EventLoop &loop;
+        std::shared_ptr<const BasicPlusPlus::Program> program;
+        Watch inputWatch;
+        Watch outputWatch;  // Not registered when input and output are the same descriptor
+
+        std::string input;
+        size_t inputRead = 0;
+        bool inputEnd = false;
+        std::string output;
+        size_t outputWritten = 0;
+        bool outputBroken = false;
+
+        OutputBuffer outputBuffer{output};
+        std::ostream outputStream{&outputBuffer};
+        std::istringstream noInput;
+        Interpreting::Interpreter interpreter;
+
+        Task main;
+        bool finished = false;
+        bool closed = false;
+        bool queued = false;
+        // Innermost suspended coroutine and what it waits for
+        std::coroutine_handle<> waiting;
+        Wait wait = Wait::NONE;
+        uint32_t untilYield;
+
+        // Task of the statement being dispatched, empty when it completed synchronously
+        Task dispatched;
+
+        Task statement(ExprStmt::Stmt &stmt);
+
+        // Block of IF / WHILE / FUNCTION, which is not counted as executed statement
+        Task nested(ExprStmt::Stmt &stmt);
+
+        Task runProgram();
+
+        Task runBlock(ExprStmt::BlockStmt &stmt);
+
+        Task runIf(ExprStmt::IfStmt &stmt);
+
+        Task runWhile(ExprStmt::WhileStmt &stmt);
+
+        Task runCall(ExprStmt::CallStmt &stmt);
+
+        Task runInput(ExprStmt::InputStmt &stmt);
+
+        Task waitForDrain();
+
+        size_t pendingOutput() const { return output.size() - outputWritten; }
+
+        // Suspends the coroutine until the event loop resumes it
+        struct Suspend {
+            Session &session;
+            Wait wait;
+
+            bool await_ready() const noexcept;
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept;
+
+            void await_resume() const noexcept {}
+        };
+
+        bool hasLine() const;
+
+        std::string takeLine();
+
+        void visit(ExprStmt::PrintStmt &stmt) override;
+        void visit(ExprStmt::InputStmt &stmt) override;
+        void visit(ExprStmt::LetStmt &stmt) override;
+        void visit(ExprStmt::ArrayLetStmt &stmt) override;
+        void visit(ExprStmt::DimStmt &stmt) override;
+        void visit(ExprStmt::MapStmt &stmt) override;
+        void visit(ExprStmt::PutStmt &stmt) override;
+        void visit(ExprStmt::GetStmt &stmt) override;
+        void visit(ExprStmt::ToNumStmt &stmt) override;
+        void visit(ExprStmt::ToStrStmt &stmt) override;
+        void visit(ExprStmt::RndStmt &stmt) override;
+        void visit(ExprStmt::BlockStmt &stmt) override;
+        void visit(ExprStmt::IfStmt &stmt) override;
+        void visit(ExprStmt::WhileStmt &stmt) override;
+        void visit(ExprStmt::ParallelForStmt &stmt) override;
+        void visit(ExprStmt::FunctionStmt &stmt) override;
+        void visit(ExprStmt::CallStmt &stmt) override;
+        void visit(ExprStmt::ReturnStmt &stmt) override;
+        void visit(ExprStmt::ContinueStmt &stmt) override;
+        void visit(ExprStmt::BreakStmt &stmt) override;
+        void visit(ExprStmt::OpenStmt &stmt) override;
+        void visit(ExprStmt::ReadLineStmt &stmt) override;
+        void visit(ExprStmt::WriteStmt &stmt) override;
+        void visit(ExprStmt::CloseStmt &stmt) override;
+
+    public:
+        Session(EventLoop &loop, std::shared_ptr<const BasicPlusPlus::Program> program, int inputFd, int outputFd,
+                uint64_t randomSeed, const BasicPlusPlus::Limits &limits);
+    };
+
+    // Single threaded epoll loop driving sessions
+    class EventLoop {
+    private:
+        friend class Session;
+
+        int epollFd;
+        Watch listenWatch{nullptr, -1};
+        std::shared_ptr<const BasicPlusPlus::Program> listenProgram;
+        uint64_t listenSeed = 0;
+        BasicPlusPlus::Limits listenLimits;
+
+        std::unordered_map<Session *, std::unique_ptr<Session>> sessions;
+        // Closed sessions are destroyed after the current batch of events, which may still point to them
+        std::vector<std::unique_ptr<Session>> closedSessions;
+        // Sessions that can continue
+        std::deque<Session *> ready;
+
+        void schedule(Session &session);
+
+        void acceptConnections();
+
+        void readInput(Session &session);
+
+        void writeOutput(Session &session);
+
+        // Runs the session until it suspends again
+        void resume(Session &session);
+
+        void updateInterest(Session &session);
+
+        void watch(Watch &watch, uint32_t events);
+
+        void close(Session &session);
+
+    public:
+        // Statements a running session executes before it lets the other sessions run
+        static constexpr uint32_t turnStatements = 10000;
+        // PRINT suspends while more output than this is not written, until half of it is written
+        static constexpr size_t outputHighWater = 64 * 1024;
+        // Input is not read further while this much is buffered and a whole line is available
+        static constexpr size_t inputHighWater = 1024 * 1024;
+
+        EventLoop();
+
+        ~EventLoop();
+
+        EventLoop(const EventLoop &) = delete;
+
+        EventLoop &operator=(const EventLoop &) = delete;
+
+        // Starts program reading lines from inputFd and writing to outputFd, which may be the same descriptor.
+        // Descriptors are switched to non-blocking mode and closed when the program ends.
+        void addSession(int inputFd, int outputFd, std::shared_ptr<const BasicPlusPlus::Program> program,
+                        uint64_t randomSeed, const BasicPlusPlus::Limits &limits = {});
+
+        // Starts new session of program for every connection to Unix socket at path, throws std::system_error
+        void listen(const std::string &socketPath, std::shared_ptr<const BasicPlusPlus::Program> program,
+                    uint64_t randomSeed, const BasicPlusPlus::Limits &limits = {});
+
+        // Runs until all sessions ended and nothing listens
+        void run();
+
+        size_t sessionCount() const { return sessions.size(); }
+    };
+}
+
+#endif //BASICPLUSPLUS_ASYNC_HPP
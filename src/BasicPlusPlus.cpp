@@ -0,0 +1,266 @@
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include "BasicPlusPlus.hpp"
+#include "Parser.hpp"
+#include "TypeInference.hpp"
+
+namespace BasicPlusPlus {
+    size_t stackSize(uint32_t maxDepth) {
+        // Measured on the deepest recursion of parsing, inference and interpreting one level, with a margin, on top
+        // of the 8 MiB default that holds the nesting of running FUNCTION calls, see Interpreter::maxNesting
+        static constexpr size_t bytesPerLevel = 4096;
+        return (8 << 20) + static_cast<size_t>(maxDepth) * bytesPerLevel;
+    }
+
+    // Program
+    static uint64_t hashNames(const std::vector<Tokenization::Token> &tokens) {
+        uint64_t signature = 0;
+        for (auto &token: tokens) {
+            bool literal = token.type == Tokenization::NUMBER || token.type == Tokenization::STRING;
+            uint64_t hash = literal ? 0 : std::hash<std::string_view>{}(token.lexeme);
+            signature = (signature ^ hash) * 0x100000001B3ull + token.type;
+        }
+        return signature;
+    }
+
+    CompileError Program::tokenizationError(Tokenization::Tokenizer &tokenizer) {
+        return CompileError(11, tokenizer.getErrorLine(),
+                            "[line " + std::to_string(tokenizer.getErrorLine()) + "]"
+                            + " Tokenization error: " + tokenizer.getErrorMessage());
+    }
+
+    CompileError Program::parsingError(Parsing::Parser &parser) {
+        Tokenization::Token &errorToken = parser.getErrorToken();
+        if (errorToken.type == Tokenization::EOF_TOKEN) {
+            return CompileError(12, errorToken.line,
+                                "[line " + std::to_string(errorToken.line) + " (at end of file)]"
+                                + " Parsing error: " + parser.getErrorMessage());
+        }
+        return CompileError(12, errorToken.line,
+                            "[line " + std::to_string(errorToken.line) + "] (at '" + errorToken.lexeme + "')"
+                            + " Parsing error: " + parser.getErrorMessage());
+    }
+
+    std::shared_ptr<const Program> Program::compile(std::istream &source, Timing::Timings *timings, uint32_t maxDepth) {
+        std::string text(std::istreambuf_iterator<char>(source), std::istreambuf_iterator<char>{});
+        return compile(std::string_view(text), timings, maxDepth);
+    }
+
+    std::shared_ptr<const Program> Program::compile(std::string_view source, Timing::Timings *timings,
+                                                    uint32_t maxDepth) {
+        std::optional<Timing::Timings> unusedTimings;
+        if (!timings) timings = &unusedTimings.emplace();
+
+        Tokenization::Tokenizer tokenizer(source);
+        std::unique_ptr<std::vector<Tokenization::Token>> tokens;
+        try {
+            auto phase = timings->phase("tokenize");
+            tokenizer.scanTokens();
+            tokens = tokenizer.getTokens();
+        } catch (const Tokenization::TokenizationError &) {
+            throw tokenizationError(tokenizer);
+        }
+        uint64_t tokenCount = tokens->size();
+        timings->tokenCount = tokenCount;
+        uint64_t names = hashNames(*tokens);
+
+        Parsing::Parser parser(std::move(tokens), maxDepth);
+        std::unique_ptr<std::vector<ExprStmt::stmt_ptr>> statements;
+        try {
+            auto phase = timings->phase("parse");
+            statements = parser.parse();
+        } catch (const Parsing::ParsingError &) {
+            throw parsingError(parser);
+        }
+
+        uint64_t typeSignature;
+        {
+            auto phase = timings->phase("infer");
+            typeSignature = TypeInference::inferTypes(*statements);
+        }
+
+        return std::make_shared<const Program>(Private{}, std::move(*statements), tokenCount, typeSignature, names);
+    }
+
+    // Execution stream buffers
+    int Execution::InputBuffer::underflow() {
+        if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+
+        line.clear();
+        if (!callback(line)) return traits_type::eof();
+        line.push_back('\n');
+        setg(line.data(), line.data(), line.data() + line.size());
+        return traits_type::to_int_type(*gptr());
+    }
+
+    int Execution::OutputBuffer::overflow(int c) {
+        sync();
+        if (c != traits_type::eof()) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    int Execution::OutputBuffer::sync() {
+        if (pptr() > pbase()) {
+            callback(std::string_view(pbase(), pptr() - pbase()));
+            setp(buffer, buffer + sizeof(buffer));
+        }
+        return 0;
+    }
+
+    // Execution
+    Execution &Execution::setInput(InputCallback callback) {
+        inputBuffer = std::make_unique<InputBuffer>(std::move(callback));
+        ownInputStream = std::make_unique<std::istream>(inputBuffer.get());
+        inputStream = ownInputStream.get();
+        return *this;
+    }
+
+    Execution &Execution::setInput(std::istream &stream) {
+        inputStream = &stream;
+        return *this;
+    }
+
+    Execution &Execution::setOutput(OutputCallback callback) {
+        outputBuffer = std::make_unique<OutputBuffer>(std::move(callback));
+        ownOutputStream = std::make_unique<std::ostream>(outputBuffer.get());
+        outputStream = ownOutputStream.get();
+        return *this;
+    }
+
+    Execution &Execution::setOutput(std::ostream &stream) {
+        outputStream = &stream;
+        return *this;
+    }
+
+    Execution &Execution::setVariable(const std::string &name, Value value) {
+        presetVariables.emplace_back(name, std::move(value));
+        return *this;
+    }
+
+    Execution &Execution::setRandomSeed(uint64_t seed) {
+        randomSeed = seed;
+        return *this;
+    }
+
+    Execution &Execution::setProfiler(Profiling::Profiler *profiler) {
+        this->profiler = profiler;
+        return *this;
+    }
+
+    Execution &Execution::setPerfCounters(Timing::PerfCounters *perfCounters) {
+        this->perfCounters = perfCounters && perfCounters->available() ? perfCounters : nullptr;
+        return *this;
+    }
+
+    Execution &Execution::setLimits(const Limits &limits) {
+        this->limits = limits;
+        return *this;
+    }
+
+    Execution &Execution::setEngine(Engine engine) {
+        this->engine = engine;
+        return *this;
+    }
+
+    Execution &Execution::setCheckpoints(std::string path, uint64_t every) {
+        checkpointPath = std::move(path);
+        checkpointEvery = every;
+        return *this;
+    }
+
+    Execution &Execution::setResume(std::string path) {
+        resumePath = std::move(path);
+        return *this;
+    }
+
+    // Checkpoint positions are valid in any program with the same shape and names, edited constants do not invalidate
+    // them unless they change inferred types, the restored variables must have the types the program was compiled for
+    static uint64_t programFingerprint(const Program &program) {
+        return Timing::countAstNodes(program.getStatements()) * 0x9E3779B97F4A7C15ull
+               ^ program.getTokenCount() ^ program.getStatements().size() << 48 ^ program.getTypeSignature()
+               ^ program.getNameSignature() * 0xC2B2AE3D27D4EB4Full;
+    }
+
+    int Execution::run() {
+        const std::vector<ExprStmt::stmt_ptr> &statements = program->getStatements();
+        interpreter = std::make_unique<Interpreting::Interpreter>(*inputStream, *outputStream, randomSeed);
+        interpreter->setProfiler(profiler);
+        if (limits.maxSteps) interpreter->setMaxSteps(limits.maxSteps);
+        if (limits.maxMemory) interpreter->setMaxMemory(limits.maxMemory);
+
+        uint64_t fingerprint = checkpointEvery || !resumePath.empty() ? programFingerprint(*program) : 0;
+        if (checkpointEvery) {
+            interpreter->setCheckpoints(statements, checkpointEvery, [this, fingerprint](Checkpointing::State &&state) {
+                state.programFingerprint = fingerprint;
+                Checkpointing::write(checkpointPath, state);
+            });
+        }
+
+        // Profiler measures the visits of the statements
+        std::unique_ptr<Closures::Compiler> closures;
+        if (engine == Engine::CLOSURE && !profiler) closures = std::make_unique<Closures::Compiler>(*interpreter);
+        auto execute = [&](ExprStmt::Stmt &stmt) {
+            if (closures) closures->run(stmt);
+            else interpreter->interpret(stmt);
+        };
+
+        failed = false;
+        try {
+            // Preset strings count to the memory limit too
+            for (auto &[name, value]: presetVariables) {
+                interpreter->setVariable(name, value);
+            }
+            size_t next = 0;
+            if (!resumePath.empty()) {
+                Checkpointing::State state = Checkpointing::read(resumePath);
+                if (state.programFingerprint != fingerprint) {
+                    throw Checkpointing::CheckpointError("Checkpoint '" + resumePath + "' is of a different program");
+                }
+                std::vector<uint32_t> position = std::move(state.position);
+                interpreter->restore(std::move(state));
+                next = interpreter->resume(statements, position);
+            }
+            for (size_t i = next; i < statements.size(); i++) {
+                if (perfCounters) [[unlikely]] {
+                    // Failing statement is counted too
+                    Timing::CounterValues start = perfCounters->read();
+                    try {
+                        execute(*statements[i]);
+                    } catch (...) {
+                        perfCounters->addStatement(i, statements[i]->line, start, perfCounters->read());
+                        throw;
+                    }
+                    perfCounters->addStatement(i, statements[i]->line, start, perfCounters->read());
+                } else {
+                    execute(*statements[i]);
+                }
+            }
+            interpreter->closeFiles();
+        } catch (const Interpreting::InterpreterError &) {
+            failed = true;
+            errorLine = interpreter->getErrorLine();
+            errorMessage = interpreter->getErrorMessage();
+        }
+
+        outputStream->flush();
+        return failed ? 13 : 0;
+    }
+
+    std::optional<Value> Execution::getVariable(const std::string &name) const {
+        if (!interpreter) return std::nullopt;
+        return interpreter->getVariable(name);
+    }
+
+    std::string Execution::getErrorOutput() const {
+        if (!failed) return "";
+        return "[line " + std::to_string(errorLine) + "] Interpreter error: " + errorMessage;
+    }
+
+    uint64_t Execution::getStatementsExecuted() const {
+        return interpreter ? interpreter->getStatementsExecuted() : 0;
+    }
+}
@@ -0,0 +1,221 @@
+#ifndef BASICPLUSPLUS_BASICPLUSPLUS_HPP
+#define BASICPLUSPLUS_BASICPLUSPLUS_HPP
+
+#include <functional>
+#include <istream>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Checkpoint.hpp"
+#include "Closures.hpp"
+#include "ExpressionsStatements.hpp"
+#include "Interpreter.hpp"
+#include "Parser.hpp"
+#include "Profiler.hpp"
+#include "Timings.hpp"
+#include "Tokenization.hpp"
+
+namespace Watching {
+    class IncrementalCompiler;
+}
+
+// Public API of the basicpp library.
+// Source is compiled once to an immutable `Program`, which can be shared by any number of threads,
+// each running it in its own cheap `Execution`.
+namespace BasicPlusPlus {
+    using Value = Tokenization::Literal;
+
+    // Tokenization or parsing error, `what()` is the message in the same format the command line tool prints
+    class CompileError : public std::exception {
+    private:
+        int code;
+        uint32_t errorLine;
+        std::string formatted;
+
+    public:
+        CompileError(int exitCode, uint32_t line, std::string &&formattedMessage)
+            : code(exitCode), errorLine(line), formatted(std::move(formattedMessage)) {}
+
+        // 11 for tokenization error, 12 for parsing error
+        int exitCode() const { return code; }
+
+        uint32_t line() const { return errorLine; }
+
+        const char *what() const noexcept override { return formatted.c_str(); }
+    };
+
+    // Limits of one run, exceeding them fails it with StepLimitExceeded / MemoryLimitExceeded error. 0 is unlimited.
+    struct Limits {
+        uint64_t maxSteps = 0;   // Executed statements, charged per block
+        uint64_t maxMemory = 0;  // Bytes of strings held by variables, arrays and maps
+        // Nesting of blocks and expressions, checked when compiled. Deeper than the default needs threads with
+        // stackSize(maxDepth).
+        uint32_t maxDepth = Parsing::Parser::defaultMaxDepth;
+    };
+
+    // How statements are executed, both give the same results
+    enum class Engine {
+        TREE_WALKER,  // Visits the syntax tree
+        CLOSURE       // Compiles statements to closures on their first run, see Closures.hpp
+    };
+
+    // Stack size of threads compiling and running programs nested up to maxDepth levels
+    size_t stackSize(uint32_t maxDepth);
+
+    // Highest Limits::maxDepth, its stack of about 400 MiB is given to every thread the library starts
+    inline constexpr uint32_t maxDepthLimit = 100000;
+
+    class Program {
+    private:
+        std::vector<ExprStmt::stmt_ptr> statements;
+        uint64_t tokenCount = 0;
+        uint64_t typeSignature = 0;
+        uint64_t nameSignature = 0;
+
+        struct Private {};
+
+        // Errors of a failed tokenizer or parser
+        static CompileError tokenizationError(Tokenization::Tokenizer &tokenizer);
+
+        static CompileError parsingError(Parsing::Parser &parser);
+
+        // Moves unchanged statements of the previous program to the next one
+        friend class Watching::IncrementalCompiler;
+
+    public:
+        Program(Private, std::vector<ExprStmt::stmt_ptr> &&statements, uint64_t tokenCount, uint64_t typeSignature,
+                uint64_t nameSignature = 0)
+            : statements(std::move(statements)), tokenCount(tokenCount), typeSignature(typeSignature),
+              nameSignature(nameSignature) {}
+
+        // Tokenizes, parses and infers types of source, throws CompileError, also when it nests deeper than maxDepth.
+        // When timings are given, "tokenize", "parse" and "infer" phases are recorded to them.
+        static std::shared_ptr<const Program> compile(std::istream &source, Timing::Timings *timings = nullptr,
+                                                      uint32_t maxDepth = Parsing::Parser::defaultMaxDepth);
+
+        static std::shared_ptr<const Program> compile(std::string_view source, Timing::Timings *timings = nullptr,
+                                                      uint32_t maxDepth = Parsing::Parser::defaultMaxDepth);
+
+        const std::vector<ExprStmt::stmt_ptr> &getStatements() const { return statements; }
+
+        uint64_t getTokenCount() const { return tokenCount; }
+
+        // Hash of the types inferred for all expressions
+        uint64_t getTypeSignature() const { return typeSignature; }
+
+        // Hash of the tokens without the values of number and string literals, so of all names in the source.
+        // 0 in programs of --watch, which are never checkpointed.
+        uint64_t getNameSignature() const { return nameSignature; }
+    };
+
+    // One run of a program, with its own variables, input, output and random generator
+    class Execution {
+    public:
+        // Stores next input line without the line break to `line`, returns false at the end of input
+        using InputCallback = std::function<bool(std::string &line)>;
+        using OutputCallback = std::function<void(std::string_view text)>;
+
+    private:
+        class InputBuffer : public std::streambuf {
+        private:
+            InputCallback callback;
+            std::string line;
+        protected:
+            int underflow() override;
+        public:
+            explicit InputBuffer(InputCallback &&callback) : callback(std::move(callback)) {}
+        };
+
+        class OutputBuffer : public std::streambuf {
+        private:
+            OutputCallback callback;
+            char buffer[4096];
+        protected:
+            int overflow(int c) override;
+            int sync() override;
+        public:
+            explicit OutputBuffer(OutputCallback &&callback) : callback(std::move(callback)) {
+                setp(buffer, buffer + sizeof(buffer));
+            }
+        };
+
+        std::shared_ptr<const Program> program;
+
+        std::unique_ptr<InputBuffer> inputBuffer;
+        std::unique_ptr<OutputBuffer> outputBuffer;
+        std::unique_ptr<std::istream> ownInputStream;
+        std::unique_ptr<std::ostream> ownOutputStream;
+        std::istream *inputStream = &std::cin;
+        std::ostream *outputStream = &std::cout;
+
+        std::vector<std::pair<std::string, Value>> presetVariables;
+        uint64_t randomSeed = std::mt19937_64::default_seed;
+        Profiling::Profiler *profiler = nullptr;
+        Timing::PerfCounters *perfCounters = nullptr;
+        Limits limits;
+        Engine engine = Engine::TREE_WALKER;
+        std::string checkpointPath;
+        uint64_t checkpointEvery = 0;
+        std::string resumePath;
+
+        std::unique_ptr<Interpreting::Interpreter> interpreter;
+        bool failed = false;
+        uint32_t errorLine = 0;
+        std::string errorMessage;
+
+    public:
+        explicit Execution(std::shared_ptr<const Program> program) : program(std::move(program)) {}
+
+        // Input and output default to process stdin and stdout
+        Execution &setInput(InputCallback callback);
+
+        Execution &setInput(std::istream &stream);
+
+        Execution &setOutput(OutputCallback callback);
+
+        Execution &setOutput(std::ostream &stream);
+
+        // Variable set before the first statement runs
+        Execution &setVariable(const std::string &name, Value value);
+
+        Execution &setRandomSeed(uint64_t seed);
+
+        Execution &setProfiler(Profiling::Profiler *profiler);
+
+        // Counts hardware events of every top level statement, ignored when the counters are unavailable
+        Execution &setPerfCounters(Timing::PerfCounters *perfCounters);
+
+        Execution &setLimits(const Limits &limits);
+
+        // Profiled runs and statements resumed from a checkpoint always use the tree walker
+        Execution &setEngine(Engine engine);
+
+        // Writes a checkpoint to path about every `every` executed statements, replacing the previous one
+        Execution &setCheckpoints(std::string path, uint64_t every);
+
+        // Continues from a checkpoint of the same program instead of the beginning, restored variables replace preset ones
+        Execution &setResume(std::string path);
+
+        // Runs the program, returns 0 on success or 13 on interpreter error.
+        // Throws Checkpointing::CheckpointError when a checkpoint can not be written or resumed.
+        int run();
+
+        // Variable value after the run
+        std::optional<Value> getVariable(const std::string &name) const;
+
+        // Interpreter error in the same format the command line tool prints, empty when there was none
+        std::string getErrorOutput() const;
+
+        uint32_t getErrorLine() const { return errorLine; }
+
+        const std::string &getErrorMessage() const { return errorMessage; }
+
+        uint64_t getStatementsExecuted() const;
+    };
+}
+
+#endif //BASICPLUSPLUS_BASICPLUSPLUS_HPP
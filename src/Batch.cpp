@@ -0,0 +1,95 @@
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include "Batch.hpp"
+#include "BasicPlusPlus.hpp"
+#include "ThreadPool.hpp"
+
+namespace Batch {
+    CompiledScript compileScript(const std::string &path, uint32_t maxDepth) {
+        CompiledScript script;
+
+        std::ifstream inStream(path);
+        if (inStream.fail()) {
+            script.exitCode = 9;
+            script.errorOutput = "Error: Failed to open input file.\n";
+            return script;
+        }
+        std::ostringstream content;
+        content << inStream.rdbuf();
+
+        try {
+            script.program = BasicPlusPlus::Program::compile(std::move(content).str(), nullptr, maxDepth);
+        } catch (const BasicPlusPlus::CompileError &e) {
+            script.exitCode = e.exitCode();
+            script.errorOutput = std::string(e.what()) + "\n";
+        }
+        return script;
+    }
+
+    static JobResult runJob(const Job &job, const CompiledScript &script, uint64_t seed,
+                            const BasicPlusPlus::Limits &limits) {
+        if (script.exitCode != 0) return {script.exitCode, script.errorOutput};
+
+        std::string input;
+        if (!job.stdinPath.empty()) {
+            std::ifstream inputFile(job.stdinPath);
+            if (inputFile.fail()) return {9, "Error: Failed to open stdin file '" + job.stdinPath + "'.\n"};
+            std::ostringstream content;
+            content << inputFile.rdbuf();
+            input = std::move(content).str();
+        }
+
+        std::istringstream inputStream(std::move(input));
+        std::ostringstream outputStream;
+        BasicPlusPlus::Execution execution(script.program);
+        execution.setInput(inputStream).setOutput(outputStream).setRandomSeed(seed).setLimits(limits);
+        try {
+            int exitCode = execution.run();
+            if (exitCode != 0) outputStream << execution.getErrorOutput() << std::endl;
+            return {exitCode, std::move(outputStream).str()};
+        } catch (const std::exception &e) {
+            return {1, std::move(outputStream).str() + "Unexpected exception: " + e.what() + "\n"};
+        }
+    }
+
+    std::vector<Job> readJobs(std::istream &jobsStream) {
+        std::vector<Job> jobs;
+        std::string line;
+        while (std::getline(jobsStream, line)) {
+            std::istringstream lineStream(line);
+            Job job;
+            if (!(lineStream >> job.scriptPath) || job.scriptPath.starts_with('#')) continue;
+            lineStream >> job.stdinPath;
+            jobs.push_back(std::move(job));
+        }
+        return jobs;
+    }
+
+    std::vector<JobResult> runJobs(const std::vector<Job> &jobs, unsigned threads,
+                                   const BasicPlusPlus::Limits &limits) {
+        Threading::ThreadPool pool(threads);
+
+        // Compile every distinct script once
+        std::map<std::string, CompiledScript> scripts;
+        for (const Job &job: jobs) scripts.try_emplace(job.scriptPath);
+        std::vector<std::pair<const std::string, CompiledScript> *> toCompile;
+        for (auto &entry: scripts) toCompile.push_back(&entry);
+
+        pool.forEach(toCompile.size(), [&toCompile, &limits](size_t i) {
+            toCompile[i]->second = compileScript(toCompile[i]->first, limits.maxDepth);
+        });
+
+        // Run the jobs, each with own interpreter, input, output and random seed
+        std::vector<uint64_t> seeds;
+        std::random_device randomDevice;
+        for (size_t i = 0; i < jobs.size(); i++) seeds.push_back((uint64_t(randomDevice()) << 32) | randomDevice());
+
+        std::vector<JobResult> results(jobs.size());
+        pool.forEach(jobs.size(), [&](size_t i) {
+            results[i] = runJob(jobs[i], scripts.at(jobs[i].scriptPath), seeds[i], limits);
+        });
+        return results;
+    }
+}
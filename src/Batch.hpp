@@ -0,0 +1,40 @@
+#ifndef BASICPLUSPLUS_BATCH_HPP
+#define BASICPLUSPLUS_BATCH_HPP
+
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "BasicPlusPlus.hpp"
+
+namespace Batch {
+    // One line of the jobs file: `<script path> [<stdin file path>]`
+    struct Job {
+        std::string scriptPath;
+        std::string stdinPath;
+    };
+
+    struct JobResult {
+        int exitCode;        // Same exit codes as running the script alone
+        std::string output;  // Captured stdout of the script, including error messages
+    };
+
+    struct CompiledScript {
+        int exitCode = 0;         // Non-zero when the script could not be compiled
+        std::string errorOutput;  // Error message main.cpp would print
+        std::shared_ptr<const BasicPlusPlus::Program> program;
+    };
+
+    // Reads and compiles script, failures are returned with the exit code main.cpp would use
+    CompiledScript compileScript(const std::string &path, uint32_t maxDepth = Parsing::Parser::defaultMaxDepth);
+
+    // Reads jobs, one per line. Empty lines and lines starting with '#' are skipped.
+    std::vector<Job> readJobs(std::istream &jobsStream);
+
+    // Runs all jobs on `threads` threads (hardware concurrency when 0). Every distinct script
+    // is tokenized and parsed only once and the AST is shared by all jobs running it.
+    std::vector<JobResult> runJobs(const std::vector<Job> &jobs, unsigned threads,
+                                   const BasicPlusPlus::Limits &limits = {});
+}
+
+#endif //BASICPLUSPLUS_BATCH_HPP
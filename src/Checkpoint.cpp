@@ -0,0 +1,321 @@
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include "Checkpoint.hpp"
+#include "HashMap.hpp"
+#include "NumArray.hpp"
+
+namespace Checkpointing {
+    using ArrayPtr = std::shared_ptr<Values::NumArray>;
+    using MapPtr = std::shared_ptr<Values::HashMap>;
+
+    static constexpr char magic[8] = {'B', 'P', 'P', 'C', 'K', 'P', 'T', '\0'};
+    static constexpr uint64_t version = 1;
+
+    struct Header {
+        char magic[8];
+        uint64_t version;
+        uint64_t programFingerprint;
+        uint64_t statementsExecuted;
+        uint64_t positionLength;
+        uint64_t arrayCount;
+        uint64_t mapCount;
+        uint64_t variableCount;
+    };
+
+    enum ValueType : uint8_t { STRING, NUMBER, BOOL, ARRAY, MAP };
+
+    static CheckpointError systemError(const std::string &what, const std::string &path) {
+        return CheckpointError(what + " '" + path + "': " + std::strerror(errno));
+    }
+
+    // Buffers small fields, large array contents are written directly
+    class Writer {
+    private:
+        int fd;
+        const std::string &path;
+        std::string buffer;
+        uint64_t offset = 0;
+
+        static constexpr size_t bufferSize = 1 << 20;
+
+        void writeAll(const char *data, size_t size) {
+            while (size > 0) {
+                ssize_t written = ::write(fd, data, size);
+                if (written < 0) {
+                    if (errno == EINTR) continue;
+                    throw systemError("Failed to write checkpoint", path);
+                }
+                data += written;
+                size -= written;
+            }
+        }
+
+    public:
+        Writer(int fd, const std::string &path) : fd(fd), path(path) {}
+
+        void bytes(const void *data, size_t size) {
+            offset += size;
+            if (size >= bufferSize) {
+                flush();
+                writeAll(static_cast<const char *>(data), size);
+                return;
+            }
+            buffer.append(static_cast<const char *>(data), size);
+            if (buffer.size() >= bufferSize) flush();
+        }
+
+        template<typename T>
+        void field(T value) { bytes(&value, sizeof(value)); }
+
+        void string(std::string_view text) {
+            field<uint64_t>(text.size());
+            bytes(text.data(), text.size());
+        }
+
+        void align() {
+            static constexpr char zeros[8] = {};
+            if (offset % 8 != 0) bytes(zeros, 8 - offset % 8);
+        }
+
+        void flush() {
+            writeAll(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    };
+
+    // Bounds checked cursor over the mapped file
+    class Reader {
+    private:
+        const char *data;
+        size_t size;
+        size_t offset = 0;
+
+    public:
+        Reader(const char *data, size_t size) : data(data), size(size) {}
+
+        const char *bytes(size_t count) {
+            if (count > size - offset) throw CheckpointError("Checkpoint is truncated or corrupted");
+            const char *result = data + offset;
+            offset += count;
+            return result;
+        }
+
+        template<typename T>
+        T field() {
+            T value;
+            std::memcpy(&value, bytes(sizeof(T)), sizeof(T));
+            return value;
+        }
+
+        std::string_view string() {
+            uint64_t length = field<uint64_t>();
+            return {bytes(length), length};
+        }
+
+        void align() {
+            if (offset % 8 != 0) bytes(8 - offset % 8);
+        }
+
+        bool atEnd() const { return offset == size; }
+    };
+
+    // Arrays and maps in the order they are stored, with their indices
+    struct Tables {
+        std::vector<const Values::NumArray *> arrays;
+        std::vector<const Values::HashMap *> maps;
+        std::unordered_map<const void *, uint64_t> indices;
+
+        void collect(const Tokenization::Literal &value) {
+            if (auto array = std::get_if<ArrayPtr>(&value)) {
+                if (indices.emplace(array->get(), arrays.size()).second) arrays.push_back(array->get());
+            } else if (auto map = std::get_if<MapPtr>(&value)) {
+                if (!indices.emplace(map->get(), maps.size()).second) return;
+                maps.push_back(map->get());
+                for (auto &entry: (*map)->getEntries()) collect(entry.value);
+            }
+        }
+    };
+
+    static void writeValue(Writer &writer, const Tables &tables, const Tokenization::Literal &value) {
+        if (auto string = std::get_if<Values::RcString>(&value)) {
+            writer.field<uint8_t>(STRING);
+            writer.string(*string);
+        } else if (auto number = std::get_if<double>(&value)) {
+            writer.field<uint8_t>(NUMBER);
+            writer.field(*number);
+        } else if (auto boolean = std::get_if<bool>(&value)) {
+            writer.field<uint8_t>(BOOL);
+            writer.field<uint8_t>(*boolean);
+        } else if (auto array = std::get_if<ArrayPtr>(&value)) {
+            writer.field<uint8_t>(ARRAY);
+            writer.field<uint64_t>(tables.indices.at(array->get()));
+        } else {
+            writer.field<uint8_t>(MAP);
+            writer.field<uint64_t>(tables.indices.at(std::get<MapPtr>(value).get()));
+        }
+    }
+
+    static Tokenization::Literal readValue(Reader &reader, const std::vector<ArrayPtr> &arrays,
+                                           const std::vector<MapPtr> &maps) {
+        switch (reader.field<uint8_t>()) {
+            case STRING:
+                return Values::RcString(reader.string());
+            case NUMBER:
+                return reader.field<double>();
+            case BOOL:
+                return reader.field<uint8_t>() != 0;
+            case ARRAY: {
+                uint64_t index = reader.field<uint64_t>();
+                if (index >= arrays.size()) break;
+                return arrays[index];
+            }
+            case MAP: {
+                uint64_t index = reader.field<uint64_t>();
+                if (index >= maps.size()) break;
+                return maps[index];
+            }
+        }
+        throw CheckpointError("Checkpoint is corrupted");
+    }
+
+    void write(const std::string &path, const State &state) {
+        Tables tables;
+        for (auto &[name, value]: state.variables) tables.collect(value);
+
+        std::string temporaryPath = path + ".tmp";
+        int fd = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) throw systemError("Failed to create checkpoint", temporaryPath);
+        try {
+            Writer writer(fd, temporaryPath);
+            Header header{};
+            std::memcpy(header.magic, magic, sizeof(magic));
+            header.version = version;
+            header.programFingerprint = state.programFingerprint;
+            header.statementsExecuted = state.statementsExecuted;
+            header.positionLength = state.position.size();
+            header.arrayCount = tables.arrays.size();
+            header.mapCount = tables.maps.size();
+            header.variableCount = state.variables.size();
+            writer.field(header);
+
+            writer.bytes(state.position.data(), state.position.size() * sizeof(uint32_t));
+            writer.align();
+            writer.string(state.randomState);
+
+            for (const Values::NumArray *array: tables.arrays) {
+                writer.align();
+                writer.field<uint64_t>(array->size());
+                writer.bytes(array->data(), array->size() * sizeof(double));
+            }
+            for (const Values::HashMap *map: tables.maps) {
+                writer.align();
+                writer.field<uint64_t>(map->size());
+                for (auto &entry: map->getEntries()) {
+                    writer.string(entry.key);
+                    writeValue(writer, tables, entry.value);
+                }
+            }
+            writer.align();
+            for (auto &[name, value]: state.variables) {
+                writer.string(name);
+                writeValue(writer, tables, value);
+            }
+            writer.flush();
+
+            if (fsync(fd) < 0) throw systemError("Failed to write checkpoint", temporaryPath);
+        } catch (...) {
+            close(fd);
+            unlink(temporaryPath.c_str());
+            throw;
+        }
+        close(fd);
+        if (rename(temporaryPath.c_str(), path.c_str()) < 0) {
+            CheckpointError error = systemError("Failed to replace checkpoint", path);
+            unlink(temporaryPath.c_str());
+            throw error;
+        }
+    }
+
+    State read(const std::string &path) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) throw systemError("Failed to open checkpoint", path);
+        struct stat status{};
+        if (fstat(fd, &status) < 0) {
+            CheckpointError error = systemError("Failed to read checkpoint", path);
+            close(fd);
+            throw error;
+        }
+        size_t size = status.st_size;
+        if (size < sizeof(Header)) {
+            close(fd);
+            throw CheckpointError("Not a checkpoint file '" + path + "'");
+        }
+        void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) throw systemError("Failed to map checkpoint", path);
+        struct Unmap {
+            void *mapping;
+            size_t size;
+            ~Unmap() { munmap(mapping, size); }
+        } unmap{mapping, size};
+        // Array contents are copied front to back once
+        madvise(mapping, size, MADV_SEQUENTIAL);
+
+        Reader reader(static_cast<const char *>(mapping), size);
+        auto header = reader.field<Header>();
+        if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version) {
+            throw CheckpointError("Not a checkpoint file '" + path + "'");
+        }
+
+        State state;
+        state.programFingerprint = header.programFingerprint;
+        state.statementsExecuted = header.statementsExecuted;
+        if (header.positionLength > size / sizeof(uint32_t)) throw CheckpointError("Checkpoint is corrupted");
+        state.position.resize(header.positionLength);
+        std::memcpy(state.position.data(), reader.bytes(header.positionLength * sizeof(uint32_t)),
+                    header.positionLength * sizeof(uint32_t));
+        reader.align();
+        state.randomState = reader.string();
+
+        // Counts are checked against the file size before anything is allocated for them
+        if (header.arrayCount > size / 8 || header.mapCount > size / 8 || header.variableCount > size / 8) {
+            throw CheckpointError("Checkpoint is corrupted");
+        }
+        std::vector<ArrayPtr> arrays;
+        arrays.reserve(header.arrayCount);
+        for (uint64_t i = 0; i < header.arrayCount; i++) {
+            reader.align();
+            uint64_t count = reader.field<uint64_t>();
+            if (count > size / sizeof(double)) throw CheckpointError("Checkpoint is corrupted");
+            auto values = reinterpret_cast<const double *>(reader.bytes(count * sizeof(double)));
+            arrays.push_back(std::make_shared<Values::NumArray>(values, count));
+        }
+
+        // Maps are created first, so entries can refer to any of them
+        std::vector<MapPtr> maps;
+        maps.reserve(header.mapCount);
+        for (uint64_t i = 0; i < header.mapCount; i++) maps.push_back(std::make_shared<Values::HashMap>(nullptr));
+        for (const MapPtr &map: maps) {
+            reader.align();
+            uint64_t count = reader.field<uint64_t>();
+            for (uint64_t i = 0; i < count; i++) {
+                Values::RcString key(reader.string());
+                map->put(key, readValue(reader, arrays, maps));
+            }
+        }
+
+        reader.align();
+        state.variables.reserve(header.variableCount);
+        for (uint64_t i = 0; i < header.variableCount; i++) {
+            std::string name(reader.string());
+            state.variables.emplace_back(std::move(name), readValue(reader, arrays, maps));
+        }
+        if (!reader.atEnd()) throw CheckpointError("Checkpoint is corrupted");
+        return state;
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef BASICPLUSPLUS_CHECKPOINT_HPP
+#define BASICPLUSPLUS_CHECKPOINT_HPP
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Tokenization.hpp"
+
+// Snapshot of a running program, written by `--checkpoint-every` and read by `--resume`.
+//
+// File layout, native byte order, every section starts 8 byte aligned:
+//   header, position, random generator state,
+//   arrays (element count, raw doubles), maps (entry count, entries), variables (name, value)
+// Strings are stored as length and bytes, values as 1 byte type and the string, number, bool or array / map index.
+// Arrays are referenced by index, so variables sharing an array still share it after restore.
+// Reading maps the file and copies array contents in bulk, nothing is parsed from text.
+namespace Checkpointing {
+    class CheckpointError : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    // Interpreter state at the start of a block outside of any FUNCTION call
+    struct State {
+        // Identifies the program the checkpoint belongs to
+        uint64_t programFingerprint = 0;
+        // Path from the program to the block about to run: index of the top level statement, then for every
+        // nested statement the branch (0 for THEN / loop body, 1 for ELSE) followed by statement index in it
+        std::vector<uint32_t> position;
+        uint64_t statementsExecuted = 0;
+        // std::mt19937_64 written by operator<<
+        std::string randomState;
+        std::vector<std::pair<std::string, Tokenization::Literal>> variables;
+    };
+
+    // Writes next to path and renames over it, so a crash never leaves a partial checkpoint.
+    // Throws CheckpointError.
+    void write(const std::string &path, const State &state);
+
+    // Maps and reads checkpoint, maps are created without owner and no value is charged to any budget.
+    // Throws CheckpointError.
+    State read(const std::string &path);
+}
+
+#endif //BASICPLUSPLUS_CHECKPOINT_HPP
@@ -0,0 +1,653 @@
+#include <utility>
+#include "Closures.hpp"
+
+namespace Closures {
+    using namespace ExprStmt;
+    using Tokenization::Literal;
+
+    // Compilation
+
+    ValueFn Compiler::compileValue(Expr &expr) {
+        // Proven types run the unchecked closures, as the visits of the interpreter do
+        if (expr.staticType == StaticType::NUMBER) {
+            return [number = compileNumber(expr)]() -> Literal { return number(); };
+        }
+        if (expr.staticType == StaticType::BOOLEAN) {
+            return [boolean = compileBoolean(expr)]() -> Literal { return boolean(); };
+        }
+        value = nullptr;
+        expr.accept(*this);
+        return std::move(value);
+    }
+
+    NumberFn Compiler::compileNumber(Expr &expr) {
+        number = nullptr;
+        value = nullptr;
+        // Nested compilations restore it before the visit returns it
+        Literal outer = std::exchange(placeholder, 0.);
+        expr.acceptNumber(*this);
+        placeholder = std::move(outer);
+        if (number) return std::move(number);
+        return [value = std::move(value)] { return std::get<double>(value()); };
+    }
+
+    BooleanFn Compiler::compileBoolean(Expr &expr) {
+        boolean = nullptr;
+        value = nullptr;
+        Literal outer = std::exchange(placeholder, false);
+        expr.acceptBoolean(*this);
+        placeholder = std::move(outer);
+        if (boolean) return std::move(boolean);
+        return [value = std::move(value)] { return std::get<bool>(value()); };
+    }
+
+    BooleanFn Compiler::compileCondition(Expr &expr, uint32_t line) {
+        if (expr.staticType == StaticType::BOOLEAN) return compileBoolean(expr);
+        return [this, value = compileValue(expr), line] {
+            Literal result = value();
+            if (!std::holds_alternative<bool>(result)) interpreter.throwError("ConditionNotBoolean", line);
+            return std::get<bool>(result);
+        };
+    }
+
+    StmtFn Compiler::compileStatement(Stmt &stmt) {
+        statement = nullptr;
+        stmt.accept(*this);
+        return std::move(statement);
+    }
+
+    Compiler::Slot Compiler::slot(const VarRef &var) {
+        if (var.slot >= 0) return {nullptr, &var};
+        return {&globals[var.name], &var};
+    }
+
+    void Compiler::run(Stmt &stmt) {
+        auto compiled = topLevel.find(&stmt);
+        if (compiled == topLevel.end()) compiled = topLevel.emplace(&stmt, compileStatement(stmt)).first;
+        interpreter.statementsExecuted++;
+        Flow flow = compiled->second();
+        // The tree walker lets loop control outside of loops escape
+        if (flow == Flow::BREAK) throw Interpreting::Break();
+        if (flow == Flow::CONTINUE) throw Interpreting::Continue();
+    }
+
+    // Expressions
+
+    Literal Compiler::visit(UnaryExpr &expr) {
+        uint32_t line = expr.line;
+        if (expr.op.type == Tokenization::MINUS) {
+            value = [this, right = compileValue(*expr.right), line]() -> Literal {
+                Literal operand = right();
+                if (auto number = std::get_if<double>(&operand)) return -*number;
+                return interpreter.unaryOperation(Tokenization::MINUS, operand, line);
+            };
+        } else {
+            value = [this, right = compileValue(*expr.right), line]() -> Literal {
+                Literal operand = right();
+                if (auto boolean = std::get_if<bool>(&operand)) return !*boolean;
+                return interpreter.unaryOperation(Tokenization::NOT, operand, line);
+            };
+        }
+        return placeholder;
+    }
+
+    // Numbers and booleans are computed in place, other operands go to Interpreter::binaryOperation
+    template<Tokenization::TokenType op>
+    ValueFn Compiler::binary(ValueFn &&left, ValueFn &&right, uint32_t line) {
+        return [this, left = std::move(left), right = std::move(right), line]() -> Literal {
+            Literal a = left();
+            Literal b = right();
+            if constexpr (op == Tokenization::AND || op == Tokenization::OR) {
+                const bool *x = std::get_if<bool>(&a);
+                const bool *y = std::get_if<bool>(&b);
+                if (x && y) return op == Tokenization::AND ? *x && *y : *x || *y;
+            } else {
+                const double *x = std::get_if<double>(&a);
+                const double *y = std::get_if<double>(&b);
+                if (x && y) {
+                    if constexpr (op == Tokenization::PLUS) return *x + *y;
+                    if constexpr (op == Tokenization::MINUS) return *x - *y;
+                    if constexpr (op == Tokenization::STAR) return *x * *y;
+                    if constexpr (op == Tokenization::SLASH) {
+                        if (*y != 0) return *x / *y;
+                    }
+                    if constexpr (op == Tokenization::LESS) return *x < *y;
+                    if constexpr (op == Tokenization::GREATER) return *x > *y;
+                    if constexpr (op == Tokenization::LESS_EQUAL) return *x <= *y;
+                    if constexpr (op == Tokenization::GREATER_EQUAL) return *x >= *y;
+                    if constexpr (op == Tokenization::EQUAL_EQUAL) return *x == *y;
+                    if constexpr (op == Tokenization::NOT_EQUAL) return *x != *y;
+                }
+            }
+            return interpreter.binaryOperation(op, a, b, line);
+        };
+    }
+
+    Literal Compiler::visit(BinaryExpr &expr) {
+        uint32_t line = expr.line;
+        if (expr.staticType == StaticType::STRING && expr.op.type == Tokenization::PLUS) {
+            // Anything added to a string is concatenated
+            value = [this, left = compileValue(*expr.left), right = compileValue(*expr.right), line]() -> Literal {
+                Literal a = left();
+                Literal b = right();
+                return interpreter.binaryOperation(Tokenization::PLUS, a, b, line);
+            };
+            return placeholder;
+        }
+        ValueFn left = compileValue(*expr.left);
+        ValueFn right = compileValue(*expr.right);
+        switch (expr.op.type) {
+            case Tokenization::PLUS: value = binary<Tokenization::PLUS>(std::move(left), std::move(right), line); break;
+            case Tokenization::MINUS: value = binary<Tokenization::MINUS>(std::move(left), std::move(right), line); break;
+            case Tokenization::STAR: value = binary<Tokenization::STAR>(std::move(left), std::move(right), line); break;
+            case Tokenization::SLASH: value = binary<Tokenization::SLASH>(std::move(left), std::move(right), line); break;
+            case Tokenization::LESS: value = binary<Tokenization::LESS>(std::move(left), std::move(right), line); break;
+            case Tokenization::GREATER:
+                value = binary<Tokenization::GREATER>(std::move(left), std::move(right), line);
+                break;
+            case Tokenization::LESS_EQUAL:
+                value = binary<Tokenization::LESS_EQUAL>(std::move(left), std::move(right), line);
+                break;
+            case Tokenization::GREATER_EQUAL:
+                value = binary<Tokenization::GREATER_EQUAL>(std::move(left), std::move(right), line);
+                break;
+            case Tokenization::EQUAL_EQUAL:
+                value = binary<Tokenization::EQUAL_EQUAL>(std::move(left), std::move(right), line);
+                break;
+            case Tokenization::NOT_EQUAL:
+                value = binary<Tokenization::NOT_EQUAL>(std::move(left), std::move(right), line);
+                break;
+            case Tokenization::AND: value = binary<Tokenization::AND>(std::move(left), std::move(right), line); break;
+            default: value = binary<Tokenization::OR>(std::move(left), std::move(right), line); break;
+        }
+        return placeholder;
+    }
+
+    Literal Compiler::visit(GroupingExpr &expr) {
+        value = compileValue(*expr.expression);
+        return placeholder;
+    }
+
+    Literal Compiler::visit(LiteralExpr &expr) {
+        value = [literal = expr.value] { return literal; };
+        return placeholder;
+    }
+
+    Literal Compiler::visit(VarExpr &expr) {
+        value = [this, variable = slot(expr.varName), line = expr.line] {
+            const Literal *result = find(variable);
+            if (!result) interpreter.throwError("VariableNotDeclared '" + variable.var->name + "'", line);
+            return *result;
+        };
+        return placeholder;
+    }
+
+    Literal Compiler::visit(ArrayExpr &expr) {
+        visitNumber(expr);
+        value = [element = std::move(number)]() -> Literal { return element(); };
+        number = nullptr;
+        return placeholder;
+    }
+
+    Literal Compiler::visit(ArrayFunctionExpr &expr) {
+        number = [this, argument = compileValue(*expr.argument), &expr] {
+            Literal array = argument();
+            return interpreter.arrayFunction(expr, array);
+        };
+        value = [result = number]() -> Literal { return result(); };
+        return placeholder;
+    }
+
+    Literal Compiler::visit(StringFunctionExpr &expr) {
+        std::vector<ValueFn> arguments;
+        for (auto &argument: expr.arguments) arguments.push_back(compileValue(*argument));
+        value = [this, arguments = std::move(arguments), &expr] {
+            Literal values[3];
+            for (size_t i = 0; i < arguments.size(); i++) values[i] = arguments[i]();
+            return interpreter.stringFunction(expr, values);
+        };
+        return placeholder;
+    }
+
+    ValueFn Compiler::compileCall(CallExpr &expr, bool valueNeeded) {
+        std::vector<ValueFn> arguments;
+        for (auto &argument: expr.arguments) arguments.push_back(compileValue(*argument));
+
+        FunctionStmt *function = expr.function;
+        if (!functions.contains(function)) {
+            functions[function];
+            // May add more functions, which keeps references to the stored bodies valid
+            StmtFn body = compileStatement(*function->body);
+            functions[function] = std::move(body);
+        }
+        const StmtFn *body = &functions[function];
+
+        return [this, &expr, arguments = std::move(arguments), body, valueNeeded] {
+            size_t base = interpreter.pushFrame(expr);
+            for (size_t i = 0; i < arguments.size(); i++) {
+                interpreter.setArgument(base + i, arguments[i](), expr.line);
+            }
+            Interpreting::Interpreter::CallFrame frame = interpreter.enterFrame(expr, base);
+            Flow flow = (*body)();
+            if (flow == Flow::BREAK || flow == Flow::CONTINUE) interpreter.throwError("LoopControlOutsideLoop", expr);
+            return interpreter.leaveFunction(expr, frame, valueNeeded);
+        };
+    }
+
+    Literal Compiler::visit(CallExpr &expr) {
+        value = compileCall(expr, true);
+        return placeholder;
+    }
+
+    Literal Compiler::visit(EofExpr &expr) {
+        boolean = [this, fileNumber = compileValue(*expr.fileNumber), line = expr.line] {
+            Literal number = fileNumber();
+            return interpreter.atEnd(interpreter.getFile(interpreter.fileNumber(number, line), line), line);
+        };
+        value = [result = boolean]() -> Literal { return result(); };
+        return placeholder;
+    }
+
+    // Proven types, read without checking the variant as Interpreter::visitNumber / visitBoolean do
+
+    double Compiler::visitNumber(UnaryExpr &expr) {
+        number = [right = compileNumber(*expr.right)] { return -right(); };
+        return 0;
+    }
+
+    double Compiler::visitNumber(BinaryExpr &expr) {
+        NumberFn left = compileNumber(*expr.left);
+        NumberFn right = compileNumber(*expr.right);
+        switch (expr.op.type) {
+            case Tokenization::PLUS:
+                number = [left = std::move(left), right = std::move(right)] { return left() + right(); };
+                break;
+            case Tokenization::MINUS:
+                number = [left = std::move(left), right = std::move(right)] { return left() - right(); };
+                break;
+            case Tokenization::STAR:
+                number = [left = std::move(left), right = std::move(right)] { return left() * right(); };
+                break;
+            default:
+                number = [this, left = std::move(left), right = std::move(right), line = expr.line] {
+                    double dividend = left();
+                    double divisor = right();
+                    if (divisor == 0) interpreter.throwError("DivisionByZero", line);
+                    return dividend / divisor;
+                };
+                break;
+        }
+        return 0;
+    }
+
+    double Compiler::visitNumber(GroupingExpr &expr) {
+        number = compileNumber(*expr.expression);
+        return 0;
+    }
+
+    double Compiler::visitNumber(LiteralExpr &expr) {
+        number = [literal = *std::get_if<double>(&expr.value)] { return literal; };
+        return 0;
+    }
+
+    double Compiler::visitNumber(VarExpr &expr) {
+        // Proven variables are assigned on every path from the start of the program, restored state may still differ
+        number = [this, variable = slot(expr.varName), line = expr.line] {
+            const Literal *value = find(variable);
+            if (const double *number = value ? std::get_if<double>(value) : nullptr) [[likely]] return *number;
+            interpreter.throwUnprovenRead(variable.var->name, value, "number", line);
+            return 0.;  // Unreachable
+        };
+        return 0;
+    }
+
+    double Compiler::visitNumber(ArrayExpr &expr) {
+        uint32_t line = expr.line;
+        if (expr.index->staticType == StaticType::NUMBER) {
+            number = [this, index = compileNumber(*expr.index), variable = slot(expr.varName), line] {
+                double position = index();
+                Values::NumArray &array = interpreter.getArray(find(variable), *variable.var, line);
+                return array.values[interpreter.arrayIndex(array, position, line)];
+            };
+        } else {
+            number = [this, index = compileValue(*expr.index), variable = slot(expr.varName), line] {
+                Literal position = index();
+                Values::NumArray &array = interpreter.getArray(find(variable), *variable.var, line);
+                return array.values[interpreter.arrayIndex(array, position, line)];
+            };
+        }
+        return 0;
+    }
+
+    bool Compiler::visitBoolean(UnaryExpr &expr) {
+        boolean = [right = compileBoolean(*expr.right)] { return !right(); };
+        return false;
+    }
+
+    template<class Compare>
+    static BooleanFn comparison(NumberFn &&left, NumberFn &&right) {
+        return [left = std::move(left), right = std::move(right)] {
+            double a = left();
+            return Compare()(a, right());
+        };
+    }
+
+    bool Compiler::visitBoolean(BinaryExpr &expr) {
+        if (expr.left->staticType == StaticType::NUMBER) {
+            NumberFn left = compileNumber(*expr.left);
+            NumberFn right = compileNumber(*expr.right);
+            switch (expr.op.type) {
+                case Tokenization::LESS: boolean = comparison<std::less<>>(std::move(left), std::move(right)); break;
+                case Tokenization::GREATER:
+                    boolean = comparison<std::greater<>>(std::move(left), std::move(right));
+                    break;
+                case Tokenization::LESS_EQUAL:
+                    boolean = comparison<std::less_equal<>>(std::move(left), std::move(right));
+                    break;
+                case Tokenization::GREATER_EQUAL:
+                    boolean = comparison<std::greater_equal<>>(std::move(left), std::move(right));
+                    break;
+                case Tokenization::EQUAL_EQUAL:
+                    boolean = comparison<std::equal_to<>>(std::move(left), std::move(right));
+                    break;
+                default: boolean = comparison<std::not_equal_to<>>(std::move(left), std::move(right)); break;
+            }
+            return false;
+        }
+        if (expr.left->staticType == StaticType::BOOLEAN) {
+            // Both operands are evaluated, as in binaryOperation
+            BooleanFn left = compileBoolean(*expr.left);
+            BooleanFn right = compileBoolean(*expr.right);
+            if (expr.op.type == Tokenization::AND) {
+                boolean = [left = std::move(left), right = std::move(right)] {
+                    bool a = left();
+                    bool b = right();
+                    return a && b;
+                };
+            } else {
+                boolean = [left = std::move(left), right = std::move(right)] {
+                    bool a = left();
+                    bool b = right();
+                    return a || b;
+                };
+            }
+            return false;
+        }
+        // Strings compared by == or <>
+        boolean = [left = compileValue(*expr.left), right = compileValue(*expr.right),
+                   equal = expr.op.type == Tokenization::EQUAL_EQUAL] {
+            Literal a = left();
+            Literal b = right();
+            return (*std::get_if<Values::RcString>(&a) == *std::get_if<Values::RcString>(&b)) == equal;
+        };
+        return false;
+    }
+
+    bool Compiler::visitBoolean(GroupingExpr &expr) {
+        boolean = compileBoolean(*expr.expression);
+        return false;
+    }
+
+    bool Compiler::visitBoolean(LiteralExpr &expr) {
+        boolean = [literal = *std::get_if<bool>(&expr.value)] { return literal; };
+        return false;
+    }
+
+    bool Compiler::visitBoolean(VarExpr &expr) {
+        boolean = [this, variable = slot(expr.varName), line = expr.line] {
+            const Literal *value = find(variable);
+            if (const bool *boolean = value ? std::get_if<bool>(value) : nullptr) [[likely]] return *boolean;
+            interpreter.throwUnprovenRead(variable.var->name, value, "boolean", line);
+            return false;  // Unreachable
+        };
+        return false;
+    }
+
+    // Statements
+
+    void Compiler::visit(PrintStmt &stmt) {
+        if (stmt.expressions.size() == 1) {
+            statement = [this, expr = compileValue(*stmt.expressions[0])] {
+                Literal printed = expr();
+                interpreter.output << interpreter.textOf(printed, interpreter.printBuffer) << std::endl;
+                return Flow::NEXT;
+            };
+            return;
+        }
+        std::vector<ValueFn> expressions;
+        for (auto &expr: stmt.expressions) expressions.push_back(compileValue(*expr));
+        statement = [this, expressions = std::move(expressions), &stmt] {
+            size_t base = interpreter.printValues.size();
+            for (const ValueFn &expr: expressions) interpreter.printValues.push_back(expr());
+            interpreter.print(stmt, base);
+            return Flow::NEXT;
+        };
+    }
+
+    void Compiler::visit(InputStmt &stmt) {
+        statement = [this, prompt = compileValue(*stmt.expr), &stmt] {
+            Literal text = prompt();
+            interpreter.readInput(stmt, text);
+            return Flow::NEXT;
+        };
+    }
+
+    void Compiler::visit(LetStmt &stmt) {
+        uint32_t line = stmt.line;
+        if (stmt.expr->staticType == StaticType::NUMBER) {
+            statement = [this, expr = compileNumber(*stmt.expr), variable = slot(stmt.targetVarName), line] {
+                double assigned = expr();
+                interpreter.store(write(variable), assigned, line);
+                return Flow::NEXT;
+            };
+            return;
+        }
+        statement = [this, expr = compileValue(*stmt.expr), variable = slot(stmt.targetVarName), line] {
+            Literal assigned = expr();
+            interpreter.store(write(variable), std::move(assigned), line);
+            return Flow::NEXT;
+        };
+    }
+
+    void Compiler::visit(ArrayLetStmt &stmt) {
+        uint32_t line = stmt.line;
+        if (stmt.index->staticType == StaticType::NUMBER && stmt.expr->staticType == StaticType::NUMBER) {
+            statement = [this, index = compileNumber(*stmt.index), expr = compileNumber(*stmt.expr),
+                         variable = slot(stmt.targetVarName), line] {
+                double position = index();
+                double assigned = expr();
+                Values::NumArray &array = interpreter.getArray(find(variable), *variable.var, line);
+                array.values[interpreter.arrayIndex(array, position, line)] = assigned;
+                return Flow::NEXT;
+            };
+            return;
+        }
+        statement = [this, index = compileValue(*stmt.index), expr = compileValue(*stmt.expr),
+                     variable = slot(stmt.targetVarName), line] {
+            Literal position = index();
+            Literal assigned = expr();
+            if (!std::holds_alternative<double>(assigned)) interpreter.throwError("ArrayElementNotNumber", line);
+            Values::NumArray &array = interpreter.getArray(find(variable), *variable.var, line);
+            array.values[interpreter.arrayIndex(array, position, line)] = std::get<double>(assigned);
+            return Flow::NEXT;
+        };
+    }
+
+    void Compiler::visit(DimStmt &stmt) {
+        statement = [this, size = compileValue(*stmt.size), &stmt] {
+            Literal elements = size();
+            interpreter.dim(stmt, elements);
+            return Flow::NEXT;
+        };
+    }
+
+    // Statements without expressions run the visit itself
+    void Compiler::visit(MapStmt &stmt) {
+        statement = [this, &stmt] {
+            interpreter.Interpreter::visit(stmt);
+            return Flow::NEXT;
+        };
+    }
+
+    void Compiler::visit(PutStmt &stmt) {
+        statement = [this, key = compileValue(*stmt.key), expr = compileValue(*stmt.value), &stmt] {
+            Literal keyValue = key();
+            Literal stored = expr();
+            interpreter.put(stmt, keyValue, std::move(stored));
+            return Flow::NEXT;
+        };
+    }
+
+    void Compiler::visit(GetStmt &stmt) {
+        statement = [this, key = compileValue(*stmt.key), &stmt] {
+            Literal keyValue = key();
+            interpreter.get(stmt, keyValue);
+            return Flow::NEXT;
+        };
+    }
+
+    void Compiler::visit(ToNumStmt &stmt) {
+        statement = [this, &stmt] {
+            interpreter.Interpreter::visit(stmt);
+            return Flow::NEXT;
+        };
+    }
+
+    void Compiler::visit(ToStrStmt &stmt) {
+        statement = [this, &stmt] {
+            interpreter.Interpreter::visit(stmt);
+            return Flow::NEXT;
+        };
+    }
+
+    void Compiler::visit(RndStmt &stmt) {
+        statement = [this, lowerBound = compileValue(*stmt.lowerBound), upperBound = compileValue(*stmt.upperBound),
+                     &stmt] {
+            Literal lower = lowerBound();
+            Literal upper = upperBound();
+            interpreter.rnd(stmt, lower, upper);
+            return Flow::NEXT;
+        };
+    }
+
+    void Compiler::visit(BlockStmt &stmt) {
+        std::vector<StmtFn> statements;
+        for (auto &nested: stmt.statementsList) statements.push_back(compileStatement(*nested));
+        statement = [this, statements = std::move(statements), &stmt] {
+            interpreter.chargeFuel(stmt);
+            for (const StmtFn &nested: statements) {
+                interpreter.statementsExecuted++;
+                Flow flow = nested();
+                if (flow != Flow::NEXT) return flow;
+            }
+            return Flow::NEXT;
+        };
+    }
+
+    void Compiler::visit(IfStmt &stmt) {
+        BooleanFn condition = compileCondition(*stmt.conditionExpr, stmt.line);
+        StmtFn thenBranch = compileStatement(*stmt.thenBranch);
+        if (!stmt.elseBranch.has_value()) {
+            statement = [condition = std::move(condition), thenBranch = std::move(thenBranch)] {
+                return condition() ? thenBranch() : Flow::NEXT;
+            };
+            return;
+        }
+        statement = [condition = std::move(condition), thenBranch = std::move(thenBranch),
+                     elseBranch = compileStatement(*stmt.elseBranch.value())] {
+            return condition() ? thenBranch() : elseBranch();
+        };
+    }
+
+    void Compiler::visit(WhileStmt &stmt) {
+        statement = [condition = compileCondition(*stmt.conditionExpr, stmt.line),
+                     body = compileStatement(*stmt.thenBranch)] {
+            while (condition()) {
+                Flow flow = body();
+                if (flow == Flow::BREAK) break;
+                if (flow == Flow::RETURN) return flow;
+            }
+            return Flow::NEXT;
+        };
+    }
+
+    void Compiler::visit(ParallelForStmt &stmt) {
+        // Iterations run on interpreters of their own threads
+        statement = [this, &stmt] {
+            interpreter.Interpreter::visit(stmt);
+            return Flow::NEXT;
+        };
+    }
+
+    void Compiler::visit(FunctionStmt &stmt) {
+        // Functions are bound to calls by the parser, the definition itself does nothing
+        statement = [] { return Flow::NEXT; };
+    }
+
+    void Compiler::visit(CallStmt &stmt) {
+        statement = [call = compileCall(*stmt.call, false)] {
+            call();
+            return Flow::NEXT;
+        };
+    }
+
+    void Compiler::visit(ReturnStmt &stmt) {
+        if (!stmt.value.has_value()) {
+            statement = [this] {
+                interpreter.returnValue.reset();
+                return Flow::RETURN;
+            };
+            return;
+        }
+        statement = [this, expr = compileValue(*stmt.value.value())] {
+            interpreter.returnValue = expr();
+            return Flow::RETURN;
+        };
+    }
+
+    void Compiler::visit(ContinueStmt &stmt) {
+        statement = [] { return Flow::CONTINUE; };
+    }
+
+    void Compiler::visit(BreakStmt &stmt) {
+        statement = [] { return Flow::BREAK; };
+    }
+
+    void Compiler::visit(OpenStmt &stmt) {
+        statement = [this, path = compileValue(*stmt.path), fileNumber = compileValue(*stmt.fileNumber), &stmt] {
+            Literal pathValue = path();
+            if (!std::holds_alternative<Values::RcString>(pathValue)) interpreter.throwError("FilePathNotString", stmt);
+            Literal number = fileNumber();
+            interpreter.openFile(stmt, std::get<Values::RcString>(pathValue), interpreter.fileNumber(number, stmt.line));
+            return Flow::NEXT;
+        };
+    }
+
+    void Compiler::visit(ReadLineStmt &stmt) {
+        statement = [this, fileNumber = compileValue(*stmt.fileNumber), &stmt] {
+            Literal number = fileNumber();
+            interpreter.readLine(stmt, interpreter.getFile(interpreter.fileNumber(number, stmt.line), stmt.line));
+            return Flow::NEXT;
+        };
+    }
+
+    void Compiler::visit(WriteStmt &stmt) {
+        statement = [this, fileNumber = compileValue(*stmt.fileNumber), expr = compileValue(*stmt.expr), &stmt] {
+            Literal number = fileNumber();
+            Interpreting::Interpreter::OpenFile &file = interpreter.getFile(interpreter.fileNumber(number, stmt.line),
+                                                                            stmt.line);
+            if (!file.writer) interpreter.throwError("FileNotOpenForOutput", stmt);
+            Literal written = expr();
+            interpreter.writeLine(stmt, file, written);
+            return Flow::NEXT;
+        };
+    }
+
+    void Compiler::visit(CloseStmt &stmt) {
+        statement = [this, fileNumber = compileValue(*stmt.fileNumber), &stmt] {
+            Literal number = fileNumber();
+            interpreter.closeFile(stmt, interpreter.fileNumber(number, stmt.line));
+            return Flow::NEXT;
+        };
+    }
+}
@@ -0,0 +1,150 @@
+#ifndef BASICPLUSPLUS_CLOSURES_HPP
+#define BASICPLUSPLUS_CLOSURES_HPP
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include "ExpressionsStatements.hpp"
+#include "Interpreter.hpp"
+
+// `--engine=closure` compiles every statement and expression once to a tree of closures. The operator, proven types
+// of the operands and storage of the variables are bound when a node is compiled, so running it is one indirect call,
+// without accept() / visit() double dispatch and the switches of the visits. Closures run on an Interpreter and call
+// the same helpers its visits do, so output, errors, fuel, memory budget and checkpoints are exactly the same.
+namespace Closures {
+    // How a statement ended. BREAK, CONTINUE and RETURN are returned to the loop or call handling them, not thrown.
+    enum class Flow : uint8_t { NEXT, BREAK, CONTINUE, RETURN };
+
+    using ValueFn = std::function<Tokenization::Literal()>;
+    using NumberFn = std::function<double()>;
+    using BooleanFn = std::function<bool()>;
+    using StmtFn = std::function<Flow()>;
+
+    class Compiler : public ExprStmt::AbstractExprVisitor, public ExprStmt::AbstractStmtVisitor {
+    private:
+        // Variable resolved when compiled
+        struct Slot {
+            Tokenization::Literal **global;  // Entry of globals, nullptr for a local variable
+            const ExprStmt::VarRef *var;
+        };
+
+        Interpreting::Interpreter &interpreter;
+        // Global variables of the interpreter once they exist, map nodes are never removed while it runs
+        std::map<std::string, Tokenization::Literal *> globals;
+        // Bodies of the called functions, stored before a body is compiled so recursive calls find it
+        std::unordered_map<const ExprStmt::FunctionStmt *, StmtFn> functions;
+        std::unordered_map<const ExprStmt::Stmt *, StmtFn> topLevel;
+
+        // Closure built by the visit of the node being compiled
+        ValueFn value;
+        NumberFn number;
+        BooleanFn boolean;
+        StmtFn statement;
+        // Returned by the visits, acceptNumber / acceptBoolean of nodes without typed visits read it
+        Tokenization::Literal placeholder;
+
+        ValueFn compileValue(ExprStmt::Expr &expr);
+
+        // Only for expressions whose staticType is NUMBER / BOOLEAN, or which are always one
+        NumberFn compileNumber(ExprStmt::Expr &expr);
+
+        BooleanFn compileBoolean(ExprStmt::Expr &expr);
+
+        // Condition of IF / WHILE, ConditionNotBoolean when it is not a boolean
+        BooleanFn compileCondition(ExprStmt::Expr &expr, uint32_t line);
+
+        StmtFn compileStatement(ExprStmt::Stmt &stmt);
+
+        ValueFn compileCall(ExprStmt::CallExpr &expr, bool valueNeeded);
+
+        template<Tokenization::TokenType op>
+        ValueFn binary(ValueFn &&left, ValueFn &&right, uint32_t line);
+
+        Slot slot(const ExprStmt::VarRef &var);
+
+        // Value of the variable, nullptr when it is not declared
+        const Tokenization::Literal *find(const Slot &slot) {
+            if (slot.global) {
+                if (!*slot.global) [[unlikely]] {
+                    auto value = interpreter.globalVariables.find(slot.var->name);
+                    if (value == interpreter.globalVariables.end()) return nullptr;
+                    *slot.global = &value->second;
+                }
+                return *slot.global;
+            }
+            const std::optional<Tokenization::Literal> &value = interpreter.frames[interpreter.frameBase + slot.var->slot];
+            return value.has_value() ? &value.value() : nullptr;
+        }
+
+        // Variable to assign to, created when it does not exist yet
+        Tokenization::Literal &write(const Slot &slot) {
+            if (slot.global) {
+                if (!*slot.global) [[unlikely]] *slot.global = &interpreter.globalVariables[slot.var->name];
+                return **slot.global;
+            }
+            std::optional<Tokenization::Literal> &value = interpreter.frames[interpreter.frameBase + slot.var->slot];
+            if (!value.has_value()) value.emplace();
+            return value.value();
+        }
+
+    public:
+        explicit Compiler(Interpreting::Interpreter &interpreter) : interpreter(interpreter) {}
+
+        // Executes top level statement as Interpreter::interpret does, compiled on its first run
+        void run(ExprStmt::Stmt &stmt);
+
+        Tokenization::Literal visit(ExprStmt::UnaryExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::BinaryExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::GroupingExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::LiteralExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::VarExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::ArrayExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::ArrayFunctionExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::StringFunctionExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::CallExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::EofExpr &expr) override;
+
+        double visitNumber(ExprStmt::UnaryExpr &expr) override;
+        double visitNumber(ExprStmt::BinaryExpr &expr) override;
+        double visitNumber(ExprStmt::GroupingExpr &expr) override;
+        double visitNumber(ExprStmt::LiteralExpr &expr) override;
+        double visitNumber(ExprStmt::VarExpr &expr) override;
+        double visitNumber(ExprStmt::ArrayExpr &expr) override;
+
+        bool visitBoolean(ExprStmt::UnaryExpr &expr) override;
+        bool visitBoolean(ExprStmt::BinaryExpr &expr) override;
+        bool visitBoolean(ExprStmt::GroupingExpr &expr) override;
+        bool visitBoolean(ExprStmt::LiteralExpr &expr) override;
+        bool visitBoolean(ExprStmt::VarExpr &expr) override;
+
+        void visit(ExprStmt::PrintStmt &stmt) override;
+        void visit(ExprStmt::InputStmt &stmt) override;
+        void visit(ExprStmt::LetStmt &stmt) override;
+        void visit(ExprStmt::ArrayLetStmt &stmt) override;
+        void visit(ExprStmt::DimStmt &stmt) override;
+        void visit(ExprStmt::MapStmt &stmt) override;
+        void visit(ExprStmt::PutStmt &stmt) override;
+        void visit(ExprStmt::GetStmt &stmt) override;
+        void visit(ExprStmt::ToNumStmt &stmt) override;
+        void visit(ExprStmt::ToStrStmt &stmt) override;
+        void visit(ExprStmt::RndStmt &stmt) override;
+        void visit(ExprStmt::BlockStmt &stmt) override;
+        void visit(ExprStmt::IfStmt &stmt) override;
+        void visit(ExprStmt::WhileStmt &stmt) override;
+        void visit(ExprStmt::ParallelForStmt &stmt) override;
+        void visit(ExprStmt::FunctionStmt &stmt) override;
+        void visit(ExprStmt::CallStmt &stmt) override;
+        void visit(ExprStmt::ReturnStmt &stmt) override;
+        void visit(ExprStmt::ContinueStmt &stmt) override;
+        void visit(ExprStmt::BreakStmt &stmt) override;
+        void visit(ExprStmt::OpenStmt &stmt) override;
+        void visit(ExprStmt::ReadLineStmt &stmt) override;
+        void visit(ExprStmt::WriteStmt &stmt) override;
+        void visit(ExprStmt::CloseStmt &stmt) override;
+    };
+}
+
+#endif //BASICPLUSPLUS_CLOSURES_HPP
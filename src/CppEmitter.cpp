@@ -0,0 +1,1339 @@
+#include <charconv>
+#include <cmath>
+#include "CppEmitter.hpp"
+#include "NumArray.hpp"
+
+namespace Emitting {
+    using namespace ExprStmt;
+    using Tokenization::Literal;
+
+    // Written at the top of every generated translation unit
+    static constexpr std::string_view runtime = R"runtime(
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// Runtime of programs compiled from BASIC, behaving as the basicpp interpreter does
+namespace rt {
+    struct MapData;
+    using Array = std::shared_ptr<std::vector<double>>;
+    using Map = std::shared_ptr<MapData>;
+    // Empty in variables not assigned yet
+    using Value = std::variant<std::monostate, std::string, double, bool, Array, Map>;
+
+    // Map keeping entries in insertion order
+    struct MapData {
+        std::vector<std::pair<std::string, Value>> entries;
+        std::unordered_map<std::string, size_t> index;
+
+        const Value *find(const std::string &key) const {
+            auto entry = index.find(key);
+            return entry == index.end() ? nullptr : &entries[entry->second].second;
+        }
+
+        void put(const std::string &key, Value &&value) {
+            auto [entry, inserted] = index.try_emplace(key, entries.size());
+            if (inserted) entries.emplace_back(key, std::move(value));
+            else entries[entry->second].second = std::move(value);
+        }
+    };
+
+    enum Op { PLUS, MINUS, STAR, SLASH, LESS, GREATER, LESS_EQUAL, GREATER_EQUAL, EQUAL_EQUAL, NOT_EQUAL, AND, OR };
+    enum ArrayFunction { SUM, MIN, MAX };
+
+    static const char *const symbols[] = {"+", "-", "*", "/", "<", ">", "<=", ">=", "==", "<>", "AND", "OR"};
+
+    static std::mt19937_64 random;
+    static uint32_t callDepth = 0;
+    static constexpr uint32_t maxCallDepth = 1000;
+
+    struct File {
+        FILE *stream;
+        bool output;
+        uint32_t line;  // Of the OPEN statement
+    };
+    static std::unordered_map<int64_t, File> files;
+
+    // Writes what is buffered, ignoring errors, as the interpreter does when it stops
+    static void dropFiles() {
+        for (auto &[number, file]: files) std::fclose(file.stream);
+        files.clear();
+    }
+
+    [[noreturn]] static void fail(const std::string &message, uint32_t line) {
+        dropFiles();
+        std::cout << "[line " << line << "] Interpreter error: " << message << std::endl;
+        std::exit(13);
+    }
+
+    // BREAK or CONTINUE outside of loop at top level, the interpreter does not handle it
+    [[noreturn]] static void unexpected() {
+        dropFiles();
+        std::cout.flush();
+        std::cerr << "Unexpected exception: std::exception" << std::endl;
+        std::exit(1);
+    }
+
+    static const char *typeName(const Value &value) {
+        switch (value.index()) {
+            case 1: return "string";
+            case 2: return "number";
+            case 3: return "boolean";
+            case 4: return "array";
+            case 5: return "map";
+        }
+        return "";
+    }
+
+    static std::string format(double number) {
+        // Whole number is printed without decimal places, ones in int64_t range without printf
+        if (number >= -9223372036854775808.0 && number < 9223372036854775808.0) {
+            int64_t whole = static_cast<int64_t>(number);
+            if (static_cast<double>(whole) == number && (whole != 0 || !std::signbit(number))) {
+                return std::to_string(whole);
+            }
+        }
+        char buffer[512];
+        std::snprintf(buffer, sizeof(buffer), std::fmod(number, 1) == 0 ? "%.0f" : "%.2f", number);
+        return buffer;
+    }
+
+    static std::string stringify(const Value &value);
+
+    static std::string stringify(const Array &array) {
+        std::string result = "[";
+        for (size_t i = 0; i < array->size(); i++) {
+            if (i > 0) result += ", ";
+            result += format((*array)[i]);
+        }
+        return result + "]";
+    }
+
+    static std::string stringify(const Map &map) {
+        std::string result = "{";
+        for (auto &[key, value]: map->entries) {
+            if (result.size() > 1) result += ", ";
+            result += key;
+            result += ": " + stringify(value);
+        }
+        return result + "}";
+    }
+
+    static std::string stringify(const Value &value) {
+        switch (value.index()) {
+            case 1: return std::get<std::string>(value);
+            case 2: return format(std::get<double>(value));
+            case 3: return std::get<bool>(value) ? "TRUE" : "FALSE";
+            case 4: return stringify(std::get<Array>(value));
+            case 5: return stringify(std::get<Map>(value));
+        }
+        return "";
+    }
+
+    // Text of a value as PRINT writes it
+    static const std::string &text(const std::string &string) { return string; }
+    static std::string text(double number) { return format(number); }
+    static std::string text(bool boolean) { return boolean ? "TRUE" : "FALSE"; }
+    static std::string text(const Array &array) { return stringify(array); }
+    static std::string text(const Map &map) { return stringify(map); }
+    static std::string text(const Value &value) { return stringify(value); }
+
+    static std::string concat(std::string_view left, std::string_view right) {
+        std::string result;
+        result.reserve(left.size() + right.size());
+        result += left;
+        result += right;
+        return result;
+    }
+
+    template<class... Texts>
+    static void print(const Texts &...texts) {
+        (std::cout << ... << texts) << '\n';
+    }
+
+    static std::string input(std::string_view prompt) {
+        std::cout << prompt << std::flush;
+        std::string line;
+        std::getline(std::cin, line);
+        return line;
+    }
+
+    // Variables
+    static const Value &read(const Value &value, const char *name, uint32_t line) {
+        if (value.index() == 0) [[unlikely]] fail("VariableNotDeclared '" + std::string(name) + "'", line);
+        return value;
+    }
+
+    template<class T>
+    static const T &read(const T &value, bool assigned, const char *name, uint32_t line) {
+        if (!assigned) [[unlikely]] fail("VariableNotDeclared '" + std::string(name) + "'", line);
+        return value;
+    }
+
+    static bool condition(const Value &value, uint32_t line) {
+        if (value.index() != 3) fail("ConditionNotBoolean", line);
+        return std::get<bool>(value);
+    }
+
+    // Arrays, folds add and compare in the order of the interpreter kernels
+    static constexpr size_t lanes = BASICPP_LANES;
+
+    template<class Vector, class Scalar>
+    static double fold(const std::vector<double> &a, double identity, Vector vector, Scalar scalar) {
+        double acc[4][lanes];
+        for (auto &accumulator: acc) {
+            for (double &lane: accumulator) lane = identity;
+        }
+        size_t n = a.size();
+        size_t i = 0;
+        for (; i + 4 * lanes <= n; i += 4 * lanes) {
+            for (size_t k = 0; k < 4; k++) {
+                for (size_t j = 0; j < lanes; j++) acc[k][j] = vector(acc[k][j], a[i + k * lanes + j]);
+            }
+        }
+        double total[lanes];
+        for (size_t j = 0; j < lanes; j++) total[j] = vector(vector(acc[0][j], acc[1][j]), vector(acc[2][j], acc[3][j]));
+        double result = total[0];
+        for (size_t j = 1; j < lanes; j++) result = scalar(result, total[j]);
+        for (; i < n; i++) result = scalar(result, a[i]);
+        return result;
+    }
+
+    static double arrayFunction(ArrayFunction function, const char *name, const Value &argument, uint32_t line) {
+        if (argument.index() != 4) fail("'" + std::string(name) + "' is not allowed on '" + typeName(argument) + "' type.", line);
+        const std::vector<double> &array = *std::get<Array>(argument);
+        auto add = [](double a, double b) { return a + b; };
+        if (function == SUM) return fold(array, 0., add, add);
+
+        if (array.empty()) fail("EmptyArray", line);
+        // Vector instructions return the second operand when the first is not less / greater
+        if (function == MIN) {
+            return fold(array, array[0], [](double a, double b) { return lanes > 1 ? (a < b ? a : b) : (b < a ? b : a); },
+                        [](double a, double b) { return b < a ? b : a; });
+        }
+        return fold(array, array[0], [](double a, double b) { return lanes > 1 ? (a > b ? a : b) : (b > a ? b : a); },
+                    [](double a, double b) { return b > a ? b : a; });
+    }
+
+    // String functions get typed arguments as they are and others as Value, checked in the order of the arguments
+    static const std::string &stringText(const char *, const std::string &text, uint32_t) { return text; }
+
+    static const std::string &stringText(const char *name, const Value &text, uint32_t line) {
+        if (text.index() != 1) fail("'" + std::string(name) + "' is not allowed on '" + typeName(text) + "' type.", line);
+        return std::get<std::string>(text);
+    }
+
+    static uint64_t stringCount(const char *, double number, uint64_t minimum, uint32_t line) {
+        if (number >= 9223372036854775808.0 && std::isfinite(number)) return UINT64_MAX;
+        if (!(number >= static_cast<double>(minimum)) || number != std::floor(number)) {
+            fail("InvalidStringPosition", line);
+        }
+        return static_cast<uint64_t>(number);
+    }
+
+    static uint64_t stringCount(const char *name, const Value &count, uint64_t minimum, uint32_t line) {
+        if (count.index() != 2) fail("'" + std::string(name) + "' is not allowed on '" + typeName(count) + "' type.", line);
+        return stringCount(name, std::get<double>(count), minimum, line);
+    }
+
+    template<class Text>
+    static double len(const Text &text, uint32_t line) {
+        return static_cast<double>(stringText("LEN", text, line).size());
+    }
+
+    template<class Text, class Start>
+    static std::string mid(const Text &text, const Start &start, uint32_t line) {
+        const std::string &string = stringText("MID", text, line);
+        return string.substr(std::min<uint64_t>(stringCount("MID", start, 1, line) - 1, string.size()));
+    }
+
+    template<class Text, class Start, class Length>
+    static std::string mid(const Text &text, const Start &start, const Length &length, uint32_t line) {
+        const std::string &string = stringText("MID", text, line);
+        uint64_t offset = std::min<uint64_t>(stringCount("MID", start, 1, line) - 1, string.size());
+        return string.substr(offset, stringCount("MID", length, 0, line));
+    }
+
+    template<class Text, class Length>
+    static std::string left(const Text &text, const Length &length, uint32_t line) {
+        const std::string &string = stringText("LEFT", text, line);
+        return string.substr(0, stringCount("LEFT", length, 0, line));
+    }
+
+    template<class Text, class Length>
+    static std::string right(const Text &text, const Length &length, uint32_t line) {
+        const std::string &string = stringText("RIGHT", text, line);
+        return string.substr(string.size() - std::min<uint64_t>(stringCount("RIGHT", length, 0, line), string.size()));
+    }
+
+    static double findFrom(const std::string &text, const std::string &search, uint64_t from) {
+        size_t found = from > text.size() ? std::string::npos : text.find(search, from);
+        return found == std::string::npos ? 0. : static_cast<double>(found + 1);
+    }
+
+    template<class Text, class Search>
+    static double instr(const Text &text, const Search &search, uint32_t line) {
+        const std::string &string = stringText("INSTR", text, line);
+        return findFrom(string, stringText("INSTR", search, line), 0);
+    }
+
+    template<class Text, class Search, class Start>
+    static double instr(const Text &text, const Search &search, const Start &start, uint32_t line) {
+        const std::string &string = stringText("INSTR", text, line);
+        const std::string &pattern = stringText("INSTR", search, line);
+        return findFrom(string, pattern, stringCount("INSTR", start, 1, line) - 1);
+    }
+
+    template<class Text>
+    static std::string upper(const Text &text, uint32_t line) {
+        std::string result = stringText("UPPER", text, line);
+        for (char &c: result) if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+        return result;
+    }
+
+    template<class Text>
+    static std::string lower(const Text &text, uint32_t line) {
+        std::string result = stringText("LOWER", text, line);
+        for (char &c: result) if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        return result;
+    }
+
+    template<class Text, class Separator, class Field>
+    static std::string split(const Text &text, const Separator &separator, const Field &field, uint32_t line) {
+        const std::string &string = stringText("SPLIT", text, line);
+        const std::string &by = stringText("SPLIT", separator, line);
+        uint64_t wanted = stringCount("SPLIT", field, 1, line);
+        if (by.empty()) fail("EmptySeparator", line);
+        size_t start = 0;
+        for (uint64_t i = 1; i < wanted; i++) {
+            size_t end = string.find(by, start);
+            if (end == std::string::npos) return "";
+            start = end + by.size();
+        }
+        size_t end = string.find(by, start);
+        return string.substr(start, end == std::string::npos ? std::string::npos : end - start);
+    }
+
+    static Array dim(const Value &size, uint32_t line) {
+        if (size.index() != 2) fail("'DIM' is not allowed on '" + std::string(typeName(size)) + "' type.", line);
+        double elements = std::floor(std::get<double>(size));
+        if (!(elements >= 0 && elements <= static_cast<double>(std::vector<double>().max_size()))) {
+            fail("InvalidArraySize", line);
+        }
+        try {
+            return std::make_shared<std::vector<double>>(static_cast<size_t>(elements), 0.);
+        } catch (const std::bad_alloc &) {
+            fail("InvalidArraySize", line);
+        } catch (const std::length_error &) {
+            fail("InvalidArraySize", line);
+        }
+    }
+
+    static std::vector<double> &arrayOf(const Value &value, const char *name, uint32_t line) {
+        if (value.index() == 0) fail("VariableNotDeclared '" + std::string(name) + "'", line);
+        if (value.index() != 4) fail("Indexing is not allowed on '" + std::string(typeName(value)) + "' type.", line);
+        return *std::get<Array>(value);
+    }
+
+    static std::vector<double> &arrayOf(const Array &array, bool assigned, const char *name, uint32_t line) {
+        if (!assigned) fail("VariableNotDeclared '" + std::string(name) + "'", line);
+        return *array;
+    }
+
+    static size_t position(const std::vector<double> &array, double index, uint32_t line) {
+        // Fractional index is truncated
+        if (!(index >= 0 && index < static_cast<double>(array.size()))) fail("IndexOutOfRange", line);
+        return static_cast<size_t>(index);
+    }
+
+    static size_t position(const std::vector<double> &array, const Value &index, uint32_t line) {
+        if (index.index() != 2) fail("IndexNotNumber", line);
+        return position(array, std::get<double>(index), line);
+    }
+
+    template<class Index>
+    static double element(const std::vector<double> &array, const Index &index, uint32_t line) {
+        return array[position(array, index, line)];
+    }
+
+    static double elementValue(double value, uint32_t) { return value; }
+
+    static double elementValue(const Value &value, uint32_t line) {
+        if (value.index() != 2) fail("ArrayElementNotNumber", line);
+        return std::get<double>(value);
+    }
+
+    // Element-wise `+ - * /` where at least one operand is an array
+    static Value arrayOperation(Op op, const Value &left, const Value &right, uint32_t line) {
+        bool leftArray = left.index() == 4;
+        bool rightArray = right.index() == 4;
+        if ((!leftArray && left.index() != 2) || (!rightArray && right.index() != 2)) {
+            fail("Binary '" + std::string(symbols[op]) + "' is not allowed on '" + typeName(left) + "' " + symbols[op]
+                 + " '" + typeName(right) + "' types.", line);
+        }
+        const std::vector<double> *a = leftArray ? std::get<Array>(left).get() : nullptr;
+        const std::vector<double> *b = rightArray ? std::get<Array>(right).get() : nullptr;
+        if (a && b && a->size() != b->size()) fail("ArraySizeMismatch", line);
+        size_t n = a ? a->size() : b->size();
+        if (op == SLASH) {
+            bool zeroDivisor = false;
+            if (b) {
+                for (double value: *b) zeroDivisor |= value == 0;
+            } else {
+                zeroDivisor = std::get<double>(right) == 0;
+            }
+            if (zeroDivisor) fail("DivisionByZero", line);
+        }
+
+        Array result = std::make_shared<std::vector<double>>(n);
+        for (size_t i = 0; i < n; i++) {
+            double x = a ? (*a)[i] : std::get<double>(left);
+            double y = b ? (*b)[i] : std::get<double>(right);
+            switch (op) {
+                case PLUS: (*result)[i] = x + y; break;
+                case MINUS: (*result)[i] = x - y; break;
+                case STAR: (*result)[i] = x * y; break;
+                default: (*result)[i] = x / y; break;
+            }
+        }
+        return result;
+    }
+
+    // Operators on values of types not known when compiled
+    static double divide(double left, double right, uint32_t line) {
+        if (right == 0) fail("DivisionByZero", line);
+        return left / right;
+    }
+
+    static Value binary(Op op, const Value &left, const Value &right, uint32_t line) {
+        bool numbers = left.index() == 2 && right.index() == 2;
+        switch (op) {
+            case PLUS:
+                if (numbers) return std::get<double>(left) + std::get<double>(right);
+                if (left.index() == 1 || right.index() == 1) return concat(text(left), text(right));
+                if (left.index() == 4 || right.index() == 4) return arrayOperation(op, left, right, line);
+                break;
+            case MINUS:
+            case STAR:
+            case SLASH:
+                if (numbers) {
+                    double a = std::get<double>(left);
+                    double b = std::get<double>(right);
+                    if (op == MINUS) return a - b;
+                    if (op == STAR) return a * b;
+                    return divide(a, b, line);
+                }
+                if (left.index() == 4 || right.index() == 4) return arrayOperation(op, left, right, line);
+                break;
+            case LESS:
+                if (numbers) return std::get<double>(left) < std::get<double>(right);
+                break;
+            case GREATER:
+                if (numbers) return std::get<double>(left) > std::get<double>(right);
+                break;
+            case LESS_EQUAL:
+                if (numbers) return std::get<double>(left) <= std::get<double>(right);
+                break;
+            case GREATER_EQUAL:
+                if (numbers) return std::get<double>(left) >= std::get<double>(right);
+                break;
+            case EQUAL_EQUAL:
+            case NOT_EQUAL:
+                if (numbers || (left.index() == 1 && right.index() == 1)) return (left == right) == (op == EQUAL_EQUAL);
+                break;
+            case AND:
+                if (left.index() == 3 && right.index() == 3) return std::get<bool>(left) && std::get<bool>(right);
+                break;
+            case OR:
+                if (left.index() == 3 && right.index() == 3) return std::get<bool>(left) || std::get<bool>(right);
+                break;
+        }
+        fail("Binary '" + std::string(symbols[op]) + "' is not allowed on '" + typeName(left) + "' " + symbols[op] + " '"
+             + typeName(right) + "' types.", line);
+    }
+
+    static Value negate(const Value &value, uint32_t line) {
+        if (value.index() == 2) return -std::get<double>(value);
+        if (value.index() == 4) return arrayOperation(STAR, value, -1., line);
+        fail("Unary '-' is not allowed on '" + std::string(typeName(value)) + "' type.", line);
+    }
+
+    static bool logicalNot(const Value &value, uint32_t line) {
+        if (value.index() == 3) return !std::get<bool>(value);
+        fail("Unary 'NOT' is not allowed on '" + std::string(typeName(value)) + "' type.", line);
+    }
+
+    // Maps
+    static const std::string &key(const std::string &key, uint32_t) { return key; }
+
+    static const std::string &key(const Value &key, uint32_t line) {
+        if (key.index() != 1) fail("KeyNotString", line);
+        return std::get<std::string>(key);
+    }
+
+    template<class T>
+    static const T &storable(const T &value, uint32_t) { return value; }
+
+    static const Value &storable(const Value &value, uint32_t line) {
+        // Maps can not contain maps
+        if (value.index() == 5) fail("'PUT' is not allowed on 'map' value.", line);
+        return value;
+    }
+
+    static MapData &mapOf(const Value &value, const char *name, const char *statement, uint32_t line) {
+        if (value.index() == 0) fail("VariableNotDeclared '" + std::string(name) + "'", line);
+        if (value.index() != 5) {
+            fail("'" + std::string(statement) + "' is not allowed on '" + typeName(value) + "' type.", line);
+        }
+        return *std::get<Map>(value);
+    }
+
+    static MapData &mapOf(const Map &map, bool assigned, const char *name, const char *, uint32_t line) {
+        if (!assigned) fail("VariableNotDeclared '" + std::string(name) + "'", line);
+        return *map;
+    }
+
+    static Value get(const MapData &map, const std::string &key, uint32_t line) {
+        const Value *value = map.find(key);
+        if (!value) fail("KeyNotFound '" + key + "'", line);
+        return *value;
+    }
+
+    // Conversions
+    static double toNumber(const std::string &text, uint32_t line) {
+        try {
+            return std::stod(text);
+        } catch (const std::invalid_argument &) {
+            fail("InvalidNumberFormat", line);
+        } catch (const std::out_of_range &) {
+            fail("InvalidNumberFormat", line);
+        }
+    }
+
+    static double toNumber(double number, uint32_t) { return number; }
+
+    static double toNumber(bool boolean, uint32_t) { return boolean ? 1. : 0.; }
+
+    static double toNumber(const Value &value, uint32_t line) {
+        switch (value.index()) {
+            case 1: return toNumber(std::get<std::string>(value), line);
+            case 2: return std::get<double>(value);
+            case 3: return std::get<bool>(value) ? 1. : 0.;
+        }
+        fail("'TONUM' is not allowed on '" + std::string(typeName(value)) + "' type.", line);
+    }
+
+    static double rnd(const Value &lowerBound, const Value &upperBound, uint32_t line) {
+        if (lowerBound.index() != 2 || upperBound.index() != 2) {
+            fail("'RND' is not allowed on '" + std::string(typeName(lowerBound)) + "', '" + typeName(lowerBound)
+                 + "' types.", line);
+        }
+        int lowerBoundInt = std::ceil(std::get<double>(lowerBound));
+        int upperBoundInt = std::floor(std::get<double>(upperBound));
+        int range = upperBoundInt - lowerBoundInt;
+        if (range <= 0) fail("InvalidRange", line);
+        return static_cast<int>(random() % range) + lowerBoundInt;
+    }
+
+    // Functions
+    static void checkDepth(uint32_t line) {
+        if (callDepth >= maxCallDepth) fail("StackOverflow", line);
+    }
+
+    struct Call {
+        Call() { callDepth++; }
+        ~Call() { callDepth--; }
+    };
+
+    static Value returned(Value &&value, const char *name, uint32_t line) {
+        if (value.index() == 0) fail("NoReturnValue '" + std::string(name) + "'", line);
+        return std::move(value);
+    }
+
+    // Files
+    static int64_t fileNumber(const Value &value, uint32_t line) {
+        const double *number = std::get_if<double>(&value);
+        if (!number || *number != std::floor(*number) || *number < 0 || *number > INT32_MAX) fail("InvalidFileNumber", line);
+        return static_cast<int64_t>(*number);
+    }
+
+    static const std::string &filePath(const std::string &path, uint32_t) { return path; }
+
+    static const std::string &filePath(const Value &path, uint32_t line) {
+        if (path.index() != 1) fail("FilePathNotString", line);
+        return std::get<std::string>(path);
+    }
+
+    static void open(const std::string &path, int64_t number, bool output, uint32_t line) {
+        if (files.contains(number)) fail("FileAlreadyOpen #" + std::to_string(number), line);
+        int fd = output ? ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666)
+                        : ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        int error = errno;
+        struct stat status;
+        if (fd >= 0 && !output) {
+            if (fstat(fd, &status) < 0) error = errno;
+            else if (S_ISDIR(status.st_mode)) error = EISDIR;
+            else error = 0;
+            if (error) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+        if (fd < 0) fail("FileOpenFailed '" + path + "': " + std::strerror(error), line);
+        FILE *stream = fdopen(fd, output ? "w" : "r");
+        setvbuf(stream, nullptr, _IOFBF, 1 << 20);
+        files.emplace(number, File{stream, output, line});
+    }
+
+    static File &file(int64_t number, bool output, uint32_t line) {
+        auto file = files.find(number);
+        if (file == files.end()) fail("FileNotOpen #" + std::to_string(number), line);
+        if (file->second.output != output) fail(output ? "FileNotOpenForOutput" : "FileNotOpenForInput", line);
+        return file->second;
+    }
+
+    static bool eof(File &file, uint32_t line) {
+        int c = std::getc(file.stream);
+        if (c != EOF) {
+            std::ungetc(c, file.stream);
+            return false;
+        }
+        if (std::ferror(file.stream)) fail("FileReadFailed: " + std::string(std::strerror(errno)), line);
+        return true;
+    }
+
+    static std::string readLine(File &file, uint32_t line) {
+        char *data = nullptr;
+        size_t capacity = 0;
+        ssize_t length = getline(&data, &capacity, file.stream);
+        if (length < 0) {
+            int error = errno;
+            std::free(data);
+            if (std::ferror(file.stream)) fail("FileReadFailed: " + std::string(std::strerror(error)), line);
+            fail("EndOfFile", line);
+        }
+        if (length > 0 && data[length - 1] == '\n') length--;
+        std::string result(data, length);
+        std::free(data);
+        return result;
+    }
+
+    static void write(File &file, std::string_view text, uint32_t line) {
+        if (std::fwrite(text.data(), 1, text.size(), file.stream) != text.size() || std::fputc('\n', file.stream) == EOF) {
+            fail("FileWriteFailed: " + std::string(std::strerror(errno)), line);
+        }
+    }
+
+    static void close(int64_t number, uint32_t line) {
+        auto file = files.find(number);
+        if (file == files.end()) fail("FileNotOpen #" + std::to_string(number), line);
+        File closed = file->second;
+        files.erase(file);
+        if (std::fclose(closed.stream) != 0 && closed.output) {
+            fail("FileWriteFailed: " + std::string(std::strerror(errno)), line);
+        }
+    }
+
+    // Files the program left open, in the order the interpreter closes them
+    static void closeFiles() {
+        while (!files.empty()) {
+            auto file = files.begin();
+            File closed = file->second;
+            files.erase(file);
+            if (std::fclose(closed.stream) != 0 && closed.output) {
+                fail("FileWriteFailed: " + std::string(std::strerror(errno)), closed.line);
+            }
+        }
+    }
+}
+)runtime";
+
+    std::string CppEmitter::typeName(Type type) {
+        switch (type) {
+            case Type::NUMBER: return "double";
+            case Type::STRING: return "std::string";
+            case Type::BOOLEAN: return "bool";
+            case Type::ARRAY: return "rt::Array";
+            case Type::MAP: return "rt::Map";
+            default: return "rt::Value";
+        }
+    }
+
+    // Variables
+
+    CppEmitter::Variable &CppEmitter::variable(const VarRef &var) {
+        Variable &variable = var.slot >= 0 ? function->locals[var.slot] : globals[var.name];
+        if (variable.name.empty()) variable.name = var.name;
+        return variable;
+    }
+
+    CppEmitter::Type CppEmitter::storage(const Variable &variable) const {
+        return finalPass && variable.type == Type::NONE ? Type::VALUE : variable.type;
+    }
+
+    void CppEmitter::join(Variable &variable, Type type) {
+        if (type == Type::NONE || variable.type == type || variable.type == Type::VALUE) return;
+        variable.type = variable.type == Type::NONE ? type : Type::VALUE;
+        changed = true;
+    }
+
+    CppEmitter::Emitted CppEmitter::read(const VarRef &var, uint32_t line) {
+        Variable &v = variable(var);
+        Type type = storage(v);
+        if (v.parameter) return {"v_" + v.name, type, true};
+        v.checked = true;
+        std::string name = "\"" + v.name + "\", " + std::to_string(line);
+        if (type == Type::VALUE) return {"rt::read(v_" + v.name + ", " + name + ")", type, false};
+        return {"rt::read(v_" + v.name + ", s_" + v.name + ", " + name + ")", type, false};
+    }
+
+    std::string CppEmitter::container(const VarRef &var, const char *statement, uint32_t line) {
+        Variable &v = variable(var);
+        Type type = storage(v);
+        Type expected = statement ? Type::MAP : Type::ARRAY;
+        std::string function = statement ? "rt::mapOf(" : "rt::arrayOf(";
+        std::string arguments = "\"" + v.name + "\", ";
+        if (statement) arguments += "\"" + std::string(statement) + "\", ";
+        arguments += std::to_string(line) + ")";
+        if (type == expected) {
+            if (!v.parameter) v.checked = true;
+            return function + "v_" + v.name + ", " + (v.parameter ? "true" : "s_" + v.name) + ", " + arguments;
+        }
+        if (type == Type::VALUE) return function + "v_" + v.name + ", " + arguments;
+        // Other type fails after the check of the variable
+        return function + value(read(var, line)) + ", " + arguments;
+    }
+
+    void CppEmitter::assign(const VarRef &var, const Emitted &assigned) {
+        Variable &v = variable(var);
+        join(v, assigned.type);
+        Type type = storage(v);
+        if (type == Type::VALUE) {
+            line("v_" + v.name + " = " + value(assigned) + ";");
+            return;
+        }
+        line("v_" + v.name + " = " + assigned.code + ";");
+        if (v.checked && !v.parameter) line("s_" + v.name + " = true;");
+    }
+
+    void CppEmitter::declare(const Variable &variable, bool fromParameter, size_t parameter) {
+        Type type = storage(variable);
+        std::string name = "v_" + variable.name;
+        if (fromParameter) {
+            line(typeName(type) + " " + name + " = std::move(arguments.p" + std::to_string(parameter) + ");");
+            return;
+        }
+        if (type == Type::NUMBER) line("double " + name + " = 0;");
+        else if (type == Type::BOOLEAN) line("bool " + name + " = false;");
+        else line(typeName(type) + " " + name + ";");
+        if (type != Type::VALUE && variable.checked) line("bool s_" + variable.name + " = false;");
+    }
+
+    // Code
+
+    void CppEmitter::line(const std::string &statement) {
+        code.append(4 * indentation, ' ');
+        code += statement;
+        code += '\n';
+    }
+
+    CppEmitter::Emitted CppEmitter::emit(Expr &expr) {
+        expr.accept(*this);
+        return std::move(result);
+    }
+
+    std::string CppEmitter::value(const Emitted &emitted) {
+        return emitted.type == Type::VALUE ? emitted.code : "rt::Value(" + emitted.code + ")";
+    }
+
+    std::string CppEmitter::text(const Emitted &emitted) {
+        return emitted.type == Type::STRING ? emitted.code : "rt::text(" + emitted.code + ")";
+    }
+
+    CppEmitter::Emitted CppEmitter::sequence(const std::vector<Emitted> &operands,
+                                             const std::function<std::string(const std::vector<std::string> &)> &combine,
+                                             Type type, bool pure) {
+        std::vector<std::string> codes;
+        size_t impure = 0;
+        for (const Emitted &operand: operands) {
+            codes.push_back(operand.code);
+            if (!operand.pure) impure++;
+        }
+        // Order of one operand with effects among pure ones does not matter
+        if (impure <= 1) return {combine(codes), type, pure};
+
+        std::string lambda = "[&] { ";
+        for (size_t i = 0; i < operands.size(); i++) {
+            lambda += "auto &&t" + std::to_string(i) + " = " + codes[i] + "; ";
+            codes[i] = "t" + std::to_string(i);
+        }
+        return {lambda + "return " + combine(codes) + "; }()", type, false};
+    }
+
+    std::string CppEmitter::constant(const std::string &text) {
+        auto [entry, inserted] = constants.try_emplace(text, constants.size());
+        return "k_" + std::to_string(entry->second);
+    }
+
+    static std::string quote(const std::string &text) {
+        std::string quoted = "\"";
+        for (unsigned char c: text) {
+            if (c == '"' || c == '\\' || c == '?') {
+                quoted += '\\';
+                quoted += static_cast<char>(c);
+            } else if (c >= 0x20 && c < 0x7F) {
+                quoted += static_cast<char>(c);
+            } else {
+                // Octal escape takes at most 3 digits, so digits following it are not taken into it
+                quoted += '\\';
+                quoted += static_cast<char>('0' + (c >> 6));
+                quoted += static_cast<char>('0' + ((c >> 3) & 7));
+                quoted += static_cast<char>('0' + (c & 7));
+            }
+        }
+        return quoted + "\"";
+    }
+
+    static std::string numberLiteral(double number) {
+        if (std::isinf(number)) return "HUGE_VAL";
+        char buffer[64];
+        // Shortest text reading back as the same double
+        auto end = std::to_chars(buffer, buffer + sizeof(buffer), number).ptr;
+        std::string text(buffer, end);
+        if (text.find_first_of(".e") == std::string::npos) text += ".0";
+        return text;
+    }
+
+    static const char *opName(Tokenization::TokenType op) {
+        switch (op) {
+            case Tokenization::PLUS: return "rt::PLUS";
+            case Tokenization::MINUS: return "rt::MINUS";
+            case Tokenization::STAR: return "rt::STAR";
+            case Tokenization::SLASH: return "rt::SLASH";
+            case Tokenization::LESS: return "rt::LESS";
+            case Tokenization::GREATER: return "rt::GREATER";
+            case Tokenization::LESS_EQUAL: return "rt::LESS_EQUAL";
+            case Tokenization::GREATER_EQUAL: return "rt::GREATER_EQUAL";
+            case Tokenization::EQUAL_EQUAL: return "rt::EQUAL_EQUAL";
+            case Tokenization::NOT_EQUAL: return "rt::NOT_EQUAL";
+            case Tokenization::AND: return "rt::AND";
+            default: return "rt::OR";
+        }
+    }
+
+    CppEmitter::Type CppEmitter::typeOf(StaticType type) {
+        switch (type) {
+            case StaticType::NUMBER: return Type::NUMBER;
+            case StaticType::STRING: return Type::STRING;
+            case StaticType::BOOLEAN: return Type::BOOLEAN;
+            default: return Type::VALUE;
+        }
+    }
+
+    // Expressions
+
+    Literal CppEmitter::visit(UnaryExpr &expr) {
+        Emitted right = emit(*expr.right);
+        std::string line = std::to_string(expr.line);
+        if (expr.op.type == Tokenization::MINUS) {
+            if (right.type == Type::NUMBER) result = {"(-" + right.code + ")", Type::NUMBER, right.pure};
+            else if (right.type == Type::NONE) result = {"", Type::NONE, false};
+            else result = {"rt::negate(" + value(right) + ", " + line + ")", Type::VALUE, false};
+        } else {
+            if (right.type == Type::BOOLEAN) result = {"(!" + right.code + ")", Type::BOOLEAN, right.pure};
+            else result = {"rt::logicalNot(" + value(right) + ", " + line + ")", Type::BOOLEAN, false};
+        }
+        return false;
+    }
+
+    Literal CppEmitter::visit(BinaryExpr &expr) {
+        Emitted left = emit(*expr.left);
+        Emitted right = emit(*expr.right);
+        std::string line = std::to_string(expr.line);
+        bool pure = left.pure && right.pure;
+        bool numbers = left.type == Type::NUMBER && right.type == Type::NUMBER;
+        bool unknown = left.type == Type::NONE || right.type == Type::NONE;
+
+        auto native = [&](const std::string &op, Type type) {
+            result = sequence({left, right}, [&](auto &codes) { return "(" + codes[0] + " " + op + " " + codes[1] + ")"; },
+                              type, pure);
+        };
+        // Checked by the runtime as the interpreter checks it
+        Type leftType = left.type;
+        Type rightType = right.type;
+        auto generic = [&](Type type) {
+            std::string call = std::string("rt::binary(") + opName(expr.op.type) + ", ";
+            result = sequence({left, right}, [&](auto &codes) {
+                return call + value({codes[0], leftType, false}) + ", " + value({codes[1], rightType, false}) + ", "
+                       + line + ")";
+            }, type, false);
+            if (type == Type::BOOLEAN) result.code = "std::get<bool>(" + result.code + ")";
+        };
+
+        switch (expr.op.type) {
+            case Tokenization::PLUS:
+                if (numbers) native("+", Type::NUMBER);
+                else if (left.type == Type::STRING || right.type == Type::STRING) {
+                    // Anything added to a string is concatenated
+                    result = sequence({left, right}, [&](auto &codes) {
+                        return "rt::concat(" + text({codes[0], leftType, false}) + ", "
+                               + text({codes[1], rightType, false}) + ")";
+                    }, Type::STRING, pure);
+                } else if (unknown) result = {"", Type::NONE, false};
+                else generic(Type::VALUE);
+                break;
+            case Tokenization::MINUS:
+            case Tokenization::STAR:
+                if (numbers) native(expr.op.type == Tokenization::MINUS ? "-" : "*", Type::NUMBER);
+                else if (unknown) result = {"", Type::NONE, false};
+                else generic(Type::VALUE);
+                break;
+            case Tokenization::SLASH:
+                if (numbers) {
+                    result = sequence({left, right}, [&](auto &codes) {
+                        return "rt::divide(" + codes[0] + ", " + codes[1] + ", " + line + ")";
+                    }, Type::NUMBER, false);
+                } else if (unknown) result = {"", Type::NONE, false};
+                else generic(Type::VALUE);
+                break;
+            case Tokenization::LESS:
+            case Tokenization::GREATER:
+            case Tokenization::LESS_EQUAL:
+            case Tokenization::GREATER_EQUAL:
+                if (numbers) native(expr.op.lexeme, Type::BOOLEAN);
+                else generic(Type::BOOLEAN);
+                break;
+            case Tokenization::EQUAL_EQUAL:
+            case Tokenization::NOT_EQUAL:
+                if (numbers || (left.type == Type::STRING && right.type == Type::STRING)) {
+                    native(expr.op.type == Tokenization::EQUAL_EQUAL ? "==" : "!=", Type::BOOLEAN);
+                } else {
+                    generic(Type::BOOLEAN);
+                }
+                break;
+            default:
+                if (left.type == Type::BOOLEAN && right.type == Type::BOOLEAN) {
+                    // Both operands are evaluated, as in the interpreter
+                    native(expr.op.type == Tokenization::AND ? "&" : "|", Type::BOOLEAN);
+                    result.code = "bool" + result.code;
+                } else {
+                    generic(Type::BOOLEAN);
+                }
+                break;
+        }
+        return false;
+    }
+
+    Literal CppEmitter::visit(GroupingExpr &expr) {
+        result = emit(*expr.expression);
+        return false;
+    }
+
+    Literal CppEmitter::visit(LiteralExpr &expr) {
+        if (auto number = std::get_if<double>(&expr.value)) {
+            result = {numberLiteral(*number), Type::NUMBER, true};
+        } else if (auto boolean = std::get_if<bool>(&expr.value)) {
+            result = {*boolean ? "true" : "false", Type::BOOLEAN, true};
+        } else {
+            result = {constant(std::get<Values::RcString>(expr.value).str()), Type::STRING, true};
+        }
+        return false;
+    }
+
+    Literal CppEmitter::visit(VarExpr &expr) {
+        if (expr.staticType == StaticType::UNKNOWN) {
+            result = read(expr.varName, expr.line);
+            return false;
+        }
+        // Proven variables are assigned on every path
+        Variable &v = variable(expr.varName);
+        Type type = typeOf(expr.staticType);
+        if (storage(v) == Type::VALUE) result = {"std::get<" + typeName(type) + ">(v_" + v.name + ")", type, true};
+        else result = {"v_" + v.name, type, true};
+        return false;
+    }
+
+    Literal CppEmitter::visit(ArrayExpr &expr) {
+        Emitted index = emit(*expr.index);
+        if (index.type != Type::NUMBER) index.code = value(index);
+        Emitted array{container(expr.varName, nullptr, expr.line), Type::ARRAY, false};
+        std::string line = std::to_string(expr.line);
+        result = sequence({index, array}, [&](auto &codes) {
+            return "rt::element(" + codes[1] + ", " + codes[0] + ", " + line + ")";
+        }, Type::NUMBER, false);
+        return false;
+    }
+
+    Literal CppEmitter::visit(ArrayFunctionExpr &expr) {
+        static const char *functionNames[] = {"rt::SUM", "rt::MIN", "rt::MAX"};
+        Emitted argument = emit(*expr.argument);
+        result = {std::string("rt::arrayFunction(") + functionNames[expr.function] + ", " + quote(expr.name) + ", "
+                  + value(argument) + ", " + std::to_string(expr.line) + ")", Type::NUMBER, false};
+        return false;
+    }
+
+    Literal CppEmitter::visit(StringFunctionExpr &expr) {
+        static const char *functionNames[] = {"rt::len", "rt::mid", "rt::left", "rt::right", "rt::instr", "rt::upper",
+                                              "rt::lower", "rt::split"};
+        std::vector<Emitted> arguments;
+        for (auto &argument: expr.arguments) {
+            Emitted emitted = emit(*argument);
+            // Strings and numbers go to the overloads of their type, others are checked as Value
+            if (emitted.type != Type::STRING && emitted.type != Type::NUMBER) emitted.code = value(emitted);
+            arguments.push_back(std::move(emitted));
+        }
+        bool number = expr.function == StringFunctionExpr::LEN || expr.function == StringFunctionExpr::INSTR;
+        std::string line = std::to_string(expr.line);
+        result = sequence(arguments, [&](const std::vector<std::string> &codes) {
+            std::string call = std::string(functionNames[expr.function]) + "(";
+            for (const std::string &code: codes) call += code + ", ";
+            return call + line + ")";
+        }, number ? Type::NUMBER : Type::STRING, false);
+        return false;
+    }
+
+    std::string CppEmitter::call(CallExpr &expr) {
+        FunctionStmt &called = *expr.function;
+        Function &target = functions[called.name];
+        if (!target.stmt) {
+            target.stmt = &called;
+            target.locals.resize(called.frameSize);
+            for (uint32_t i = 0; i < called.parameterCount; i++) target.locals[i].parameter = true;
+        }
+        std::string line = std::to_string(expr.line);
+        // Braced initializer evaluates arguments left to right
+        std::string arguments;
+        for (size_t i = 0; i < expr.arguments.size(); i++) {
+            Emitted argument = emit(*expr.arguments[i]);
+            join(target.locals[i], argument.type);
+            if (i > 0) arguments += ", ";
+            arguments += storage(target.locals[i]) == Type::VALUE ? value(argument) : argument.code;
+        }
+        // Depth is checked before the arguments are evaluated
+        return "(rt::checkDepth(" + line + "), f_" + called.name + "(" + line + ", a_" + called.name + "{" + arguments
+               + "}))";
+    }
+
+    Literal CppEmitter::visit(CallExpr &expr) {
+        result = {"rt::returned(" + call(expr) + ", \"" + expr.name + "\", " + std::to_string(expr.line) + ")",
+                  Type::VALUE, false};
+        return false;
+    }
+
+    Literal CppEmitter::visit(EofExpr &expr) {
+        Emitted number = emit(*expr.fileNumber);
+        std::string line = std::to_string(expr.line);
+        result = {"rt::eof(rt::file(rt::fileNumber(" + value(number) + ", " + line + "), false, " + line + "), " + line
+                  + ")", Type::BOOLEAN, false};
+        return false;
+    }
+
+    // Statements
+
+    void CppEmitter::visit(PrintStmt &stmt) {
+        // All arguments are evaluated before the first is written
+        std::vector<Emitted> texts;
+        for (auto &expr: stmt.expressions) {
+            Emitted emitted = emit(*expr);
+            texts.push_back({text(emitted), Type::STRING, emitted.pure});
+        }
+        Emitted printed = sequence(texts, [&stmt](const std::vector<std::string> &codes) {
+            std::string call = "rt::print(" + codes[0];
+            for (size_t i = 1; i < codes.size(); i++) {
+                if (stmt.separators[i - 1] == PrintStmt::Separator::TAB) call += ", \"\\t\"";
+                call += ", " + codes[i];
+            }
+            return call + ")";
+        }, Type::NONE, false);
+        line(printed.code + ";");
+    }
+
+    void CppEmitter::visit(InputStmt &stmt) {
+        Emitted prompt = emit(*stmt.expr);
+        assign(stmt.targetVarName, {"rt::input(" + text(prompt) + ")", Type::STRING, false});
+    }
+
+    void CppEmitter::visit(LetStmt &stmt) {
+        assign(stmt.targetVarName, emit(*stmt.expr));
+    }
+
+    void CppEmitter::visit(ArrayLetStmt &stmt) {
+        Emitted index = emit(*stmt.index);
+        Emitted assigned = emit(*stmt.expr);
+        std::string line = std::to_string(stmt.line);
+        this->line("{");
+        indentation++;
+        this->line("auto &&index = " + (index.type == Type::NUMBER ? index.code : value(index)) + ";");
+        this->line("double element = rt::elementValue("
+                   + (assigned.type == Type::NUMBER ? assigned.code : value(assigned)) + ", " + line + ");");
+        this->line("std::vector<double> &array = " + container(stmt.targetVarName, nullptr, stmt.line) + ";");
+        this->line("array[rt::position(array, index, " + line + ")] = element;");
+        indentation--;
+        this->line("}");
+    }
+
+    void CppEmitter::visit(DimStmt &stmt) {
+        Emitted size = emit(*stmt.size);
+        assign(stmt.varName, {"rt::dim(" + value(size) + ", " + std::to_string(stmt.line) + ")", Type::ARRAY, false});
+    }
+
+    void CppEmitter::visit(MapStmt &stmt) {
+        assign(stmt.varName, {"std::make_shared<rt::MapData>()", Type::MAP, true});
+    }
+
+    void CppEmitter::visit(PutStmt &stmt) {
+        Emitted key = emit(*stmt.key);
+        Emitted stored = emit(*stmt.value);
+        std::string line = std::to_string(stmt.line);
+        this->line("{");
+        indentation++;
+        this->line("auto &&key = " + (key.type == Type::STRING ? key.code : value(key)) + ";");
+        this->line("rt::Value value = " + value(stored) + ";");
+        this->line("const std::string &keyText = rt::key(key, " + line + ");");
+        this->line("rt::storable(value, " + line + ");");
+        this->line(container(stmt.mapVar, "PUT", stmt.line) + ".put(keyText, std::move(value));");
+        indentation--;
+        this->line("}");
+    }
+
+    void CppEmitter::visit(GetStmt &stmt) {
+        bool isHas = stmt.op.type == Tokenization::HAS;
+        Emitted key = emit(*stmt.key);
+        std::string line = std::to_string(stmt.line);
+        this->line("{");
+        indentation++;
+        this->line("auto &&key = " + (key.type == Type::STRING ? key.code : value(key)) + ";");
+        this->line("const std::string &keyText = rt::key(key, " + line + ");");
+        this->line("const rt::MapData &map = " + container(stmt.mapVar, isHas ? "HAS" : "GET", stmt.line) + ";");
+        if (isHas) assign(stmt.dstVar, {"(map.find(keyText) != nullptr)", Type::BOOLEAN, true});
+        else assign(stmt.dstVar, {"rt::get(map, keyText, " + line + ")", Type::VALUE, false});
+        indentation--;
+        this->line("}");
+    }
+
+    void CppEmitter::visit(ToNumStmt &stmt) {
+        Emitted source = read(stmt.srcVar, stmt.line);
+        bool convertible = source.type == Type::NUMBER || source.type == Type::STRING || source.type == Type::BOOLEAN;
+        assign(stmt.dstVar.has_value() ? stmt.dstVar.value() : stmt.srcVar,
+               {"rt::toNumber(" + (convertible ? source.code : value(source)) + ", " + std::to_string(stmt.line) + ")",
+                Type::NUMBER, false});
+    }
+
+    void CppEmitter::visit(ToStrStmt &stmt) {
+        Emitted source = read(stmt.srcVar, stmt.line);
+        // A string is kept
+        assign(stmt.dstVar.has_value() ? stmt.dstVar.value() : stmt.srcVar, {text(source), Type::STRING, false});
+    }
+
+    void CppEmitter::visit(RndStmt &stmt) {
+        Emitted lowerBound = emit(*stmt.lowerBound);
+        Emitted upperBound = emit(*stmt.upperBound);
+        lowerBound.code = value(lowerBound);
+        upperBound.code = value(upperBound);
+        std::string line = std::to_string(stmt.line);
+        assign(stmt.dstVar, sequence({lowerBound, upperBound}, [&](auto &codes) {
+            return "rt::rnd(" + codes[0] + ", " + codes[1] + ", " + line + ")";
+        }, Type::NUMBER, false));
+    }
+
+    void CppEmitter::visit(BlockStmt &stmt) {
+        for (auto &statement: stmt.statementsList) statement->accept(*this);
+    }
+
+    void CppEmitter::block(Stmt &stmt) {
+        indentation++;
+        stmt.accept(*this);
+        indentation--;
+    }
+
+    // Condition of IF / WHILE, ConditionNotBoolean when it is not a boolean
+    static std::string conditionCode(const std::string &code, bool boolean, const std::string &value, uint32_t line) {
+        return boolean ? code : "rt::condition(" + value + ", " + std::to_string(line) + ")";
+    }
+
+    void CppEmitter::visit(IfStmt &stmt) {
+        Emitted condition = emit(*stmt.conditionExpr);
+        line("if (" + conditionCode(condition.code, condition.type == Type::BOOLEAN, value(condition), stmt.line)
+             + ") {");
+        block(*stmt.thenBranch);
+        if (stmt.elseBranch.has_value()) {
+            line("} else {");
+            block(*stmt.elseBranch.value());
+        }
+        line("}");
+    }
+
+    void CppEmitter::visit(WhileStmt &stmt) {
+        Emitted condition = emit(*stmt.conditionExpr);
+        line("while (" + conditionCode(condition.code, condition.type == Type::BOOLEAN, value(condition), stmt.line)
+             + ") {");
+        loopDepth++;
+        block(*stmt.thenBranch);
+        loopDepth--;
+        line("}");
+    }
+
+    void CppEmitter::visit(ParallelForStmt &stmt) {
+        throw EmitError(stmt.line, "PARALLEL FOR can not be compiled to C++, run the script with the interpreter");
+    }
+
+    void CppEmitter::visit(FunctionStmt &stmt) {
+        Function &emitted = functions[stmt.name];
+        if (!emitted.stmt) {
+            emitted.stmt = &stmt;
+            emitted.locals.resize(stmt.frameSize);
+            for (uint32_t i = 0; i < stmt.parameterCount; i++) emitted.locals[i].parameter = true;
+        }
+        std::string topLevel = std::move(code);
+        int topIndentation = indentation;
+        code.clear();
+        function = &emitted;
+        stmt.body->accept(*this);
+        function = nullptr;
+        emitted.code = std::move(code);
+        code = std::move(topLevel);
+        indentation = topIndentation;
+    }
+
+    void CppEmitter::visit(CallStmt &stmt) {
+        // Value is dropped, so no NoReturnValue check
+        line(call(*stmt.call) + ";");
+    }
+
+    void CppEmitter::visit(ReturnStmt &stmt) {
+        if (stmt.value.has_value()) line("return " + value(emit(*stmt.value.value())) + ";");
+        else line("return {};");
+    }
+
+    // Loop control outside of loop fails at the call of the function, at top level it escapes the interpreter
+    void CppEmitter::visit(ContinueStmt &stmt) {
+        if (loopDepth > 0) line("continue;");
+        else if (function) line("rt::fail(\"LoopControlOutsideLoop\", callLine);");
+        else line("rt::unexpected();");
+    }
+
+    void CppEmitter::visit(BreakStmt &stmt) {
+        if (loopDepth > 0) line("break;");
+        else if (function) line("rt::fail(\"LoopControlOutsideLoop\", callLine);");
+        else line("rt::unexpected();");
+    }
+
+    void CppEmitter::visit(OpenStmt &stmt) {
+        Emitted path = emit(*stmt.path);
+        Emitted number = emit(*stmt.fileNumber);
+        std::string line = std::to_string(stmt.line);
+        this->line("{");
+        indentation++;
+        this->line("auto &&path = " + (path.type == Type::STRING ? path.code : value(path)) + ";");
+        this->line("const std::string &pathText = rt::filePath(path, " + line + ");");
+        this->line("rt::open(pathText, rt::fileNumber(" + value(number) + ", " + line + "), "
+                   + (stmt.forOutput ? "true" : "false") + ", " + line + ");");
+        indentation--;
+        this->line("}");
+    }
+
+    void CppEmitter::visit(ReadLineStmt &stmt) {
+        Emitted number = emit(*stmt.fileNumber);
+        std::string line = std::to_string(stmt.line);
+        assign(stmt.dstVar, {"rt::readLine(rt::file(rt::fileNumber(" + value(number) + ", " + line + "), false, "
+                             + line + "), " + line + ")", Type::STRING, false});
+    }
+
+    void CppEmitter::visit(WriteStmt &stmt) {
+        Emitted number = emit(*stmt.fileNumber);
+        std::string line = std::to_string(stmt.line);
+        this->line("{");
+        indentation++;
+        // File is checked before the value is evaluated
+        this->line("rt::File &file = rt::file(rt::fileNumber(" + value(number) + ", " + line + "), true, " + line + ");");
+        this->line("rt::write(file, " + text(emit(*stmt.expr)) + ", " + line + ");");
+        indentation--;
+        this->line("}");
+    }
+
+    void CppEmitter::visit(CloseStmt &stmt) {
+        Emitted number = emit(*stmt.fileNumber);
+        std::string line = std::to_string(stmt.line);
+        this->line("rt::close(rt::fileNumber(" + value(number) + ", " + line + "), " + line + ");");
+    }
+
+    // Program
+
+    void CppEmitter::pass(const std::vector<stmt_ptr> &program) {
+        changed = false;
+        code.clear();
+        indentation = 1;
+        loopDepth = 0;
+        for (auto &stmt: program) stmt->accept(*this);
+    }
+
+    std::string CppEmitter::emitProgram(const std::vector<stmt_ptr> &program, const std::string &sourceName) {
+        // Every pass only widens types, so they settle after at most two changes of every variable
+        do {
+            pass(program);
+        } while (changed);
+        finalPass = true;
+        pass(program);
+        std::string body = std::move(code);
+
+        code = "// Generated by basicpp --emit-cpp from " + sourceName + "\n";
+        code += "#define BASICPP_LANES " + std::to_string(Values::Kernels::vectorLanes()) + "\n";
+        code += runtime;
+        code += "\n// Program\n";
+        std::vector<std::string> texts(constants.size());
+        for (auto &[text, index]: constants) texts[index] = text;
+        for (size_t i = 0; i < texts.size(); i++) {
+            code += "static const std::string k_" + std::to_string(i) + "(" + quote(texts[i]) + ", "
+                    + std::to_string(texts[i].size()) + ");\n";
+        }
+
+        indentation = 1;
+        for (auto &[name, emitted]: functions) {
+            code += "\nstruct a_" + name + " {\n";
+            for (uint32_t i = 0; i < emitted.stmt->parameterCount; i++) {
+                line(typeName(storage(emitted.locals[i])) + " p" + std::to_string(i) + ";");
+            }
+            code += "};\n\nstatic rt::Value f_" + name + "(uint32_t callLine, a_" + name + " arguments);\n";
+        }
+        for (auto &[name, emitted]: functions) {
+            code += "\nstatic rt::Value f_" + name + "([[maybe_unused]] uint32_t callLine, a_" + name
+                    + " arguments) {\n";
+            line("rt::Call call;");
+            for (size_t i = 0; i < emitted.locals.size(); i++) {
+                Variable &local = emitted.locals[i];
+                if (local.name.empty()) local.name = "unused" + std::to_string(i);
+                declare(local, local.parameter, i);
+            }
+            code += emitted.code;
+            line("return {};");
+            code += "}\n";
+        }
+
+        code += "\nint main() {\n";
+        line("std::ios::sync_with_stdio(false);");
+        line("rt::random.seed(std::time(nullptr));");
+        for (auto &[name, global]: globals) declare(global, false, 0);
+        code += body;
+        line("rt::closeFiles();");
+        line("return 0;");
+        code += "}\n";
+        return std::move(code);
+    }
+}
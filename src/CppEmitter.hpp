@@ -0,0 +1,159 @@
+#ifndef BASICPLUSPLUS_CPPEMITTER_HPP
+#define BASICPLUSPLUS_CPPEMITTER_HPP
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "ExpressionsStatements.hpp"
+
+// `--emit-cpp` translates a type-annotated program to one standalone C++ translation unit, which the system compiler
+// builds to a native program printing the same output and the same errors on the same lines as the interpreter.
+//
+// Variables are C++ locals of `main` or of the function they belong to. Every variable assigned values of one type
+// only is a plain `double`, `std::string`, `bool`, array or map, others hold `rt::Value`. Types of variables are found
+// by assigning them the types of their values until nothing changes, so parameters get the types of the arguments.
+// Reads proven by TypeInference need no check, others check a flag for VariableNotDeclared.
+// Operations on known types are native C++, on other values they call the runtime, which checks them as the
+// interpreter does. The runtime is written at the top of the translation unit, so it needs no other file.
+namespace Emitting {
+    // Statement the emitter can not translate, what() is the message
+    class EmitError : public std::runtime_error {
+    private:
+        uint32_t errorLine;
+
+    public:
+        EmitError(uint32_t line, const std::string &message) : std::runtime_error(message), errorLine(line) {}
+
+        uint32_t line() const { return errorLine; }
+    };
+
+    class CppEmitter : public ExprStmt::AbstractExprVisitor, public ExprStmt::AbstractStmtVisitor {
+    private:
+        // C++ type of a variable or expression, NONE while no assigned value was seen yet
+        enum class Type : uint8_t { NONE, NUMBER, STRING, BOOLEAN, ARRAY, MAP, VALUE };
+
+        struct Emitted {
+            std::string code;
+            Type type;
+            bool pure;  // Can not fail nor have side effects, so it may be evaluated in any order
+        };
+
+        struct Variable {
+            std::string name;
+            Type type = Type::NONE;
+            bool parameter = false;
+            bool checked = false;  // Read where it may not be assigned yet, needs the assigned flag
+        };
+
+        // Functions are emitted when the pass reaches their definition
+        struct Function {
+            const ExprStmt::FunctionStmt *stmt;
+            std::vector<Variable> locals;  // By slot
+            std::string code;
+        };
+
+        std::map<std::string, Variable> globals;
+        std::map<std::string, Function> functions;
+        Function *function = nullptr;  // Being emitted, nullptr at top level
+        std::map<std::string, size_t> constants;
+
+        // Types changed in this pass, final pass emits unassigned variables as rt::Value
+        bool changed = false;
+        bool finalPass = false;
+
+        std::string code;
+        int indentation = 1;
+        uint32_t loopDepth = 0;
+        Emitted result;
+
+        static std::string typeName(Type type);
+
+        static Type typeOf(ExprStmt::StaticType type);
+
+        Variable &variable(const ExprStmt::VarRef &var);
+
+        Type storage(const Variable &variable) const;
+
+        // Joins type of the assigned value to the type of the variable
+        void join(Variable &variable, Type type);
+
+        void line(const std::string &statement);
+
+        Emitted emit(ExprStmt::Expr &expr);
+
+        // Code converting an emitted expression to rt::Value
+        static std::string value(const Emitted &emitted);
+
+        // Code of the text PRINT writes for an emitted expression
+        static std::string text(const Emitted &emitted);
+
+        // Combines operands evaluated left to right, as C++ does not order evaluation of function arguments
+        static Emitted sequence(const std::vector<Emitted> &operands,
+                                const std::function<std::string(const std::vector<std::string> &)> &combine,
+                                Type type, bool pure);
+
+        std::string constant(const std::string &text);
+
+        // Checked read of a variable in a statement or an unproven expression
+        Emitted read(const ExprStmt::VarRef &var, uint32_t line);
+
+        // Array or map variable for indexing, PUT, GET and HAS
+        std::string container(const ExprStmt::VarRef &var, const char *statement, uint32_t line);
+
+        void assign(const ExprStmt::VarRef &var, const Emitted &value);
+
+        // Call of a function without the NoReturnValue check
+        std::string call(ExprStmt::CallExpr &expr);
+
+        void block(ExprStmt::Stmt &stmt);
+
+        void declare(const Variable &variable, bool fromParameter, size_t parameter);
+
+        void pass(const std::vector<ExprStmt::stmt_ptr> &program);
+
+    public:
+        Tokenization::Literal visit(ExprStmt::UnaryExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::BinaryExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::GroupingExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::LiteralExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::VarExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::ArrayExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::ArrayFunctionExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::StringFunctionExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::CallExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::EofExpr &expr) override;
+
+        void visit(ExprStmt::PrintStmt &stmt) override;
+        void visit(ExprStmt::InputStmt &stmt) override;
+        void visit(ExprStmt::LetStmt &stmt) override;
+        void visit(ExprStmt::ArrayLetStmt &stmt) override;
+        void visit(ExprStmt::DimStmt &stmt) override;
+        void visit(ExprStmt::MapStmt &stmt) override;
+        void visit(ExprStmt::PutStmt &stmt) override;
+        void visit(ExprStmt::GetStmt &stmt) override;
+        void visit(ExprStmt::ToNumStmt &stmt) override;
+        void visit(ExprStmt::ToStrStmt &stmt) override;
+        void visit(ExprStmt::RndStmt &stmt) override;
+        void visit(ExprStmt::BlockStmt &stmt) override;
+        void visit(ExprStmt::IfStmt &stmt) override;
+        void visit(ExprStmt::WhileStmt &stmt) override;
+        void visit(ExprStmt::ParallelForStmt &stmt) override;
+        void visit(ExprStmt::FunctionStmt &stmt) override;
+        void visit(ExprStmt::CallStmt &stmt) override;
+        void visit(ExprStmt::ReturnStmt &stmt) override;
+        void visit(ExprStmt::ContinueStmt &stmt) override;
+        void visit(ExprStmt::BreakStmt &stmt) override;
+        void visit(ExprStmt::OpenStmt &stmt) override;
+        void visit(ExprStmt::ReadLineStmt &stmt) override;
+        void visit(ExprStmt::WriteStmt &stmt) override;
+        void visit(ExprStmt::CloseStmt &stmt) override;
+
+        // C++ source of the program, sourceName is mentioned in its first line. Throws EmitError.
+        std::string emitProgram(const std::vector<ExprStmt::stmt_ptr> &program, const std::string &sourceName);
+    };
+}
+
+#endif //BASICPLUSPLUS_CPPEMITTER_HPP
@@ -0,0 +1,351 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <system_error>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "Daemon.hpp"
+
+namespace Daemon {
+    static std::system_error systemError(const char *what) {
+        return std::system_error(errno, std::generic_category(), what);
+    }
+
+    static sockaddr_un socketAddress(const std::string &socketPath) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (socketPath.size() >= sizeof(address.sun_path)) {
+            throw std::system_error(std::make_error_code(std::errc::filename_too_long), socketPath);
+        }
+        std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+        return address;
+    }
+
+    // Reads frames from blocking socket through a buffer, so small frames do not cost a system call each
+    class FrameReader {
+    private:
+        int fd;
+        char buffer[65536];
+        size_t begin = 0;
+        size_t end = 0;
+
+        bool readBytes(char *target, size_t count) {
+            while (count > 0) {
+                if (begin == end) {
+                    ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+                    if (received < 0 && errno == EINTR) continue;
+                    if (received <= 0) return false;
+                    begin = 0;
+                    end = received;
+                }
+                size_t taken = std::min(count, end - begin);
+                std::memcpy(target, buffer + begin, taken);
+                begin += taken;
+                target += taken;
+                count -= taken;
+            }
+            return true;
+        }
+
+    public:
+        explicit FrameReader(int fd) : fd(fd) {}
+
+        // Returns false at the end of the stream and for a frame longer than maxFrameSize
+        bool read(FrameType &type, std::string &payload) {
+            unsigned char header[5];
+            if (!readBytes(reinterpret_cast<char *>(header), sizeof(header))) return false;
+            type = static_cast<FrameType>(header[0]);
+            uint32_t length = header[1] | header[2] << 8 | header[3] << 16 | uint32_t(header[4]) << 24;
+            if (length > maxFrameSize) return false;
+            payload.resize(length);
+            return readBytes(payload.data(), length);
+        }
+    };
+
+    // Collects frames and writes them in large chunks
+    class FrameWriter {
+    private:
+        int fd;
+        std::string buffer;
+        bool broken = false;
+
+        static constexpr size_t flushSize = 64 * 1024;
+
+        void writeFrame(FrameType type, std::string_view payload) {
+            uint32_t length = payload.size();
+            char header[5] = {static_cast<char>(type), static_cast<char>(length), static_cast<char>(length >> 8),
+                              static_cast<char>(length >> 16), static_cast<char>(length >> 24)};
+            buffer.append(header, sizeof(header));
+            buffer.append(payload);
+            if (buffer.size() >= flushSize) flush();
+        }
+
+    public:
+        explicit FrameWriter(int fd) : fd(fd) {}
+
+        // Payload longer than maxFrameSize is split, only output and input can be that long
+        void write(FrameType type, std::string_view payload) {
+            while (payload.size() > maxFrameSize) {
+                writeFrame(type, payload.substr(0, maxFrameSize));
+                payload.remove_prefix(maxFrameSize);
+            }
+            writeFrame(type, payload);
+        }
+
+        void writeExit(int exitCode) {
+            char code[4] = {static_cast<char>(exitCode), static_cast<char>(exitCode >> 8),
+                            static_cast<char>(exitCode >> 16), static_cast<char>(exitCode >> 24)};
+            write(EXIT, std::string_view(code, sizeof(code)));
+        }
+
+        // Returns false when the peer is gone, later output is dropped
+        bool flush() {
+            size_t written = 0;
+            while (!broken && written < buffer.size()) {
+                // Peer closing the connection must not kill the process by SIGPIPE
+                ssize_t count = send(fd, buffer.data() + written, buffer.size() - written, MSG_NOSIGNAL);
+                if (count >= 0) written += count;
+                else if (errno != EINTR) broken = true;
+            }
+            buffer.clear();
+            return !broken;
+        }
+    };
+
+    // ProgramCache
+    std::shared_ptr<const Batch::CompiledScript> ProgramCache::get(const std::string &path) {
+        std::error_code modifiedError, sizeError;
+        auto modified = std::filesystem::last_write_time(path, modifiedError);
+        uintmax_t size = std::filesystem::file_size(path, sizeError);
+        // Missing file is not cached, compileScript reports it
+        if (modifiedError || sizeError) {
+            return std::make_shared<const Batch::CompiledScript>(Batch::compileScript(path, maxDepth));
+        }
+
+        {
+            std::lock_guard lock(mutex);
+            auto found = entries.find(path);
+            if (found != entries.end() && found->second.modified == modified && found->second.size == size) {
+                return found->second.script;
+            }
+        }
+
+        // Compiled without the lock, so other scripts are served meanwhile
+        auto script = std::make_shared<const Batch::CompiledScript>(Batch::compileScript(path, maxDepth));
+        std::lock_guard lock(mutex);
+        entries[path] = {modified, size, script};
+        return script;
+    }
+
+    // Server
+    Server::Server(unsigned threads, uint64_t randomSeed, const BasicPlusPlus::Limits &limits)
+        : cache(limits.maxDepth), nextSeed(randomSeed), limits(limits) {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 0; i < threads; i++) {
+            workers.emplace_back(Threading::threadStackSize(), [this] { workerLoop(); });
+        }
+    }
+
+    Server::~Server() {
+        {
+            std::lock_guard lock(queueMutex);
+            stopping = true;
+        }
+        queueCondition.notify_all();
+        for (auto &worker: workers) worker.join();
+        for (int fd: connections) close(fd);
+    }
+
+    void Server::serve(const std::string &socketPath) {
+        sockaddr_un address = socketAddress(socketPath);
+        int listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) throw systemError("socket");
+        // Socket left by a previous run is replaced, any other file is not
+        struct stat existing{};
+        if (stat(socketPath.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode)) unlink(socketPath.c_str());
+        if (bind(listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 ||
+            listen(listenFd, SOMAXCONN) < 0) {
+            std::system_error error = systemError("bind");
+            close(listenFd);
+            throw error;
+        }
+
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0) {
+                // Out of descriptors or memory lasts until connections are closed, so retrying at once would spin
+                if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                } else if (errno != EINTR && errno != ECONNABORTED && errno != EPROTO) {
+                    std::system_error error = systemError("accept");
+                    close(listenFd);
+                    throw error;
+                }
+                continue;
+            }
+            {
+                std::lock_guard lock(queueMutex);
+                connections.push_back(fd);
+            }
+            queueCondition.notify_one();
+        }
+    }
+
+    void Server::workerLoop() {
+        while (true) {
+            int fd;
+            {
+                std::unique_lock lock(queueMutex);
+                queueCondition.wait(lock, [this] { return !connections.empty() || stopping; });
+                if (stopping) return;
+                fd = connections.front();
+                connections.pop_front();
+            }
+            serveConnection(fd);
+            close(fd);
+        }
+    }
+
+    void Server::serveConnection(int fd) {
+        // Timed out receive ends the connection, or the input of the script waiting for it
+        timeval timeout{idleTimeoutSeconds, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        FrameReader reader(fd);
+        while (serveRequest(fd, reader)) {}
+    }
+
+    bool Server::serveRequest(int fd, FrameReader &reader) {
+        std::string scriptPath;
+        std::vector<std::pair<std::string, std::string>> arguments;
+        std::string input;
+
+        FrameType type;
+        std::string payload;
+        while (true) {
+            if (!reader.read(type, payload)) return false;
+            if (type == RUN) break;
+            switch (type) {
+                case SCRIPT:
+                    scriptPath = std::move(payload);
+                    break;
+                case ARGUMENT: {
+                    size_t separator = payload.find('=');
+                    if (separator == std::string::npos) return false;
+                    arguments.emplace_back(payload.substr(0, separator), payload.substr(separator + 1));
+                    break;
+                }
+                case STDIN:
+                    input += payload;
+                    break;
+                default:
+                    return false;
+            }
+        }
+
+        FrameWriter writer(fd);
+        std::shared_ptr<const Batch::CompiledScript> script = cache.get(scriptPath);
+        if (script->exitCode != 0) {
+            // Same streams main.cpp prints to, only a missing file is reported to stderr
+            writer.write(script->exitCode == 9 ? STDERR : STDOUT, script->errorOutput);
+            writer.writeExit(script->exitCode);
+            return writer.flush();
+        }
+
+        // Input sent with the request is used first, then lines are requested from the client
+        size_t inputRead = 0;
+        bool inputEnd = false;
+        auto readLine = [&](std::string &line) {
+            while (true) {
+                size_t lineEnd = input.find('\n', inputRead);
+                if (lineEnd != std::string::npos) {
+                    line.assign(input, inputRead, lineEnd - inputRead);
+                    inputRead = lineEnd + 1;
+                    return true;
+                }
+                if (inputEnd) {
+                    if (inputRead == input.size()) return false;
+                    line.assign(input, inputRead);
+                    inputRead = input.size();
+                    return true;
+                }
+                writer.write(INPUT_REQUEST, {});
+                if (!writer.flush() || !reader.read(type, payload) || type != STDIN || payload.empty()) {
+                    inputEnd = true;
+                } else {
+                    input += payload;
+                }
+            }
+        };
+
+        BasicPlusPlus::Execution execution(script->program);
+        execution.setInput(readLine)
+                 .setOutput([&writer](std::string_view text) { writer.write(STDOUT, text); })
+                 .setRandomSeed(nextSeed++)
+                 .setLimits(limits);
+        for (auto &[name, value]: arguments) execution.setVariable(name, value);
+
+        int exitCode;
+        try {
+            exitCode = execution.run();
+            if (exitCode != 0) writer.write(STDOUT, execution.getErrorOutput() + "\n");
+        } catch (const std::exception &e) {
+            exitCode = 1;
+            writer.write(STDERR, std::string("Unexpected exception: ") + e.what() + "\n");
+        }
+        writer.writeExit(exitCode);
+        return writer.flush();
+    }
+
+    // Client
+    int runClient(const std::string &socketPath, const std::string &scriptPath,
+                  const std::vector<std::string> &arguments, std::istream &input,
+                  std::ostream &output, std::ostream &errorOutput) {
+        sockaddr_un address = socketAddress(socketPath);
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) throw systemError("socket");
+        struct Closer {
+            int fd;
+            ~Closer() { close(fd); }
+        } closer{fd};
+        if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) throw systemError("connect");
+
+        // Daemon has its own working directory
+        FrameWriter writer(fd);
+        writer.write(SCRIPT, std::filesystem::absolute(scriptPath).string());
+        for (const std::string &argument: arguments) writer.write(ARGUMENT, argument);
+        writer.write(RUN, {});
+        if (!writer.flush()) throw std::system_error(std::make_error_code(std::errc::connection_reset), "send");
+
+        FrameReader reader(fd);
+        FrameType type;
+        std::string payload;
+        std::string line;
+        while (reader.read(type, payload)) {
+            if (type == STDOUT) {
+                output << payload << std::flush;
+            } else if (type == STDERR) {
+                errorOutput << payload << std::flush;
+            } else if (type == INPUT_REQUEST) {
+                // Input is read only when the script needs it, so interactive scripts work as when run directly
+                // The daemon reads one STDIN frame for each request, so a line must fit in one
+                if (std::getline(input, line)) {
+                    if (line.size() >= maxFrameSize) {
+                        throw std::system_error(std::make_error_code(std::errc::message_size), "Input line too long");
+                    }
+                    writer.write(STDIN, line + "\n");
+                }
+                else writer.write(STDIN, {});
+                writer.flush();
+            } else if (type == EXIT && payload.size() == 4) {
+                auto byte = [&payload](int i) { return uint32_t(static_cast<unsigned char>(payload[i])); };
+                return static_cast<int>(byte(0) | byte(1) << 8 | byte(2) << 16 | byte(3) << 24);
+            }
+        }
+        throw std::system_error(std::make_error_code(std::errc::connection_reset), "Daemon closed connection");
+    }
+}
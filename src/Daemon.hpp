@@ -0,0 +1,113 @@
+#ifndef BASICPLUSPLUS_DAEMON_HPP
+#define BASICPLUSPLUS_DAEMON_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <istream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "Batch.hpp"
+#include "ThreadPool.hpp"
+
+// `--serve` daemon keeping compiled programs in memory, so a run of a cached script skips process start,
+// reading and compiling the source.
+//
+// Requests and responses are sequences of frames: 1 byte type, 4 byte little-endian payload length, payload.
+// Request:  SCRIPT <absolute path>, any ARGUMENT <name=value>, any STDIN <data>, RUN
+// Response: any STDOUT <data> and STDERR <data> as the script runs, EXIT <4 byte little-endian exit code>
+// When the script reads past the input sent with the request, the daemon sends INPUT_REQUEST and waits
+// for STDIN with more input, empty STDIN ends the input.
+// One connection can send any number of requests one after another.
+// Payloads are at most maxFrameSize bytes, longer output is sent in several frames and a longer frame closes the
+// connection, so a client can not make the daemon allocate more.
+namespace Daemon {
+    inline constexpr uint32_t maxFrameSize = 16 * 1024 * 1024;
+
+    enum FrameType : uint8_t {
+        SCRIPT = 'S',
+        ARGUMENT = 'A',
+        STDIN = 'I',
+        RUN = 'R',
+        STDOUT = 'O',
+        STDERR = 'E',
+        INPUT_REQUEST = 'N',
+        EXIT = 'X',
+    };
+
+    class FrameReader;
+
+    // Compiled scripts by path, recompiled when modification time or size of the file changes
+    class ProgramCache {
+    private:
+        struct Entry {
+            std::filesystem::file_time_type modified;
+            uintmax_t size;
+            std::shared_ptr<const Batch::CompiledScript> script;
+        };
+
+        uint32_t maxDepth;
+        std::mutex mutex;
+        std::map<std::string, Entry> entries;
+
+    public:
+        explicit ProgramCache(uint32_t maxDepth) : maxDepth(maxDepth) {}
+
+        std::shared_ptr<const Batch::CompiledScript> get(const std::string &path);
+    };
+
+    class Server {
+    private:
+        ProgramCache cache;
+        std::atomic<uint64_t> nextSeed;
+        BasicPlusPlus::Limits limits;
+
+        // Accepted connections waiting for a worker
+        std::mutex queueMutex;
+        std::condition_variable queueCondition;
+        std::deque<int> connections;
+        bool stopping = false;
+        std::vector<Threading::Thread> workers;
+
+        // Longest wait for a frame or for the client to take output, so idle clients do not keep workers forever
+        static constexpr int idleTimeoutSeconds = 60;
+
+        void workerLoop();
+
+        void serveConnection(int fd);
+
+        // Returns false when the connection was closed or broken
+        bool serveRequest(int fd, FrameReader &reader);
+
+    public:
+        // Connections are served by `threads` workers, hardware concurrency when 0.
+        // Every request gets the next random seed, every run is limited by limits.
+        explicit Server(unsigned threads = 0, uint64_t randomSeed = 0, const BasicPlusPlus::Limits &limits = {});
+
+        // Waits for the workers to finish connections they serve
+        ~Server();
+
+        Server(const Server &) = delete;
+
+        Server &operator=(const Server &) = delete;
+
+        // Accepts connections to Unix socket at path forever, throws std::system_error
+        [[noreturn]] void serve(const std::string &socketPath);
+    };
+
+    // Runs script through the daemon, sends it lines of input when it asks and copies its stdout and stderr.
+    // Returns exit code of the script, throws std::system_error when the daemon can not be reached.
+    int runClient(const std::string &socketPath, const std::string &scriptPath,
+                  const std::vector<std::string> &arguments, std::istream &input,
+                  std::ostream &output, std::ostream &errorOutput);
+}
+
+#endif //BASICPLUSPLUS_DAEMON_HPP
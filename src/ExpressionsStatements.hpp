@@ -13,6 +13,11 @@ namespace ExprStmt {
     class GroupingExpr;
     class LiteralExpr;
     class VarExpr;
+    class ArrayExpr;
+    class ArrayFunctionExpr;
+    class StringFunctionExpr;
+    class CallExpr;
+    class EofExpr;
 
     class AbstractExprVisitor {
     public:
@@ -23,6 +28,25 @@ namespace ExprStmt {
         virtual Tokenization::Literal visit(GroupingExpr &expr) = 0;
         virtual Tokenization::Literal visit(LiteralExpr &expr) = 0;
         virtual Tokenization::Literal visit(VarExpr &expr) = 0;
+        virtual Tokenization::Literal visit(ArrayExpr &expr) = 0;
+        virtual Tokenization::Literal visit(ArrayFunctionExpr &expr) = 0;
+        virtual Tokenization::Literal visit(StringFunctionExpr &expr) = 0;
+        virtual Tokenization::Literal visit(CallExpr &expr) = 0;
+        virtual Tokenization::Literal visit(EofExpr &expr) = 0;
+
+        // Evaluation of expressions proven to be a number or boolean (see StaticType) without building a Literal,
+        // by default through visit
+        virtual double visitNumber(UnaryExpr &expr);
+        virtual double visitNumber(BinaryExpr &expr);
+        virtual double visitNumber(GroupingExpr &expr);
+        virtual double visitNumber(LiteralExpr &expr);
+        virtual double visitNumber(VarExpr &expr);
+        virtual double visitNumber(ArrayExpr &expr);
+        virtual bool visitBoolean(UnaryExpr &expr);
+        virtual bool visitBoolean(BinaryExpr &expr);
+        virtual bool visitBoolean(GroupingExpr &expr);
+        virtual bool visitBoolean(LiteralExpr &expr);
+        virtual bool visitBoolean(VarExpr &expr);
     };
 
     // Visitor for Stmt
@@ -30,14 +54,27 @@ namespace ExprStmt {
     class PrintStmt;
     class InputStmt;
     class LetStmt;
+    class ArrayLetStmt;
+    class DimStmt;
+    class MapStmt;
+    class PutStmt;
+    class GetStmt;
     class ToNumStmt;
     class ToStrStmt;
     class RndStmt;
     class BlockStmt;
     class IfStmt;
     class WhileStmt;
+    class ParallelForStmt;
+    class FunctionStmt;
+    class CallStmt;
+    class ReturnStmt;
     class ContinueStmt;
     class BreakStmt;
+    class OpenStmt;
+    class ReadLineStmt;
+    class WriteStmt;
+    class CloseStmt;
 
     class AbstractStmtVisitor {
     public:
@@ -46,27 +83,55 @@ namespace ExprStmt {
         virtual void visit(PrintStmt &stmt) = 0;
         virtual void visit(InputStmt &stmt) = 0;
         virtual void visit(LetStmt &stmt) = 0;
+        virtual void visit(ArrayLetStmt &stmt) = 0;
+        virtual void visit(DimStmt &stmt) = 0;
+        virtual void visit(MapStmt &stmt) = 0;
+        virtual void visit(PutStmt &stmt) = 0;
+        virtual void visit(GetStmt &stmt) = 0;
         virtual void visit(ToNumStmt &stmt) = 0;
         virtual void visit(ToStrStmt &stmt) = 0;
         virtual void visit(RndStmt &stmt) = 0;
         virtual void visit(BlockStmt &stmt) = 0;
         virtual void visit(IfStmt &stmt) = 0;
         virtual void visit(WhileStmt &stmt) = 0;
+        virtual void visit(ParallelForStmt &stmt) = 0;
+        virtual void visit(FunctionStmt &stmt) = 0;
+        virtual void visit(CallStmt &stmt) = 0;
+        virtual void visit(ReturnStmt &stmt) = 0;
         virtual void visit(ContinueStmt &stmt) = 0;
         virtual void visit(BreakStmt &stmt) = 0;
+        virtual void visit(OpenStmt &stmt) = 0;
+        virtual void visit(ReadLineStmt &stmt) = 0;
+        virtual void visit(WriteStmt &stmt) = 0;
+        virtual void visit(CloseStmt &stmt) = 0;
     };
 
     using stmt_ptr = std::unique_ptr<Stmt>;
 
+    // Variable named in the source. Inside FUNCTION the parser resolves it to a slot of the call frame.
+    struct VarRef {
+        std::string name;
+        int32_t slot = -1;  // -1 for global variable
+    };
+
+    // Type every evaluation of an expression has, proven by TypeInference::inferTypes, UNKNOWN when not proven
+    enum class StaticType : uint8_t { UNKNOWN, NUMBER, STRING, BOOLEAN };
+
     // Implementations
     class Expr {
     protected:
         explicit Expr(uint32_t line) : line(line) {}
     public:
         uint32_t line;
+        StaticType staticType = StaticType::UNKNOWN;
         virtual ~Expr() noexcept = default;
 
         virtual Tokenization::Literal accept(AbstractExprVisitor &) = 0;
+
+        // Only for expressions whose staticType is NUMBER / BOOLEAN
+        virtual double acceptNumber(AbstractExprVisitor &v) { return std::get<double>(accept(v)); }
+
+        virtual bool acceptBoolean(AbstractExprVisitor &v) { return std::get<bool>(accept(v)); }
     };
 
     using expr_ptr = std::unique_ptr<Expr>;
@@ -93,6 +158,10 @@ namespace ExprStmt {
         UnaryExpr(Tokenization::Token &&op, expr_ptr &&right, uint32_t line) : op(op), right(std::move(right)), Expr(line) {}
 
         virtual Tokenization::Literal accept(AbstractExprVisitor &v) override { return v.visit(*this); }
+
+        virtual double acceptNumber(AbstractExprVisitor &v) override { return v.visitNumber(*this); }
+
+        virtual bool acceptBoolean(AbstractExprVisitor &v) override { return v.visitBoolean(*this); }
     };
 
     class BinaryExpr : public Expr {
@@ -105,6 +174,10 @@ namespace ExprStmt {
                                                                                   right(std::move(right)), Expr(line) {}
 
         virtual Tokenization::Literal accept(AbstractExprVisitor &v) override { return v.visit(*this); }
+
+        virtual double acceptNumber(AbstractExprVisitor &v) override { return v.visitNumber(*this); }
+
+        virtual bool acceptBoolean(AbstractExprVisitor &v) override { return v.visitBoolean(*this); }
     };
 
     class GroupingExpr : public Expr {
@@ -114,6 +187,10 @@ namespace ExprStmt {
         GroupingExpr(expr_ptr &&expression, uint32_t line) : expression(std::move(expression)), Expr(line) {}
 
         virtual Tokenization::Literal accept(AbstractExprVisitor &v) override { return v.visit(*this); }
+
+        virtual double acceptNumber(AbstractExprVisitor &v) override { return v.visitNumber(*this); }
+
+        virtual bool acceptBoolean(AbstractExprVisitor &v) override { return v.visitBoolean(*this); }
     };
 
     class LiteralExpr : public Expr {
@@ -123,13 +200,88 @@ namespace ExprStmt {
         LiteralExpr(Tokenization::Literal &&value, uint32_t line) : value(value), Expr(line) {}
 
         virtual Tokenization::Literal accept(AbstractExprVisitor &v) override { return v.visit(*this); }
+
+        virtual double acceptNumber(AbstractExprVisitor &v) override { return v.visitNumber(*this); }
+
+        virtual bool acceptBoolean(AbstractExprVisitor &v) override { return v.visitBoolean(*this); }
     };
 
     class VarExpr : public Expr {
     public:
-        const std::string varName;
+        const VarRef varName;
 
-        VarExpr(std::string &&varName, uint32_t line) : varName(varName), Expr(line) {}
+        VarExpr(VarRef &&varName, uint32_t line) : varName(std::move(varName)), Expr(line) {}
+
+        virtual Tokenization::Literal accept(AbstractExprVisitor &v) override { return v.visit(*this); }
+
+        virtual double acceptNumber(AbstractExprVisitor &v) override { return v.visitNumber(*this); }
+
+        virtual bool acceptBoolean(AbstractExprVisitor &v) override { return v.visitBoolean(*this); }
+    };
+
+    // Element `varName(index)` of an array
+    class ArrayExpr : public Expr {
+    public:
+        const VarRef varName;
+        const expr_ptr index;
+
+        ArrayExpr(VarRef &&varName, expr_ptr &&index, uint32_t line) : varName(std::move(varName)),
+                                                                      index(std::move(index)), Expr(line) {}
+
+        virtual Tokenization::Literal accept(AbstractExprVisitor &v) override { return v.visit(*this); }
+
+        virtual double acceptNumber(AbstractExprVisitor &v) override { return v.visitNumber(*this); }
+    };
+
+    // Whole array built-in `SUM`, `MIN` or `MAX`
+    class ArrayFunctionExpr : public Expr {
+    public:
+        enum Function { SUM, MIN, MAX };
+
+        const Function function;
+        const std::string name;
+        const expr_ptr argument;
+
+        ArrayFunctionExpr(Function function, std::string &&name, expr_ptr &&argument, uint32_t line) :
+            function(function), name(std::move(name)), argument(std::move(argument)), Expr(line) {}
+
+        virtual Tokenization::Literal accept(AbstractExprVisitor &v) override { return v.visit(*this); }
+    };
+
+    // `LEN(text)`, `MID(text, start[, length])`, `INSTR(text, search[, start])`, ... built-in string functions
+    class StringFunctionExpr : public Expr {
+    public:
+        enum Function { LEN, MID, LEFT, RIGHT, INSTR, UPPER, LOWER, SPLIT };
+
+        const Function function;
+        const std::string name;
+        const std::vector<expr_ptr> arguments;
+
+        StringFunctionExpr(Function function, std::string &&name, std::vector<expr_ptr> &&arguments, uint32_t line) :
+            function(function), name(std::move(name)), arguments(std::move(arguments)), Expr(line) {}
+
+        virtual Tokenization::Literal accept(AbstractExprVisitor &v) override { return v.visit(*this); }
+    };
+
+    // `CALL name(arguments)`, `function` is resolved by the parser once the whole program is parsed
+    class CallExpr : public Expr {
+    public:
+        const std::string name;
+        const std::vector<expr_ptr> arguments;
+        FunctionStmt *function = nullptr;
+
+        CallExpr(std::string &&name, std::vector<expr_ptr> &&arguments, uint32_t line) :
+            name(std::move(name)), arguments(std::move(arguments)), Expr(line) {}
+
+        virtual Tokenization::Literal accept(AbstractExprVisitor &v) override { return v.visit(*this); }
+    };
+
+    // `EOF(#number)`, whether every line of the file opened FOR INPUT was read
+    class EofExpr : public Expr {
+    public:
+        const expr_ptr fileNumber;
+
+        EofExpr(expr_ptr &&fileNumber, uint32_t line) : fileNumber(std::move(fileNumber)), Expr(line) {}
 
         virtual Tokenization::Literal accept(AbstractExprVisitor &v) override { return v.visit(*this); }
     };
@@ -137,9 +289,14 @@ namespace ExprStmt {
     // Definitions of all the different statement types
     class PrintStmt : public Stmt {
     public:
-        const expr_ptr expr;
+        // Written between two arguments, `;` writes nothing, `,` a tab
+        enum class Separator : uint8_t { NONE, TAB };
 
-        PrintStmt(expr_ptr &&expr, uint32_t line) : expr(std::move(expr)), Stmt(line) {}
+        const std::vector<expr_ptr> expressions;
+        const std::vector<Separator> separators;  // separators[i] is written before expressions[i + 1]
+
+        PrintStmt(std::vector<expr_ptr> &&expressions, std::vector<Separator> &&separators, uint32_t line)
+            : expressions(std::move(expressions)), separators(std::move(separators)), Stmt(line) {}
 
         virtual void accept(AbstractStmtVisitor &v) override { return v.visit(*this); }
     };
@@ -147,9 +304,9 @@ namespace ExprStmt {
     class InputStmt : public Stmt {
     public:
         const expr_ptr expr;
-        const std::string targetVarName;
+        const VarRef targetVarName;
 
-        InputStmt(expr_ptr &&expr, std::string &&targetVar, uint32_t line) : expr(std::move(expr)),
+        InputStmt(expr_ptr &&expr, VarRef &&targetVar, uint32_t line) : expr(std::move(expr)),
                                                               targetVarName(std::move(targetVar)), Stmt(line) {}
 
         virtual void accept(AbstractStmtVisitor &v) override { return v.visit(*this); }
@@ -158,20 +315,79 @@ namespace ExprStmt {
     class LetStmt : public Stmt {
     public:
         const expr_ptr expr;
-        const std::string targetVarName;
+        const VarRef targetVarName;
 
-        LetStmt(expr_ptr &&expr, std::string &&targetVar, uint32_t line) : expr(std::move(expr)),
+        LetStmt(expr_ptr &&expr, VarRef &&targetVar, uint32_t line) : expr(std::move(expr)),
                                                             targetVarName(std::move(targetVar)), Stmt(line) {}
 
         virtual void accept(AbstractStmtVisitor &v) override { return v.visit(*this); }
     };
 
+    class ArrayLetStmt : public Stmt {
+    public:
+        const expr_ptr index;
+        const expr_ptr expr;
+        const VarRef targetVarName;
+
+        ArrayLetStmt(expr_ptr &&index, expr_ptr &&expr, VarRef &&targetVar, uint32_t line) :
+            index(std::move(index)), expr(std::move(expr)), targetVarName(std::move(targetVar)), Stmt(line) {}
+
+        virtual void accept(AbstractStmtVisitor &v) override { return v.visit(*this); }
+    };
+
+    class DimStmt : public Stmt {
+    public:
+        const VarRef varName;
+        const expr_ptr size;
+
+        DimStmt(VarRef &&varName, expr_ptr &&size, uint32_t line) : varName(std::move(varName)),
+                                                                        size(std::move(size)), Stmt(line) {}
+
+        virtual void accept(AbstractStmtVisitor &v) override { return v.visit(*this); }
+    };
+
+    class MapStmt : public Stmt {
+    public:
+        const VarRef varName;
+
+        MapStmt(VarRef &&varName, uint32_t line) : varName(std::move(varName)), Stmt(line) {}
+
+        virtual void accept(AbstractStmtVisitor &v) override { return v.visit(*this); }
+    };
+
+    class PutStmt : public Stmt {
+    public:
+        const VarRef mapVar;
+        const expr_ptr key;
+        const expr_ptr value;
+
+        PutStmt(VarRef &&mapVar, expr_ptr &&key, expr_ptr &&value, uint32_t line) : mapVar(std::move(mapVar)),
+                                                                                        key(std::move(key)),
+                                                                                        value(std::move(value)), Stmt(line) {}
+
+        virtual void accept(AbstractStmtVisitor &v) override { return v.visit(*this); }
+    };
+
+    // `GET dstVar, mapVar, key` or `HAS dstVar, mapVar, key`, told apart by `op`
+    class GetStmt : public Stmt {
+    public:
+        const Tokenization::Token op;
+        const VarRef dstVar;
+        const VarRef mapVar;
+        const expr_ptr key;
+
+        GetStmt(Tokenization::Token &&op, VarRef &&dstVar, VarRef &&mapVar, expr_ptr &&key, uint32_t line) :
+            op(op), dstVar(std::move(dstVar)), mapVar(std::move(mapVar)), key(std::move(key)), Stmt(line) {}
+
+        virtual void accept(AbstractStmtVisitor &v) override { return v.visit(*this); }
+    };
+
     class ToNumStmt : public Stmt {
     public:
-        const std::string srcVar;
-        const std::optional<std::string> dstVar;
+        const VarRef srcVar;
+        const std::optional<VarRef> dstVar;
 
-        ToNumStmt(std::string &&srcVar, std::optional<std::string> &&dstVar, uint32_t line) : srcVar(std::move(srcVar)),
+        ToNumStmt(VarRef &&srcVar, std::optional<VarRef> &&dstVar, uint32_t line) : srcVar(std::move(srcVar)),
                                                                                               dstVar(std::move(dstVar)), Stmt(line) {}
 
         virtual void accept(AbstractStmtVisitor &v) override { return v.visit(*this); }
@@ -179,10 +395,10 @@ namespace ExprStmt {
     
     class ToStrStmt : public Stmt {
     public:
-        const std::string srcVar;
-        const std::optional<std::string> dstVar;
+        const VarRef srcVar;
+        const std::optional<VarRef> dstVar;
 
-        ToStrStmt(std::string &&srcVar, std::optional<std::string> &&dstVar, uint32_t line) : srcVar(std::move(srcVar)),
+        ToStrStmt(VarRef &&srcVar, std::optional<VarRef> &&dstVar, uint32_t line) : srcVar(std::move(srcVar)),
                                                                                               dstVar(std::move(dstVar)), Stmt(line) {}
 
         virtual void accept(AbstractStmtVisitor &v) override { return v.visit(*this); }
@@ -190,11 +406,11 @@ namespace ExprStmt {
     
     class RndStmt : public Stmt {
     public:
-        const std::string dstVar;
+        const VarRef dstVar;
         const expr_ptr lowerBound;
         const expr_ptr upperBound;
 
-        RndStmt(std::string &&dstVar, expr_ptr &&lowerBound, expr_ptr &&upperBound, uint32_t line) : dstVar(std::move(dstVar)),
+        RndStmt(VarRef &&dstVar, expr_ptr &&lowerBound, expr_ptr &&upperBound, uint32_t line) : dstVar(std::move(dstVar)),
                                                                                       lowerBound(std::move(lowerBound)),
                                                                                       upperBound(std::move(upperBound)), Stmt(line) {}
 
@@ -233,6 +449,64 @@ namespace ExprStmt {
         virtual void accept(AbstractStmtVisitor &v) override { return v.visit(*this); }
     };
 
+    class ParallelForStmt : public Stmt {
+    public:
+        // `REDUCE varName WITH op` clause
+        struct Reduction {
+            std::string varName;
+            Tokenization::Token op;
+        };
+
+        const std::string loopVarName;
+        const expr_ptr fromExpr;
+        const expr_ptr toExpr;
+        const std::vector<Reduction> reductions;
+        const stmt_ptr body;
+
+        ParallelForStmt(std::string &&loopVarName, expr_ptr &&fromExpr, expr_ptr &&toExpr,
+                        std::vector<Reduction> &&reductions, stmt_ptr &&body, uint32_t line) :
+            loopVarName(std::move(loopVarName)), fromExpr(std::move(fromExpr)), toExpr(std::move(toExpr)),
+            reductions(std::move(reductions)), body(std::move(body)), Stmt(line) {}
+
+        virtual void accept(AbstractStmtVisitor &v) override { return v.visit(*this); }
+    };
+
+    // Parameters are the first slots of the frame, followed by the other local variables
+    class FunctionStmt : public Stmt {
+    public:
+        const std::string name;
+        const uint32_t parameterCount;
+        const uint32_t frameSize;
+        // Deepest nesting of blocks and expressions in the body, which every running call adds to the C++ stack
+        const uint32_t nestingHeight;
+        const stmt_ptr body;
+
+        FunctionStmt(std::string &&name, uint32_t parameterCount, uint32_t frameSize, uint32_t nestingHeight,
+                     stmt_ptr &&body, uint32_t line) :
+            name(std::move(name)), parameterCount(parameterCount), frameSize(frameSize), nestingHeight(nestingHeight),
+            body(std::move(body)), Stmt(line) {}
+
+        virtual void accept(AbstractStmtVisitor &v) override { return v.visit(*this); }
+    };
+
+    class CallStmt : public Stmt {
+    public:
+        const std::unique_ptr<CallExpr> call;
+
+        CallStmt(std::unique_ptr<CallExpr> &&call, uint32_t line) : call(std::move(call)), Stmt(line) {}
+
+        virtual void accept(AbstractStmtVisitor &v) override { return v.visit(*this); }
+    };
+
+    class ReturnStmt : public Stmt {
+    public:
+        const std::optional<expr_ptr> value;
+
+        ReturnStmt(std::optional<expr_ptr> &&value, uint32_t line) : value(std::move(value)), Stmt(line) {}
+
+        virtual void accept(AbstractStmtVisitor &v) override { return v.visit(*this); }
+    };
+
     class BreakStmt : public Stmt {
     public:
         BreakStmt(uint32_t line) : Stmt(line) {}
@@ -247,6 +521,65 @@ namespace ExprStmt {
         virtual void accept(AbstractStmtVisitor &v) override { return v.visit(*this); }
     };
 
+    // `OPEN path FOR INPUT AS #number` or `OPEN path FOR OUTPUT AS #number`
+    class OpenStmt : public Stmt {
+    public:
+        const expr_ptr path;
+        const bool forOutput;
+        const expr_ptr fileNumber;
+
+        OpenStmt(expr_ptr &&path, bool forOutput, expr_ptr &&fileNumber, uint32_t line) :
+            path(std::move(path)), forOutput(forOutput), fileNumber(std::move(fileNumber)), Stmt(line) {}
+
+        virtual void accept(AbstractStmtVisitor &v) override { return v.visit(*this); }
+    };
+
+    // `READLINE #number, dstVar`
+    class ReadLineStmt : public Stmt {
+    public:
+        const expr_ptr fileNumber;
+        const VarRef dstVar;
+
+        ReadLineStmt(expr_ptr &&fileNumber, VarRef &&dstVar, uint32_t line) :
+            fileNumber(std::move(fileNumber)), dstVar(std::move(dstVar)), Stmt(line) {}
+
+        virtual void accept(AbstractStmtVisitor &v) override { return v.visit(*this); }
+    };
+
+    // `WRITE #number, expr` writes the value as PRINT does
+    class WriteStmt : public Stmt {
+    public:
+        const expr_ptr fileNumber;
+        const expr_ptr expr;
+
+        WriteStmt(expr_ptr &&fileNumber, expr_ptr &&expr, uint32_t line) :
+            fileNumber(std::move(fileNumber)), expr(std::move(expr)), Stmt(line) {}
+
+        virtual void accept(AbstractStmtVisitor &v) override { return v.visit(*this); }
+    };
+
+    // `CLOSE #number`
+    class CloseStmt : public Stmt {
+    public:
+        const expr_ptr fileNumber;
+
+        CloseStmt(expr_ptr &&fileNumber, uint32_t line) : fileNumber(std::move(fileNumber)), Stmt(line) {}
+
+        virtual void accept(AbstractStmtVisitor &v) override { return v.visit(*this); }
+    };
+
+
+    inline double AbstractExprVisitor::visitNumber(UnaryExpr &expr) { return std::get<double>(visit(expr)); }
+    inline double AbstractExprVisitor::visitNumber(BinaryExpr &expr) { return std::get<double>(visit(expr)); }
+    inline double AbstractExprVisitor::visitNumber(GroupingExpr &expr) { return std::get<double>(visit(expr)); }
+    inline double AbstractExprVisitor::visitNumber(LiteralExpr &expr) { return std::get<double>(visit(expr)); }
+    inline double AbstractExprVisitor::visitNumber(VarExpr &expr) { return std::get<double>(visit(expr)); }
+    inline double AbstractExprVisitor::visitNumber(ArrayExpr &expr) { return std::get<double>(visit(expr)); }
+    inline bool AbstractExprVisitor::visitBoolean(UnaryExpr &expr) { return std::get<bool>(visit(expr)); }
+    inline bool AbstractExprVisitor::visitBoolean(BinaryExpr &expr) { return std::get<bool>(visit(expr)); }
+    inline bool AbstractExprVisitor::visitBoolean(GroupingExpr &expr) { return std::get<bool>(visit(expr)); }
+    inline bool AbstractExprVisitor::visitBoolean(LiteralExpr &expr) { return std::get<bool>(visit(expr)); }
+    inline bool AbstractExprVisitor::visitBoolean(VarExpr &expr) { return std::get<bool>(visit(expr)); }
 }
 
 #endif //BASICPLUSPLUS_EXPRESSIONSSTATEMENTS_HPP
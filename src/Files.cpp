@@ -0,0 +1,162 @@
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Files.hpp"
+
+namespace Files {
+    FileError::FileError(int error) : std::runtime_error(std::strerror(error)) {}
+
+    LineReader::LineReader(const std::string &path) {
+        fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) throw FileError(errno);
+        struct stat status;
+        if (fstat(fd, &status) < 0) {
+            int error = errno;
+            ::close(fd);
+            throw FileError(error);
+        }
+        if (S_ISDIR(status.st_mode)) {
+            ::close(fd);
+            throw FileError(EISDIR);
+        }
+        if (S_ISREG(status.st_mode) && status.st_size > 0) {
+            void *mapped = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                madvise(mapped, status.st_size, MADV_SEQUENTIAL);
+                mapping = static_cast<char *>(mapped);
+                mappingSize = status.st_size;
+                next = mapping;
+                end = mapping + mappingSize;
+                endOfFile = true;
+                return;
+            }
+        }
+        // Not a regular file, or one that can not be mapped
+        capacity = bufferSize;
+        buffer = std::make_unique<char[]>(capacity);
+        next = end = buffer.get();
+    }
+
+    LineReader::~LineReader() {
+        if (mapping) munmap(mapping, mappingSize);
+        ::close(fd);
+    }
+
+    bool LineReader::fill() {
+        if (endOfFile) return false;
+        size_t unread = end - next;
+        if (unread == capacity) {
+            // Line longer than the buffer
+            auto larger = std::make_unique<char[]>(capacity * 2);
+            std::memcpy(larger.get(), next, unread);
+            buffer = std::move(larger);
+            capacity *= 2;
+        } else {
+            std::memmove(buffer.get(), next, unread);
+        }
+        next = buffer.get();
+        end = next + unread;
+        while (true) {
+            ssize_t count = ::read(fd, buffer.get() + unread, capacity - unread);
+            if (count < 0 && errno == EINTR) continue;
+            if (count < 0) throw FileError(errno);
+            if (count == 0) {
+                endOfFile = true;
+                return false;
+            }
+            end += count;
+            return true;
+        }
+    }
+
+    bool LineReader::atEnd() {
+        while (next == end) {
+            if (!fill()) return true;
+        }
+        return false;
+    }
+
+    bool LineReader::readLine(std::string_view &line) {
+        size_t searched = 0;
+        while (true) {
+            auto lineBreak = static_cast<const char *>(std::memchr(next + searched, '\n', end - next - searched));
+            if (lineBreak) {
+                line = std::string_view(next, lineBreak - next);
+                next = lineBreak + 1;
+                break;
+            }
+            searched = end - next;
+            if (!fill()) {
+                if (next == end) return false;
+                // Last line without line break
+                line = std::string_view(next, end - next);
+                next = end;
+                break;
+            }
+        }
+        if (mapping && next - mapping - released >= releaseStep) {
+            // Whole pages before the line just read are not needed anymore
+            size_t page = sysconf(_SC_PAGESIZE);
+            size_t releaseEnd = (line.data() - mapping) / page * page;
+            if (releaseEnd > released) {
+                madvise(mapping + released, releaseEnd - released, MADV_DONTNEED);
+                released = releaseEnd;
+            }
+        }
+        return true;
+    }
+
+    BufferedWriter::BufferedWriter(const std::string &path) {
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if (fd < 0) throw FileError(errno);
+        buffer = std::make_unique<char[]>(bufferSize);
+    }
+
+    BufferedWriter::~BufferedWriter() {
+        if (fd < 0) return;
+        try {
+            writeAll(buffer.get(), used);
+        } catch (const FileError &) {
+            // Error is reported only by close()
+        }
+        ::close(fd);
+    }
+
+    void BufferedWriter::writeAll(const char *data, size_t size) {
+        while (size > 0) {
+            ssize_t written = ::write(fd, data, size);
+            if (written < 0 && errno == EINTR) continue;
+            if (written < 0) throw FileError(errno);
+            data += written;
+            size -= written;
+        }
+    }
+
+    void BufferedWriter::writeLarge(std::string_view text) {
+        writeAll(buffer.get(), used);
+        used = 0;
+        if (text.size() >= bufferSize) {
+            writeAll(text.data(), text.size());
+        } else {
+            text.copy(buffer.get(), text.size());
+            used = text.size();
+        }
+    }
+
+    void BufferedWriter::close() {
+        try {
+            writeAll(buffer.get(), used);
+            used = 0;
+        } catch (const FileError &) {
+            ::close(fd);
+            fd = -1;
+            throw;
+        }
+        int result = ::close(fd);
+        fd = -1;
+        if (result < 0) throw FileError(errno);
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef BASICPLUSPLUS_FILES_HPP
+#define BASICPLUSPLUS_FILES_HPP
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// Files opened by `OPEN path FOR INPUT|OUTPUT AS #n`, read line by line and written in large blocks,
+// so scripts stream files of any size at disk speed without a system call per line.
+namespace Files {
+    // Reason of a failed system call, as strerror describes errno
+    class FileError : public std::runtime_error {
+    public:
+        explicit FileError(int error);
+    };
+
+    // Regular files are mapped whole and lines are found with memchr straight in the mapping, which glibc scans
+    // a vector at a time. Pages behind the read position are unmapped as reading goes, so memory stays bounded
+    // for files larger than RAM. Pipes and devices are read through a large buffer instead.
+    class LineReader {
+    private:
+        static constexpr size_t bufferSize = 1 << 20;
+        // Read pages are released every this many bytes
+        static constexpr size_t releaseStep = 64 << 20;
+
+        int fd;
+        char *mapping = nullptr;
+        size_t mappingSize = 0;
+        size_t released = 0;  // Mapped bytes already released
+        std::unique_ptr<char[]> buffer;
+        size_t capacity = 0;
+        const char *next = nullptr;  // First unread character
+        const char *end = nullptr;   // End of mapped or buffered data
+        bool endOfFile = false;      // Nothing more to read from fd
+
+        // Reads more into the buffer, keeping the unread characters, false at the end of file
+        bool fill();
+
+    public:
+        // Throws FileError
+        explicit LineReader(const std::string &path);
+
+        ~LineReader();
+
+        LineReader(const LineReader &) = delete;
+
+        LineReader &operator=(const LineReader &) = delete;
+
+        // Whether every line was read. Throws FileError.
+        bool atEnd();
+
+        // Next line without its line break, valid until the next call, false after the last line.
+        // The last line may end without a line break. Throws FileError.
+        bool readLine(std::string_view &line);
+    };
+
+    // Coalesces writes in a large buffer and writes it in one system call when full
+    class BufferedWriter {
+    private:
+        static constexpr size_t bufferSize = 1 << 20;
+
+        int fd;
+        std::unique_ptr<char[]> buffer;
+        size_t used = 0;
+
+        void writeAll(const char *data, size_t size);
+
+    public:
+        // Creates or truncates the file. Throws FileError.
+        explicit BufferedWriter(const std::string &path);
+
+        // Flushes what close() did not, ignoring errors
+        ~BufferedWriter();
+
+        BufferedWriter(const BufferedWriter &) = delete;
+
+        BufferedWriter &operator=(const BufferedWriter &) = delete;
+
+        // Throws FileError
+        void write(std::string_view text) {
+            if (text.size() <= bufferSize - used) {
+                text.copy(buffer.get() + used, text.size());
+                used += text.size();
+            } else {
+                writeLarge(text);
+            }
+        }
+
+        // Text which does not fit to the buffer, throws FileError
+        void writeLarge(std::string_view text);
+
+        // Writes the buffer and closes the file, throws FileError
+        void close();
+    };
+}
+
+#endif //BASICPLUSPLUS_FILES_HPP
@@ -0,0 +1,51 @@
+#include "HashMap.hpp"
+
+namespace Values {
+    // Slot holding the key, or the empty slot where it belongs
+    size_t HashMap::findSlot(const RcString &key, uint64_t hash) const {
+        uint32_t tag = static_cast<uint32_t>(hash >> 32);
+        size_t index = hash & mask;
+        while (true) {
+            const Slot &slot = slots[index];
+            if (slot.entry == 0) return index;
+            if (slot.hashTag == tag) {
+                const Entry &entry = entries[slot.entry - 1];
+                if (entry.hash == hash && entry.key == key) return index;
+            }
+            index = (index + 1) & mask;
+        }
+    }
+
+    void HashMap::grow() {
+        size_t capacity = slots.empty() ? 16 : slots.size() * 2;
+        slots.assign(capacity, {0, 0});
+        mask = capacity - 1;
+        for (size_t i = 0; i < entries.size(); i++) {
+            uint64_t hash = entries[i].hash;
+            size_t index = hash & mask;
+            while (slots[index].entry != 0) index = (index + 1) & mask;
+            slots[index] = {static_cast<uint32_t>(i + 1), static_cast<uint32_t>(hash >> 32)};
+        }
+    }
+
+    const Tokenization::Literal *HashMap::find(const RcString &key) const {
+        if (entries.empty()) return nullptr;
+        const Slot &slot = slots[findSlot(key, key.hash())];
+        if (slot.entry == 0) return nullptr;
+        return &entries[slot.entry - 1].value;
+    }
+
+    void HashMap::put(const RcString &key, Tokenization::Literal &&value) {
+        // Load factor is kept at most 3/4, so probe sequences stay short
+        if ((entries.size() + 1) * 4 > slots.size() * 3) grow();
+
+        uint64_t keyHash = key.hash();
+        Slot &slot = slots[findSlot(key, keyHash)];
+        if (slot.entry != 0) {
+            entries[slot.entry - 1].value = std::move(value);
+            return;
+        }
+        entries.push_back({key, keyHash, std::move(value)});
+        slot = {static_cast<uint32_t>(entries.size()), static_cast<uint32_t>(keyHash >> 32)};
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef BASICPLUSPLUS_HASHMAP_HPP
+#define BASICPLUSPLUS_HASHMAP_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "MemoryBudget.hpp"
+#include "RcString.hpp"
+#include "Tokenization.hpp"
+
+namespace Values {
+    // Map from string keys to values created by `MAP`, shared by reference between variables.
+    // Open addressing with linear probing; slots hold only entry index and part of the key hash,
+    // so probing stays within one small array and entries are compared only when the hash matches.
+    class HashMap {
+    public:
+        struct Entry {
+            RcString key;
+            uint64_t hash;  // Hash cached by the key, reused when the table grows
+            Tokenization::Literal value;
+        };
+
+    private:
+        struct Slot {
+            uint32_t entry;    // Index into entries + 1, 0 for empty slot
+            uint32_t hashTag;  // Upper half of the key hash
+        };
+
+        std::vector<Entry> entries;  // In insertion order
+        std::vector<Slot> slots;     // Power of two size
+        size_t mask = 0;
+
+        size_t findSlot(const RcString &key, uint64_t hash) const;
+
+        void grow();
+
+    public:
+        // Interpreter that created the map, PARALLEL FOR iterations may only modify maps they created
+        const void *owner;
+
+        // Budget charged for the map and its entries by the interpreter, nullptr without memory limit
+        std::shared_ptr<MemoryBudget> budget;
+        uint64_t chargedBytes = 0;
+
+        // Memory charged for an entry besides its key and string value, slots included at average load
+        static constexpr uint64_t entryBytes = sizeof(Entry) + 2 * sizeof(Slot);
+
+        explicit HashMap(const void *owner) : owner(owner) {}
+
+        ~HashMap() {
+            if (budget) budget->release(chargedBytes);
+        }
+
+        HashMap(const HashMap &) = delete;
+
+        HashMap &operator=(const HashMap &) = delete;
+
+        // nullptr when key is not present
+        const Tokenization::Literal *find(const RcString &key) const;
+
+        // Stores the key itself, sharing its characters
+        void put(const RcString &key, Tokenization::Literal &&value);
+
+        size_t size() const { return entries.size(); }
+
+        const std::vector<Entry> &getEntries() const { return entries; }
+    };
+}
+
+#endif //BASICPLUSPLUS_HASHMAP_HPP
@@ -1,9 +1,23 @@
+#include <algorithm>
 #include <sstream>
 #include <cmath>
 #include <iostream>
 #include "Interpreter.hpp"
+#include "Numbers.hpp"
+#include "Strings.hpp"
+#include "ThreadPool.hpp"
+#include "TypeInference.hpp"
 
 namespace Interpreting {
+    using ArrayPtr = std::shared_ptr<Values::NumArray>;
+    using MapPtr = std::shared_ptr<Values::HashMap>;
+
+    // Bytes of a value charged to the memory budget where it is stored, arrays and maps are charged on their own
+    static uint64_t stringBytes(const Tokenization::Literal &value) {
+        const Values::RcString *string = std::get_if<Values::RcString>(&value);
+        return string ? string->size() : 0;
+    }
+
     Tokenization::Literal Interpreter::visit(ExprStmt::LiteralExpr &expr) {
         return expr.value;
     }
@@ -14,13 +28,22 @@ namespace Interpreting {
 
     Tokenization::Literal Interpreter::visit(ExprStmt::UnaryExpr &expr) {
         Tokenization::Literal right = expr.right->accept(*this);
-        switch (expr.op.type) {
+        return unaryOperation(expr.op.type, right, expr.line);
+    }
+
+    Tokenization::Literal Interpreter::unaryOperation(Tokenization::TokenType op, Tokenization::Literal &right,
+                                                      uint32_t line) {
+        switch (op) {
             case Tokenization::MINUS:
                 if (std::holds_alternative<double>(right)) return -std::get<double>(right);
-                throwError("Unary '-' is not allowed on '" + getLiteralTypeName(right) + "' type.", expr);
+                if (std::holds_alternative<ArrayPtr>(right)) {
+                    Tokenization::Literal minusOne = -1.;
+                    return arrayOperation(Tokenization::STAR, right, minusOne, line);
+                }
+                throwError("Unary '-' is not allowed on '" + getLiteralTypeName(right) + "' type.", line);
             case Tokenization::NOT:
                 if (std::holds_alternative<bool>(right)) return !std::get<bool>(right);
-                throwError("Unary 'NOT' is not allowed on '" + getLiteralTypeName(right) + "' type.", expr);
+                throwError("Unary 'NOT' is not allowed on '" + getLiteralTypeName(right) + "' type.", line);
         }
         
         // Unreachable
@@ -28,153 +51,564 @@ namespace Interpreting {
     }
 
     Tokenization::Literal Interpreter::visit(ExprStmt::BinaryExpr &expr) {
+        if (expr.staticType == ExprStmt::StaticType::NUMBER) return visitNumber(expr);
+        if (expr.staticType == ExprStmt::StaticType::BOOLEAN) return visitBoolean(expr);
         Tokenization::Literal left = expr.left->accept(*this);
         Tokenization::Literal right = expr.right->accept(*this);
+        return binaryOperation(expr.op.type, left, right, expr.line);
+    }
+
+    // Proven types: operands of the node are annotated as TypeInference infers its type from them,
+    // so their values are read without checking the variant
+    double Interpreter::visitNumber(ExprStmt::UnaryExpr &expr) {
+        return -expr.right->acceptNumber(*this);
+    }
 
+    double Interpreter::visitNumber(ExprStmt::BinaryExpr &expr) {
+        double left = expr.left->acceptNumber(*this);
+        double right = expr.right->acceptNumber(*this);
         switch (expr.op.type) {
+            case Tokenization::PLUS:
+                return left + right;
+            case Tokenization::MINUS:
+                return left - right;
+            case Tokenization::STAR:
+                return left * right;
+            default:
+                if (right == 0) throwError("DivisionByZero", expr);
+                return left / right;
+        }
+    }
+
+    double Interpreter::visitNumber(ExprStmt::GroupingExpr &expr) {
+        return expr.expression->acceptNumber(*this);
+    }
+
+    double Interpreter::visitNumber(ExprStmt::LiteralExpr &expr) {
+        return *std::get_if<double>(&expr.value);
+    }
+
+    double Interpreter::visitNumber(ExprStmt::VarExpr &expr) {
+        // Proven variables are assigned on every path from the start of the program, restored state may still differ
+        const Tokenization::Literal *value = findVariable(expr.varName);
+        if (const double *number = value ? std::get_if<double>(value) : nullptr) [[likely]] return *number;
+        throwUnprovenRead(expr.varName.name, value, "number", expr.line);
+        return 0;  // Unreachable
+    }
+
+    double Interpreter::visitNumber(ExprStmt::ArrayExpr &expr) {
+        if (expr.index->staticType == ExprStmt::StaticType::NUMBER) {
+            double position = expr.index->acceptNumber(*this);
+            Values::NumArray &array = getArray(expr.varName, expr.line);
+            return array.values[arrayIndex(array, position, expr.line)];
+        }
+        Tokenization::Literal index = expr.index->accept(*this);
+        Values::NumArray &array = getArray(expr.varName, expr.line);
+        return array.values[arrayIndex(array, index, expr.line)];
+    }
+
+    bool Interpreter::visitBoolean(ExprStmt::UnaryExpr &expr) {
+        return !expr.right->acceptBoolean(*this);
+    }
+
+    bool Interpreter::visitBoolean(ExprStmt::BinaryExpr &expr) {
+        if (expr.left->staticType == ExprStmt::StaticType::NUMBER) {
+            double left = expr.left->acceptNumber(*this);
+            double right = expr.right->acceptNumber(*this);
+            switch (expr.op.type) {
+                case Tokenization::LESS:
+                    return left < right;
+                case Tokenization::GREATER:
+                    return left > right;
+                case Tokenization::LESS_EQUAL:
+                    return left <= right;
+                case Tokenization::GREATER_EQUAL:
+                    return left >= right;
+                case Tokenization::EQUAL_EQUAL:
+                    return left == right;
+                default:
+                    return left != right;
+            }
+        }
+        if (expr.left->staticType == ExprStmt::StaticType::BOOLEAN) {
+            // Both operands are evaluated, as in binaryOperation
+            bool left = expr.left->acceptBoolean(*this);
+            bool right = expr.right->acceptBoolean(*this);
+            return expr.op.type == Tokenization::AND ? left && right : left || right;
+        }
+        // Strings compared by == or <>
+        Tokenization::Literal left = expr.left->accept(*this);
+        Tokenization::Literal right = expr.right->accept(*this);
+        bool equal = *std::get_if<Values::RcString>(&left) == *std::get_if<Values::RcString>(&right);
+        return expr.op.type == Tokenization::EQUAL_EQUAL ? equal : !equal;
+    }
+
+    bool Interpreter::visitBoolean(ExprStmt::GroupingExpr &expr) {
+        return expr.expression->acceptBoolean(*this);
+    }
+
+    bool Interpreter::visitBoolean(ExprStmt::LiteralExpr &expr) {
+        return *std::get_if<bool>(&expr.value);
+    }
+
+    bool Interpreter::visitBoolean(ExprStmt::VarExpr &expr) {
+        const Tokenization::Literal *value = findVariable(expr.varName);
+        if (const bool *boolean = value ? std::get_if<bool>(value) : nullptr) [[likely]] return *boolean;
+        throwUnprovenRead(expr.varName.name, value, "boolean", expr.line);
+        return false;  // Unreachable
+    }
+
+    Tokenization::Literal Interpreter::binaryOperation(Tokenization::TokenType op, Tokenization::Literal &left,
+                                                       Tokenization::Literal &right, uint32_t line) {
+        switch (op) {
             case Tokenization::PLUS:
                 if (std::holds_alternative<double>(left) && std::holds_alternative<double>(right)){
                     return std::get<double>(left) + std::get<double>(right);
                 }
-                if (std::holds_alternative<std::string>(left)){
-                    return std::get<std::string>(left) + stringify(right);
+                if (std::holds_alternative<Values::RcString>(left) || std::holds_alternative<Values::RcString>(right)){
+                    std::string leftBuffer, rightBuffer;
+                    std::string_view leftText = textOf(left, leftBuffer);
+                    std::string_view rightText = textOf(right, rightBuffer);
+                    if (memoryBudget) [[unlikely]] checkTemporary(leftText.size() + rightText.size(), line);
+                    return Values::RcString::concat(leftText, rightText);
                 }
-                if (std::holds_alternative<std::string>(right)){
-                    return stringify(right) + std::get<std::string>(right);
+                if (std::holds_alternative<ArrayPtr>(left) || std::holds_alternative<ArrayPtr>(right)) {
+                    return arrayOperation(op, left, right, line);
                 }
-                throwError("Binary '+' is not allowed on '" + getLiteralTypeName(left) + "' + '" + getLiteralTypeName(right) + "' types.", expr);
+                throwError("Binary '+' is not allowed on '" + getLiteralTypeName(left) + "' + '" + getLiteralTypeName(right) + "' types.", line);
                 
             case Tokenization::MINUS:
                 if (std::holds_alternative<double>(left) && std::holds_alternative<double>(right)){
                     return std::get<double>(left) - std::get<double>(right);
                 }
-                throwError("Binary '-' is not allowed on '" + getLiteralTypeName(left) + "' - '" + getLiteralTypeName(right) + "' types.", expr);
+                if (std::holds_alternative<ArrayPtr>(left) || std::holds_alternative<ArrayPtr>(right)) {
+                    return arrayOperation(op, left, right, line);
+                }
+                throwError("Binary '-' is not allowed on '" + getLiteralTypeName(left) + "' - '" + getLiteralTypeName(right) + "' types.", line);
                 
             case Tokenization::STAR:
                 if (std::holds_alternative<double>(left) && std::holds_alternative<double>(right)){
                     return std::get<double>(left) * std::get<double>(right);
                 }
-                throwError("Binary '*' is not allowed on '" + getLiteralTypeName(left) + "' * '" + getLiteralTypeName(right) + "' types.", expr);
+                if (std::holds_alternative<ArrayPtr>(left) || std::holds_alternative<ArrayPtr>(right)) {
+                    return arrayOperation(op, left, right, line);
+                }
+                throwError("Binary '*' is not allowed on '" + getLiteralTypeName(left) + "' * '" + getLiteralTypeName(right) + "' types.", line);
                 
             case Tokenization::SLASH:
                 if (std::holds_alternative<double>(left) && std::holds_alternative<double>(right)){
-                    if (std::get<double>(right) == 0) throwError("DivisionByZero", expr);
-                    return std::get<double>(left) - std::get<double>(right);
+                    if (std::get<double>(right) == 0) throwError("DivisionByZero", line);
+                    return std::get<double>(left) / std::get<double>(right);
+                }
+                if (std::holds_alternative<ArrayPtr>(left) || std::holds_alternative<ArrayPtr>(right)) {
+                    return arrayOperation(op, left, right, line);
                 }
-                throwError("Binary '/' is not allowed on '" + getLiteralTypeName(left) + "' / '" + getLiteralTypeName(right) + "' types.", expr);
+                throwError("Binary '/' is not allowed on '" + getLiteralTypeName(left) + "' / '" + getLiteralTypeName(right) + "' types.", line);
                 
             case Tokenization::LESS:
                 if (std::holds_alternative<double>(left) && std::holds_alternative<double>(right)){
                     return std::get<double>(left) < std::get<double>(right);
                 }
-                throwError("Binary '<' is not allowed on '" + getLiteralTypeName(left) + "' < '" + getLiteralTypeName(right) + "' types.", expr);
+                throwError("Binary '<' is not allowed on '" + getLiteralTypeName(left) + "' < '" + getLiteralTypeName(right) + "' types.", line);
                 
             case Tokenization::GREATER:
                 if (std::holds_alternative<double>(left) && std::holds_alternative<double>(right)){
                     return std::get<double>(left) > std::get<double>(right);
                 }
-                throwError("Binary '>' is not allowed on '" + getLiteralTypeName(left) + "' > '" + getLiteralTypeName(right) + "' types.", expr);
+                throwError("Binary '>' is not allowed on '" + getLiteralTypeName(left) + "' > '" + getLiteralTypeName(right) + "' types.", line);
                 
             case Tokenization::LESS_EQUAL:
                 if (std::holds_alternative<double>(left) && std::holds_alternative<double>(right)){
                     return std::get<double>(left) <= std::get<double>(right);
                 }
-                throwError("Binary '<=' is not allowed on '" + getLiteralTypeName(left) + "' <= '" + getLiteralTypeName(right) + "' types.", expr);
+                throwError("Binary '<=' is not allowed on '" + getLiteralTypeName(left) + "' <= '" + getLiteralTypeName(right) + "' types.", line);
                 
             case Tokenization::GREATER_EQUAL:
                 if (std::holds_alternative<double>(left) && std::holds_alternative<double>(right)){
                     return std::get<double>(left) >= std::get<double>(right);
                 }
-                throwError("Binary '>=' is not allowed on '" + getLiteralTypeName(left) + "' >= '" + getLiteralTypeName(right) + "' types.", expr);
+                throwError("Binary '>=' is not allowed on '" + getLiteralTypeName(left) + "' >= '" + getLiteralTypeName(right) + "' types.", line);
                 
             case Tokenization::EQUAL_EQUAL:
                 if (std::holds_alternative<double>(left) && std::holds_alternative<double>(right)){
                     return std::get<double>(left) == std::get<double>(right);
                 }
-                if (std::holds_alternative<std::string>(left) && std::holds_alternative<std::string>(right)){
-                    return std::get<std::string>(left) == std::get<std::string>(right);
+                if (std::holds_alternative<Values::RcString>(left) && std::holds_alternative<Values::RcString>(right)){
+                    return std::get<Values::RcString>(left) == std::get<Values::RcString>(right);
                 }
-                throwError("Binary '==' is not allowed on '" + getLiteralTypeName(left) + "' == '" + getLiteralTypeName(right) + "' types.", expr);
+                throwError("Binary '==' is not allowed on '" + getLiteralTypeName(left) + "' == '" + getLiteralTypeName(right) + "' types.", line);
                 
             case Tokenization::NOT_EQUAL:
                 if (std::holds_alternative<double>(left) && std::holds_alternative<double>(right)){
                     return std::get<double>(left) != std::get<double>(right);
                 }
-                if (std::holds_alternative<std::string>(left) && std::holds_alternative<std::string>(right)){
-                    return std::get<std::string>(left) != std::get<std::string>(right);
+                if (std::holds_alternative<Values::RcString>(left) && std::holds_alternative<Values::RcString>(right)){
+                    return !(std::get<Values::RcString>(left) == std::get<Values::RcString>(right));
                 }
-                throwError("Binary '<>' is not allowed on '" + getLiteralTypeName(left) + "' <> '" + getLiteralTypeName(right) + "' types.", expr);
+                throwError("Binary '<>' is not allowed on '" + getLiteralTypeName(left) + "' <> '" + getLiteralTypeName(right) + "' types.", line);
                 
             case Tokenization::AND:
                 if (std::holds_alternative<bool>(left) && std::holds_alternative<bool>(right)){
                     return std::get<bool>(left) && std::get<bool>(right);
                 }
-                throwError("Binary 'AND' is not allowed on '" + getLiteralTypeName(left) + "' AND '" + getLiteralTypeName(right) + "' types.", expr);
+                throwError("Binary 'AND' is not allowed on '" + getLiteralTypeName(left) + "' AND '" + getLiteralTypeName(right) + "' types.", line);
                 
             case Tokenization::OR:
                 if (std::holds_alternative<bool>(left) && std::holds_alternative<bool>(right)){
                     return std::get<bool>(left) || std::get<bool>(right);
                 }
-                throwError("Binary 'OR' is not allowed on '" + getLiteralTypeName(left) + "' OR '" + getLiteralTypeName(right) + "' types.", expr);
+                throwError("Binary 'OR' is not allowed on '" + getLiteralTypeName(left) + "' OR '" + getLiteralTypeName(right) + "' types.", line);
         }
         
         // Unreachable
         throw std::runtime_error("UNREACHABLE!");
     }
 
+    Tokenization::Literal Interpreter::arrayOperation(Tokenization::TokenType op, Tokenization::Literal &left,
+                                                      Tokenization::Literal &right, uint32_t line) {
+        static const std::map<Tokenization::TokenType, std::string> symbols = {
+            {Tokenization::PLUS, "+"}, {Tokenization::MINUS, "-"}, {Tokenization::STAR, "*"}, {Tokenization::SLASH, "/"}
+        };
+        const std::string &symbol = symbols.at(op);
+        bool leftArray = std::holds_alternative<ArrayPtr>(left);
+        bool rightArray = std::holds_alternative<ArrayPtr>(right);
+        if ((!leftArray && !std::holds_alternative<double>(left)) || (!rightArray && !std::holds_alternative<double>(right))) {
+            throwError("Binary '" + symbol + "' is not allowed on '" + getLiteralTypeName(left) + "' " + symbol + " '"
+                       + getLiteralTypeName(right) + "' types.", line);
+        }
+
+        const Values::NumArray *a = leftArray ? std::get<ArrayPtr>(left).get() : nullptr;
+        const Values::NumArray *b = rightArray ? std::get<ArrayPtr>(right).get() : nullptr;
+        if (a && b && a->size() != b->size()) throwError("ArraySizeMismatch", line);
+        size_t n = a ? a->size() : b->size();
+
+        if (op == Tokenization::SLASH) {
+            bool zeroDivisor = b ? Values::Kernels::containsZero(b->data(), n) : std::get<double>(right) == 0;
+            if (zeroDivisor) throwError("DivisionByZero", line);
+        }
+
+        // Operand nobody else references is a temporary of this expression, so its storage is reused
+        ArrayPtr result;
+        if (leftArray && std::get<ArrayPtr>(left).use_count() == 1) {
+            result = std::get<ArrayPtr>(left);
+        } else if (rightArray && std::get<ArrayPtr>(right).use_count() == 1) {
+            result = std::get<ArrayPtr>(right);
+        } else {
+            result = newArray(n, line);
+        }
+        double *out = result->data();
+
+        using namespace Values::Kernels;
+        switch (op) {
+            case Tokenization::PLUS:
+                if (a && b) add(a->data(), b->data(), out, n);
+                else if (a) addScalar(a->data(), std::get<double>(right), out, n);
+                else addScalar(b->data(), std::get<double>(left), out, n);
+                break;
+            case Tokenization::MINUS:
+                if (a && b) subtract(a->data(), b->data(), out, n);
+                else if (a) subtractScalar(a->data(), std::get<double>(right), out, n);
+                else scalarSubtract(std::get<double>(left), b->data(), out, n);
+                break;
+            case Tokenization::STAR:
+                if (a && b) multiply(a->data(), b->data(), out, n);
+                else if (a) multiplyScalar(a->data(), std::get<double>(right), out, n);
+                else multiplyScalar(b->data(), std::get<double>(left), out, n);
+                break;
+            case Tokenization::SLASH:
+                if (a && b) divide(a->data(), b->data(), out, n);
+                else if (a) divideScalar(a->data(), std::get<double>(right), out, n);
+                else scalarDivide(std::get<double>(left), b->data(), out, n);
+                break;
+        }
+        return result;
+    }
+
     Tokenization::Literal Interpreter::visit(ExprStmt::VarExpr &expr) {
         return getVarValue(expr.varName, expr);
     }
 
+    Values::NumArray &Interpreter::getArray(const ExprStmt::VarRef &var, uint32_t line) {
+        return getArray(findVariable(var), var, line);
+    }
+
+    Values::NumArray &Interpreter::getArray(const Tokenization::Literal *value, const ExprStmt::VarRef &var,
+                                            uint32_t line) {
+        if (!value) throwError("VariableNotDeclared '" + var.name + "'", line);
+        if (!std::holds_alternative<ArrayPtr>(*value)) {
+            Tokenization::Literal copy = *value;
+            throwError("Indexing is not allowed on '" + getLiteralTypeName(copy) + "' type.", line);
+        }
+        return *std::get<ArrayPtr>(*value);
+    }
+
+    Values::HashMap &Interpreter::getMap(const ExprStmt::VarRef &var, const char *statement, uint32_t line) {
+        return getMap(findVariable(var), var, statement, line);
+    }
+
+    Values::HashMap &Interpreter::getMap(const Tokenization::Literal *value, const ExprStmt::VarRef &var,
+                                         const char *statement, uint32_t line) {
+        if (!value) throwError("VariableNotDeclared '" + var.name + "'", line);
+        if (!std::holds_alternative<MapPtr>(*value)) {
+            Tokenization::Literal copy = *value;
+            throwError("'" + std::string(statement) + "' is not allowed on '" + getLiteralTypeName(copy) + "' type.", line);
+        }
+        return *std::get<MapPtr>(*value);
+    }
+
+    int64_t Interpreter::fileNumber(ExprStmt::Expr &expr, const char *statement, uint32_t line) {
+        // Files belong to the interpreter running the program, iterations can not share them
+        if (parent) throwError(std::string(statement) + " is not allowed in PARALLEL FOR", line);
+        Tokenization::Literal value = expr.accept(*this);
+        return fileNumber(value, line);
+    }
+
+    int64_t Interpreter::fileNumber(const Tokenization::Literal &value, uint32_t line) {
+        const double *number = std::get_if<double>(&value);
+        int64_t whole;
+        if (!number || !Values::asWhole(*number, whole) || whole < 0 || whole > INT32_MAX) {
+            throwError("InvalidFileNumber", line);
+        }
+        return whole;
+    }
+
+    Interpreter::OpenFile &Interpreter::getFile(ExprStmt::Expr &expr, const char *statement, uint32_t line) {
+        return getFile(fileNumber(expr, statement, line), line);
+    }
+
+    Interpreter::OpenFile &Interpreter::getFile(int64_t number, uint32_t line) {
+        auto file = files.find(number);
+        if (file == files.end()) throwError("FileNotOpen #" + std::to_string(number), line);
+        return file->second;
+    }
+
+    size_t Interpreter::arrayIndex(const Values::NumArray &array, Tokenization::Literal &index, uint32_t line) {
+        if (!std::holds_alternative<double>(index)) throwError("IndexNotNumber", line);
+        // Fractional index is truncated
+        return arrayIndex(array, std::get<double>(index), line);
+    }
+
+    size_t Interpreter::arrayIndex(const Values::NumArray &array, double position, uint32_t line) {
+        if (!(position >= 0 && position < static_cast<double>(array.size()))) throwError("IndexOutOfRange", line);
+        return static_cast<size_t>(position);
+    }
+
+    Tokenization::Literal Interpreter::visit(ExprStmt::ArrayExpr &expr) {
+        return visitNumber(expr);
+    }
+
+    Tokenization::Literal Interpreter::visit(ExprStmt::ArrayFunctionExpr &expr) {
+        Tokenization::Literal argument = expr.argument->accept(*this);
+        return arrayFunction(expr, argument);
+    }
+
+    double Interpreter::arrayFunction(ExprStmt::ArrayFunctionExpr &expr, Tokenization::Literal &argument) {
+        if (!std::holds_alternative<ArrayPtr>(argument)) {
+            throwError("'" + expr.name + "' is not allowed on '" + getLiteralTypeName(argument) + "' type.", expr);
+        }
+        const Values::NumArray &array = *std::get<ArrayPtr>(argument);
+        if (expr.function == ExprStmt::ArrayFunctionExpr::SUM) return Values::Kernels::sum(array.data(), array.size());
+
+        if (array.size() == 0) throwError("EmptyArray", expr);
+        if (expr.function == ExprStmt::ArrayFunctionExpr::MIN) return Values::Kernels::min(array.data(), array.size());
+        return Values::Kernels::max(array.data(), array.size());
+    }
+
+    Tokenization::Literal Interpreter::visit(ExprStmt::StringFunctionExpr &expr) {
+        Tokenization::Literal arguments[3];
+        for (size_t i = 0; i < expr.arguments.size(); i++) arguments[i] = expr.arguments[i]->accept(*this);
+        return stringFunction(expr, arguments);
+    }
+
+    Tokenization::Literal Interpreter::stringFunction(ExprStmt::StringFunctionExpr &expr,
+                                                      Tokenization::Literal *arguments) {
+        using Function = ExprStmt::StringFunctionExpr::Function;
+        const Values::RcString &text = textArgument(expr, arguments[0]);
+        const size_t size = text.size();
+        const bool optional = expr.arguments.size() == 3;
+        switch (expr.function) {
+            case Function::LEN:
+                return static_cast<double>(size);
+            case Function::MID: {
+                // Start past the end gives an empty string, length past the end is cut
+                uint64_t offset = std::min<uint64_t>(countArgument(expr, arguments[1], 1) - 1, size);
+                uint64_t length = optional ? countArgument(expr, arguments[2], 0) : size;
+                return Values::RcString::slice(text, offset, std::min<uint64_t>(length, size - offset));
+            }
+            case Function::LEFT:
+                return Values::RcString::slice(text, 0, std::min<uint64_t>(countArgument(expr, arguments[1], 0), size));
+            case Function::RIGHT: {
+                uint64_t length = std::min<uint64_t>(countArgument(expr, arguments[1], 0), size);
+                return Values::RcString::slice(text, size - length, length);
+            }
+            case Function::INSTR: {
+                const Values::RcString &search = textArgument(expr, arguments[1]);
+                uint64_t from = optional ? countArgument(expr, arguments[2], 1) - 1 : 0;
+                if (from > size) return 0.;
+                size_t position = Values::Strings::find(text.view(), search.view(), from);
+                return position == std::string_view::npos ? 0. : static_cast<double>(position + 1);
+            }
+            case Function::UPPER:
+            case Function::LOWER: {
+                if (memoryBudget) [[unlikely]] checkTemporary(size, expr.line);
+                auto convert = expr.function == Function::UPPER ? Values::Strings::upper : Values::Strings::lower;
+                return Values::RcString::filled(size, [&](char *out) { convert(text.data(), out, size); });
+            }
+            case Function::SPLIT:
+            default: {
+                const Values::RcString &separator = textArgument(expr, arguments[1]);
+                uint64_t field = countArgument(expr, arguments[2], 1);
+                if (separator.empty()) throwError("EmptySeparator", expr);
+                // Skips the fields before the wanted one, fewer fields give an empty string
+                size_t start = 0;
+                for (uint64_t i = 1; i < field; i++) {
+                    size_t end = Values::Strings::find(text.view(), separator.view(), start);
+                    if (end == std::string_view::npos) return Values::RcString();
+                    start = end + separator.size();
+                }
+                size_t end = Values::Strings::find(text.view(), separator.view(), start);
+                return Values::RcString::slice(text, start, (end == std::string_view::npos ? size : end) - start);
+            }
+        }
+    }
+
+    const Values::RcString &Interpreter::textArgument(ExprStmt::StringFunctionExpr &expr,
+                                                      Tokenization::Literal &argument) {
+        if (!std::holds_alternative<Values::RcString>(argument)) {
+            throwError("'" + expr.name + "' is not allowed on '" + getLiteralTypeName(argument) + "' type.", expr);
+        }
+        return std::get<Values::RcString>(argument);
+    }
+
+    uint64_t Interpreter::countArgument(ExprStmt::StringFunctionExpr &expr, Tokenization::Literal &argument,
+                                        uint64_t minimum) {
+        if (!std::holds_alternative<double>(argument)) {
+            throwError("'" + expr.name + "' is not allowed on '" + getLiteralTypeName(argument) + "' type.", expr);
+        }
+        double number = std::get<double>(argument);
+        // Numbers this large are whole and past the end of any string
+        if (number >= Values::wholeLimit && std::isfinite(number)) return UINT64_MAX;
+        int64_t whole;
+        if (!Values::asWhole(number, whole) || whole < static_cast<int64_t>(minimum)) {
+            throwError("InvalidStringPosition", expr);
+        }
+        return static_cast<uint64_t>(whole);
+    }
+
     void Interpreter::throwError(std::string message, ExprStmt::Expr &expr) {
-        errorMessage = std::move(message);
-        errorLine = expr.line;
-        throw InterpreterError();
+        throwError(std::move(message), expr.line);
     }
 
     void Interpreter::throwError(std::string message, ExprStmt::Stmt &stmt) {
+        throwError(std::move(message), stmt.line);
+    }
+
+    void Interpreter::throwError(std::string message, uint32_t line) {
         errorMessage = std::move(message);
-        errorLine = stmt.line;
+        errorLine = line;
         throw InterpreterError();
     }
 
+    void Interpreter::throwUnprovenRead(const std::string &name, const Tokenization::Literal *value, const char *type,
+                                        uint32_t line) {
+        if (!value) throwError("VariableNotDeclared '" + name + "'", line);
+        Tokenization::Literal found = *value;
+        throwError("Variable '" + name + "' is '" + getLiteralTypeName(found) + "' type, not '" + type + "'", line);
+    }
+
     // helper type
     template<class... Ts>
     struct overloaded : Ts... { using Ts::operator()...; };
     
     std::string Interpreter::getLiteralTypeName(Tokenization::Literal &literal) {
         return std::visit(overloaded {
-                [](std::string &arg) { return "string"; },
+                [](Values::RcString &arg) { return "string"; },
                 [](double &arg) { return "number"; },
-                [](bool &arg) { return "boolean"; }
+                [](bool &arg) { return "boolean"; },
+                [](ArrayPtr &arg) { return "array"; },
+                [](MapPtr &arg) { return "map"; }
         }, literal);
     }
 
+    static std::string stringifyNumber(double number) {
+        std::string result;
+        Values::appendNumber(result, number);
+        return result;
+    }
+
+    std::string_view Interpreter::textOf(Tokenization::Literal &literal, std::string &buffer) {
+        if (auto string = std::get_if<Values::RcString>(&literal)) return string->view();
+        // Numbers are formatted into the buffer, without a temporary string
+        if (auto number = std::get_if<double>(&literal)) {
+            buffer.clear();
+            Values::appendNumber(buffer, *number);
+            return buffer;
+        }
+        buffer = stringify(literal);
+        return buffer;
+    }
+
     std::string Interpreter::stringify(Tokenization::Literal &literal) {
         return std::visit(overloaded {
-                [](std::string &arg) { return arg; },
-                [](double &arg) {
-                    if (std::fmod(arg, 1) == 0) {
-                        // Whole number is printed without decimal places
-                        return std::format("{:.0f}", arg);
-                    } else {
-                        return std::format("{:.2f}", arg);
+                [](Values::RcString &arg) { return arg.str(); },
+                [](double &arg) { return stringifyNumber(arg); },
+                [](bool &arg) { return std::string(arg ? "TRUE" : "FALSE"); },
+                [](ArrayPtr &arg) {
+                    std::string result = "[";
+                    for (size_t i = 0; i < arg->size(); i++) {
+                        if (i > 0) result += ", ";
+                        Values::appendNumber(result, arg->values[i]);
                     }
+                    return result + "]";
                 },
-                [](bool &arg) { return std::string(arg ? "TRUE" : "FALSE"); }
+                [this](MapPtr &arg) {
+                    std::string result = "{";
+                    for (auto &entry: arg->getEntries()) {
+                        if (result.size() > 1) result += ", ";
+                        Tokenization::Literal value = entry.value;
+                        result += entry.key.view();
+                        result += ": " + stringify(value);
+                    }
+                    return result + "}";
+                }
         }, literal);
     }
 
-    Tokenization::Literal Interpreter::getVarValue(const std::string &varName, ExprStmt::Expr &expr) {
+    const Tokenization::Literal *Interpreter::findVariable(const std::string &varName) const {
         auto value = globalVariables.find(varName);
-        if (value == globalVariables.end()) throwError("VariableNotDeclared '" + varName + "'", expr);
-        return value->second;
+        if (value != globalVariables.end()) return &value->second;
+        // Inside PARALLEL FOR body, variables not written by the iteration are read from the parent
+        if (parent) return parent->findVariable(varName);
+        return nullptr;
+    }
+
+    const Tokenization::Literal *Interpreter::findVariable(const ExprStmt::VarRef &var) const {
+        if (var.slot >= 0) {
+            const std::optional<Tokenization::Literal> &value = frames[frameBase + var.slot];
+            return value.has_value() ? &value.value() : nullptr;
+        }
+        return findVariable(var.name);
+    }
+
+    Tokenization::Literal &Interpreter::variableForWrite(const ExprStmt::VarRef &var) {
+        if (var.slot >= 0) {
+            std::optional<Tokenization::Literal> &value = frames[frameBase + var.slot];
+            if (!value.has_value()) value.emplace();
+            return value.value();
+        }
+        return globalVariables[var.name];
+    }
+
+    Tokenization::Literal Interpreter::getVarValue(const ExprStmt::VarRef &var, ExprStmt::Expr &expr) {
+        const Tokenization::Literal *value = findVariable(var);
+        if (!value) throwError("VariableNotDeclared '" + var.name + "'", expr);
+        return *value;
     }
     
-    Tokenization::Literal Interpreter::getVarValue(const std::string &varName, ExprStmt::Stmt &stmt) {
-        auto value = globalVariables.find(varName);
-        if (value == globalVariables.end()) throwError("VariableNotDeclared '" + varName + "'", stmt);
-        return value->second;
+    Tokenization::Literal Interpreter::getVarValue(const ExprStmt::VarRef &var, ExprStmt::Stmt &stmt) {
+        const Tokenization::Literal *value = findVariable(var);
+        if (!value) throwError("VariableNotDeclared '" + var.name + "'", stmt);
+        return *value;
     }
     
     std::string &Interpreter::getErrorMessage() {
@@ -186,90 +620,540 @@ namespace Interpreting {
     }
     
     void Interpreter::interpret(ExprStmt::stmt_ptr &stmt) {
-        stmt->accept(*this);
+        execute(*stmt);
+    }
+
+    void Interpreter::interpret(ExprStmt::Stmt &stmt) {
+        execute(stmt);
+    }
+
+    void Interpreter::setVariable(const std::string &name, Tokenization::Literal value) {
+        store(globalVariables[name], std::move(value), 0);
+    }
+
+    std::optional<Tokenization::Literal> Interpreter::getVariable(const std::string &name) const {
+        const Tokenization::Literal *value = findVariable(name);
+        if (!value) return std::nullopt;
+        return *value;
+    }
+
+    void Interpreter::setProfiler(Profiling::Profiler *profiler) {
+        this->profiler = profiler;
+    }
+
+    void Interpreter::setMaxSteps(uint64_t maxSteps) {
+        stepsLeft = maxSteps;
+        fuel = fuelGiven = 0;
+    }
+
+    void Interpreter::setMaxMemory(uint64_t maxBytes) {
+        memoryBudget = std::make_shared<Values::MemoryBudget>(maxBytes);
+    }
+
+    Interpreter::~Interpreter() {
+        releaseVariables();
+    }
+
+    void Interpreter::releaseVariables() {
+        if (!memoryBudget) return;
+        for (auto &[name, value]: globalVariables) memoryBudget->release(stringBytes(value));
+        for (auto &value: frames) {
+            if (value.has_value()) memoryBudget->release(stringBytes(value.value()));
+        }
+    }
+
+    void Interpreter::chargeStore(const Tokenization::Literal &target, const Tokenization::Literal &value,
+                                  uint32_t line) {
+        uint64_t oldBytes = stringBytes(target);
+        uint64_t newBytes = stringBytes(value);
+        if (newBytes > oldBytes) chargeMemory(newBytes - oldBytes, line);
+        else memoryBudget->release(oldBytes - newBytes);
+    }
+
+    void Interpreter::chargeMemory(uint64_t bytes, uint32_t line) {
+        if (!memoryBudget->charge(bytes)) throwError("MemoryLimitExceeded", line);
+    }
+
+    void Interpreter::checkTemporary(uint64_t bytes, uint32_t line) {
+        if (!memoryBudget->fits(bytes)) throwError("MemoryLimitExceeded", line);
+    }
+
+    std::shared_ptr<Values::NumArray> Interpreter::newArray(size_t size, uint32_t line) {
+        if (!memoryBudget) return std::make_shared<Values::NumArray>(size);
+        // Charged before allocation, so an array over the limit is never allocated
+        chargeMemory(Values::NumArray::bytes(size), line);
+        ArrayPtr array;
+        try {
+            array = std::make_shared<Values::NumArray>(size);
+        } catch (...) {
+            memoryBudget->release(Values::NumArray::bytes(size));
+            throw;
+        }
+        array->budget = memoryBudget;
+        return array;
+    }
+
+    void Interpreter::refuel(ExprStmt::BlockStmt &block, uint64_t steps) {
+        if (sharedFuel) {
+            uint64_t left = sharedFuel->load(std::memory_order_relaxed);
+            uint64_t taken;
+            do {
+                if (fuel + left < steps) throwError("StepLimitExceeded", block);
+                taken = std::min(std::max(sharedFuelWindow, steps - fuel), left);
+            } while (!sharedFuel->compare_exchange_weak(left, left - taken, std::memory_order_relaxed));
+            fuelGiven += taken;
+            fuel += taken;
+            return;
+        }
+        if (checkpointEvery) {
+            stepsSinceCheckpoint += fuelGiven - fuel;
+            if (stepsSinceCheckpoint >= checkpointEvery) {
+                // Only the position outside of FUNCTION calls can be resumed, so the checkpoint waits for the call,
+                // and for open files to be closed
+                if (callDepth == 0 && files.empty()) {
+                    takeCheckpoint(block);
+                    stepsSinceCheckpoint = 0;
+                    checkpointPending = false;
+                } else {
+                    checkpointPending = true;
+                }
+            }
+        }
+        uint64_t window = checkpointEvery ? checkpointEvery : UINT64_MAX;
+
+        uint64_t available = fuelAvailable();
+        if (available < steps) throwError("StepLimitExceeded", block);
+        fuelGiven = std::min(std::max(window, steps), available);
+        if (stepsLeft != UINT64_MAX) stepsLeft = available - fuelGiven;
+        fuel = fuelGiven;
+    }
+
+    void Interpreter::useFuel(uint64_t steps, ExprStmt::Stmt &stmt) {
+        if (steps <= fuel) {
+            fuel -= steps;
+            return;
+        }
+        // Rest is taken from the limit as if the window was larger, the next block refuels
+        uint64_t extra = steps - fuel;
+        if (stepsLeft != UINT64_MAX) {
+            if (stepsLeft < extra) throwError("StepLimitExceeded", stmt);
+            stepsLeft -= extra;
+        }
+        fuelGiven += extra;
+        fuel = 0;
+    }
+
+    void Interpreter::endFuelWindow() {
+        if (stepsLeft != UINT64_MAX) stepsLeft += fuel;
+        fuelGiven -= fuel;
+        fuel = 0;
+    }
+
+    // Registers position of every block in stmt that runs outside of FUNCTION and PARALLEL FOR,
+    // steps lead from the parent block to stmt
+    template<typename Positions>
+    static void collectBlockPositions(const ExprStmt::Stmt &stmt, const ExprStmt::BlockStmt *parent,
+                                      std::vector<uint32_t> &steps, Positions &positions) {
+        if (auto block = dynamic_cast<const ExprStmt::BlockStmt *>(&stmt)) {
+            positions.emplace(block, typename Positions::mapped_type{parent, steps});
+            std::vector<uint32_t> nestedSteps;
+            for (uint32_t i = 0; i < block->statementsList.size(); i++) {
+                nestedSteps.assign(1, i);
+                collectBlockPositions(*block->statementsList[i], block, nestedSteps, positions);
+            }
+        } else if (auto ifStmt = dynamic_cast<const ExprStmt::IfStmt *>(&stmt)) {
+            steps.push_back(0);
+            collectBlockPositions(*ifStmt->thenBranch, parent, steps, positions);
+            steps.back() = 1;
+            if (ifStmt->elseBranch.has_value()) {
+                collectBlockPositions(*ifStmt->elseBranch.value(), parent, steps, positions);
+            }
+            steps.pop_back();
+        } else if (auto whileStmt = dynamic_cast<const ExprStmt::WhileStmt *>(&stmt)) {
+            steps.push_back(0);
+            collectBlockPositions(*whileStmt->thenBranch, parent, steps, positions);
+            steps.pop_back();
+        }
+    }
+
+    void Interpreter::setCheckpoints(const std::vector<ExprStmt::stmt_ptr> &program, uint64_t every,
+                                     std::function<void(Checkpointing::State &&)> handler) {
+        checkpointEvery = every;
+        checkpointHandler = std::move(handler);
+        blockPositions.clear();
+        std::vector<uint32_t> steps;
+        for (uint32_t i = 0; i < program.size(); i++) {
+            steps.assign(1, i);
+            collectBlockPositions(*program[i], nullptr, steps, blockPositions);
+        }
+        // The window up to the first checkpoint starts now
+        endFuelWindow();
+        fuelGiven = 0;
+    }
+
+    void Interpreter::takeCheckpoint(ExprStmt::BlockStmt &block) {
+        if (!blockPositions.contains(&block)) return;
+
+        Checkpointing::State state;
+        // Steps are collected from the innermost block outwards
+        for (const ExprStmt::BlockStmt *current = &block; current;) {
+            const BlockPosition &position = blockPositions.at(current);
+            state.position.insert(state.position.end(), position.steps.rbegin(), position.steps.rend());
+            current = position.parent;
+        }
+        std::reverse(state.position.begin(), state.position.end());
+        state.statementsExecuted = statementsExecuted;
+        std::ostringstream randomState;
+        randomState << random;
+        state.randomState = std::move(randomState).str();
+        state.variables.assign(globalVariables.begin(), globalVariables.end());
+        // Output printed before the checkpoint is not printed again by the resumed run
+        output.flush();
+        checkpointHandler(std::move(state));
+    }
+
+    void Interpreter::restore(Checkpointing::State &&state) {
+        statementsExecuted = state.statementsExecuted;
+        std::istringstream randomState(state.randomState);
+        randomState >> random;
+        if (randomState.fail()) throw Checkpointing::CheckpointError("Checkpoint is corrupted");
+        for (auto &[name, value]: state.variables) {
+            adoptRestored(value);
+            store(globalVariables[name], std::move(value), 0);
+        }
+    }
+
+    void Interpreter::adoptRestored(const Tokenization::Literal &value) {
+        if (auto array = std::get_if<ArrayPtr>(&value)) {
+            // Array shared by several variables is charged once
+            if (!memoryBudget || (*array)->budget) return;
+            chargeMemory(Values::NumArray::bytes((*array)->size()), 0);
+            (*array)->budget = memoryBudget;
+        } else if (auto map = std::get_if<MapPtr>(&value)) {
+            if ((*map)->owner == this) return;
+            (*map)->owner = this;
+            uint64_t bytes = sizeof(Values::HashMap);
+            for (auto &entry: (*map)->getEntries()) {
+                adoptRestored(entry.value);
+                bytes += entry.key.size() + Values::HashMap::entryBytes + stringBytes(entry.value);
+            }
+            if (memoryBudget) {
+                chargeMemory(bytes, 0);
+                (*map)->budget = memoryBudget;
+                (*map)->chargedBytes = bytes;
+            }
+        }
+    }
+
+    // Block the checkpoint was taken at, nullptr when the position does not lead to one
+    static const ExprStmt::Stmt *resumedBlock(const ExprStmt::Stmt &stmt, const std::vector<uint32_t> &position,
+                                              size_t depth) {
+        if (depth == position.size()) return &stmt;
+        uint32_t index = position[depth];
+        if (auto block = dynamic_cast<const ExprStmt::BlockStmt *>(&stmt); block && index < block->statementsList.size()) {
+            return resumedBlock(*block->statementsList[index], position, depth + 1);
+        } else if (auto ifStmt = dynamic_cast<const ExprStmt::IfStmt *>(&stmt); ifStmt && index == 0) {
+            return resumedBlock(*ifStmt->thenBranch, position, depth + 1);
+        } else if (ifStmt && index == 1 && ifStmt->elseBranch.has_value()) {
+            return resumedBlock(*ifStmt->elseBranch.value(), position, depth + 1);
+        } else if (auto whileStmt = dynamic_cast<const ExprStmt::WhileStmt *>(&stmt); whileStmt && index == 0) {
+            return resumedBlock(*whileStmt->thenBranch, position, depth + 1);
+        }
+        return nullptr;
+    }
+
+    static bool hasType(const Tokenization::Literal &value, ExprStmt::StaticType type) {
+        switch (type) {
+            case ExprStmt::StaticType::NUMBER: return std::holds_alternative<double>(value);
+            case ExprStmt::StaticType::STRING: return std::holds_alternative<Values::RcString>(value);
+            case ExprStmt::StaticType::BOOLEAN: return std::holds_alternative<bool>(value);
+            default: return true;
+        }
+    }
+
+    size_t Interpreter::resume(const std::vector<ExprStmt::stmt_ptr> &program, const std::vector<uint32_t> &position) {
+        const ExprStmt::Stmt *block = position.empty() || position[0] >= program.size()
+                                      ? nullptr : resumedBlock(*program[position[0]], position, 1);
+        if (!block) throw Checkpointing::CheckpointError("Checkpoint position is not in the program");
+        // Proven reads after the block rely on the variables inference knows at its start
+        for (auto &[name, type]: TypeInference::provenAt(program, *block)) {
+            auto variable = globalVariables.find(name);
+            if (variable == globalVariables.end() || !hasType(variable->second, type)) {
+                throw Checkpointing::CheckpointError("Checkpoint has no variable '" + name
+                                                     + "' of the type the program reads it as");
+            }
+        }
+        resumeIn(*program[position[0]], position, 1);
+        return position[0] + 1;
+    }
+
+    void Interpreter::resumeIn(ExprStmt::Stmt &stmt, const std::vector<uint32_t> &position, size_t depth) {
+        // The block the checkpoint was taken at, its statement was executed and condition evaluated before
+        if (depth == position.size()) {
+            stmt.accept(*this);
+            return;
+        }
+
+        uint32_t index = position[depth];
+        if (auto block = dynamic_cast<ExprStmt::BlockStmt *>(&stmt); block && index < block->statementsList.size()) {
+            resumeIn(*block->statementsList[index], position, depth + 1);
+            for (size_t i = index + 1; i < block->statementsList.size(); i++) {
+                execute(*block->statementsList[i]);
+            }
+        } else if (auto ifStmt = dynamic_cast<ExprStmt::IfStmt *>(&stmt); ifStmt && index == 0) {
+            resumeIn(*ifStmt->thenBranch, position, depth + 1);
+        } else if (ifStmt && index == 1 && ifStmt->elseBranch.has_value()) {
+            resumeIn(*ifStmt->elseBranch.value(), position, depth + 1);
+        } else if (auto whileStmt = dynamic_cast<ExprStmt::WhileStmt *>(&stmt); whileStmt && index == 0) {
+            try {
+                resumeIn(*whileStmt->thenBranch, position, depth + 1);
+            } catch (const Break &) {
+                return;
+            } catch (const Continue &) {
+                // Next iteration
+            }
+            // Rest of the loop, starting with its condition
+            whileStmt->accept(*this);
+        } else {
+            throw Checkpointing::CheckpointError("Checkpoint position is not in the program");
+        }
+    }
+
+    uint64_t Interpreter::getStatementsExecuted() const {
+        return statementsExecuted;
+    }
+
+    void Interpreter::executeProfiled(ExprStmt::Stmt &stmt) {
+        // Leave also when BREAK / CONTINUE / error unwinds through the statement
+        struct Leave {
+            Profiling::Profiler *profiler;
+            ~Leave() { profiler->leave(); }
+        } leave{profiler};
+
+        profiler->enter(stmt);
+        stmt.accept(*this);
     }
 
     void Interpreter::visit(ExprStmt::PrintStmt &stmt) {
-        Tokenization::Literal value = stmt.expr->accept(*this);
-        std::cout << stringify(value) << std::endl; 
+        if (stmt.expressions.size() == 1) {
+            Tokenization::Literal value = stmt.expressions[0]->accept(*this);
+            output << textOf(value, printBuffer) << std::endl;
+            return;
+        }
+        size_t base = printValues.size();
+        for (auto &expr: stmt.expressions) printValues.push_back(expr->accept(*this));
+        print(stmt, base);
+    }
+
+    void Interpreter::appendText(std::string &out, Tokenization::Literal &value) {
+        if (auto string = std::get_if<Values::RcString>(&value)) out += string->view();
+        else if (auto number = std::get_if<double>(&value)) Values::appendNumber(out, *number);
+        else out += stringify(value);
+    }
+
+    void Interpreter::appendPrinted(std::string &out, ExprStmt::PrintStmt &stmt, size_t base) {
+        for (size_t i = 0; i < stmt.expressions.size(); i++) {
+            if (i > 0 && stmt.separators[i - 1] == ExprStmt::PrintStmt::Separator::TAB) out += '\t';
+            appendText(out, printValues[base + i]);
+        }
+        printValues.resize(base);
+    }
+
+    void Interpreter::print(ExprStmt::PrintStmt &stmt, size_t base) {
+        printBuffer.clear();
+        appendPrinted(printBuffer, stmt, base);
+        output << printBuffer << std::endl;
     }
     
     void Interpreter::visit(ExprStmt::InputStmt &stmt) {
+        if (parent) throwError("INPUT is not allowed in PARALLEL FOR", stmt);
+        if (inputSuspends) throwError("INPUT is not allowed in CALL expression of async session", stmt);
         Tokenization::Literal value = stmt.expr->accept(*this);
-        std::cout << stringify(value);
+        readInput(stmt, value);
+    }
+
+    void Interpreter::readInput(ExprStmt::InputStmt &stmt, Tokenization::Literal &prompt) {
+        std::string buffer;
+        output << textOf(prompt, buffer) << std::flush;
         std::string outValue;
-        std::getline(std::cin, outValue);
-        globalVariables[stmt.targetVarName] = outValue;
+        std::getline(input, outValue);
+        store(variableForWrite(stmt.targetVarName), Values::RcString(outValue), stmt.line);
     }
     
     void Interpreter::visit(ExprStmt::LetStmt &stmt) {
         Tokenization::Literal value = stmt.expr->accept(*this);
-        globalVariables[stmt.targetVarName] = value;
+        store(variableForWrite(stmt.targetVarName), std::move(value), stmt.line);
     }
     
+    void Interpreter::visit(ExprStmt::ArrayLetStmt &stmt) {
+        if (stmt.index->staticType == ExprStmt::StaticType::NUMBER && stmt.expr->staticType == ExprStmt::StaticType::NUMBER) {
+            double position = stmt.index->acceptNumber(*this);
+            double value = stmt.expr->acceptNumber(*this);
+            Values::NumArray &array = getArray(stmt.targetVarName, stmt.line);
+            array.values[arrayIndex(array, position, stmt.line)] = value;
+            return;
+        }
+        Tokenization::Literal index = stmt.index->accept(*this);
+        Tokenization::Literal value = stmt.expr->accept(*this);
+        if (!std::holds_alternative<double>(value)) throwError("ArrayElementNotNumber", stmt);
+        Values::NumArray &array = getArray(stmt.targetVarName, stmt.line);
+        array.values[arrayIndex(array, index, stmt.line)] = std::get<double>(value);
+    }
+
+    void Interpreter::visit(ExprStmt::DimStmt &stmt) {
+        Tokenization::Literal size = stmt.size->accept(*this);
+        dim(stmt, size);
+    }
+
+    void Interpreter::dim(ExprStmt::DimStmt &stmt, Tokenization::Literal &size) {
+        if (!std::holds_alternative<double>(size)) {
+            throwError("'DIM' is not allowed on '" + getLiteralTypeName(size) + "' type.", stmt);
+        }
+        double elements = std::floor(std::get<double>(size));
+        if (!(elements >= 0 && elements <= static_cast<double>(std::vector<double>().max_size()))) {
+            throwError("InvalidArraySize", stmt);
+        }
+        try {
+            store(variableForWrite(stmt.varName), newArray(static_cast<size_t>(elements), stmt.line), stmt.line);
+        } catch (const std::bad_alloc &) {
+            throwError("InvalidArraySize", stmt);
+        } catch (const std::length_error &) {
+            throwError("InvalidArraySize", stmt);
+        }
+    }
+
+    void Interpreter::visit(ExprStmt::MapStmt &stmt) {
+        MapPtr map = std::make_shared<Values::HashMap>(this);
+        if (memoryBudget) [[unlikely]] {
+            chargeMemory(sizeof(Values::HashMap), stmt.line);
+            map->budget = memoryBudget;
+            map->chargedBytes = sizeof(Values::HashMap);
+        }
+        store(variableForWrite(stmt.varName), std::move(map), stmt.line);
+    }
+
+    void Interpreter::visit(ExprStmt::PutStmt &stmt) {
+        Tokenization::Literal key = stmt.key->accept(*this);
+        Tokenization::Literal value = stmt.value->accept(*this);
+        put(stmt, key, std::move(value));
+    }
+
+    void Interpreter::put(ExprStmt::PutStmt &stmt, Tokenization::Literal &key, Tokenization::Literal &&value) {
+        if (!std::holds_alternative<Values::RcString>(key)) throwError("KeyNotString", stmt);
+        // Maps can not contain maps, so they never form reference cycles
+        if (std::holds_alternative<MapPtr>(value)) throwError("'PUT' is not allowed on 'map' value.", stmt);
+
+        Values::HashMap &map = getMap(stmt.mapVar, "PUT", stmt.line);
+        // Iterations run in parallel, they may only modify maps they created
+        if (parent && map.owner != this) throwError("PUT to map created outside PARALLEL FOR is not allowed", stmt);
+        if (map.budget) [[unlikely]] {
+            // Charged before the entry is stored, so the map never holds more than the budget allows
+            const Values::RcString &keyString = std::get<Values::RcString>(key);
+            const Tokenization::Literal *previous = map.find(keyString);
+            uint64_t bytes = stringBytes(value);
+            uint64_t previousBytes = previous ? stringBytes(*previous) : 0;
+            if (!previous) bytes += keyString.size() + Values::HashMap::entryBytes;
+            if (bytes > previousBytes) {
+                chargeMemory(bytes - previousBytes, stmt.line);
+            } else {
+                map.budget->release(previousBytes - bytes);
+            }
+            map.chargedBytes += bytes - previousBytes;
+        }
+        map.put(std::get<Values::RcString>(key), std::move(value));
+    }
+
+    void Interpreter::visit(ExprStmt::GetStmt &stmt) {
+        Tokenization::Literal key = stmt.key->accept(*this);
+        get(stmt, key);
+    }
+
+    void Interpreter::get(ExprStmt::GetStmt &stmt, Tokenization::Literal &key) {
+        if (!std::holds_alternative<Values::RcString>(key)) throwError("KeyNotString", stmt);
+        bool isHas = stmt.op.type == Tokenization::HAS;
+
+        const Values::HashMap &map = getMap(stmt.mapVar, isHas ? "HAS" : "GET", stmt.line);
+        const Tokenization::Literal *value = map.find(std::get<Values::RcString>(key));
+        if (isHas) {
+            store(variableForWrite(stmt.dstVar), value != nullptr, stmt.line);
+        } else {
+            if (!value) throwError("KeyNotFound '" + std::get<Values::RcString>(key).str() + "'", stmt);
+            store(variableForWrite(stmt.dstVar), Tokenization::Literal(*value), stmt.line);
+        }
+    }
+
     void Interpreter::visit(ExprStmt::ToNumStmt &stmt) {
         Tokenization::Literal value = getVarValue(stmt.srcVar, stmt);
+        if (std::holds_alternative<ArrayPtr>(value) || std::holds_alternative<MapPtr>(value)) {
+            throwError("'TONUM' is not allowed on '" + getLiteralTypeName(value) + "' type.", stmt);
+        }
         Tokenization::Literal newValue;
         if (std::holds_alternative<double>(value)) newValue = value;
         if (std::holds_alternative<bool>(value)) newValue = std::get<bool>(value) ? 1. : 0.;
-        if (std::holds_alternative<std::string>(value)) {
+        if (std::holds_alternative<Values::RcString>(value)) {
             // Parse string
             try {
-                newValue = std::stod(std::get<std::string>(value));
+                newValue = std::stod(std::get<Values::RcString>(value).str());
             } catch (const std::invalid_argument&) {
                 throwError("InvalidNumberFormat", stmt);
             } catch (const std::out_of_range&) {
                 throwError("InvalidNumberFormat", stmt);
             }
         }
-        globalVariables[stmt.dstVar.has_value() ? stmt.dstVar.value() : stmt.srcVar] = newValue;
+        store(variableForWrite(stmt.dstVar.has_value() ? stmt.dstVar.value() : stmt.srcVar), std::move(newValue), stmt.line);
     }
     
     void Interpreter::visit(ExprStmt::ToStrStmt &stmt) {
         Tokenization::Literal value = getVarValue(stmt.srcVar, stmt);
-        Tokenization::Literal newValue = stringify(value);
-        globalVariables[stmt.dstVar.has_value() ? stmt.dstVar.value() : stmt.srcVar] = newValue;
+        // A string is kept, sharing its characters
+        Tokenization::Literal newValue = std::holds_alternative<Values::RcString>(value) ? value
+                                                                                          : Values::RcString(stringify(value));
+        store(variableForWrite(stmt.dstVar.has_value() ? stmt.dstVar.value() : stmt.srcVar), std::move(newValue), stmt.line);
     }
     
     void Interpreter::visit(ExprStmt::RndStmt &stmt) {
         Tokenization::Literal lowerBound = stmt.lowerBound->accept(*this);
         Tokenization::Literal upperBound = stmt.upperBound->accept(*this);
+        rnd(stmt, lowerBound, upperBound);
+    }
 
+    void Interpreter::rnd(ExprStmt::RndStmt &stmt, Tokenization::Literal &lowerBound, Tokenization::Literal &upperBound) {
         if (std::holds_alternative<double>(lowerBound) && std::holds_alternative<double>(upperBound)) {
-            int lowerBoundInt = ceil(std::get<double>(lowerBound));
-            int upperBoundInt = floor(std::get<double>(upperBound));
+            // Whole bounds, the usual case, need no rounding
+            double lower = std::get<double>(lowerBound);
+            double upper = std::get<double>(upperBound);
+            int64_t whole;
+            int lowerBoundInt = Values::asWhole(lower, whole) ? lower : std::ceil(lower);
+            int upperBoundInt = Values::asWhole(upper, whole) ? upper : std::floor(upper);
             int range = upperBoundInt - lowerBoundInt;
-            double rndValue = (std::rand() % range) + lowerBoundInt;
-            globalVariables[stmt.dstVar] = rndValue;
+            if (range <= 0) throwError("InvalidRange", stmt);
+            double rndValue = static_cast<int>(random() % range) + lowerBoundInt;
+            store(variableForWrite(stmt.dstVar), rndValue, stmt.line);
         } else {
             throwError("'RND' is not allowed on '" + getLiteralTypeName(lowerBound) + "', '" + getLiteralTypeName(lowerBound) + "' types.", stmt);
         }
     }
 
     void Interpreter::visit(ExprStmt::BlockStmt &stmt) {
+        chargeFuel(stmt);
         for (auto & statement : stmt.statementsList) {
-            statement->accept(*this);
+            execute(*statement);
+            if (returning) return;
         }
     }
 
     void Interpreter::visit(ExprStmt::IfStmt &stmt) {
-        Tokenization::Literal cond = stmt.conditionExpr->accept(*this);
-        if (std::holds_alternative<bool>(cond)) {
-            if (std::get<bool>(cond)) {
-                stmt.thenBranch->accept(*this);
-            } else {
-                if (stmt.elseBranch.has_value()) {
-                    stmt.elseBranch.value()->accept(*this);
-                }
-            }
+        if (condition(*stmt.conditionExpr, stmt)) {
+            stmt.thenBranch->accept(*this);
         } else {
-            throwError("ConditionNotBoolean", stmt);
+            if (stmt.elseBranch.has_value()) {
+                stmt.elseBranch.value()->accept(*this);
+            }
         }
     }
     
     void Interpreter::visit(ExprStmt::WhileStmt &stmt) {
-        Tokenization::Literal cond = stmt.conditionExpr->accept(*this);
-        while (std::holds_alternative<bool>(cond) && std::get<bool>(cond)) {
+        while (condition(*stmt.conditionExpr, stmt)) {
             try {
                 stmt.thenBranch->accept(*this);
             } catch (const Break&) {
@@ -278,11 +1162,240 @@ namespace Interpreting {
             } catch (const Continue&) {
                 // continue
             }
-            cond = stmt.conditionExpr->accept(*this);
+            if (returning) return;
+        }
+    }
+
+    // Value x for which `x op value == value`
+    static std::optional<Tokenization::Literal> reductionIdentity(Tokenization::TokenType op,
+                                                                  const Tokenization::Literal &value) {
+        switch (op) {
+            case Tokenization::PLUS:
+                if (std::holds_alternative<double>(value)) return 0.;
+                if (std::holds_alternative<Values::RcString>(value)) return Values::RcString();
+                break;
+            case Tokenization::STAR:
+                if (std::holds_alternative<double>(value)) return 1.;
+                break;
+            case Tokenization::AND:
+                if (std::holds_alternative<bool>(value)) return true;
+                break;
+            case Tokenization::OR:
+                if (std::holds_alternative<bool>(value)) return false;
+                break;
+        }
+        return std::nullopt;
+    }
+
+    void Interpreter::visit(ExprStmt::ParallelForStmt &stmt) {
+        Tokenization::Literal from = stmt.fromExpr->accept(*this);
+        Tokenization::Literal to = stmt.toExpr->accept(*this);
+        if (!std::holds_alternative<double>(from) || !std::holds_alternative<double>(to)) {
+            throwError("'PARALLEL FOR' is not allowed on '" + getLiteralTypeName(from) + "' TO '"
+                       + getLiteralTypeName(to) + "' types.", stmt);
+        }
+        double first = std::get<double>(from);
+        double last = std::get<double>(to);
+        if (first > last) return;
+        // Iteration count must fit uint64_t, NaN and infinite bounds fail here too
+        if (!(last - first < 18446744073709551616.0)) throwError("InvalidRange", stmt);
+        uint64_t iterations = static_cast<uint64_t>(std::floor(last - first)) + 1;
+
+        // Every chunk accumulates reductions from their identity, partial results are combined in chunk order
+        std::vector<Tokenization::Literal> initialValues;
+        std::vector<Tokenization::Literal> identities;
+        for (auto &reduction: stmt.reductions) {
+            initialValues.push_back(getVarValue(ExprStmt::VarRef{reduction.varName}, stmt));
+            std::optional<Tokenization::Literal> identity = reductionIdentity(reduction.op.type, initialValues.back());
+            if (!identity.has_value()) {
+                throwError("'REDUCE WITH " + reduction.op.lexeme + "' is not allowed on '"
+                           + getLiteralTypeName(initialValues.back()) + "' type.", stmt);
+            }
+            identities.push_back(std::move(identity.value()));
+        }
+
+        // Fixed number of chunks, so results and output do not depend on number of threads
+        uint64_t chunkCount = std::min<uint64_t>(iterations, parallelChunks);
+
+        struct ChunkResult {
+            std::string output;
+            std::vector<Tokenization::Literal> partials;
+            uint64_t statementsExecuted = 0;
+            uint64_t fuelUsed = 0;
+            bool failed = false;
+            uint32_t errorLine = 0;
+            std::string errorMessage;
+        };
+        std::vector<ChunkResult> chunks(chunkCount);
+        std::vector<uint64_t> seeds;
+        for (uint64_t i = 0; i < chunkCount; i++) seeds.push_back(random());
+        // Limited loop shares the steps left between its chunks, iterations of a loop nested in one share them too
+        uint64_t available = fuelAvailable();
+        std::atomic<uint64_t> steps(available);
+        std::atomic<uint64_t> *pool = sharedFuel ? sharedFuel : available == UINT64_MAX ? nullptr : &steps;
+
+        Threading::ThreadPool::shared().forEach(chunkCount, [&](size_t chunkIndex) {
+            ChunkResult &chunk = chunks[chunkIndex];
+            // iterations * chunkIndex / chunkCount, without overflowing for large iteration counts
+            auto bound = [&](uint64_t index) {
+                return iterations / chunkCount * index + iterations % chunkCount * index / chunkCount;
+            };
+            uint64_t begin = bound(chunkIndex);
+            uint64_t end = bound(chunkIndex + 1);
+
+            std::istringstream noInput;
+            std::ostringstream output;
+            Interpreter child(noInput, output, seeds[chunkIndex]);
+            child.parent = this;
+            // The loop is charged for what the chunks used together afterwards
+            child.fuel = child.fuelGiven = pool ? 0 : UINT64_MAX;
+            child.stepsLeft = pool ? 0 : UINT64_MAX;
+            child.sharedFuel = pool;
+            child.memoryBudget = memoryBudget;
+            // The calling thread runs chunks on top of its running calls
+            child.nesting = nesting;
+            chunk.partials = identities;
+
+            try {
+                for (uint64_t iteration = begin; iteration < end; iteration++) {
+                    // Private variables of the iteration, only reductions are carried to the next one
+                    child.releaseVariables();
+                    child.globalVariables.clear();
+                    for (size_t r = 0; r < stmt.reductions.size(); r++) {
+                        child.store(child.globalVariables[stmt.reductions[r].varName],
+                                    Tokenization::Literal(chunk.partials[r]), stmt.line);
+                    }
+                    child.globalVariables[stmt.loopVarName] = first + static_cast<double>(iteration);
+
+                    try {
+                        stmt.body->accept(child);
+                    } catch (const Continue &) {
+                        // Next iteration
+                    } catch (const Break &) {
+                        child.throwError("BREAK is not allowed in PARALLEL FOR", stmt);
+                    }
+
+                    for (size_t r = 0; r < stmt.reductions.size(); r++) {
+                        chunk.partials[r] = child.globalVariables[stmt.reductions[r].varName];
+                    }
+                }
+            } catch (const InterpreterError &) {
+                chunk.failed = true;
+                chunk.errorLine = child.errorLine;
+                chunk.errorMessage = child.errorMessage;
+            }
+            chunk.statementsExecuted = child.statementsExecuted;
+            if (pool) {
+                // Unused fuel goes back for chunks still running
+                pool->fetch_add(child.fuel, std::memory_order_relaxed);
+                child.fuelGiven -= child.fuel;
+                child.fuel = 0;
+            }
+            chunk.fuelUsed = child.fuelGiven - child.fuel;
+            chunk.output = std::move(output).str();
+        });
+
+        // Output and the first error in iteration order, as if the loop ran serially
+        for (ChunkResult &chunk: chunks) {
+            statementsExecuted += chunk.statementsExecuted;
+            output << chunk.output;
+            if (chunk.failed) throwError(std::move(chunk.errorMessage), chunk.errorLine);
+            // Fuel of a nested loop was taken from the shared steps already
+            if (sharedFuel) fuelGiven += chunk.fuelUsed;
+            else useFuel(chunk.fuelUsed, stmt);
+        }
+
+        for (size_t r = 0; r < stmt.reductions.size(); r++) {
+            Tokenization::Literal result = initialValues[r];
+            for (ChunkResult &chunk: chunks) {
+                result = binaryOperation(stmt.reductions[r].op.type, result, chunk.partials[r], stmt.line);
+            }
+            store(globalVariables[stmt.reductions[r].varName], std::move(result), stmt.line);
+        }
+    }
+
+    void Interpreter::visit(ExprStmt::FunctionStmt &stmt) {
+        // Functions are bound to calls by the parser, the definition itself does nothing
+    }
+
+    Tokenization::Literal Interpreter::visit(ExprStmt::CallExpr &expr) {
+        return callFunction(expr, true);
+    }
+
+    void Interpreter::visit(ExprStmt::CallStmt &stmt) {
+        callFunction(*stmt.call, false);
+    }
+
+    Tokenization::Literal Interpreter::callFunction(ExprStmt::CallExpr &expr, bool valueNeeded) {
+        CallFrame frame = enterFunction(expr);
+        try {
+            expr.function->body->accept(*this);
+        } catch (const Break &) {
+            throwError("LoopControlOutsideLoop", expr);
+        } catch (const Continue &) {
+            throwError("LoopControlOutsideLoop", expr);
+        }
+        return leaveFunction(expr, frame, valueNeeded);
+    }
+
+    Interpreter::CallFrame Interpreter::enterFunction(ExprStmt::CallExpr &expr) {
+        size_t base = pushFrame(expr);
+        for (size_t i = 0; i < expr.arguments.size(); i++) {
+            setArgument(base + i, expr.arguments[i]->accept(*this), expr.line);
+        }
+        return enterFrame(expr, base);
+    }
+
+    size_t Interpreter::pushFrame(ExprStmt::CallExpr &expr) {
+        if (callDepth >= maxCallDepth || nesting + nestingOf(expr) > maxNesting) throwError("StackOverflow", expr);
+
+        // Arguments are evaluated in the caller frame, calls among them push their frames above the new one
+        size_t base = frames.size();
+        frames.resize(base + expr.function->frameSize);
+        return base;
+    }
+
+    void Interpreter::setArgument(size_t slot, Tokenization::Literal &&argument, uint32_t line) {
+        if (memoryBudget) [[unlikely]] chargeMemory(stringBytes(argument), line);
+        frames[slot] = std::move(argument);
+    }
+
+    Interpreter::CallFrame Interpreter::enterFrame(ExprStmt::CallExpr &expr, size_t base) {
+        CallFrame frame{base, frameBase};
+        frameBase = base;
+        callDepth++;
+        nesting += nestingOf(expr);
+        return frame;
+    }
+
+    Tokenization::Literal Interpreter::leaveFunction(ExprStmt::CallExpr &expr, const CallFrame &frame, bool valueNeeded) {
+        callDepth--;
+        nesting -= nestingOf(expr);
+        // Checkpoint that came due during the call is taken at the next block
+        if (checkpointPending && callDepth == 0) [[unlikely]] endFuelWindow();
+        frameBase = frame.callerBase;
+        if (memoryBudget) [[unlikely]] {
+            for (size_t i = frame.base; i < frames.size(); i++) {
+                if (frames[i].has_value()) memoryBudget->release(stringBytes(frames[i].value()));
+            }
         }
-        if (!std::holds_alternative<bool>(cond)) {
-            throwError("ConditionNotBoolean", stmt);
+        frames.resize(frame.base);
+
+        returning = false;
+        std::optional<Tokenization::Literal> result = std::move(returnValue);
+        returnValue.reset();
+        if (result.has_value()) return std::move(result.value());
+        if (valueNeeded) throwError("NoReturnValue '" + expr.function->name + "'", expr);
+        return false;
+    }
+
+    void Interpreter::visit(ExprStmt::ReturnStmt &stmt) {
+        if (stmt.value.has_value()) {
+            returnValue = stmt.value.value()->accept(*this);
+        } else {
+            returnValue.reset();
         }
+        returning = true;
     }
 
     void Interpreter::visit(ExprStmt::BreakStmt &stmt) {
@@ -293,4 +1406,109 @@ namespace Interpreting {
         throw Continue();
     }
 
+    Tokenization::Literal Interpreter::visit(ExprStmt::EofExpr &expr) {
+        return atEnd(getFile(*expr.fileNumber, "EOF", expr.line), expr.line);
+    }
+
+    bool Interpreter::atEnd(OpenFile &file, uint32_t line) {
+        if (!file.reader) throwError("FileNotOpenForInput", line);
+        try {
+            return file.reader->atEnd();
+        } catch (const Files::FileError &e) {
+            throwError("FileReadFailed: " + std::string(e.what()), line);
+        }
+        return false;  // Unreachable
+    }
+
+    void Interpreter::visit(ExprStmt::OpenStmt &stmt) {
+        Tokenization::Literal path = stmt.path->accept(*this);
+        if (!std::holds_alternative<Values::RcString>(path)) throwError("FilePathNotString", stmt);
+        openFile(stmt, std::get<Values::RcString>(path), fileNumber(*stmt.fileNumber, "OPEN", stmt.line));
+    }
+
+    void Interpreter::openFile(ExprStmt::OpenStmt &stmt, const Values::RcString &path, int64_t number) {
+        if (files.contains(number)) throwError("FileAlreadyOpen #" + std::to_string(number), stmt);
+
+        const std::string pathString = path.str();
+        OpenFile file{nullptr, nullptr, stmt.line};
+        try {
+            if (stmt.forOutput) {
+                file.writer = std::make_unique<Files::BufferedWriter>(pathString);
+            } else {
+                file.reader = std::make_unique<Files::LineReader>(pathString);
+            }
+        } catch (const Files::FileError &e) {
+            throwError("FileOpenFailed '" + pathString + "': " + e.what(), stmt);
+        }
+        files.emplace(number, std::move(file));
+    }
+
+    void Interpreter::visit(ExprStmt::ReadLineStmt &stmt) {
+        readLine(stmt, getFile(*stmt.fileNumber, "READLINE", stmt.line));
+    }
+
+    void Interpreter::readLine(ExprStmt::ReadLineStmt &stmt, OpenFile &file) {
+        if (!file.reader) throwError("FileNotOpenForInput", stmt);
+        std::string_view line;
+        bool read = false;
+        try {
+            read = file.reader->readLine(line);
+        } catch (const Files::FileError &e) {
+            throwError("FileReadFailed: " + std::string(e.what()), stmt);
+        }
+        if (!read) throwError("EndOfFile", stmt);
+        store(variableForWrite(stmt.dstVar), Values::RcString(line), stmt.line);
+    }
+
+    void Interpreter::visit(ExprStmt::WriteStmt &stmt) {
+        OpenFile &file = getFile(*stmt.fileNumber, "WRITE", stmt.line);
+        if (!file.writer) throwError("FileNotOpenForOutput", stmt);
+        Tokenization::Literal value = stmt.expr->accept(*this);
+        writeLine(stmt, file, value);
+    }
+
+    void Interpreter::writeLine(ExprStmt::WriteStmt &stmt, OpenFile &file, Tokenization::Literal &value) {
+        std::string buffer;
+        try {
+            file.writer->write(textOf(value, buffer));
+            file.writer->write("\n");
+        } catch (const Files::FileError &e) {
+            throwError("FileWriteFailed: " + std::string(e.what()), stmt);
+        }
+    }
+
+    void Interpreter::visit(ExprStmt::CloseStmt &stmt) {
+        closeFile(stmt, fileNumber(*stmt.fileNumber, "CLOSE", stmt.line));
+    }
+
+    void Interpreter::closeFile(ExprStmt::CloseStmt &stmt, int64_t number) {
+        auto file = files.find(number);
+        if (file == files.end()) throwError("FileNotOpen #" + std::to_string(number), stmt);
+        std::unique_ptr<Files::BufferedWriter> writer = std::move(file->second.writer);
+        files.erase(file);
+        // Checkpoint that came due while files were open is taken at the next block
+        if (checkpointPending && callDepth == 0 && files.empty()) [[unlikely]] endFuelWindow();
+        if (!writer) return;
+        try {
+            writer->close();
+        } catch (const Files::FileError &e) {
+            throwError("FileWriteFailed: " + std::string(e.what()), stmt);
+        }
+    }
+
+    void Interpreter::closeFiles() {
+        while (!files.empty()) {
+            auto file = files.begin();
+            std::unique_ptr<Files::BufferedWriter> writer = std::move(file->second.writer);
+            uint32_t line = file->second.line;
+            files.erase(file);
+            if (!writer) continue;
+            try {
+                writer->close();
+            } catch (const Files::FileError &e) {
+                throwError("FileWriteFailed: " + std::string(e.what()), line);
+            }
+        }
+    }
+
 }
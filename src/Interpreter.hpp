@@ -1,9 +1,28 @@
 #ifndef BASICPLUSPLUS_INTERPRETER_HPP
 #define BASICPLUSPLUS_INTERPRETER_HPP
 
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <unordered_map>
 #include "ExpressionsStatements.hpp"
 #include "Tokenization.hpp"
 #include "Parser.hpp"
+#include "Profiler.hpp"
+#include "NumArray.hpp"
+#include "HashMap.hpp"
+#include "Files.hpp"
+#include "MemoryBudget.hpp"
+#include "Checkpoint.hpp"
+
+namespace Async {
+    class Session;
+}
+
+namespace Closures {
+    class Compiler;
+}
 
 namespace Interpreting {
     class InterpreterError : public std::exception {};
@@ -12,25 +31,297 @@ namespace Interpreting {
     
     class Interpreter : public ExprStmt::AbstractExprVisitor, public ExprStmt::AbstractStmtVisitor {
     private:
+        // Runs control flow, INPUT and PRINT as coroutines and everything else through this interpreter
+        friend class Async::Session;
+        // Compiles statements to closures calling the same helpers the visits do
+        friend class Closures::Compiler;
+
         std::map<std::string, Tokenization::Literal> globalVariables;
+
+        // Every interpreter has its own input, output and random generator, so multiple can run in parallel
+        std::istream &input;
+        std::ostream &output;
+        std::mt19937_64 random;
+
+        // Interpreter running PARALLEL FOR this interpreter runs iterations of, nullptr otherwise
+        const Interpreter *parent = nullptr;
+        // Number of chunks PARALLEL FOR iterations are split into
+        static constexpr uint64_t parallelChunks = 256;
         
 //        std::unique_ptr<std::vector<ExprStmt::expr_ptr>> expressions;
         std::string errorMessage;
         uint32_t errorLine;
 
+        Profiling::Profiler *profiler = nullptr;
+        uint64_t statementsExecuted = 0;
+
+        // Local variables of FUNCTION calls, frame of the running call starts at frameBase
+        std::vector<std::optional<Tokenization::Literal>> frames;
+        size_t frameBase = 0;
+        uint32_t callDepth = 0;
+        // Every call nests several visits on the C++ stack, the limit keeps them well within a default thread stack
+        static constexpr uint32_t maxCallDepth = 1000;
+        // Running calls together nest the visits of their bodies, which is limited too, as a call of a deeply nested
+        // body takes many times the stack of a plain one. Levels are sized at 256 bytes, above the largest measured
+        // visit of one level, so the limit takes 6 MiB of the 8 MiB default thread stack. Deeper programs get threads
+        // with their levels on top, see BasicPlusPlus::stackSize.
+        uint32_t nesting = 0;
+        static constexpr uint32_t maxNesting = 24 * 1024;
+        // Set by RETURN, blocks and loops stop executing until the call returns
+        bool returning = false;
+        std::optional<Tokenization::Literal> returnValue;
+
+        // Arguments of PRINTs being evaluated, CALLs in the arguments push theirs on top. All are evaluated before
+        // their texts are appended to the reused printBuffer, which is written to the output at once.
+        std::vector<Tokenization::Literal> printValues;
+        std::string printBuffer;
+
+        // Set by Async::Session, INPUT can suspend only when the session runs it, not nested in an expression
+        bool inputSuspends = false;
+
+        // Steps left before refuel(), charged per executed block
+        uint64_t fuel = UINT64_MAX;
+        // Fuel given by the last refuel()
+        uint64_t fuelGiven = UINT64_MAX;
+        // Steps of the step limit not given as fuel yet, UINT64_MAX when unlimited
+        uint64_t stepsLeft = UINT64_MAX;
+        // Steps left to a limited PARALLEL FOR, its iterations take fuel from it in sharedFuelWindow steps instead of
+        // stepsLeft, so together they stop at the limit. fuelGiven is all fuel they took. nullptr outside of one.
+        std::atomic<uint64_t> *sharedFuel = nullptr;
+        static constexpr uint64_t sharedFuelWindow = 4096;
+        // Checkpoint is due this many steps after the previous one, 0 when checkpoints are disabled
+        uint64_t checkpointEvery = 0;
+        uint64_t stepsSinceCheckpoint = 0;
+        // Set when a checkpoint is due during a FUNCTION call, the window ends when the call returns
+        bool checkpointPending = false;
+        std::function<void(Checkpointing::State &&)> checkpointHandler;
+        // Position of every block a checkpoint can be taken at, see Checkpointing::State::position.
+        // Stored relative to the enclosing block, so deep nesting takes linear memory.
+        struct BlockPosition {
+            const ExprStmt::BlockStmt *parent;  // nullptr for blocks of top level statements
+            std::vector<uint32_t> steps;       // Path from the parent block, or from the program
+        };
+        std::unordered_map<const ExprStmt::BlockStmt *, BlockPosition> blockPositions;
+        // Limit of memory held by values, nullptr when unlimited
+        std::shared_ptr<Values::MemoryBudget> memoryBudget;
+
+        // File opened by OPEN, either for input or for output
+        struct OpenFile {
+            std::unique_ptr<Files::LineReader> reader;
+            std::unique_ptr<Files::BufferedWriter> writer;
+            uint32_t line;  // Of the OPEN statement
+        };
+        // By file number. Checkpoints wait until all files are closed, a resumed run could not reopen them.
+        std::unordered_map<int64_t, OpenFile> files;
+
+        struct CallFrame {
+            size_t base;
+            size_t callerBase;
+        };
+
+        // Executes a statement, reporting it to the profiler if one is attached
+        void execute(ExprStmt::Stmt &stmt) {
+            statementsExecuted++;
+            if (profiler) [[unlikely]] {
+                executeProfiled(stmt);
+            } else {
+                stmt.accept(*this);
+            }
+        }
+
+        void executeProfiled(ExprStmt::Stmt &stmt);
+
+        // Every block is charged for its statements and one step for entering it, which is the back-edge of loops,
+        // so even an empty loop runs out of fuel and straight-line code costs no check per statement.
+        // Fuel is given in windows ending at the step limit or the next checkpoint.
+        void chargeFuel(ExprStmt::BlockStmt &block) {
+            uint64_t steps = block.statementsList.size() + 1;
+            if (fuel < steps) [[unlikely]] refuel(block, steps);
+            fuel -= steps;
+        }
+
+        // Takes checkpoint when it is due and gives the next window, raises StepLimitExceeded at the limit
+        void refuel(ExprStmt::BlockStmt &block, uint64_t steps);
+
+        // Charges steps used outside of chargeFuel
+        void useFuel(uint64_t steps, ExprStmt::Stmt &stmt);
+
+        // Makes the next block refuel
+        void endFuelWindow();
+
+        // Step limit left including the current window
+        uint64_t fuelAvailable() const {
+            if (sharedFuel) return sharedFuel->load(std::memory_order_relaxed) + fuel;
+            return stepsLeft == UINT64_MAX ? UINT64_MAX : stepsLeft + fuel;
+        }
+
+        void takeCheckpoint(ExprStmt::BlockStmt &block);
+
+        // Charges restored array or map to the memory budget and makes the map owned by this interpreter
+        void adoptRestored(const Tokenization::Literal &value);
+
+        // Continues stmt from the block at position, depth elements of the position lead to stmt
+        void resumeIn(ExprStmt::Stmt &stmt, const std::vector<uint32_t> &position, size_t depth);
+
+        // Assigns value to variable storage, strings are charged to the memory budget by the change of their size
+        void store(Tokenization::Literal &target, Tokenization::Literal &&value, uint32_t line) {
+            if (memoryBudget) [[unlikely]] chargeStore(target, value, line);
+            target = std::move(value);
+        }
+
+        void chargeStore(const Tokenization::Literal &target, const Tokenization::Literal &value, uint32_t line);
+
+        void chargeMemory(uint64_t bytes, uint32_t line);
+
+        // Checks that a temporary value fits the budget before it is built
+        void checkTemporary(uint64_t bytes, uint32_t line);
+
+        // Strings held by variables go back to the budget when the variables are dropped
+        void releaseVariables();
+
+        std::shared_ptr<Values::NumArray> newArray(size_t size, uint32_t line);
+
         void throwError(std::string message, ExprStmt::Expr &expr);
         
         void throwError(std::string message, ExprStmt::Stmt &stmt);
+
+        void throwError(std::string message, uint32_t line);
+
+        // Error of an unchecked read of a proven variable that finds it missing or of another type, which only
+        // state injected into a run, eg. a broken checkpoint, can cause
+        void throwUnprovenRead(const std::string &name, const Tokenization::Literal *value, const char *type,
+                               uint32_t line);
         
         std::string getLiteralTypeName(Tokenization::Literal &literal);
         
         std::string stringify(Tokenization::Literal &literal);
+
+        // Characters of a string value without copying them, other values are stringified into buffer
+        std::string_view textOf(Tokenization::Literal &literal, std::string &buffer);
+
+        // Appends text of value to out, strings and numbers without a temporary string
+        void appendText(std::string &out, Tokenization::Literal &value);
+
+        // Appends printValues from base on with the separators of PRINT to out, then pops them
+        void appendPrinted(std::string &out, ExprStmt::PrintStmt &stmt, size_t base);
+
+        // Writes printValues from base on as one line of PRINT
+        void print(ExprStmt::PrintStmt &stmt, size_t base);
         
-        Tokenization::Literal getVarValue(const std::string &varName, ExprStmt::Expr &expr);
+        Tokenization::Literal unaryOperation(Tokenization::TokenType op, Tokenization::Literal &right, uint32_t line);
+
+        Tokenization::Literal binaryOperation(Tokenization::TokenType op, Tokenization::Literal &left,
+                                              Tokenization::Literal &right, uint32_t line);
+
+        // Element-wise `+ - * /` where at least one operand is an array
+        Tokenization::Literal arrayOperation(Tokenization::TokenType op, Tokenization::Literal &left,
+                                             Tokenization::Literal &right, uint32_t line);
+
+        Values::NumArray &getArray(const ExprStmt::VarRef &var, uint32_t line);
+
+        // Array in the variable found at value, nullptr when it is not declared
+        Values::NumArray &getArray(const Tokenization::Literal *value, const ExprStmt::VarRef &var, uint32_t line);
+
+        size_t arrayIndex(const Values::NumArray &array, Tokenization::Literal &index, uint32_t line);
+
+        size_t arrayIndex(const Values::NumArray &array, double position, uint32_t line);
+
+        // Condition of IF / WHILE, ConditionNotBoolean when it is not a boolean
+        bool condition(ExprStmt::Expr &expr, ExprStmt::Stmt &stmt) {
+            if (expr.staticType == ExprStmt::StaticType::BOOLEAN) return expr.acceptBoolean(*this);
+            Tokenization::Literal value = expr.accept(*this);
+            if (!std::holds_alternative<bool>(value)) throwError("ConditionNotBoolean", stmt);
+            return std::get<bool>(value);
+        }
+
+        Values::HashMap &getMap(const ExprStmt::VarRef &var, const char *statement, uint32_t line);
+
+        Values::HashMap &getMap(const Tokenization::Literal *value, const ExprStmt::VarRef &var, const char *statement,
+                                uint32_t line);
+
+        // `SUM`, `MIN` or `MAX` of the evaluated argument
+        double arrayFunction(ExprStmt::ArrayFunctionExpr &expr, Tokenization::Literal &argument);
+
+        // `LEN`, `MID`, ... of the evaluated arguments, as many as expr has
+        Tokenization::Literal stringFunction(ExprStmt::StringFunctionExpr &expr, Tokenization::Literal *arguments);
+
+        const Values::RcString &textArgument(ExprStmt::StringFunctionExpr &expr, Tokenization::Literal &argument);
+
+        // Whole number of at least minimum, InvalidStringPosition otherwise
+        uint64_t countArgument(ExprStmt::StringFunctionExpr &expr, Tokenization::Literal &argument, uint64_t minimum);
+
+        // Statements with their expressions already evaluated, in the order the visits evaluate them
+        void readInput(ExprStmt::InputStmt &stmt, Tokenization::Literal &prompt);
+
+        void dim(ExprStmt::DimStmt &stmt, Tokenization::Literal &size);
+
+        void put(ExprStmt::PutStmt &stmt, Tokenization::Literal &key, Tokenization::Literal &&value);
+
+        void get(ExprStmt::GetStmt &stmt, Tokenization::Literal &key);
+
+        void rnd(ExprStmt::RndStmt &stmt, Tokenization::Literal &lowerBound, Tokenization::Literal &upperBound);
+
+        // Whole number of `#number`, InvalidFileNumber otherwise
+        int64_t fileNumber(ExprStmt::Expr &expr, const char *statement, uint32_t line);
+
+        int64_t fileNumber(const Tokenization::Literal &value, uint32_t line);
+
+        // File open under `#number`, FileNotOpen otherwise
+        OpenFile &getFile(ExprStmt::Expr &expr, const char *statement, uint32_t line);
+
+        OpenFile &getFile(int64_t number, uint32_t line);
+
+        bool atEnd(OpenFile &file, uint32_t line);
 
-        Tokenization::Literal getVarValue(const std::string &varName, ExprStmt::Stmt &stmt);
+        void openFile(ExprStmt::OpenStmt &stmt, const Values::RcString &path, int64_t number);
+
+        void readLine(ExprStmt::ReadLineStmt &stmt, OpenFile &file);
+
+        // Writes value of WRITE to file opened for output
+        void writeLine(ExprStmt::WriteStmt &stmt, OpenFile &file, Tokenization::Literal &value);
+
+        void closeFile(ExprStmt::CloseStmt &stmt, int64_t number);
+
+        const Tokenization::Literal *findVariable(const std::string &varName) const;
+
+        const Tokenization::Literal *findVariable(const ExprStmt::VarRef &var) const;
+
+        // Variable to assign to, created when it does not exist yet
+        Tokenization::Literal &variableForWrite(const ExprStmt::VarRef &var);
+
+        Tokenization::Literal getVarValue(const ExprStmt::VarRef &var, ExprStmt::Expr &expr);
+
+        Tokenization::Literal getVarValue(const ExprStmt::VarRef &var, ExprStmt::Stmt &stmt);
+
+        Tokenization::Literal callFunction(ExprStmt::CallExpr &expr, bool valueNeeded);
+
+        // Evaluates arguments and pushes the frame of the called function
+        CallFrame enterFunction(ExprStmt::CallExpr &expr);
+
+        // Steps of enterFunction: frame is pushed, arguments are stored to its first slots, then it becomes current
+        size_t pushFrame(ExprStmt::CallExpr &expr);
+
+        void setArgument(size_t slot, Tokenization::Literal &&argument, uint32_t line);
+
+        // Levels of nesting a running call adds: the visit of the call and of its body
+        static uint32_t nestingOf(const ExprStmt::CallExpr &expr) { return expr.function->nestingHeight + 1; }
+
+        CallFrame enterFrame(ExprStmt::CallExpr &expr, size_t base);
+
+        // Pops the frame and returns the RETURN value
+        Tokenization::Literal leaveFunction(ExprStmt::CallExpr &expr, const CallFrame &frame, bool valueNeeded);
 
     public:
+        explicit Interpreter(std::istream &input = std::cin, std::ostream &output = std::cout,
+                             uint64_t randomSeed = std::mt19937_64::default_seed)
+            : input(input), output(output), random(randomSeed) {}
+
+        ~Interpreter() override;
+
+        Interpreter(const Interpreter &) = delete;
+
+        Interpreter &operator=(const Interpreter &) = delete;
+
         Tokenization::Literal visit(ExprStmt::UnaryExpr &expr) override;
 
         Tokenization::Literal visit(ExprStmt::BinaryExpr &expr) override;
@@ -40,6 +331,38 @@ namespace Interpreting {
         Tokenization::Literal visit(ExprStmt::LiteralExpr &expr) override;
         
         Tokenization::Literal visit(ExprStmt::VarExpr &expr) override;
+
+        Tokenization::Literal visit(ExprStmt::ArrayExpr &expr) override;
+
+        Tokenization::Literal visit(ExprStmt::ArrayFunctionExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::StringFunctionExpr &expr) override;
+
+        Tokenization::Literal visit(ExprStmt::CallExpr &expr) override;
+
+        Tokenization::Literal visit(ExprStmt::EofExpr &expr) override;
+
+        // Unchecked evaluation of expressions with proven type, used only where TypeInference annotated the node
+        double visitNumber(ExprStmt::UnaryExpr &expr) override;
+
+        double visitNumber(ExprStmt::BinaryExpr &expr) override;
+
+        double visitNumber(ExprStmt::GroupingExpr &expr) override;
+
+        double visitNumber(ExprStmt::LiteralExpr &expr) override;
+
+        double visitNumber(ExprStmt::VarExpr &expr) override;
+
+        double visitNumber(ExprStmt::ArrayExpr &expr) override;
+
+        bool visitBoolean(ExprStmt::UnaryExpr &expr) override;
+
+        bool visitBoolean(ExprStmt::BinaryExpr &expr) override;
+
+        bool visitBoolean(ExprStmt::GroupingExpr &expr) override;
+
+        bool visitBoolean(ExprStmt::LiteralExpr &expr) override;
+
+        bool visitBoolean(ExprStmt::VarExpr &expr) override;
         
         void visit(ExprStmt::PrintStmt &stmt) override;
         
@@ -47,6 +370,16 @@ namespace Interpreting {
         
         void visit(ExprStmt::LetStmt &stmt) override;
         
+        void visit(ExprStmt::ArrayLetStmt &stmt) override;
+        
+        void visit(ExprStmt::DimStmt &stmt) override;
+        
+        void visit(ExprStmt::MapStmt &stmt) override;
+        
+        void visit(ExprStmt::PutStmt &stmt) override;
+        
+        void visit(ExprStmt::GetStmt &stmt) override;
+        
         void visit(ExprStmt::ToNumStmt &stmt) override;
         
         void visit(ExprStmt::ToStrStmt &stmt) override;
@@ -59,12 +392,60 @@ namespace Interpreting {
 
         void visit(ExprStmt::WhileStmt &stmt) override;
 
+        void visit(ExprStmt::ParallelForStmt &stmt) override;
+
+        void visit(ExprStmt::FunctionStmt &stmt) override;
+
+        void visit(ExprStmt::CallStmt &stmt) override;
+
+        void visit(ExprStmt::ReturnStmt &stmt) override;
+
         void visit(ExprStmt::BreakStmt &stmt) override;
 
         void visit(ExprStmt::ContinueStmt &stmt) override;
 
+        void visit(ExprStmt::OpenStmt &stmt) override;
+
+        void visit(ExprStmt::ReadLineStmt &stmt) override;
+
+        void visit(ExprStmt::WriteStmt &stmt) override;
+
+        void visit(ExprStmt::CloseStmt &stmt) override;
+
+        // Closes files the program left open, writing what is buffered, raises FileWriteFailed on error
+        void closeFiles();
+
         void interpret(ExprStmt::stmt_ptr &stmt);
 
+        void interpret(ExprStmt::Stmt &stmt);
+
+        void setVariable(const std::string &name, Tokenization::Literal value);
+
+        std::optional<Tokenization::Literal> getVariable(const std::string &name) const;
+
+        void setProfiler(Profiling::Profiler *profiler);
+
+        // StepLimitExceeded is raised after about this many executed statements
+        void setMaxSteps(uint64_t maxSteps);
+
+        // MemoryLimitExceeded is raised when strings in variables, arrays and maps would take more bytes.
+        // Must be set before any variable.
+        void setMaxMemory(uint64_t maxBytes);
+
+        // Every `every` steps, at the start of the next block outside of FUNCTION and PARALLEL FOR, handler gets
+        // the state to continue from. Program is the list of top level statements the positions are relative to.
+        void setCheckpoints(const std::vector<ExprStmt::stmt_ptr> &program, uint64_t every,
+                            std::function<void(Checkpointing::State &&)> handler);
+
+        // Restores variables, random generator and statement count of a checkpoint
+        void restore(Checkpointing::State &&state);
+
+        // Runs the top level statement the checkpoint was taken in from its position to its end.
+        // Returns index of the top level statement to continue with, throws Checkpointing::CheckpointError.
+        size_t resume(const std::vector<ExprStmt::stmt_ptr> &program, const std::vector<uint32_t> &position);
+
+        uint64_t getStatementsExecuted() const;
+
         std::string &getErrorMessage();
         
         uint32_t getErrorLine();
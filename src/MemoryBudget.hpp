@@ -0,0 +1,37 @@
+#ifndef BASICPLUSPLUS_MEMORYBUDGET_HPP
+#define BASICPLUSPLUS_MEMORYBUDGET_HPP
+
+#include <atomic>
+#include <cstdint>
+
+namespace Values {
+    // Bytes held by values of one run, limited by `--max-memory`.
+    // Shared by PARALLEL FOR iterations, and arrays and maps release their bytes when the last reference is dropped,
+    // which may happen on any thread and after the interpreter is gone.
+    class MemoryBudget {
+    private:
+        std::atomic<uint64_t> used = 0;
+
+    public:
+        const uint64_t limit;
+
+        explicit MemoryBudget(uint64_t limit) : limit(limit) {}
+
+        // Returns false and charges nothing when bytes do not fit into the limit
+        bool charge(uint64_t bytes) {
+            uint64_t before = used.fetch_add(bytes, std::memory_order_relaxed);
+            if (before + bytes <= limit) return true;
+            used.fetch_sub(bytes, std::memory_order_relaxed);
+            return false;
+        }
+
+        void release(uint64_t bytes) { used.fetch_sub(bytes, std::memory_order_relaxed); }
+
+        // Whether a temporary value of this size could be created now
+        bool fits(uint64_t bytes) const { return used.load(std::memory_order_relaxed) + bytes <= limit; }
+
+        uint64_t getUsed() const { return used.load(std::memory_order_relaxed); }
+    };
+}
+
+#endif //BASICPLUSPLUS_MEMORYBUDGET_HPP
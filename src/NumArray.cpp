@@ -0,0 +1,189 @@
+#include "NumArray.hpp"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define BASICPLUSPLUS_SIMD_AVX
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BASICPLUSPLUS_SIMD_SSE2
+#endif
+
+namespace Values::Kernels {
+    // Thin wrappers so the kernels below are written once for every vector width
+#if defined(BASICPLUSPLUS_SIMD_AVX)
+    using Vec = __m256d;
+    static constexpr size_t lanes = 4;
+    static inline Vec load(const double *p) { return _mm256_loadu_pd(p); }
+    static inline void store(double *p, Vec v) { _mm256_storeu_pd(p, v); }
+    static inline Vec broadcast(double s) { return _mm256_set1_pd(s); }
+    static inline Vec vadd(Vec a, Vec b) { return _mm256_add_pd(a, b); }
+    static inline Vec vsub(Vec a, Vec b) { return _mm256_sub_pd(a, b); }
+    static inline Vec vmul(Vec a, Vec b) { return _mm256_mul_pd(a, b); }
+    static inline Vec vdiv(Vec a, Vec b) { return _mm256_div_pd(a, b); }
+    static inline Vec vmin(Vec a, Vec b) { return _mm256_min_pd(a, b); }
+    static inline Vec vmax(Vec a, Vec b) { return _mm256_max_pd(a, b); }
+    static inline bool anyZero(Vec v) {
+        return _mm256_movemask_pd(_mm256_cmp_pd(v, _mm256_setzero_pd(), _CMP_EQ_OQ)) != 0;
+    }
+#elif defined(BASICPLUSPLUS_SIMD_SSE2)
+    using Vec = __m128d;
+    static constexpr size_t lanes = 2;
+    static inline Vec load(const double *p) { return _mm_loadu_pd(p); }
+    static inline void store(double *p, Vec v) { _mm_storeu_pd(p, v); }
+    static inline Vec broadcast(double s) { return _mm_set1_pd(s); }
+    static inline Vec vadd(Vec a, Vec b) { return _mm_add_pd(a, b); }
+    static inline Vec vsub(Vec a, Vec b) { return _mm_sub_pd(a, b); }
+    static inline Vec vmul(Vec a, Vec b) { return _mm_mul_pd(a, b); }
+    static inline Vec vdiv(Vec a, Vec b) { return _mm_div_pd(a, b); }
+    static inline Vec vmin(Vec a, Vec b) { return _mm_min_pd(a, b); }
+    static inline Vec vmax(Vec a, Vec b) { return _mm_max_pd(a, b); }
+    static inline bool anyZero(Vec v) { return _mm_movemask_pd(_mm_cmpeq_pd(v, _mm_setzero_pd())) != 0; }
+#else
+    // Portable fallback, one lane wide
+    using Vec = double;
+    static constexpr size_t lanes = 1;
+    static inline Vec load(const double *p) { return *p; }
+    static inline void store(double *p, Vec v) { *p = v; }
+    static inline Vec broadcast(double s) { return s; }
+    static inline Vec vadd(Vec a, Vec b) { return a + b; }
+    static inline Vec vsub(Vec a, Vec b) { return a - b; }
+    static inline Vec vmul(Vec a, Vec b) { return a * b; }
+    static inline Vec vdiv(Vec a, Vec b) { return a / b; }
+    static inline Vec vmin(Vec a, Vec b) { return b < a ? b : a; }
+    static inline Vec vmax(Vec a, Vec b) { return b > a ? b : a; }
+    static inline bool anyZero(Vec v) { return v == 0; }
+#endif
+
+    static inline double horizontal(Vec v, double (*combine)(double, double)) {
+        double parts[lanes];
+        store(parts, v);
+        double result = parts[0];
+        for (size_t i = 1; i < lanes; i++) result = combine(result, parts[i]);
+        return result;
+    }
+
+    struct Add {
+        static Vec vec(Vec a, Vec b) { return vadd(a, b); }
+        static double scalar(double a, double b) { return a + b; }
+    };
+
+    struct Subtract {
+        static Vec vec(Vec a, Vec b) { return vsub(a, b); }
+        static double scalar(double a, double b) { return a - b; }
+    };
+
+    struct Multiply {
+        static Vec vec(Vec a, Vec b) { return vmul(a, b); }
+        static double scalar(double a, double b) { return a * b; }
+    };
+
+    struct Divide {
+        static Vec vec(Vec a, Vec b) { return vdiv(a, b); }
+        static double scalar(double a, double b) { return a / b; }
+    };
+
+    struct Min {
+        static Vec vec(Vec a, Vec b) { return vmin(a, b); }
+        static double scalar(double a, double b) { return b < a ? b : a; }
+    };
+
+    struct Max {
+        static Vec vec(Vec a, Vec b) { return vmax(a, b); }
+        static double scalar(double a, double b) { return b > a ? b : a; }
+    };
+
+    template<class Op>
+    static void elementWise(const double *a, const double *b, double *out, size_t n) {
+        size_t i = 0;
+        for (; i + 2 * lanes <= n; i += 2 * lanes) {
+            Vec x0 = Op::vec(load(a + i), load(b + i));
+            Vec x1 = Op::vec(load(a + i + lanes), load(b + i + lanes));
+            store(out + i, x0);
+            store(out + i + lanes, x1);
+        }
+        for (; i < n; i++) out[i] = Op::scalar(a[i], b[i]);
+    }
+
+    template<class Op>
+    static void withScalarRight(const double *a, double s, double *out, size_t n) {
+        Vec sv = broadcast(s);
+        size_t i = 0;
+        for (; i + 2 * lanes <= n; i += 2 * lanes) {
+            store(out + i, Op::vec(load(a + i), sv));
+            store(out + i + lanes, Op::vec(load(a + i + lanes), sv));
+        }
+        for (; i < n; i++) out[i] = Op::scalar(a[i], s);
+    }
+
+    template<class Op>
+    static void withScalarLeft(double s, const double *a, double *out, size_t n) {
+        Vec sv = broadcast(s);
+        size_t i = 0;
+        for (; i + 2 * lanes <= n; i += 2 * lanes) {
+            store(out + i, Op::vec(sv, load(a + i)));
+            store(out + i + lanes, Op::vec(sv, load(a + i + lanes)));
+        }
+        for (; i < n; i++) out[i] = Op::scalar(s, a[i]);
+    }
+
+    // Folds with independent accumulators, so consecutive vector operations do not wait for each other
+    template<class Op>
+    static double fold(const double *a, size_t n, double identity) {
+        Vec acc[4] = {broadcast(identity), broadcast(identity), broadcast(identity), broadcast(identity)};
+        size_t i = 0;
+        for (; i + 4 * lanes <= n; i += 4 * lanes) {
+            for (size_t k = 0; k < 4; k++) acc[k] = Op::vec(acc[k], load(a + i + k * lanes));
+        }
+        Vec total = Op::vec(Op::vec(acc[0], acc[1]), Op::vec(acc[2], acc[3]));
+        double result = horizontal(total, Op::scalar);
+        for (; i < n; i++) result = Op::scalar(result, a[i]);
+        return result;
+    }
+
+    size_t vectorLanes() {
+        return lanes;
+    }
+
+    double sum(const double *a, size_t n) {
+        return fold<Add>(a, n, 0.);
+    }
+
+    double min(const double *a, size_t n) {
+        return fold<Min>(a, n, a[0]);
+    }
+
+    double max(const double *a, size_t n) {
+        return fold<Max>(a, n, a[0]);
+    }
+
+    bool containsZero(const double *a, size_t n) {
+        size_t i = 0;
+        for (; i + lanes <= n; i += lanes) {
+            if (anyZero(load(a + i))) return true;
+        }
+        for (; i < n; i++) {
+            if (a[i] == 0) return true;
+        }
+        return false;
+    }
+
+    void add(const double *a, const double *b, double *out, size_t n) { elementWise<Add>(a, b, out, n); }
+
+    void subtract(const double *a, const double *b, double *out, size_t n) { elementWise<Subtract>(a, b, out, n); }
+
+    void multiply(const double *a, const double *b, double *out, size_t n) { elementWise<Multiply>(a, b, out, n); }
+
+    void divide(const double *a, const double *b, double *out, size_t n) { elementWise<Divide>(a, b, out, n); }
+
+    void addScalar(const double *a, double s, double *out, size_t n) { withScalarRight<Add>(a, s, out, n); }
+
+    void subtractScalar(const double *a, double s, double *out, size_t n) { withScalarRight<Subtract>(a, s, out, n); }
+
+    void multiplyScalar(const double *a, double s, double *out, size_t n) { withScalarRight<Multiply>(a, s, out, n); }
+
+    void divideScalar(const double *a, double s, double *out, size_t n) { withScalarRight<Divide>(a, s, out, n); }
+
+    void scalarSubtract(double s, const double *a, double *out, size_t n) { withScalarLeft<Subtract>(s, a, out, n); }
+
+    void scalarDivide(double s, const double *a, double *out, size_t n) { withScalarLeft<Divide>(s, a, out, n); }
+}
@@ -0,0 +1,77 @@
+#ifndef BASICPLUSPLUS_NUMARRAY_HPP
+#define BASICPLUSPLUS_NUMARRAY_HPP
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "MemoryBudget.hpp"
+
+namespace Values {
+    // Contiguous numeric array created by `DIM`, shared by reference between variables
+    class NumArray {
+    public:
+        std::vector<double> values;
+        // Budget charged for the array by the interpreter, nullptr without memory limit
+        std::shared_ptr<MemoryBudget> budget;
+
+        explicit NumArray(size_t size) : values(size, 0.) {}
+
+        NumArray(const double *values, size_t size) : values(values, values + size) {}
+
+        ~NumArray() {
+            if (budget) budget->release(bytes(values.size()));
+        }
+
+        NumArray(const NumArray &) = delete;
+
+        NumArray &operator=(const NumArray &) = delete;
+
+        // Memory charged for array of size elements
+        static uint64_t bytes(size_t size) { return sizeof(NumArray) + size * sizeof(double); }
+
+        size_t size() const { return values.size(); }
+
+        double *data() { return values.data(); }
+
+        const double *data() const { return values.data(); }
+    };
+
+    // SIMD kernels for whole array operations, `out` may alias inputs
+    namespace Kernels {
+        // Doubles per vector register, 1 for the portable fallback. Folds keep 4 accumulators of this many lanes,
+        // which fixes the order SUM adds elements in.
+        size_t vectorLanes();
+
+        double sum(const double *a, size_t n);
+
+        double min(const double *a, size_t n);  // n must be > 0
+
+        double max(const double *a, size_t n);  // n must be > 0
+
+        bool containsZero(const double *a, size_t n);
+
+        void add(const double *a, const double *b, double *out, size_t n);
+
+        void subtract(const double *a, const double *b, double *out, size_t n);
+
+        void multiply(const double *a, const double *b, double *out, size_t n);
+
+        void divide(const double *a, const double *b, double *out, size_t n);
+
+        // Array OP scalar
+        void addScalar(const double *a, double s, double *out, size_t n);
+
+        void subtractScalar(const double *a, double s, double *out, size_t n);
+
+        void multiplyScalar(const double *a, double s, double *out, size_t n);
+
+        void divideScalar(const double *a, double s, double *out, size_t n);
+
+        // Scalar OP array
+        void scalarSubtract(double s, const double *a, double *out, size_t n);
+
+        void scalarDivide(double s, const double *a, double *out, size_t n);
+    }
+}
+
+#endif //BASICPLUSPLUS_NUMARRAY_HPP
@@ -0,0 +1,21 @@
+#include <charconv>
+#include <cmath>
+#include <format>
+#include <iterator>
+#include "Numbers.hpp"
+
+namespace Values {
+    void appendNumber(std::string &out, double number) {
+        int64_t whole;
+        // -0 is whole too, but printed with its sign
+        if (asWhole(number, whole) && (whole != 0 || !std::signbit(number))) {
+            char buffer[24];
+            out.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), whole).ptr);
+        } else if (std::fmod(number, 1) == 0) {
+            // Whole number beyond int64_t
+            std::format_to(std::back_inserter(out), "{:.0f}", number);
+        } else {
+            std::format_to(std::back_inserter(out), "{:.2f}", number);
+        }
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef BASICPLUSPLUS_NUMBERS_HPP
+#define BASICPLUSPLUS_NUMBERS_HPP
+
+#include <cstdint>
+#include <string>
+
+namespace Values {
+    // Numbers are doubles, which hold every whole number up to 2^53 exactly. Whole numbers, which most counters,
+    // indices, sizes and bounds are, take int64_t paths giving the same results as the double operations they replace.
+
+    // 2^63, every whole double of smaller magnitude converts to int64_t exactly
+    inline constexpr double wholeLimit = 9223372036854775808.0;
+
+    // Stores number to whole and returns true when it is a whole number in int64_t range, -0 is 0
+    inline bool asWhole(double number, int64_t &whole) {
+        if (!(number >= -wholeLimit && number < wholeLimit)) return false;
+        whole = static_cast<int64_t>(number);
+        return static_cast<double>(whole) == number;
+    }
+
+    // Appends number as PRINT shows it, whole numbers without decimal places, others rounded to 2
+    void appendNumber(std::string &out, double number);
+}
+
+#endif //BASICPLUSPLUS_NUMBERS_HPP
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include "Parser.hpp"
 #include "Tokenization.hpp"
 
@@ -23,6 +24,41 @@ namespace Parsing {
         return cur().type == type;
     }
 
+    static bool isWord(const Token &token, std::string_view word) {
+        if (token.type != IDENTIFIER) return false;
+        std::string_view name = std::get<Values::RcString>(token.literal.value()).view();
+        return std::ranges::equal(name, word, [](char a, char b) { return tolower(a) == b; });
+    }
+
+    bool Parser::checkWord(std::string_view word) {
+        return isWord(cur(), word);
+    }
+
+    bool Parser::matchWord(std::string_view word) {
+        if (!checkWord(word)) return false;
+        advance();
+        return true;
+    }
+
+    void Parser::consumeWord(std::string_view word, std::string &&message) {
+        if (!matchWord(word)) throwErrorAtCurrentToken(std::move(message));
+    }
+
+    bool Parser::statementAhead() {
+        // '#' never continues an expression, OPEN is followed by its path, and no identifier follows another one
+        if (checkWord("readline") || checkWord("write") || checkWord("close")) return peek().type == HASH;
+        if (checkWord("parallel")) return isWord(peek(), "for");
+        if (checkWord("dim") || checkWord("map") || checkWord("put") || checkWord("get") || checkWord("has")) {
+            return peek().type == IDENTIFIER;
+        }
+        return checkWord("open") && (peek().type == STRING || peek().type == IDENTIFIER || isWord(peek(), "call"));
+    }
+
+    bool Parser::callAhead() {
+        // A name followed by '(' never continues an expression ending with a variable
+        return checkWord("call") && peek().type == IDENTIFIER && tokens->at(currentTokenIndex + 2).type == LEFT_PAREN;
+    }
+
     Token &Parser::advance() {
         if (currentTokenIndex <= tokens->size()) currentTokenIndex++;
         return prev();
@@ -52,11 +88,41 @@ namespace Parsing {
     }
 
     void Parser::throwErrorAtCurrentToken(std::string &&message) {
-        errorTokenIndex = currentTokenIndex;
+        throwErrorAtToken(currentTokenIndex, std::move(message));
+    }
+
+    void Parser::throwErrorAtToken(uint32_t tokenIndex, std::string &&message) {
+        errorTokenIndex = tokenIndex;
         errorMessage = std::move(message);
         throw ParsingError();
     }
 
+    void Parser::throwNestingError() {
+        throwErrorAtCurrentToken("Program is nested deeper than " + std::to_string(maxDepth) + " levels.");
+    }
+
+    Parser::Nesting::Nesting(Parser &parser) : parser(parser) {
+        if (++parser.depth > parser.maxDepth) parser.throwNestingError();
+        parser.deepest = std::max(parser.deepest, parser.depth);
+    }
+
+    template<typename T>
+    std::unique_ptr<T> Parser::nested(std::unique_ptr<T> &&expr, uint32_t operandHeight) {
+        height = operandHeight + 1;
+        if (depth + height > maxDepth) throwNestingError();
+        deepest = std::max(deepest, depth + height);
+        return std::move(expr);
+    }
+
+    VarRef Parser::variable(const Token &token) {
+        std::string name = std::get<Values::RcString>(token.literal.value()).str();
+        if (!functionLocals) return {std::move(name)};
+
+        // Every variable of a function is local, slots are numbered in order of first use
+        auto slot = functionLocals->try_emplace(name, static_cast<int32_t>(functionLocals->size())).first->second;
+        return {std::move(name), slot};
+    }
+
     // Top down expression parsing
     expr_ptr Parser::expression() {
         return orWord();
@@ -67,8 +133,10 @@ namespace Parsing {
 
         while (match(OR)) {
             Token op = prev();
+            uint32_t leftHeight = height;
             expr_ptr right = andWord();
-            expr = std::make_unique<BinaryExpr>(std::move(expr), std::move(op), std::move(right), prev().line);
+            expr = nested(std::make_unique<BinaryExpr>(std::move(expr), std::move(op), std::move(right), prev().line),
+                          std::max(leftHeight, height));
         }
 
         return expr;
@@ -79,8 +147,10 @@ namespace Parsing {
 
         while (match(AND)) {
             Token op = prev();
+            uint32_t leftHeight = height;
             expr_ptr right = unaryNot();
-            expr = std::make_unique<BinaryExpr>(std::move(expr), std::move(op), std::move(right), prev().line);
+            expr = nested(std::make_unique<BinaryExpr>(std::move(expr), std::move(op), std::move(right), prev().line),
+                          std::max(leftHeight, height));
         }
 
         return expr;
@@ -89,8 +159,9 @@ namespace Parsing {
     expr_ptr Parser::unaryNot() {
         if (match(NOT)) {
             Token op = prev();
+            Nesting nesting(*this);
             expr_ptr right = unaryNot();
-            return std::make_unique<UnaryExpr>(std::move(op), std::move(right), prev().line);
+            return nested(std::make_unique<UnaryExpr>(std::move(op), std::move(right), prev().line), height);
         }
 
         return comparison();
@@ -101,8 +172,10 @@ namespace Parsing {
 
         while (match(GREATER, GREATER_EQUAL, LESS, LESS_EQUAL, NOT_EQUAL, EQUAL_EQUAL)) {
             Token op = prev();
+            uint32_t leftHeight = height;
             expr_ptr right = term();
-            expr = std::make_unique<BinaryExpr>(std::move(expr), std::move(op), std::move(right), prev().line);
+            expr = nested(std::make_unique<BinaryExpr>(std::move(expr), std::move(op), std::move(right), prev().line),
+                          std::max(leftHeight, height));
         }
 
         return expr;
@@ -113,8 +186,10 @@ namespace Parsing {
 
         while (match(MINUS, PLUS)) {
             Token op = prev();
+            uint32_t leftHeight = height;
             expr_ptr right = factor();
-            expr = std::make_unique<BinaryExpr>(std::move(expr), std::move(op), std::move(right), prev().line);
+            expr = nested(std::make_unique<BinaryExpr>(std::move(expr), std::move(op), std::move(right), prev().line),
+                          std::max(leftHeight, height));
         }
 
         return expr;
@@ -125,8 +200,10 @@ namespace Parsing {
 
         while (match(SLASH, STAR)) {
             Token op = prev();
+            uint32_t leftHeight = height;
             expr_ptr right = unary();
-            expr = std::make_unique<BinaryExpr>(std::move(expr), std::move(op), std::move(right), prev().line);
+            expr = nested(std::make_unique<BinaryExpr>(std::move(expr), std::move(op), std::move(right), prev().line),
+                          std::max(leftHeight, height));
         }
 
         return expr;
@@ -135,28 +212,87 @@ namespace Parsing {
     expr_ptr Parser::unary() {
         if (match(MINUS)) {
             Token op = prev();
+            Nesting nesting(*this);
             expr_ptr right = unary();
-            return std::make_unique<UnaryExpr>(std::move(op), std::move(right), prev().line);
+            return nested(std::make_unique<UnaryExpr>(std::move(op), std::move(right), prev().line), height);
         }
 
         return primary();
     }
 
+    const std::map<std::string, ArrayFunctionExpr::Function> Parser::arrayFunctions = {
+        {"sum", ArrayFunctionExpr::SUM},
+        {"min", ArrayFunctionExpr::MIN},
+        {"max", ArrayFunctionExpr::MAX},
+    };
+
+    const std::map<std::string, Parser::StringFunction> Parser::stringFunctions = {
+        {"len", {StringFunctionExpr::LEN, 1, 1}},
+        {"mid", {StringFunctionExpr::MID, 2, 3}},
+        {"left", {StringFunctionExpr::LEFT, 2, 2}},
+        {"right", {StringFunctionExpr::RIGHT, 2, 2}},
+        {"instr", {StringFunctionExpr::INSTR, 2, 3}},
+        {"upper", {StringFunctionExpr::UPPER, 1, 1}},
+        {"lower", {StringFunctionExpr::LOWER, 1, 1}},
+        {"split", {StringFunctionExpr::SPLIT, 3, 3}},
+    };
+
     expr_ptr Parser::primary() {
         if (match(NUMBER, STRING, BOOLEAN)) {
             Literal value = prev().literal.value();
-            return std::make_unique<LiteralExpr>(std::move(value), prev().line);
+            if (auto string = std::get_if<Values::RcString>(&value)) {
+                value = constants.try_emplace(string->str(), *string).first->second;
+            }
+            return nested(std::make_unique<LiteralExpr>(std::move(value), prev().line), 0);
         }
 
         if (match(LEFT_PAREN)) {
+            Nesting nesting(*this);
             expr_ptr expr = expression();
             consume(RIGHT_PAREN, "Expect ')' after expression.");
-            return std::make_unique<GroupingExpr>(std::move(expr), prev().line);
+            return nested(std::make_unique<GroupingExpr>(std::move(expr), prev().line), height);
+        }
+
+        if (callAhead()) {
+            advance();
+            return callExpr();
         }
 
         if (match(IDENTIFIER)) {
-            std::string varName = std::get<std::string>(prev().literal.value());
-            return std::make_unique<VarExpr>(std::move(varName), prev().line);
+            Token nameToken = prev();
+            std::string varName = std::get<Values::RcString>(nameToken.literal.value()).str();
+            // `EOF(#n)`, '#' never starts an array index
+            if (check(LEFT_PAREN) && peek().type == HASH && varName.size() == 3 && tolower(varName[0]) == 'e'
+                && tolower(varName[1]) == 'o' && tolower(varName[2]) == 'f') {
+                advance();
+                Nesting nesting(*this);
+                expr_ptr number = fileNumber("EOF");
+                consume(RIGHT_PAREN, "Expect ')' after file number.");
+                return nested(std::make_unique<EofExpr>(std::move(number), prev().line), height);
+            }
+            // Built-in names are not keywords, so they stay usable as variable names. Only a name followed by '('
+            // can be one, plain variables are not looked up.
+            if (check(LEFT_PAREN)) {
+                std::string nameLower;
+                for (char c: varName) nameLower.push_back(tolower(c));
+                auto stringFunction = stringFunctions.find(nameLower);
+                if (stringFunction != stringFunctions.end()) return stringFunctionExpr(stringFunction->second, varName);
+
+                advance();
+                Nesting nesting(*this);
+                expr_ptr argument = expression();
+                consume(RIGHT_PAREN, "Expect ')' after array index.");
+
+                auto function = arrayFunctions.find(nameLower);
+                if (function != arrayFunctions.end()) {
+                    std::string nameUpper;
+                    for (char c: varName) nameUpper.push_back(toupper(c));
+                    return nested(std::make_unique<ArrayFunctionExpr>(function->second, std::move(nameUpper),
+                                                                      std::move(argument), prev().line), height);
+                }
+                return nested(std::make_unique<ArrayExpr>(variable(nameToken), std::move(argument), prev().line), height);
+            }
+            return nested(std::make_unique<VarExpr>(variable(nameToken), prev().line), 0);
         }
 
         throwErrorAtCurrentToken("Expression expected.");
@@ -181,12 +317,33 @@ namespace Parsing {
         if (match(RND)) return rndStmt();
         if (match(BREAK)) return std::make_unique<BreakStmt>(prev().line);
         if (match(CONTINUE)) return std::make_unique<ContinueStmt>(prev().line);
+        // Statement words that are not keywords, so they stay usable as variable names. No other statement starts
+        // with an identifier.
+        if (matchWord("parallel")) {
+            if (functionLocals) throwErrorAtCurrentToken("PARALLEL FOR is not allowed in FUNCTION.");
+            return parallelForStmt();
+        }
+        if (matchWord("call")) {
+            std::unique_ptr<CallExpr> call = callExpr();
+            return std::make_unique<CallStmt>(std::move(call), prev().line);
+        }
+        if (matchWord("return")) return returnStmt();
+        if (matchWord("dim")) return dimStmt();
+        if (matchWord("map")) return mapStmt();
+        if (matchWord("put")) return putStmt();
+        if (matchWord("get") || matchWord("has")) return getStmt();
+        if (matchWord("open")) return openStmt();
+        if (matchWord("readline")) return readLineStmt();
+        if (matchWord("write")) return writeStmt();
+        if (matchWord("close")) return std::make_unique<CloseStmt>(fileNumber("CLOSE"), prev().line);
+        if (checkWord("function")) throwErrorAtCurrentToken("FUNCTION is only allowed at top level.");
         
         throwErrorAtCurrentToken("Statement expected.");
         return nullptr;  // Unreachable
     }
     
     ExprStmt::stmt_ptr Parser::block() {
+        Nesting nesting(*this);
         std::vector<stmt_ptr> declars;
         
         while (!check(END) && !check(ELSE)) {
@@ -197,29 +354,35 @@ namespace Parsing {
     }
     
     stmt_ptr Parser::printStmt() {
-        expr_ptr value = expression();
-        return std::make_unique<PrintStmt>(std::move(value), prev().line);
+        std::vector<expr_ptr> values;
+        std::vector<PrintStmt::Separator> separators;
+        values.push_back(expression());
+        while (match(SEMICOLON, COMMA)) {
+            separators.push_back(prev().type == COMMA ? PrintStmt::Separator::TAB : PrintStmt::Separator::NONE);
+            values.push_back(expression());
+        }
+        return std::make_unique<PrintStmt>(std::move(values), std::move(separators), prev().line);
     }
     
     stmt_ptr Parser::inputStmt() {
         expr_ptr value = expression();
         consume(COMMA, "INPUT expects two parameters separated by comma.");
         Token targetVariableToken = consume(IDENTIFIER, "INPUT second parameter must be variable identifier.");
-        std::string targetVariable = std::get<std::string>(targetVariableToken.literal.value());
+        VarRef targetVariable = variable(targetVariableToken);
         return std::make_unique<InputStmt>(std::move(value), std::move(targetVariable), prev().line);
     }
     
     stmt_ptr Parser::toNumStmt() {
         Token srcVarToken = consume(IDENTIFIER, "TONUM first parameter must be variable identifier.");
-        std::string srcVarName = std::get<std::string>(srcVarToken.literal.value());
+        VarRef srcVarName = variable(srcVarToken);
         
-        std::optional<std::string> dstVarName = std::nullopt;
+        std::optional<VarRef> dstVarName = std::nullopt;
         
         if (check(COMMA)) {
             advance();
 
             Token dstVarToken = consume(IDENTIFIER, "TONUM second parameter must be variable identifier.");
-            dstVarName = std::get<std::string>(dstVarToken.literal.value());
+            dstVarName = variable(dstVarToken);
         }
         
         return std::make_unique<ToNumStmt>(std::move(srcVarName), std::move(dstVarName), prev().line);
@@ -227,15 +390,15 @@ namespace Parsing {
     
     stmt_ptr Parser::toStrStmt() {
         Token srcVarToken = consume(IDENTIFIER, "TOSTR first parameter must be variable identifier.");
-        std::string srcVarName = std::get<std::string>(srcVarToken.literal.value());
+        VarRef srcVarName = variable(srcVarToken);
         
-        std::optional<std::string> dstVarName = std::nullopt;
+        std::optional<VarRef> dstVarName = std::nullopt;
         
         if (check(COMMA)) {
             advance();
 
             Token dstVarToken = consume(IDENTIFIER, "TOSTR second parameter must be variable identifier.");
-            dstVarName = std::get<std::string>(dstVarToken.literal.value());
+            dstVarName = variable(dstVarToken);
         }
         
         return std::make_unique<ToNumStmt>(std::move(srcVarName), std::move(dstVarName), prev().line);
@@ -243,7 +406,7 @@ namespace Parsing {
     
     stmt_ptr Parser::rndStmt() {
         Token dstVarToken = consume(IDENTIFIER, "RND first parameter must be variable identifier.");
-        std::string dstVarName = std::get<std::string>(dstVarToken.literal.value());
+        VarRef dstVarName = variable(dstVarToken);
 
         consume(COMMA, "RND expects three parameters separated by comma.");
         expr_ptr lowerBound = expression();
@@ -279,22 +442,273 @@ namespace Parsing {
         return std::make_unique<WhileStmt>(std::move(condition), std::move(thenBranch), prev().line);
     }
     
+    stmt_ptr Parser::parallelForStmt() {
+        consumeWord("for", "FOR keyword expected after PARALLEL.");
+        Token loopVarToken = consume(IDENTIFIER, "Loop variable identifier expected after PARALLEL FOR.");
+        std::string loopVarName = std::get<Values::RcString>(loopVarToken.literal.value()).str();
+        consume(EQUAL, "Equal sign expected after loop variable identifier.");
+        expr_ptr fromExpr = expression();
+        consumeWord("to", "TO keyword expected after PARALLEL FOR start value.");
+        expr_ptr toExpr = expression();
+
+        std::vector<ParallelForStmt::Reduction> reductions;
+        while (matchWord("reduce")) {
+            Token varToken = consume(IDENTIFIER, "REDUCE expects variable identifier.");
+            std::string varName = std::get<Values::RcString>(varToken.literal.value()).str();
+            consumeWord("with", "WITH keyword expected after REDUCE variable.");
+            if (!match(PLUS, STAR, AND, OR)) {
+                throwErrorAtCurrentToken("REDUCE operator must be one of '+', '*', 'AND', 'OR'.");
+            }
+            reductions.push_back({std::move(varName), prev()});
+        }
+
+        consume(DO, "DO keyword expected after PARALLEL FOR range.");
+        stmt_ptr body = block();
+
+        consume(END, "END keyword expected at the end of PARALLEL FOR block.");
+        return std::make_unique<ParallelForStmt>(std::move(loopVarName), std::move(fromExpr), std::move(toExpr),
+                                                 std::move(reductions), std::move(body), prev().line);
+    }
+    
     stmt_ptr Parser::letDeclaration() {
         Token variableToken = consume(IDENTIFIER, "Variable name expected after LET.");
-        std::string variableName = std::get<std::string>(variableToken.literal.value());
+        VarRef variableName = variable(variableToken);
+        if (match(LEFT_PAREN)) {
+            expr_ptr index = expression();
+            consume(RIGHT_PAREN, "Expect ')' after array index.");
+            consume(EQUAL, "Equal sign expected after array element.");
+            expr_ptr value = expression();
+            return std::make_unique<ArrayLetStmt>(std::move(index), std::move(value), std::move(variableName),
+                                                  prev().line);
+        }
         consume(EQUAL, "Equal sign expected after variable identifier.");
         expr_ptr value = expression();
         return std::make_unique<LetStmt>(std::move(value), std::move(variableName), prev().line);
     }
     
+    stmt_ptr Parser::dimStmt() {
+        Token variableToken = consume(IDENTIFIER, "Array name expected after DIM.");
+        VarRef variableName = variable(variableToken);
+        consume(LEFT_PAREN, "Expect '(' after array name.");
+        expr_ptr size = expression();
+        consume(RIGHT_PAREN, "Expect ')' after array size.");
+        return std::make_unique<DimStmt>(std::move(variableName), std::move(size), prev().line);
+    }
+    
+    stmt_ptr Parser::mapStmt() {
+        Token variableToken = consume(IDENTIFIER, "Map name expected after MAP.");
+        VarRef variableName = variable(variableToken);
+        return std::make_unique<MapStmt>(std::move(variableName), prev().line);
+    }
+    
+    stmt_ptr Parser::putStmt() {
+        Token mapVarToken = consume(IDENTIFIER, "PUT first parameter must be variable identifier.");
+        VarRef mapVarName = variable(mapVarToken);
+
+        consume(COMMA, "PUT expects three parameters separated by comma.");
+        expr_ptr key = expression();
+
+        consume(COMMA, "PUT expects three parameters separated by comma.");
+        expr_ptr value = expression();
+
+        return std::make_unique<PutStmt>(std::move(mapVarName), std::move(key), std::move(value), prev().line);
+    }
+    
+    stmt_ptr Parser::getStmt() {
+        Token op{isWord(prev(), "has") ? HAS : GET, prev().lexeme, std::nullopt, prev().line};
+        Token dstVarToken = consume(IDENTIFIER, op.lexeme + " first parameter must be variable identifier.");
+        VarRef dstVarName = variable(dstVarToken);
+
+        consume(COMMA, op.lexeme + " expects three parameters separated by comma.");
+        Token mapVarToken = consume(IDENTIFIER, op.lexeme + " second parameter must be variable identifier.");
+        VarRef mapVarName = variable(mapVarToken);
+
+        consume(COMMA, op.lexeme + " expects three parameters separated by comma.");
+        expr_ptr key = expression();
+
+        return std::make_unique<GetStmt>(std::move(op), std::move(dstVarName), std::move(mapVarName), std::move(key),
+                                         prev().line);
+    }
+    
+    stmt_ptr Parser::functionDeclaration() {
+        if (functionLocals) throwErrorAtToken(currentTokenIndex - 1, "FUNCTION is only allowed at top level.");
+        uint32_t nameTokenIndex = currentTokenIndex;
+        Token nameToken = consume(IDENTIFIER, "Function name expected after FUNCTION.");
+        std::string name = std::get<Values::RcString>(nameToken.literal.value()).str();
+        if (functions.contains(name)) throwErrorAtToken(nameTokenIndex, "Function '" + name + "' is already defined.");
+
+        std::map<std::string, int32_t> locals;
+        functionLocals = &locals;
+        struct Leave {
+            std::map<std::string, int32_t> *&functionLocals;
+            ~Leave() { functionLocals = nullptr; }
+        } leave{functionLocals};
+
+        consume(LEFT_PAREN, "Expect '(' after function name.");
+        uint32_t parameterCount = 0;
+        if (!check(RIGHT_PAREN)) {
+            do {
+                Token parameterToken = consume(IDENTIFIER, "Parameter name expected.");
+                if (locals.contains(std::get<Values::RcString>(parameterToken.literal.value()).str())) {
+                    throwErrorAtToken(currentTokenIndex - 1, "Duplicate parameter name.");
+                }
+                variable(parameterToken);
+                parameterCount++;
+            } while (match(COMMA));
+        }
+        consume(RIGHT_PAREN, "Expect ')' after parameters.");
+
+        deepest = 0;
+        stmt_ptr body = block();
+        consume(END, "END keyword expected at the end of FUNCTION block.");
+
+        auto function = std::make_unique<FunctionStmt>(std::move(name), parameterCount,
+                                                       static_cast<uint32_t>(locals.size()), deepest, std::move(body),
+                                                       prev().line);
+        functions[function->name] = function.get();
+        return function;
+    }
+
+    expr_ptr Parser::stringFunctionExpr(const StringFunction &function, const std::string &name) {
+        std::string nameUpper;
+        for (char c: name) nameUpper.push_back(toupper(c));
+
+        consume(LEFT_PAREN, "Expect '(' after " + nameUpper + ".");
+        std::vector<expr_ptr> arguments;
+        uint32_t argumentsHeight = 0;
+        {
+            Nesting nesting(*this);
+            do {
+                arguments.push_back(expression());
+                argumentsHeight = std::max(argumentsHeight, height);
+            } while (match(COMMA));
+        }
+        if (arguments.size() < function.minArguments || arguments.size() > function.maxArguments) {
+            std::string expected = std::to_string(function.minArguments);
+            if (function.maxArguments != function.minArguments) {
+                expected += " or " + std::to_string(function.maxArguments);
+            }
+            throwErrorAtCurrentToken(nameUpper + " expects " + expected
+                                     + (function.maxArguments == 1 ? " argument." : " arguments."));
+        }
+        consume(RIGHT_PAREN, "Expect ')' after arguments.");
+        return nested(std::make_unique<StringFunctionExpr>(function.function, std::move(nameUpper),
+                                                           std::move(arguments), prev().line), argumentsHeight);
+    }
+
+    std::unique_ptr<CallExpr> Parser::callExpr() {
+        uint32_t nameTokenIndex = currentTokenIndex;
+        Token nameToken = consume(IDENTIFIER, "Function name expected after CALL.");
+        std::string name = std::get<Values::RcString>(nameToken.literal.value()).str();
+
+        consume(LEFT_PAREN, "Expect '(' after function name.");
+        std::vector<expr_ptr> arguments;
+        uint32_t argumentsHeight = 0;
+        if (!check(RIGHT_PAREN)) {
+            Nesting nesting(*this);
+            do {
+                arguments.push_back(expression());
+                argumentsHeight = std::max(argumentsHeight, height);
+            } while (match(COMMA));
+        }
+        consume(RIGHT_PAREN, "Expect ')' after arguments.");
+
+        auto call = nested(std::make_unique<CallExpr>(std::move(name), std::move(arguments), prev().line),
+                           argumentsHeight);
+        unresolvedCalls.push_back({call.get(), nameTokenIndex});
+        return call;
+    }
+
+    expr_ptr Parser::fileNumber(const std::string &keyword) {
+        consume(HASH, keyword + " expects '#' before file number.");
+        return expression();
+    }
+
+    stmt_ptr Parser::openStmt() {
+        expr_ptr path = expression();
+        consumeWord("for", "FOR keyword expected after OPEN file path.");
+        bool forOutput = false;
+        if (matchWord("output")) {
+            forOutput = true;
+        } else {
+            consume(INPUT, "INPUT or OUTPUT keyword expected after OPEN FOR.");
+        }
+        consumeWord("as", "AS keyword expected after OPEN file mode.");
+        expr_ptr number = fileNumber("OPEN");
+        return std::make_unique<OpenStmt>(std::move(path), forOutput, std::move(number), prev().line);
+    }
+
+    stmt_ptr Parser::readLineStmt() {
+        expr_ptr number = fileNumber("READLINE");
+        consume(COMMA, "READLINE expects two parameters separated by comma.");
+        Token dstVarToken = consume(IDENTIFIER, "READLINE second parameter must be variable identifier.");
+        VarRef dstVar = variable(dstVarToken);
+        return std::make_unique<ReadLineStmt>(std::move(number), std::move(dstVar), prev().line);
+    }
+
+    stmt_ptr Parser::writeStmt() {
+        expr_ptr number = fileNumber("WRITE");
+        consume(COMMA, "WRITE expects two parameters separated by comma.");
+        expr_ptr value = expression();
+        return std::make_unique<WriteStmt>(std::move(number), std::move(value), prev().line);
+    }
+
+    stmt_ptr Parser::returnStmt() {
+        if (!functionLocals) throwErrorAtToken(currentTokenIndex - 1, "RETURN is only allowed in FUNCTION.");
+
+        // Statements never start with a token that can start an expression
+        std::optional<expr_ptr> value = std::nullopt;
+        if (check(NUMBER) || check(STRING) || check(BOOLEAN) || (check(IDENTIFIER) && !statementAhead())
+            || check(LEFT_PAREN) || check(MINUS) || check(NOT)) {
+            value = expression();
+        }
+        return std::make_unique<ReturnStmt>(std::move(value), prev().line);
+    }
+
+    // Calls can precede the function definition, so they are resolved after the whole program is parsed
+    void Parser::resolveCalls() {
+        for (auto &[call, nameTokenIndex]: unresolvedCalls) {
+            auto function = functions.find(call->name);
+            if (function == functions.end()) {
+                throwErrorAtToken(nameTokenIndex, "Function '" + call->name + "' is not defined.");
+            }
+            if (call->arguments.size() != function->second->parameterCount) {
+                throwErrorAtToken(nameTokenIndex, "Function '" + call->name + "' expects "
+                                                  + std::to_string(function->second->parameterCount) + " arguments.");
+            }
+            call->function = function->second;
+        }
+        unresolvedCalls.clear();
+    }
+    
     // Parse all the statements
     std::unique_ptr<std::vector<stmt_ptr>> Parser::parse() {
         std::unique_ptr<std::vector<stmt_ptr>> statements = std::make_unique<std::vector<stmt_ptr>>();
 
         while (!isAtEnd()) {
-            stmt_ptr stmt = declaration();
+            stmt_ptr stmt = matchWord("function") ? functionDeclaration() : declaration();
             statements->push_back(std::move(stmt));
         }
+        resolveCalls();
+
+        return statements;
+    }
+
+    std::vector<Parser::TopLevelStatement> Parser::parseTopLevel() {
+        std::vector<TopLevelStatement> statements;
+        size_t callCount = unresolvedCalls.size();
+
+        while (!isAtEnd()) {
+            uint32_t firstTokenIndex = currentTokenIndex;
+            uint32_t firstLine = cur().line;
+            stmt_ptr stmt = matchWord("function") ? functionDeclaration() : declaration();
+
+            std::vector<CallExpr *> calls;
+            for (size_t i = callCount; i < unresolvedCalls.size(); i++) calls.push_back(unresolvedCalls[i].first);
+            callCount = unresolvedCalls.size();
+            statements.push_back({std::move(stmt), firstLine, prev().line, currentTokenIndex - firstTokenIndex,
+                                  std::move(calls)});
+        }
 
         return statements;
     }
@@ -3,6 +3,8 @@
 
 #include <vector>
 #include <memory>
+#include <string_view>
+#include <unordered_map>
 #include "Tokenization.hpp"
 #include "ExpressionsStatements.hpp"
 
@@ -10,10 +12,50 @@ namespace Parsing {
     class ParsingError : public std::exception {};
 
     class Parser {
+    public:
+        // Deepest nesting of blocks and expressions the default thread stack can parse, type and interpret
+        static constexpr uint32_t defaultMaxDepth = 1000;
+
     private:
+        static const std::map<std::string, ExprStmt::ArrayFunctionExpr::Function> arrayFunctions;
+
+        struct StringFunction {
+            ExprStmt::StringFunctionExpr::Function function;
+            uint32_t minArguments;
+            uint32_t maxArguments;
+        };
+
+        static const std::map<std::string, StringFunction> stringFunctions;
+
         std::unique_ptr<std::vector<Tokenization::Token>> tokens;
         uint32_t currentTokenIndex = 0;
 
+        // Every pass over the AST recurses, so nesting is limited to what the stack of the thread can hold.
+        // `depth` counts blocks and expressions being parsed around the current token, `height` is the height
+        // of the expression parsed last, their sum is checked against maxDepth. `deepest` is the highest sum
+        // reached, the nesting height of a FUNCTION body.
+        uint32_t maxDepth;
+        uint32_t depth = 0;
+        uint32_t height = 0;
+        uint32_t deepest = 0;
+
+        // Counts one level of recursion for its lifetime
+        struct Nesting {
+            Parser &parser;
+
+            explicit Nesting(Parser &parser);
+
+            ~Nesting() { parser.depth--; }
+        };
+
+        // Slots of local variables of the FUNCTION being parsed, nullptr outside of functions
+        std::map<std::string, int32_t> *functionLocals = nullptr;
+        std::map<std::string, ExprStmt::FunctionStmt *> functions;
+        // Pool of string literals, equal literals share one value, so evaluating them copies only a pointer
+        std::unordered_map<std::string, Values::RcString> constants;
+        // Calls and index of their function name token
+        std::vector<std::pair<ExprStmt::CallExpr *, uint32_t>> unresolvedCalls;
+
         uint32_t errorTokenIndex;
         std::string errorMessage;
 
@@ -49,6 +91,14 @@ namespace Parsing {
         
         ExprStmt::stmt_ptr letDeclaration();
         
+        ExprStmt::stmt_ptr dimStmt();
+        
+        ExprStmt::stmt_ptr mapStmt();
+        
+        ExprStmt::stmt_ptr putStmt();
+        
+        ExprStmt::stmt_ptr getStmt();
+        
         ExprStmt::stmt_ptr toNumStmt();
         
         ExprStmt::stmt_ptr rndStmt();
@@ -59,11 +109,47 @@ namespace Parsing {
         
         ExprStmt::stmt_ptr whileStmt();
         
+        ExprStmt::stmt_ptr parallelForStmt();
+        
+        ExprStmt::stmt_ptr functionDeclaration();
+        
+        std::unique_ptr<ExprStmt::CallExpr> callExpr();
+
+        // Arguments in parentheses after the name of a string function
+        ExprStmt::expr_ptr stringFunctionExpr(const StringFunction &function, const std::string &name);
+        
+        ExprStmt::stmt_ptr returnStmt();
+
+        // `#number` of file statements
+        ExprStmt::expr_ptr fileNumber(const std::string &keyword);
+
+        ExprStmt::stmt_ptr openStmt();
+
+        ExprStmt::stmt_ptr readLineStmt();
+
+        ExprStmt::stmt_ptr writeStmt();
+        
+        ExprStmt::VarRef variable(const Tokenization::Token &token);
+
+        // Sets height of expr one above its highest operand, throws when it is nested too deep
+        template<typename T>
+        std::unique_ptr<T> nested(std::unique_ptr<T> &&expr, uint32_t operandHeight);
+        
         // Helper functions
         template<typename... Args>
         bool match(Args... types);  // Check if current token type is any of types
         
         bool check(Tokenization::TokenType);  // Check if current token is of type
+
+        bool checkWord(std::string_view word);  // Check if current token is identifier `word` in any case
+
+        bool matchWord(std::string_view word);  // checkWord(), and advance if it is
+
+        void consumeWord(std::string_view word, std::string &&message);  // matchWord(), but throws if it is not
+
+        bool statementAhead();  // Check if current token starts a statement rather than an expression
+
+        bool callAhead();  // Check if current token is CALL of a function rather than a variable
         
         Tokenization::Token &advance();  // Return cur token and advance
         
@@ -78,14 +164,38 @@ namespace Parsing {
         Tokenization::Token &prev();
 
         // Error handling
-        void throwErrorAtCurrentToken(std::string &&message);
+        [[noreturn]] void throwErrorAtCurrentToken(std::string &&message);
+        
+        [[noreturn]] void throwErrorAtToken(uint32_t tokenIndex, std::string &&message);
+
+        [[noreturn]] void throwNestingError();
         
         void synchronize();
 
     public:
-        explicit Parser(std::unique_ptr<std::vector<Tokenization::Token>> &&tokens) : tokens(std::move(tokens)) {}
+        // Top level statement with the lines of its first and last token and its calls, not resolved yet
+        struct TopLevelStatement {
+            ExprStmt::stmt_ptr statement;
+            uint32_t firstLine;
+            uint32_t lastLine;
+            uint32_t tokenCount;
+            std::vector<ExprStmt::CallExpr *> calls;
+        };
+
+        explicit Parser(std::unique_ptr<std::vector<Tokenization::Token>> &&tokens, uint32_t maxDepth = defaultMaxDepth)
+            : tokens(std::move(tokens)), maxDepth(maxDepth) {}
 
         std::unique_ptr<std::vector<ExprStmt::stmt_ptr>> parse();
+
+        // Parses statements like parse() without resolving calls, so a part of a program can be parsed apart
+        // from the rest of it and linked by the caller
+        std::vector<TopLevelStatement> parseTopLevel();
+
+        // Links calls parsed so far to functions, throws ParsingError for unknown function or wrong argument count
+        void resolveCalls();
+
+        // Whether parsing stopped at the EOF token, parse() leaves a single token before it unparsed
+        bool parsedAll() { return cur().type == Tokenization::EOF_TOKEN; }
         
         std::string &getErrorMessage();
 
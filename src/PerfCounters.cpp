@@ -0,0 +1,119 @@
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "PerfCounters.hpp"
+
+namespace Timing {
+    static perf_event_attr eventAttributes(Counter counter) {
+        perf_event_attr attributes{};
+        attributes.size = sizeof(attributes);
+        attributes.type = PERF_TYPE_HARDWARE;
+        switch (counter) {
+            case CYCLES:
+                attributes.config = PERF_COUNT_HW_CPU_CYCLES;
+                break;
+            case INSTRUCTIONS:
+                attributes.config = PERF_COUNT_HW_INSTRUCTIONS;
+                break;
+            case L1D_MISSES:
+                attributes.type = PERF_TYPE_HW_CACHE;
+                attributes.config = PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8
+                                    | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+                break;
+            case LLC_MISSES:
+                attributes.type = PERF_TYPE_HW_CACHE;
+                attributes.config = PERF_COUNT_HW_CACHE_LL | PERF_COUNT_HW_CACHE_OP_READ << 8
+                                    | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+                break;
+            case BRANCH_MISSES:
+                attributes.config = PERF_COUNT_HW_BRANCH_MISSES;
+                break;
+            case COUNTER_COUNT:
+                break;
+        }
+        attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        // Kernel and hypervisor are excluded, so the default perf_event_paranoid level allows counting
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        return attributes;
+    }
+
+    PerfCounters::PerfCounters() {
+        int firstErrno = 0;
+        bool any = false;
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            perf_event_attr attributes = eventAttributes(static_cast<Counter>(i));
+            fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+            if (fds[i] >= 0) {
+                any = true;
+            } else if (firstErrno == 0) {
+                firstErrno = errno;
+            }
+        }
+        if (any) return;
+        error = std::strerror(firstErrno);
+        if (firstErrno == EACCES || firstErrno == EPERM) {
+            error += " (perf_event_paranoid or container does not allow counting)";
+        } else if (firstErrno == ENOENT || firstErrno == ENODEV || firstErrno == EOPNOTSUPP) {
+            error += " (no hardware counters, eg. in a virtual machine)";
+        }
+    }
+
+    PerfCounters::~PerfCounters() {
+        for (int fd: fds) {
+            if (fd >= 0) close(fd);
+        }
+    }
+
+    const char *PerfCounters::name(Counter counter) {
+        switch (counter) {
+            case CYCLES: return "cycles";
+            case INSTRUCTIONS: return "instructions";
+            case L1D_MISSES: return "L1d misses";
+            case LLC_MISSES: return "LLC misses";
+            case BRANCH_MISSES: return "branch misses";
+            case COUNTER_COUNT: break;
+        }
+        return "";
+    }
+
+    CounterValues PerfCounters::read() const {
+        CounterValues values{};
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            if (fds[i] < 0) continue;
+            struct {
+                uint64_t value;
+                uint64_t timeEnabled;
+                uint64_t timeRunning;
+            } result;
+            if (::read(fds[i], &result, sizeof(result)) != sizeof(result) || result.timeRunning == 0) continue;
+            values[i] = result.timeRunning < result.timeEnabled
+                        ? static_cast<uint64_t>(static_cast<double>(result.value) * result.timeEnabled
+                                                / result.timeRunning)
+                        : result.value;
+        }
+        return values;
+    }
+
+    void PerfCounters::addStatement(size_t index, uint32_t line, const CounterValues &start,
+                                    const CounterValues &end) {
+        if (index >= statements.size()) statements.resize(index + 1, {0});
+        StatementCounters &statement = statements[index];
+        statement.line = line;
+        statement.executions++;
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            // Scaled values of multiplexed counters are estimates and may go back slightly
+            if (end[i] > start[i]) statement.values[i] += end[i] - start[i];
+        }
+    }
+
+    std::vector<StatementCounters> PerfCounters::getStatements() const {
+        std::vector<StatementCounters> executed;
+        for (auto &statement: statements) {
+            if (statement.executions > 0) executed.push_back(statement);
+        }
+        return executed;
+    }
+}
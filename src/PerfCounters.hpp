@@ -0,0 +1,69 @@
+#ifndef BASICPLUSPLUS_PERFCOUNTERS_HPP
+#define BASICPLUSPLUS_PERFCOUNTERS_HPP
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Timing {
+    // Hardware events counted by PerfCounters, in report order
+    enum Counter {
+        CYCLES,
+        INSTRUCTIONS,
+        L1D_MISSES,
+        LLC_MISSES,
+        BRANCH_MISSES,
+        COUNTER_COUNT
+    };
+
+    using CounterValues = std::array<uint64_t, COUNTER_COUNT>;
+
+    // Events counted while a top level statement ran, summed over its executions
+    struct StatementCounters {
+        uint32_t line;
+        uint64_t executions = 0;
+        CounterValues values{};
+    };
+
+    // Hardware performance counters of the thread that opens them read with Linux `perf_event_open`, user space only.
+    // PARALLEL FOR chunks run by pool workers are not counted, an inherited counter would add a worker only when it
+    // exits, and the workers live as long as the process. Every event is opened on its own, events the host does not
+    // count are left out. Without any event, eg. in a container or virtual machine without PMU access, nothing is
+    // counted and `getError` tells why.
+    class PerfCounters {
+    private:
+        std::array<int, COUNTER_COUNT> fds;
+        std::string error;
+        // Indexed by top level statement
+        std::vector<StatementCounters> statements;
+
+    public:
+        PerfCounters();
+
+        ~PerfCounters();
+
+        PerfCounters(const PerfCounters &) = delete;
+
+        PerfCounters &operator=(const PerfCounters &) = delete;
+
+        static const char *name(Counter counter);
+
+        bool available() const { return error.empty(); }
+
+        bool counts(Counter counter) const { return fds[counter] >= 0; }
+
+        const std::string &getError() const { return error; }
+
+        // Totals since the counters were opened, scaled up when the kernel multiplexed them with other events
+        CounterValues read() const;
+
+        // Adds events counted by one execution of top level statement `index`
+        void addStatement(size_t index, uint32_t line, const CounterValues &start, const CounterValues &end);
+
+        // Statements that were executed, in program order
+        std::vector<StatementCounters> getStatements() const;
+    };
+}
+
+#endif //BASICPLUSPLUS_PERFCOUNTERS_HPP
@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <format>
+#include <istream>
+#include "Profiler.hpp"
+
+using namespace ExprStmt;
+
+namespace Profiling {
+    // Resolves statement kind name for the reports
+    class StmtKindVisitor : public AbstractStmtVisitor {
+    public:
+        const char *name = "?";
+
+        void visit(PrintStmt &stmt) override { name = "PRINT"; }
+        void visit(InputStmt &stmt) override { name = "INPUT"; }
+        void visit(LetStmt &stmt) override { name = "LET"; }
+        void visit(ArrayLetStmt &stmt) override { name = "LET"; }
+        void visit(DimStmt &stmt) override { name = "DIM"; }
+        void visit(MapStmt &stmt) override { name = "MAP"; }
+        void visit(PutStmt &stmt) override { name = "PUT"; }
+        void visit(GetStmt &stmt) override { name = stmt.op.type == Tokenization::HAS ? "HAS" : "GET"; }
+        void visit(ToNumStmt &stmt) override { name = "TONUM"; }
+        void visit(ToStrStmt &stmt) override { name = "TOSTR"; }
+        void visit(RndStmt &stmt) override { name = "RND"; }
+        void visit(BlockStmt &stmt) override { name = "BLOCK"; }
+        void visit(IfStmt &stmt) override { name = "IF"; }
+        void visit(WhileStmt &stmt) override { name = "WHILE"; }
+        void visit(ParallelForStmt &stmt) override { name = "PARALLEL FOR"; }
+        void visit(FunctionStmt &stmt) override { name = "FUNCTION"; }
+        void visit(CallStmt &stmt) override { name = "CALL"; }
+        void visit(ReturnStmt &stmt) override { name = "RETURN"; }
+        void visit(ContinueStmt &stmt) override { name = "CONTINUE"; }
+        void visit(BreakStmt &stmt) override { name = "BREAK"; }
+        void visit(OpenStmt &stmt) override { name = "OPEN"; }
+        void visit(ReadLineStmt &stmt) override { name = "READLINE"; }
+        void visit(WriteStmt &stmt) override { name = "WRITE"; }
+        void visit(CloseStmt &stmt) override { name = "CLOSE"; }
+    };
+
+    const char *Profiler::kindName(Stmt &stmt) {
+        StmtKindVisitor visitor;
+        stmt.accept(visitor);
+        return visitor.name;
+    }
+
+    Profiler::Profiler(uint32_t samplePeriod) : samplePeriod(std::max(samplePeriod, 1u)),
+                                                untilSample(this->samplePeriod),
+                                                lastSample(std::chrono::steady_clock::now()) {}
+
+    ProfileEntry &Profiler::lineEntry(uint32_t line) {
+        if (line >= lines.size()) lines.resize(line + 1);
+        return lines[line];
+    }
+
+    void Profiler::enter(Stmt &stmt) {
+        const char *kind = kindName(stmt);
+        lineEntry(stmt.line).count++;
+        kinds[kind].count++;
+        stack.push_back({stmt.line, kind});
+        if (--untilSample == 0) sample();
+    }
+
+    void Profiler::sample() {
+        untilSample = samplePeriod;
+
+        auto now = std::chrono::steady_clock::now();
+        uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastSample).count();
+        lastSample = now;
+        if (stack.empty()) return;
+
+        lineEntry(stack.back().line).exclusiveNs += elapsed;
+        kinds[stack.back().kind].exclusiveNs += elapsed;
+
+        // Inclusive time is counted once per line / kind even when it is on the stack multiple times
+        std::string collapsed;
+        for (size_t i = 0; i < stack.size(); i++) {
+            const Frame &frame = stack[i];
+            bool lineSeen = false;
+            bool kindSeen = false;
+            for (size_t j = 0; j < i; j++) {
+                lineSeen |= stack[j].line == frame.line;
+                kindSeen |= stack[j].kind == frame.kind;
+            }
+            if (!lineSeen) lineEntry(frame.line).inclusiveNs += elapsed;
+            if (!kindSeen) kinds[frame.kind].inclusiveNs += elapsed;
+
+            if (i > 0) collapsed.push_back(';');
+            collapsed += std::format("{} (line {})", frame.kind, frame.line);
+        }
+        collapsedStacks[collapsed] += elapsed;
+    }
+
+    void Profiler::finish() {
+        sample();
+    }
+
+    void Profiler::writeListing(std::istream &source, std::ostream &out) const {
+        uint64_t totalNs = 0;
+        for (auto &[kind, entry]: kinds) totalNs += entry.exclusiveNs;
+
+        out << std::format("{:>10} {:>12} {:>12} {:>6}  {}\n", "count", "incl ms", "excl ms", "excl%", "source");
+
+        std::string sourceLine;
+        uint32_t lineNumber = 1;
+        ProfileEntry empty;
+        while (std::getline(source, sourceLine)) {
+            const ProfileEntry &entry = lineNumber < lines.size() ? lines[lineNumber] : empty;
+            if (entry.count == 0) {
+                out << std::format("{:>10} {:>12} {:>12} {:>6}  {:>4}| {}\n", "", "", "", "", lineNumber, sourceLine);
+            } else {
+                double percent = totalNs ? 100.0 * entry.exclusiveNs / totalNs : 0;
+                out << std::format("{:>10} {:>12.3f} {:>12.3f} {:>5.1f}%  {:>4}| {}\n", entry.count,
+                                   entry.inclusiveNs / 1e6, entry.exclusiveNs / 1e6, percent, lineNumber, sourceLine);
+            }
+            lineNumber++;
+        }
+
+        out << "\nPer statement kind:\n";
+        out << std::format("{:<12} {:>12} {:>12} {:>12}\n", "kind", "count", "incl ms", "excl ms");
+        std::vector<std::pair<std::string, ProfileEntry>> sortedKinds(kinds.begin(), kinds.end());
+        std::sort(sortedKinds.begin(), sortedKinds.end(), [](auto &a, auto &b) {
+            return a.second.exclusiveNs > b.second.exclusiveNs;
+        });
+        for (auto &[kind, entry]: sortedKinds) {
+            out << std::format("{:<12} {:>12} {:>12.3f} {:>12.3f}\n", kind, entry.count,
+                               entry.inclusiveNs / 1e6, entry.exclusiveNs / 1e6);
+        }
+        out << std::format("\nSampled every {} statements, {:.3f} ms total.\n", samplePeriod, totalNs / 1e6);
+    }
+
+    void Profiler::writeCollapsed(std::ostream &out) const {
+        for (auto &[stack, ns]: collapsedStacks) {
+            if (ns > 0) out << stack << ' ' << ns << '\n';
+        }
+    }
+}
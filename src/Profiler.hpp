@@ -0,0 +1,64 @@
+#ifndef BASICPLUSPLUS_PROFILER_HPP
+#define BASICPLUSPLUS_PROFILER_HPP
+
+#include <chrono>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "ExpressionsStatements.hpp"
+
+namespace Profiling {
+    // Per source line / per statement kind totals
+    struct ProfileEntry {
+        uint64_t count = 0;        // Number of executions
+        uint64_t inclusiveNs = 0;  // Sampled time spent in the statement including nested statements
+        uint64_t exclusiveNs = 0;  // Sampled time spent in the statement itself
+    };
+
+    // Counts every executed statement and every `samplePeriod` statements attributes the elapsed
+    // wall-clock time to the statements currently on the execution stack.
+    class Profiler {
+    private:
+        struct Frame {
+            uint32_t line;
+            const char *kind;
+        };
+
+        uint32_t samplePeriod;
+        uint32_t untilSample;
+        std::chrono::steady_clock::time_point lastSample;
+        std::vector<Frame> stack;
+
+        std::vector<ProfileEntry> lines;  // Indexed by line number
+        std::map<const char *, ProfileEntry> kinds;
+        std::map<std::string, uint64_t> collapsedStacks;  // "frame;frame;frame" -> ns
+
+        void sample();
+
+        ProfileEntry &lineEntry(uint32_t line);
+
+        static const char *kindName(ExprStmt::Stmt &stmt);
+
+    public:
+        explicit Profiler(uint32_t samplePeriod = 64);
+
+        // Called by the interpreter around every executed statement
+        void enter(ExprStmt::Stmt &stmt);
+
+        void leave() {
+            stack.pop_back();
+        }
+
+        // Attribute time since the last sample, call before writing the reports
+        void finish();
+
+        // Source listing annotated with counts and times, followed by a per statement kind summary
+        void writeListing(std::istream &source, std::ostream &out) const;
+
+        // Collapsed stacks in the format `flamegraph.pl` reads
+        void writeCollapsed(std::ostream &out) const;
+    };
+}
+
+#endif //BASICPLUSPLUS_PROFILER_HPP
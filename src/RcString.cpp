@@ -0,0 +1,54 @@
+#include <functional>
+#include <new>
+#include "RcString.hpp"
+
+namespace Values {
+    char *RcString::allocate(size_t size) {
+        if (size <= inlineCapacity) {
+            tag = static_cast<uint8_t>(size);
+            return bytes;
+        }
+        auto *heap = static_cast<Block *>(::operator new(sizeof(Block) + size));
+        new(heap) Block{{1}, {0}, size, heap->own(), nullptr};
+        std::memcpy(bytes, &heap, sizeof(heap));
+        tag = heapTag;
+        return heap->own();
+    }
+
+    void RcString::deallocate(Block *block) {
+        Block *owner = block->owner;
+        block->~Block();
+        ::operator delete(block);
+        if (owner && owner->references.fetch_sub(1, std::memory_order_acq_rel) == 1) deallocate(owner);
+    }
+
+    uint64_t RcString::computeHash(std::string_view text) {
+        // 0 marks a hash not computed yet
+        uint64_t hash = std::hash<std::string_view>{}(text);
+        return hash != 0 ? hash : 1;
+    }
+
+    RcString RcString::slice(const RcString &source, size_t offset, size_t length) {
+        if (length == source.size()) return source;
+        if (length <= inlineCapacity) return RcString(source.view().substr(offset, length));
+        // Slices of slices point to the block holding the characters, they share them only when they are at least
+        // half of that block, however many times the string was cut
+        Block *owner = source.block()->owner ? source.block()->owner : source.block();
+        if (length < owner->size / 2) return RcString(source.view().substr(offset, length));
+        owner->references.fetch_add(1, std::memory_order_relaxed);
+        auto *heap = static_cast<Block *>(::operator new(sizeof(Block)));
+        new(heap) Block{{1}, {0}, length, source.data() + offset, owner};
+        RcString result;
+        std::memcpy(result.bytes, &heap, sizeof(heap));
+        result.tag = heapTag;
+        return result;
+    }
+
+    RcString RcString::concat(std::string_view left, std::string_view right) {
+        RcString result;
+        char *data = result.allocate(left.size() + right.size());
+        left.copy(data, left.size());
+        right.copy(data + left.size(), right.size());
+        return result;
+    }
+}
@@ -0,0 +1,154 @@
+#ifndef BASICPLUSPLUS_RCSTRING_HPP
+#define BASICPLUSPLUS_RCSTRING_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace Values {
+    // Immutable string value of the interpreter. Strings up to `inlineCapacity` bytes are stored inside the object,
+    // longer ones in a heap block shared by all copies, so copying a value is at most a reference count increment.
+    // The block caches the hash of the string, equal strings are found by pointer identity, length and hash before
+    // their bytes are compared. References are counted atomically, values cross PARALLEL FOR threads.
+    // A long slice of a heap string is a block pointing into the characters of the block it was cut from.
+    class RcString {
+    public:
+        static constexpr size_t inlineCapacity = 15;
+
+    private:
+        struct Block {
+            std::atomic<uint64_t> references;
+            std::atomic<uint64_t> hash;  // 0 until computed
+            size_t size;
+            const char *chars;  // Right after the block, or in owner
+            Block *owner;       // Block holding the characters of a slice, nullptr when they follow this one
+
+            char *own() { return reinterpret_cast<char *>(this + 1); }
+        };
+
+        static constexpr uint8_t heapTag = 0xFF;
+
+        // Characters, or the Block pointer in the first bytes
+        alignas(Block *) char bytes[inlineCapacity];
+        // Inline length, heapTag for heap block
+        uint8_t tag = 0;
+
+        Block *block() const {
+            Block *result;
+            std::memcpy(&result, bytes, sizeof(result));
+            return result;
+        }
+
+        void retain() const {
+            if (tag == heapTag) block()->references.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void release() {
+            if (tag == heapTag && block()->references.fetch_sub(1, std::memory_order_acq_rel) == 1) deallocate(block());
+        }
+
+        // Uninitialized characters of the given length
+        char *allocate(size_t size);
+
+        static void deallocate(Block *block);
+
+        static uint64_t computeHash(std::string_view text);
+
+    public:
+        RcString() = default;
+
+        RcString(std::string_view text) { text.copy(allocate(text.size()), text.size()); }
+
+        RcString(const std::string &text) : RcString(std::string_view(text)) {}
+
+        RcString(const char *text) : RcString(std::string_view(text)) {}
+
+        RcString(const RcString &other) : tag(other.tag) {
+            std::memcpy(bytes, other.bytes, sizeof(bytes));
+            retain();
+        }
+
+        RcString(RcString &&other) noexcept : tag(other.tag) {
+            std::memcpy(bytes, other.bytes, sizeof(bytes));
+            other.tag = 0;
+        }
+
+        RcString &operator=(const RcString &other) {
+            other.retain();
+            release();
+            std::memcpy(bytes, other.bytes, sizeof(bytes));
+            tag = other.tag;
+            return *this;
+        }
+
+        RcString &operator=(RcString &&other) noexcept {
+            if (this != &other) {
+                release();
+                std::memcpy(bytes, other.bytes, sizeof(bytes));
+                tag = other.tag;
+                other.tag = 0;
+            }
+            return *this;
+        }
+
+        ~RcString() { release(); }
+
+        static RcString concat(std::string_view left, std::string_view right);
+
+        // Characters from offset of length, within source. Slices of at least half of the block holding the characters
+        // of a heap string share them, so a kept slice holds at most twice its size. Shorter ones are copied.
+        static RcString slice(const RcString &source, size_t offset, size_t length);
+
+        // String of size characters written by fill(char *data)
+        template<class Fill>
+        static RcString filled(size_t size, Fill fill) {
+            RcString result;
+            fill(result.allocate(size));
+            return result;
+        }
+
+        size_t size() const { return tag == heapTag ? block()->size : tag; }
+
+        bool empty() const { return tag == 0; }
+
+        const char *data() const { return tag == heapTag ? block()->chars : bytes; }
+
+        std::string_view view() const { return {data(), size()}; }
+
+        operator std::string_view() const { return view(); }
+
+        std::string str() const { return std::string(view()); }
+
+        // Hash of the text, the same for equal strings, cached for heap strings
+        uint64_t hash() const {
+            if (tag != heapTag) return computeHash(view());
+            uint64_t cached = block()->hash.load(std::memory_order_relaxed);
+            if (cached == 0) {
+                cached = computeHash(view());
+                block()->hash.store(cached, std::memory_order_relaxed);
+            }
+            return cached;
+        }
+
+        friend bool operator==(const RcString &a, const RcString &b) {
+            // Strings of the inline length are always inline, so different tags mean different lengths
+            if (a.tag != b.tag) return false;
+            if (a.tag != heapTag) return std::memcmp(a.bytes, b.bytes, a.tag) == 0;
+            Block *left = a.block();
+            Block *right = b.block();
+            if (left == right) return true;
+            if (left->size != right->size) return false;
+            uint64_t leftHash = left->hash.load(std::memory_order_relaxed);
+            uint64_t rightHash = right->hash.load(std::memory_order_relaxed);
+            if (leftHash != 0 && rightHash != 0 && leftHash != rightHash) return false;
+            return std::memcmp(left->chars, right->chars, left->size) == 0;
+        }
+
+        friend std::ostream &operator<<(std::ostream &out, const RcString &string) { return out << string.view(); }
+    };
+}
+
+#endif //BASICPLUSPLUS_RCSTRING_HPP
@@ -0,0 +1,98 @@
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include "Strings.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BASICPLUSPLUS_SIMD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BASICPLUSPLUS_SIMD_SSE2
+#endif
+
+namespace Values::Strings {
+    // Thin wrappers so the kernels below are written once for every vector width
+#if defined(BASICPLUSPLUS_SIMD_AVX2)
+    using Vec = __m256i;
+    static constexpr size_t width = 32;
+    static inline Vec load(const char *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+    static inline void store(char *p, Vec v) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v); }
+    static inline Vec broadcast(char c) { return _mm256_set1_epi8(c); }
+    static inline Vec equal(Vec a, Vec b) { return _mm256_cmpeq_epi8(a, b); }
+    static inline Vec greater(Vec a, Vec b) { return _mm256_cmpgt_epi8(a, b); }
+    static inline Vec both(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+    static inline Vec add(Vec a, Vec b) { return _mm256_add_epi8(a, b); }
+    static inline Vec flip(Vec a, Vec b) { return _mm256_xor_si256(a, b); }
+    static inline uint32_t mask(Vec v) { return static_cast<uint32_t>(_mm256_movemask_epi8(v)); }
+#elif defined(BASICPLUSPLUS_SIMD_SSE2)
+    using Vec = __m128i;
+    static constexpr size_t width = 16;
+    static inline Vec load(const char *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+    static inline void store(char *p, Vec v) { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v); }
+    static inline Vec broadcast(char c) { return _mm_set1_epi8(c); }
+    static inline Vec equal(Vec a, Vec b) { return _mm_cmpeq_epi8(a, b); }
+    static inline Vec greater(Vec a, Vec b) { return _mm_cmpgt_epi8(a, b); }
+    static inline Vec both(Vec a, Vec b) { return _mm_and_si128(a, b); }
+    static inline Vec add(Vec a, Vec b) { return _mm_add_epi8(a, b); }
+    static inline Vec flip(Vec a, Vec b) { return _mm_xor_si128(a, b); }
+    static inline uint32_t mask(Vec v) { return static_cast<uint32_t>(_mm_movemask_epi8(v)); }
+#endif
+
+    size_t find(std::string_view text, std::string_view pattern, size_t from) {
+        if (from > text.size() || pattern.size() > text.size() - from) return std::string_view::npos;
+        if (pattern.empty()) return from;
+        if (pattern.size() == 1) {
+            const void *found = std::memchr(text.data() + from, pattern[0], text.size() - from);
+            return found ? static_cast<const char *>(found) - text.data() : std::string_view::npos;
+        }
+
+        const char *data = text.data();
+        size_t last = pattern.size() - 1;
+        // Positions a pattern can start at
+        size_t end = text.size() - last;
+        size_t i = from;
+#if defined(BASICPLUSPLUS_SIMD_AVX2) || defined(BASICPLUSPLUS_SIMD_SSE2)
+        Vec first = broadcast(pattern[0]);
+        Vec final = broadcast(pattern[last]);
+        for (; i + width <= end; i += width) {
+            uint32_t candidates = mask(both(equal(load(data + i), first), equal(load(data + i + last), final)));
+            while (candidates) {
+                size_t position = i + std::countr_zero(candidates);
+                if (std::memcmp(data + position + 1, pattern.data() + 1, last - 1) == 0) return position;
+                candidates &= candidates - 1;
+            }
+        }
+#endif
+        for (; i < end; i++) {
+            if (data[i] == pattern[0] && data[i + last] == pattern[last]
+                && std::memcmp(data + i + 1, pattern.data() + 1, last - 1) == 0) {
+                return i;
+            }
+        }
+        return std::string_view::npos;
+    }
+
+    // Flips case of the letters from `from` to `from` + 25
+    static void flipCase(const char *in, char *out, size_t n, char from) {
+        size_t i = 0;
+#if defined(BASICPLUSPLUS_SIMD_AVX2) || defined(BASICPLUSPLUS_SIMD_SSE2)
+        // Letters are moved to the bottom of the signed range, so one signed compare finds them
+        Vec shift = broadcast(static_cast<char>(-128 - from));
+        Vec letters = broadcast(static_cast<char>(-128 + 26));
+        Vec bit = broadcast(0x20);
+        for (; i + width <= n; i += width) {
+            Vec v = load(in + i);
+            store(out + i, flip(v, both(greater(letters, add(v, shift)), bit)));
+        }
+#endif
+        for (; i < n; i++) {
+            char c = in[i];
+            out[i] = c >= from && c <= from + 25 ? static_cast<char>(c ^ 0x20) : c;
+        }
+    }
+
+    void upper(const char *in, char *out, size_t n) { flipCase(in, out, n, 'a'); }
+
+    void lower(const char *in, char *out, size_t n) { flipCase(in, out, n, 'A'); }
+}
@@ -0,0 +1,22 @@
+#ifndef BASICPLUSPLUS_STRINGS_HPP
+#define BASICPLUSPLUS_STRINGS_HPP
+
+#include <cstddef>
+#include <string_view>
+
+namespace Values {
+    // SIMD kernels of the string built-ins, `out` may alias `in`
+    namespace Strings {
+        // Position of the first occurrence of pattern in text at or after from, npos when there is none.
+        // Compares the first and the last character of pattern at a vector of positions at once, the rest of pattern
+        // only where both match.
+        size_t find(std::string_view text, std::string_view pattern, size_t from);
+
+        // ASCII letters only, other bytes are copied
+        void upper(const char *in, char *out, size_t n);
+
+        void lower(const char *in, char *out, size_t n);
+    }
+}
+
+#endif //BASICPLUSPLUS_STRINGS_HPP
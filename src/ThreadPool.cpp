@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <pthread.h>
+#include <system_error>
+#include "ThreadPool.hpp"
+
+namespace Threading {
+    struct ThreadPool::TaskGroup {
+        const std::function<void(size_t)> &fn;
+        size_t remaining;
+        std::mutex mutex;
+        std::condition_variable done;
+        std::exception_ptr exception;
+
+        TaskGroup(const std::function<void(size_t)> &fn, size_t remaining) : fn(fn), remaining(remaining) {}
+    };
+
+    static std::atomic<size_t> stackSizeOfThreads = defaultStackSize;
+
+    void setThreadStackSize(size_t bytes) {
+        stackSizeOfThreads = bytes;
+    }
+
+    size_t threadStackSize() {
+        return stackSizeOfThreads;
+    }
+
+    // Thread
+    Thread::Thread(size_t stackSize, std::function<void()> fn) {
+        // Attributes of this thread only, the process wide defaults are left as they are
+        pthread_attr_t attributes;
+        int error = pthread_attr_init(&attributes);
+        if (error == 0) {
+            error = pthread_attr_setstacksize(&attributes, stackSize);
+            if (error == 0) {
+                auto start = [](void *argument) -> void * {
+                    std::unique_ptr<std::function<void()>> run(static_cast<std::function<void()> *>(argument));
+                    (*run)();
+                    return nullptr;
+                };
+                auto run = std::make_unique<std::function<void()>>(std::move(fn));
+                error = pthread_create(&handle, &attributes, start, run.get());
+                if (error == 0) run.release();
+            }
+            pthread_attr_destroy(&attributes);
+        }
+        if (error != 0) throw std::system_error(error, std::generic_category(), "Failed to start thread");
+        joinable = true;
+    }
+
+    void Thread::join() {
+        if (!joinable) return;
+        pthread_join(handle, nullptr);
+        joinable = false;
+    }
+
+    // Pool and queue index of the current worker thread
+    static thread_local ThreadPool *currentPool = nullptr;
+    static thread_local size_t currentWorker = 0;
+
+    ThreadPool::ThreadPool(unsigned threads) {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+        for (unsigned i = 0; i < threads; i++) {
+            queues.push_back(std::make_unique<WorkerQueue>());
+        }
+        for (unsigned i = 0; i < threads; i++) {
+            workers.emplace_back(threadStackSize(), [this, i] { workerLoop(i); });
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard lock(sleepMutex);
+            stopping = true;
+        }
+        sleepCondition.notify_all();
+        for (auto &worker: workers) worker.join();
+    }
+
+    void ThreadPool::workerLoop(size_t workerIndex) {
+        currentPool = this;
+        currentWorker = workerIndex;
+
+        while (true) {
+            Task task{};
+            if (popTask(workerIndex, task) || stealTask(workerIndex, task)) {
+                runTask(task);
+                continue;
+            }
+
+            std::unique_lock lock(sleepMutex);
+            sleepCondition.wait(lock, [this] { return stopping || queuedTasks > 0; });
+            if (stopping && queuedTasks == 0) return;
+        }
+    }
+
+    bool ThreadPool::popTask(size_t queueIndex, Task &task) {
+        WorkerQueue &queue = *queues[queueIndex];
+        std::lock_guard lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+
+        task = queue.tasks.back();
+        queue.tasks.pop_back();
+        queuedTasks--;
+        return true;
+    }
+
+    bool ThreadPool::stealTask(size_t thiefIndex, Task &task) {
+        for (size_t i = 1; i <= queues.size(); i++) {
+            WorkerQueue &queue = *queues[(thiefIndex + i) % queues.size()];
+            std::lock_guard lock(queue.mutex);
+            if (queue.tasks.empty()) continue;
+
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+            queuedTasks--;
+            return true;
+        }
+        return false;
+    }
+
+    void ThreadPool::runTask(Task &task) {
+        TaskGroup &group = *task.group;
+        try {
+            group.fn(task.index);
+        } catch (...) {
+            std::lock_guard lock(group.mutex);
+            if (!group.exception) group.exception = std::current_exception();
+        }
+
+        // Group lives on the stack of forEach caller, it must not be touched after the lock is released
+        std::lock_guard lock(group.mutex);
+        if (--group.remaining == 0) group.done.notify_all();
+    }
+
+    void ThreadPool::forEach(size_t count, const std::function<void(size_t)> &fn) {
+        if (count == 0) return;
+        if (count == 1) {
+            fn(0);
+            return;
+        }
+
+        TaskGroup group(fn, count);
+        bool isWorker = currentPool == this;
+
+        {
+            // Counted before pushing, so popping workers never see the counter below zero
+            std::lock_guard lock(sleepMutex);
+            queuedTasks += count;
+        }
+        // Worker keeps the tasks in its own queue for others to steal, external thread spreads them
+        for (size_t i = 0; i < count; i++) {
+            size_t queueIndex = isWorker ? currentWorker : i % queues.size();
+            std::lock_guard lock(queues[queueIndex]->mutex);
+            queues[queueIndex]->tasks.push_back({&group, i});
+        }
+        sleepCondition.notify_all();
+
+        // Help until there is nothing left to take, then wait for tasks running on other threads
+        size_t helperIndex = isWorker ? currentWorker : 0;
+        while (true) {
+            {
+                std::lock_guard lock(group.mutex);
+                if (group.remaining == 0) break;
+            }
+            Task task{};
+            if ((isWorker && popTask(helperIndex, task)) || stealTask(helperIndex, task)) {
+                runTask(task);
+            } else {
+                break;
+            }
+        }
+
+        std::unique_lock lock(group.mutex);
+        group.done.wait(lock, [&group] { return group.remaining == 0; });
+        if (group.exception) std::rethrow_exception(group.exception);
+    }
+
+    unsigned ThreadPool::size() const {
+        return workers.size();
+    }
+
+    ThreadPool &ThreadPool::shared() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    int runWithStack(size_t stackSize, const std::function<int()> &fn) {
+        setThreadStackSize(stackSize);
+        int result = 0;
+        std::exception_ptr exception;
+        Thread(stackSize, [&] {
+            try {
+                result = fn();
+            } catch (...) {
+                exception = std::current_exception();
+            }
+        }).join();
+        if (exception) std::rethrow_exception(exception);
+        return result;
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef BASICPLUSPLUS_THREADPOOL_HPP
+#define BASICPLUSPLUS_THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace Threading {
+    // Stack size of the threads the library starts: pool workers, daemon workers and runWithStack.
+    // The default is the usual main thread stack, which holds programs of the default nesting depth.
+    inline constexpr size_t defaultStackSize = 8 << 20;
+
+    void setThreadStackSize(size_t bytes);
+
+    size_t threadStackSize();
+
+    // Thread running fn on a stack of stackSize bytes, which std::thread can not set. Stack pages are committed only
+    // when touched. Throws std::system_error when the thread can not be started, the destructor joins it.
+    class Thread {
+    private:
+        pthread_t handle{};
+        bool joinable = false;
+
+    public:
+        Thread(size_t stackSize, std::function<void()> fn);
+
+        ~Thread() { join(); }
+
+        Thread(Thread &&other) noexcept : handle(other.handle), joinable(std::exchange(other.joinable, false)) {}
+
+        Thread &operator=(Thread &&) = delete;
+
+        void join();
+    };
+
+    // Work-stealing thread pool. Every worker owns a task deque, takes its own work from the back
+    // and steals from the front of the other workers' deques when it runs out of work.
+    class ThreadPool {
+    private:
+        struct TaskGroup;
+
+        struct Task {
+            TaskGroup *group;
+            size_t index;
+        };
+
+        struct WorkerQueue {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        std::vector<std::unique_ptr<WorkerQueue>> queues;
+        std::vector<Thread> workers;
+
+        std::mutex sleepMutex;
+        std::condition_variable sleepCondition;
+        std::atomic<size_t> queuedTasks = 0;
+        bool stopping = false;
+
+        void workerLoop(size_t workerIndex);
+
+        bool popTask(size_t queueIndex, Task &task);
+
+        bool stealTask(size_t thiefIndex, Task &task);
+
+        static void runTask(Task &task);
+
+    public:
+        // Pool with `threads` workers, hardware concurrency when 0
+        explicit ThreadPool(unsigned threads = 0);
+
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        // Runs fn(i) for every i in [0, count) and waits until all of them finished.
+        // The calling thread helps with the work, so nested calls from inside a task do not deadlock.
+        // First exception thrown by fn is rethrown after all tasks finished.
+        void forEach(size_t count, const std::function<void(size_t)> &fn);
+
+        unsigned size() const;
+
+        // Process wide pool with hardware concurrency workers
+        static ThreadPool &shared();
+    };
+
+    // Runs fn on a new thread with stack of stackSize bytes and returns its result, rethrows its exception.
+    // Threads the library starts afterwards, including the shared pool when it does not exist yet, get the same size.
+    int runWithStack(size_t stackSize, const std::function<int()> &fn);
+}
+
+#endif //BASICPLUSPLUS_THREADPOOL_HPP
@@ -0,0 +1,333 @@
+#include <algorithm>
+#include <format>
+#include "Timings.hpp"
+
+using namespace ExprStmt;
+
+namespace Timing {
+    Timings::Phase::~Phase() {
+        auto wallEnd = std::chrono::steady_clock::now();
+        std::clock_t cpuEnd = std::clock();
+        std::optional<CounterValues> counters;
+        if (countersStart) {
+            CounterValues end = timings.perfCounters->read();
+            counters.emplace();
+            for (int i = 0; i < COUNTER_COUNT; i++) {
+                (*counters)[i] = end[i] > (*countersStart)[i] ? end[i] - (*countersStart)[i] : 0;
+            }
+        }
+        timings.phases.push_back({
+            std::move(name),
+            std::chrono::duration<double, std::milli>(wallEnd - wallStart).count(),
+            1000.0 * (cpuEnd - cpuStart) / CLOCKS_PER_SEC,
+            counters
+        });
+    }
+
+    const PhaseTime *Timings::findPhase(const std::string &name) const {
+        for (auto &phase: phases) {
+            if (phase.name == name) return &phase;
+        }
+        return nullptr;
+    }
+
+    static double perSecond(uint64_t count, const PhaseTime *phase) {
+        if (!phase || phase->wallMs <= 0) return 0;
+        return count / (phase->wallMs / 1000.0);
+    }
+
+    void Timings::print(std::ostream &out) const {
+        double totalWall = 0;
+        double totalCpu = 0;
+
+        out << std::format("{:<12} {:>12} {:>12}\n", "phase", "wall ms", "cpu ms");
+        for (auto &phase: phases) {
+            out << std::format("{:<12} {:>12.3f} {:>12.3f}\n", phase.name, phase.wallMs, phase.cpuMs);
+            totalWall += phase.wallMs;
+            totalCpu += phase.cpuMs;
+        }
+        out << std::format("{:<12} {:>12.3f} {:>12.3f}\n", "total", totalWall, totalCpu);
+
+        out << std::format("source bytes: {}, tokens: {}, AST nodes: {}, statements executed: {}\n",
+                           sourceBytes, tokenCount, astNodeCount, statementsExecuted);
+        out << std::format("tokens/s: {:.0f}, statements/s: {:.0f}\n",
+                           perSecond(tokenCount, findPhase("tokenize")),
+                           perSecond(statementsExecuted, findPhase("interpret")));
+        if (perfCounters) printCounters(out);
+    }
+
+    static void printCounterRow(std::ostream &out, const std::string &label, const PerfCounters &perfCounters,
+                                const CounterValues &values) {
+        out << std::format("{:<12}", label);
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            if (perfCounters.counts(static_cast<Counter>(i))) out << std::format(" {:>14}", values[i]);
+            else out << std::format(" {:>14}", "-");
+            if (i != INSTRUCTIONS) continue;
+            // Instructions per cycle
+            if (perfCounters.counts(CYCLES) && perfCounters.counts(INSTRUCTIONS) && values[CYCLES]) {
+                out << std::format(" {:>6.2f}", static_cast<double>(values[INSTRUCTIONS]) / values[CYCLES]);
+            } else {
+                out << std::format(" {:>6}", "-");
+            }
+        }
+        out << '\n';
+    }
+
+    void Timings::printCounters(std::ostream &out) const {
+        if (!perfCounters) return;
+        if (!perfCounters->available()) {
+            out << "perf counters unavailable: " << perfCounters->getError() << '\n';
+            return;
+        }
+        out << std::format("{:<12}", "phase");
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            out << std::format(" {:>14}", PerfCounters::name(static_cast<Counter>(i)));
+            if (i == INSTRUCTIONS) out << std::format(" {:>6}", "IPC");
+        }
+        out << '\n';
+        for (auto &phase: phases) {
+            if (phase.counters) printCounterRow(out, phase.name, *perfCounters, *phase.counters);
+        }
+
+        std::vector<StatementCounters> statements = perfCounters->getStatements();
+        if (statements.empty()) return;
+        // Only the statements taking the most cycles, a program can have many cheap ones
+        constexpr size_t shownStatements = 20;
+        std::stable_sort(statements.begin(), statements.end(), [](auto &a, auto &b) {
+            return a.values[CYCLES] > b.values[CYCLES];
+        });
+        if (statements.size() > shownStatements) statements.resize(shownStatements);
+        out << "top level statements by cycles:\n";
+        for (auto &statement: statements) {
+            printCounterRow(out, "line " + std::to_string(statement.line), *perfCounters, statement.values);
+        }
+    }
+
+    // JSON object with counted events, uncounted are left out
+    static std::string countersJson(const PerfCounters &perfCounters, const CounterValues &values) {
+        static const char *keys[COUNTER_COUNT] = {"cycles", "instructions", "l1d_misses", "llc_misses",
+                                                  "branch_misses"};
+        std::string result = "{";
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            if (!perfCounters.counts(static_cast<Counter>(i))) continue;
+            if (result.size() > 1) result += ", ";
+            result += std::format("\"{}\": {}", keys[i], values[i]);
+        }
+        return result + "}";
+    }
+
+    void Timings::printJson(std::ostream &out) const {
+        out << "{\"phases\": [";
+        for (size_t i = 0; i < phases.size(); i++) {
+            out << (i ? ", " : "")
+                << std::format("{{\"name\": \"{}\", \"wall_ms\": {:.3f}, \"cpu_ms\": {:.3f}",
+                               phases[i].name, phases[i].wallMs, phases[i].cpuMs);
+            if (phases[i].counters) out << ", \"counters\": " << countersJson(*perfCounters, *phases[i].counters);
+            out << "}";
+        }
+        out << std::format("], \"source_bytes\": {}, \"tokens\": {}, \"ast_nodes\": {}, \"statements_executed\": {}, "
+                           "\"tokens_per_second\": {:.0f}, \"statements_per_second\": {:.0f}",
+                           sourceBytes, tokenCount, astNodeCount, statementsExecuted,
+                           perSecond(tokenCount, findPhase("tokenize")),
+                           perSecond(statementsExecuted, findPhase("interpret")));
+        if (perfCounters && perfCounters->available()) {
+            out << ", \"statement_counters\": [";
+            std::vector<StatementCounters> statements = perfCounters->getStatements();
+            for (size_t i = 0; i < statements.size(); i++) {
+                out << (i ? ", " : "")
+                    << std::format("{{\"line\": {}, \"executions\": {}, \"counters\": {}}}", statements[i].line,
+                                   statements[i].executions, countersJson(*perfCounters, statements[i].values));
+            }
+            out << "]";
+        } else if (perfCounters) {
+            out << std::format(", \"counters_error\": \"{}\"", perfCounters->getError());
+        }
+        out << "}\n";
+    }
+
+    // Counts nodes of the AST
+    class NodeCounter : public AbstractExprVisitor, public AbstractStmtVisitor {
+    public:
+        uint64_t count = 0;
+
+        Tokenization::Literal visit(UnaryExpr &expr) override {
+            count++;
+            expr.right->accept(*this);
+            return false;
+        }
+
+        Tokenization::Literal visit(BinaryExpr &expr) override {
+            count++;
+            expr.left->accept(*this);
+            expr.right->accept(*this);
+            return false;
+        }
+
+        Tokenization::Literal visit(GroupingExpr &expr) override {
+            count++;
+            expr.expression->accept(*this);
+            return false;
+        }
+
+        Tokenization::Literal visit(LiteralExpr &expr) override {
+            count++;
+            return false;
+        }
+
+        Tokenization::Literal visit(VarExpr &expr) override {
+            count++;
+            return false;
+        }
+
+        Tokenization::Literal visit(ArrayExpr &expr) override {
+            count++;
+            expr.index->accept(*this);
+            return false;
+        }
+
+        Tokenization::Literal visit(ArrayFunctionExpr &expr) override {
+            count++;
+            expr.argument->accept(*this);
+            return false;
+        }
+
+        Tokenization::Literal visit(StringFunctionExpr &expr) override {
+            count++;
+            for (auto &argument: expr.arguments) argument->accept(*this);
+            return false;
+        }
+
+        Tokenization::Literal visit(CallExpr &expr) override {
+            count++;
+            for (auto &argument: expr.arguments) argument->accept(*this);
+            return false;
+        }
+
+        Tokenization::Literal visit(EofExpr &expr) override {
+            count++;
+            expr.fileNumber->accept(*this);
+            return false;
+        }
+
+        void visit(PrintStmt &stmt) override {
+            count++;
+            for (auto &expr: stmt.expressions) expr->accept(*this);
+        }
+
+        void visit(InputStmt &stmt) override {
+            count++;
+            stmt.expr->accept(*this);
+        }
+
+        void visit(LetStmt &stmt) override {
+            count++;
+            stmt.expr->accept(*this);
+        }
+
+        void visit(ArrayLetStmt &stmt) override {
+            count++;
+            stmt.index->accept(*this);
+            stmt.expr->accept(*this);
+        }
+
+        void visit(DimStmt &stmt) override {
+            count++;
+            stmt.size->accept(*this);
+        }
+
+        void visit(MapStmt &stmt) override { count++; }
+
+        void visit(PutStmt &stmt) override {
+            count++;
+            stmt.key->accept(*this);
+            stmt.value->accept(*this);
+        }
+
+        void visit(GetStmt &stmt) override {
+            count++;
+            stmt.key->accept(*this);
+        }
+
+        void visit(ToNumStmt &stmt) override { count++; }
+
+        void visit(ToStrStmt &stmt) override { count++; }
+
+        void visit(RndStmt &stmt) override {
+            count++;
+            stmt.lowerBound->accept(*this);
+            stmt.upperBound->accept(*this);
+        }
+
+        void visit(BlockStmt &stmt) override {
+            count++;
+            for (auto &statement: stmt.statementsList) statement->accept(*this);
+        }
+
+        void visit(IfStmt &stmt) override {
+            count++;
+            stmt.conditionExpr->accept(*this);
+            stmt.thenBranch->accept(*this);
+            if (stmt.elseBranch.has_value()) stmt.elseBranch.value()->accept(*this);
+        }
+
+        void visit(WhileStmt &stmt) override {
+            count++;
+            stmt.conditionExpr->accept(*this);
+            stmt.thenBranch->accept(*this);
+        }
+
+        void visit(ParallelForStmt &stmt) override {
+            count++;
+            stmt.fromExpr->accept(*this);
+            stmt.toExpr->accept(*this);
+            stmt.body->accept(*this);
+        }
+
+        void visit(FunctionStmt &stmt) override {
+            count++;
+            stmt.body->accept(*this);
+        }
+
+        void visit(CallStmt &stmt) override {
+            count++;
+            stmt.call->accept(*this);
+        }
+
+        void visit(ReturnStmt &stmt) override {
+            count++;
+            if (stmt.value.has_value()) stmt.value.value()->accept(*this);
+        }
+
+        void visit(ContinueStmt &stmt) override { count++; }
+
+        void visit(BreakStmt &stmt) override { count++; }
+
+        void visit(OpenStmt &stmt) override {
+            count++;
+            stmt.path->accept(*this);
+            stmt.fileNumber->accept(*this);
+        }
+
+        void visit(ReadLineStmt &stmt) override {
+            count++;
+            stmt.fileNumber->accept(*this);
+        }
+
+        void visit(WriteStmt &stmt) override {
+            count++;
+            stmt.fileNumber->accept(*this);
+            stmt.expr->accept(*this);
+        }
+
+        void visit(CloseStmt &stmt) override {
+            count++;
+            stmt.fileNumber->accept(*this);
+        }
+    };
+
+    uint64_t countAstNodes(const std::vector<stmt_ptr> &statements) {
+        NodeCounter counter;
+        for (auto &statement: statements) statement->accept(counter);
+        return counter.count;
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef BASICPLUSPLUS_TIMINGS_HPP
+#define BASICPLUSPLUS_TIMINGS_HPP
+
+#include <chrono>
+#include <ctime>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "ExpressionsStatements.hpp"
+#include "PerfCounters.hpp"
+
+namespace Timing {
+    struct PhaseTime {
+        std::string name;
+        double wallMs;
+        double cpuMs;
+        std::optional<CounterValues> counters;  // Events counted in the phase, with perf counters
+    };
+
+    // Collects wall-clock and CPU time of the phases of one run and prints them as text or JSON,
+    // together with hardware events of every phase and top level statement when perfCounters are set
+    class Timings {
+    private:
+        std::vector<PhaseTime> phases;
+
+        const PhaseTime *findPhase(const std::string &name) const;
+
+    public:
+        uint64_t sourceBytes = 0;
+        uint64_t tokenCount = 0;
+        uint64_t astNodeCount = 0;
+        uint64_t statementsExecuted = 0;
+        // Counters read at the start and end of every phase, nullptr or unavailable to skip them
+        PerfCounters *perfCounters = nullptr;
+
+        // Measures the phase from construction until destruction, also when the phase throws
+        class Phase {
+        private:
+            Timings &timings;
+            std::string name;
+            std::chrono::steady_clock::time_point wallStart;
+            std::clock_t cpuStart;
+            std::optional<CounterValues> countersStart;
+
+        public:
+            Phase(Timings &timings, std::string &&name) : timings(timings), name(std::move(name)),
+                                                          wallStart(std::chrono::steady_clock::now()),
+                                                          cpuStart(std::clock()) {
+                if (timings.perfCounters && timings.perfCounters->available()) {
+                    countersStart = timings.perfCounters->read();
+                }
+            }
+
+            ~Phase();
+        };
+
+        Phase phase(std::string &&name) { return {*this, std::move(name)}; }
+
+        void print(std::ostream &out) const;
+
+        void printJson(std::ostream &out) const;
+
+        // Events of the phases and of the top level statements taking the most cycles
+        void printCounters(std::ostream &out) const;
+    };
+
+    // Number of Expr and Stmt nodes in the AST
+    uint64_t countAstNodes(const std::vector<ExprStmt::stmt_ptr> &statements);
+}
+
+#endif //BASICPLUSPLUS_TIMINGS_HPP
@@ -1,14 +1,32 @@
+#include <algorithm>
+#include <cstring>
+#include <iterator>
 #include <optional>
 #include <string>
 #include "Tokenization.hpp"
+#include "ThreadPool.hpp"
+
+namespace Tokenization {
+    // '\0' ends the source, except as the first character, which is an unexpected character
+    static std::string_view beforeNul(std::string_view source) {
+        return source.substr(0, source.find('\0', 1));
+    }
+
+    Tokenizer::Tokenizer(std::istream &inputStream)
+        : ownedSource(std::istreambuf_iterator<char>(inputStream), std::istreambuf_iterator<char>()),
+          source(beforeNul(ownedSource)) {}
+
+    Tokenizer::Tokenizer(std::string_view source) : source(beforeNul(source)) {}
+
 
-namespace Tokenization {    
     void Tokenizer::scanToken() {
         char c = advance();
         switch (c) {
             case '(': addToken(LEFT_PAREN, c); break;
             case ')': addToken(RIGHT_PAREN, c); break;
             case ',': addToken(COMMA, c); break;
+            case ';': addToken(SEMICOLON, c); break;
+            case '#': addToken(HASH, c); break;
             case '-': addToken(MINUS, c); break;
             case '+': addToken(PLUS, c); break;
             case '*': addToken(STAR, c); break;
@@ -145,27 +163,128 @@ namespace Tokenization {
     }
 
     void Tokenizer::scanTokens() {
+        if (source.size() >= parallelThreshold && Threading::ThreadPool::shared().size() > 1) {
+            scanParallel();
+        } else {
+            scanChunk();
+        }
+
+        addToken(EOF_TOKEN, "");
+    }
+
+    void Tokenizer::scanChunk() {
         while (!isAtEnd()) {
             scanToken();
         }
+    }
 
-        addToken(EOF_TOKEN, "");
+    bool Tokenizer::endsInString(std::string_view lines, bool inString) {
+        const char *c = lines.data();
+        const char *end = c + lines.size();
+        while (c < end) {
+            if (inString) {
+                c = static_cast<const char *>(std::memchr(c, '"', end - c));
+                if (!c) return true;
+                c++;
+                inString = false;
+            } else if (*c == '"') {
+                c++;
+                inString = true;
+            } else if (isAlpha(*c)) {
+                // Words are scanned whole, as scanIdentifier does, so only REM keyword starts a comment
+                const char *word = c;
+                while (c < end && (isAlpha(*c) || isDigit(*c))) c++;
+                if (c - word == 3 && tolower(word[0]) == 'r' && tolower(word[1]) == 'e' && tolower(word[2]) == 'm') {
+                    c = static_cast<const char *>(std::memchr(c, '\n', end - c));
+                    if (!c) return false;
+                    c++;
+                }
+            } else {
+                c++;
+            }
+        }
+        return inString;
+    }
+
+    void Tokenizer::scanParallel() {
+        Threading::ThreadPool &pool = Threading::ThreadPool::shared();
+
+        // A few chunks per worker balance lines that take longer, every chunk starts after a line break
+        size_t chunkCount = std::min<size_t>(pool.size() * 4, source.size() / (parallelThreshold / 4));
+        std::vector<size_t> starts{0};
+        for (size_t i = 1; i < chunkCount; i++) {
+            size_t lineBreak = source.find('\n', std::max(starts.back(), i * (source.size() / chunkCount)));
+            if (lineBreak == std::string_view::npos || lineBreak + 1 == source.size()) break;
+            starts.push_back(lineBreak + 1);
+        }
+        starts.push_back(source.size());
+
+        // Pre-pass: line breaks and the string literal state at the end for both states at the start
+        struct Summary {
+            uint32_t lineBreaks;
+            bool endsInString[2];
+        };
+        std::vector<Summary> summaries(starts.size() - 1);
+        pool.forEach(summaries.size(), [this, &starts, &summaries](size_t i) {
+            std::string_view lines = source.substr(starts[i], starts[i + 1] - starts[i]);
+            summaries[i].lineBreaks = std::count(lines.begin(), lines.end(), '\n');
+            summaries[i].endsInString[false] = endsInString(lines, false);
+            summaries[i].endsInString[true] = endsInString(lines, true);
+        });
+
+        // Chunk starting inside a string literal is joined to the previous one, so no token crosses chunks
+        std::vector<size_t> chunkStarts;
+        std::vector<uint32_t> chunkLines;
+        bool inString = false;
+        uint32_t line = 1;
+        for (size_t i = 0; i < summaries.size(); i++) {
+            if (!inString) {
+                chunkStarts.push_back(starts[i]);
+                chunkLines.push_back(line);
+            }
+            inString = summaries[i].endsInString[inString];
+            line += summaries[i].lineBreaks;
+        }
+        chunkStarts.push_back(source.size());
+
+        std::vector<std::unique_ptr<Tokenizer>> chunks(chunkLines.size());
+        std::vector<char> failed(chunks.size(), false);
+        pool.forEach(chunks.size(), [this, &chunks, &chunkStarts, &chunkLines, &failed](size_t i) {
+            std::string_view lines = source.substr(chunkStarts[i], chunkStarts[i + 1] - chunkStarts[i]);
+            chunks[i].reset(new Tokenizer(lines, chunkLines[i]));
+            try {
+                chunks[i]->scanChunk();
+            } catch (const TokenizationError &) {
+                failed[i] = true;
+            }
+        });
+
+        // Serial tokenizer stops at the first error
+        for (size_t i = 0; i < chunks.size(); i++) {
+            if (!failed[i]) continue;
+            errorMessage = std::move(chunks[i]->errorMessage);
+            lineNumber = chunks[i]->lineNumber;
+            throw TokenizationError();
+        }
+
+        size_t tokenCount = 0;
+        for (auto &chunk: chunks) tokenCount += chunk->tokens->size();
+        tokens->reserve(tokenCount + 1);
+        for (auto &chunk: chunks) {
+            for (Token &token: *chunk->tokens) tokens->push_back(std::move(token));
+        }
+        lineNumber = chunks.back()->lineNumber;
     }
     
     char Tokenizer::advance() {
-         lastChar = curChar;
-         curChar = nextChar;
-        
-         if (inputStream.eof() || !inputStream.get(nextChar) || nextChar == '\0') {
-             isEnd = true;
-             nextChar = 0;
-         }
-         
-         return curChar;
+        lastChar = curChar;
+        curChar = peek();
+        if (position < source.size()) position++;
+        return curChar;
     }
     
     char Tokenizer::peek() {
-        return nextChar;
+        return position < source.size() ? source[position] : 0;
     }
     
     char Tokenizer::cur() {
@@ -177,7 +296,7 @@ namespace Tokenization {
     }
     
     bool Tokenizer::matchNext(char c) {
-        if (isEnd) return false;
+        if (isAtEnd()) return false;
         return c == peek();
     }
 
@@ -212,7 +331,7 @@ namespace Tokenization {
     }
 
     bool Tokenizer::isAtEnd() {
-        return nextChar == '\0' && isEnd;
+        return position >= source.size();
     }
 
     bool Tokenizer::isDigit(char c) {
@@ -8,13 +8,22 @@
 #include <memory>
 #include <map>
 #include <istream>
+#include <string_view>
+#include "RcString.hpp"
+
+namespace Values {
+    class NumArray;
+    class HashMap;
+}
 
 namespace Tokenization {
-    using Literal = std::variant<std::string, double, bool>;
+    // Arrays and maps never appear in tokens, they are created at runtime by `DIM` / `MAP` and shared by reference
+    using Literal = std::variant<Values::RcString, double, bool, std::shared_ptr<Values::NumArray>,
+                                 std::shared_ptr<Values::HashMap>>;
     
     enum TokenType {
         // One character
-        LEFT_PAREN, RIGHT_PAREN, COMMA,
+        LEFT_PAREN, RIGHT_PAREN, COMMA, SEMICOLON, HASH,
         MINUS, PLUS, SLASH, STAR,
 
         // Potentially more characters
@@ -29,6 +38,9 @@ namespace Tokenization {
         REM, LET, INPUT, PRINT, TONUM, TOSTR, RND,
         IF, THEN, ELSE, END, WHILE, DO, BREAK, CONTINUE,
         NOT, AND, OR,
+
+        // Operators of GetStmt, the words themselves are parsed as identifiers
+        GET, HAS,
         
         EOF_TOKEN
     };
@@ -46,16 +58,29 @@ namespace Tokenization {
     class Tokenizer {
     private:
         static const std::map<std::string, TokenType> keywords;
-        
-        std::istream &inputStream;
-        bool isEnd = false;
+
+        // Sources at least this large are split at line breaks and tokenized on the shared thread pool
+        static constexpr size_t parallelThreshold = 1 << 20;
+
+        std::string ownedSource;  // Source read from the stream
+        std::string_view source;  // Ends before the first '\0' after the first character
+        size_t position = 0;      // Index of the next character
         char lastChar = 0;
         char curChar = 0;
-        char nextChar = 0;
         std::unique_ptr<std::vector<Token>> tokens = std::make_unique<std::vector<Token>>();
         u_int32_t lineNumber = 1;  // Current line
         std::string errorMessage;  // Error message is stored here if error occurred
-        
+
+        // Tokens of the whole source, without EOF token
+        void scanChunk();
+
+        // Splits source to chunks of lines, which never start inside a string literal, and tokenizes them in parallel.
+        // Tokens, their lines and the first error are the same as from scanChunk.
+        void scanParallel();
+
+        // Whether lines starting inside (or outside) of a string literal end inside one, skipping REM comments
+        static bool endsInString(std::string_view lines, bool inString);
+
         void scanToken();
         
         void scanString();
@@ -92,12 +117,15 @@ namespace Tokenization {
         void throwError(std::string &&message);
 
     public:
-        explicit Tokenizer(std::istream &inputStream) : inputStream(inputStream) {
-            if (!inputStream.get(nextChar)) {
-                nextChar = 0;
-                isEnd = true;
-            }
-        }
+        // Reads the whole stream
+        explicit Tokenizer(std::istream &inputStream);
+
+        // Source must outlive the tokenizer
+        explicit Tokenizer(std::string_view source);
+
+        // Tokenizer of lines cut from a larger source, numbered from firstLine. The lines must not start inside
+        // a string literal or contain '\0'.
+        Tokenizer(std::string_view lines, uint32_t firstLine) : source(lines), lineNumber(firstLine) {}
 
         void scanTokens();
         
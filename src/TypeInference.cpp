@@ -0,0 +1,330 @@
+#include "TypeInference.hpp"
+
+namespace TypeInference {
+    using namespace ExprStmt;
+    using Tokenization::Literal;
+
+    static StaticType literalType(const Literal &value) {
+        if (std::holds_alternative<double>(value)) return StaticType::NUMBER;
+        if (std::holds_alternative<Values::RcString>(value)) return StaticType::STRING;
+        if (std::holds_alternative<bool>(value)) return StaticType::BOOLEAN;
+        return StaticType::UNKNOWN;
+    }
+
+    Inferrer::State Inferrer::join(const State &a, const State &b) {
+        if (!a.reachable) return b;
+        if (!b.reachable) return a;
+        State result;
+        for (auto &[name, type]: a.variables) {
+            auto other = b.variables.find(name);
+            if (other != b.variables.end() && other->second == type) result.variables.emplace(name, type);
+        }
+        return result;
+    }
+
+    void Inferrer::assign(const VarRef &var, StaticType type) {
+        if (tracked(var)) assign(var.name, type);
+    }
+
+    void Inferrer::assign(const std::string &name, StaticType type) {
+        if (type == StaticType::UNKNOWN) state.variables.erase(name);
+        else state.variables[name] = type;
+    }
+
+    void Inferrer::expressions(const std::vector<Expr *> &exprs) {
+        sawCall = false;
+        for (Expr *expr: exprs) expr->accept(*this);
+        if (sawCall && !inFunction) {
+            state.variables.clear();
+            for (Expr *expr: exprs) expr->accept(*this);
+        }
+    }
+
+    void Inferrer::annotate(Expr &expr, StaticType type) {
+        expr.staticType = type;
+        signature = signature * 0x100000001B3ull + static_cast<uint64_t>(type) + 1;
+    }
+
+    void Inferrer::leave() {
+        state.reachable = false;
+        state.variables.clear();
+    }
+
+    // Expressions
+    Literal Inferrer::visit(UnaryExpr &expr) {
+        expr.right->accept(*this);
+        StaticType operand = expr.right->staticType;
+        if (expr.op.type == Tokenization::MINUS && operand == StaticType::NUMBER) {
+            annotate(expr, StaticType::NUMBER);
+        } else if (expr.op.type == Tokenization::NOT && operand == StaticType::BOOLEAN) {
+            annotate(expr, StaticType::BOOLEAN);
+        } else {
+            annotate(expr, StaticType::UNKNOWN);
+        }
+        return false;
+    }
+
+    Literal Inferrer::visit(BinaryExpr &expr) {
+        expr.left->accept(*this);
+        expr.right->accept(*this);
+        StaticType left = expr.left->staticType;
+        StaticType right = expr.right->staticType;
+        bool numbers = left == StaticType::NUMBER && right == StaticType::NUMBER;
+        StaticType type = StaticType::UNKNOWN;
+        switch (expr.op.type) {
+            case Tokenization::PLUS:
+                // Anything added to a string is concatenated
+                if (numbers) type = StaticType::NUMBER;
+                else if (left == StaticType::STRING || right == StaticType::STRING) type = StaticType::STRING;
+                break;
+            case Tokenization::MINUS:
+            case Tokenization::STAR:
+            case Tokenization::SLASH:
+                if (numbers) type = StaticType::NUMBER;
+                break;
+            case Tokenization::LESS:
+            case Tokenization::GREATER:
+            case Tokenization::LESS_EQUAL:
+            case Tokenization::GREATER_EQUAL:
+                if (numbers) type = StaticType::BOOLEAN;
+                break;
+            case Tokenization::EQUAL_EQUAL:
+            case Tokenization::NOT_EQUAL:
+                if (numbers || (left == StaticType::STRING && right == StaticType::STRING)) type = StaticType::BOOLEAN;
+                break;
+            case Tokenization::AND:
+            case Tokenization::OR:
+                if (left == StaticType::BOOLEAN && right == StaticType::BOOLEAN) type = StaticType::BOOLEAN;
+                break;
+            default:
+                break;
+        }
+        annotate(expr, type);
+        return false;
+    }
+
+    Literal Inferrer::visit(GroupingExpr &expr) {
+        expr.expression->accept(*this);
+        annotate(expr, expr.expression->staticType);
+        return false;
+    }
+
+    Literal Inferrer::visit(LiteralExpr &expr) {
+        annotate(expr, literalType(expr.value));
+        return false;
+    }
+
+    Literal Inferrer::visit(VarExpr &expr) {
+        StaticType type = StaticType::UNKNOWN;
+        if (tracked(expr.varName)) {
+            auto variable = state.variables.find(expr.varName.name);
+            if (variable != state.variables.end()) type = variable->second;
+        }
+        annotate(expr, type);
+        return false;
+    }
+
+    Literal Inferrer::visit(ArrayExpr &expr) {
+        // Arrays hold only numbers, any other outcome is an error
+        expr.index->accept(*this);
+        annotate(expr, StaticType::NUMBER);
+        return false;
+    }
+
+    Literal Inferrer::visit(ArrayFunctionExpr &expr) {
+        expr.argument->accept(*this);
+        annotate(expr, StaticType::NUMBER);
+        return false;
+    }
+
+    Literal Inferrer::visit(StringFunctionExpr &expr) {
+        for (auto &argument: expr.arguments) argument->accept(*this);
+        bool number = expr.function == StringFunctionExpr::LEN || expr.function == StringFunctionExpr::INSTR;
+        annotate(expr, number ? StaticType::NUMBER : StaticType::STRING);
+        return false;
+    }
+
+    Literal Inferrer::visit(CallExpr &expr) {
+        for (auto &argument: expr.arguments) argument->accept(*this);
+        sawCall = true;
+        annotate(expr, StaticType::UNKNOWN);
+        return false;
+    }
+
+    Literal Inferrer::visit(EofExpr &expr) {
+        expr.fileNumber->accept(*this);
+        annotate(expr, StaticType::BOOLEAN);
+        return false;
+    }
+
+    // Statements
+    void Inferrer::visit(PrintStmt &stmt) {
+        std::vector<Expr *> exprs;
+        for (auto &expr: stmt.expressions) exprs.push_back(expr.get());
+        expressions(exprs);
+    }
+
+    void Inferrer::visit(InputStmt &stmt) {
+        expressions({stmt.expr.get()});
+        assign(stmt.targetVarName, StaticType::STRING);
+    }
+
+    void Inferrer::visit(LetStmt &stmt) {
+        expressions({stmt.expr.get()});
+        assign(stmt.targetVarName, stmt.expr->staticType);
+    }
+
+    void Inferrer::visit(ArrayLetStmt &stmt) {
+        expressions({stmt.index.get(), stmt.expr.get()});
+    }
+
+    void Inferrer::visit(DimStmt &stmt) {
+        expressions({stmt.size.get()});
+        assign(stmt.varName, StaticType::UNKNOWN);
+    }
+
+    void Inferrer::visit(MapStmt &stmt) {
+        assign(stmt.varName, StaticType::UNKNOWN);
+    }
+
+    void Inferrer::visit(PutStmt &stmt) {
+        expressions({stmt.key.get(), stmt.value.get()});
+    }
+
+    void Inferrer::visit(GetStmt &stmt) {
+        expressions({stmt.key.get()});
+        assign(stmt.dstVar, stmt.op.type == Tokenization::HAS ? StaticType::BOOLEAN : StaticType::UNKNOWN);
+    }
+
+    void Inferrer::visit(ToNumStmt &stmt) {
+        assign(stmt.dstVar.has_value() ? stmt.dstVar.value() : stmt.srcVar, StaticType::NUMBER);
+    }
+
+    void Inferrer::visit(ToStrStmt &stmt) {
+        assign(stmt.dstVar.has_value() ? stmt.dstVar.value() : stmt.srcVar, StaticType::STRING);
+    }
+
+    void Inferrer::visit(RndStmt &stmt) {
+        expressions({stmt.lowerBound.get(), stmt.upperBound.get()});
+        assign(stmt.dstVar, StaticType::NUMBER);
+    }
+
+    void Inferrer::visit(BlockStmt &stmt) {
+        if (&stmt == target) targetVariables = state.variables;
+        for (auto &statement: stmt.statementsList) statement->accept(*this);
+    }
+
+    void Inferrer::visit(IfStmt &stmt) {
+        expressions({stmt.conditionExpr.get()});
+        State condition = state;
+        stmt.thenBranch->accept(*this);
+        State thenState = std::move(state);
+        state = std::move(condition);
+        if (stmt.elseBranch.has_value()) stmt.elseBranch.value()->accept(*this);
+        state = join(thenState, state);
+    }
+
+    void Inferrer::visit(WhileStmt &stmt) {
+        // Variables only get forgotten, so the loop is typed at most once per variable known at its start
+        while (true) {
+            State head = state;
+            expressions({stmt.conditionExpr.get()});
+            State condition = state;
+            loops.emplace_back();
+            stmt.thenBranch->accept(*this);
+            LoopExits exits = std::move(loops.back());
+            loops.pop_back();
+
+            State next = join(head, join(state, exits.continues));
+            if (next == head) {
+                state = join(condition, exits.breaks);
+                return;
+            }
+            state = std::move(next);
+        }
+    }
+
+    void Inferrer::visit(ParallelForStmt &stmt) {
+        expressions({stmt.fromExpr.get(), stmt.toExpr.get()});
+        State entry = state;
+        // Every iteration starts with the variables of the loop, reading the others from before the loop.
+        // Reductions carry the value of the previous iteration, so their type is not known.
+        if (inFunction) {
+            state.variables.clear();
+        } else {
+            for (auto &reduction: stmt.reductions) state.variables.erase(reduction.varName);
+            state.variables[stmt.loopVarName] = StaticType::NUMBER;
+        }
+        loops.emplace_back();
+        stmt.body->accept(*this);
+        loops.pop_back();
+
+        state = std::move(entry);
+        if (!inFunction) {
+            for (auto &reduction: stmt.reductions) state.variables.erase(reduction.varName);
+        }
+    }
+
+    void Inferrer::visit(FunctionStmt &stmt) {
+        // Parameters can be anything, the definition itself does not change the state
+        State outer = std::move(state);
+        std::vector<LoopExits> outerLoops = std::move(loops);
+        bool outerInFunction = inFunction;
+        state = State();
+        loops.clear();
+        inFunction = true;
+        stmt.body->accept(*this);
+        state = std::move(outer);
+        loops = std::move(outerLoops);
+        inFunction = outerInFunction;
+    }
+
+    void Inferrer::visit(CallStmt &stmt) {
+        expressions({stmt.call.get()});
+    }
+
+    void Inferrer::visit(ReturnStmt &stmt) {
+        if (stmt.value.has_value()) expressions({stmt.value.value().get()});
+        leave();
+    }
+
+    void Inferrer::visit(ContinueStmt &stmt) {
+        if (!loops.empty()) loops.back().continues = join(loops.back().continues, state);
+        leave();
+    }
+
+    void Inferrer::visit(BreakStmt &stmt) {
+        if (!loops.empty()) loops.back().breaks = join(loops.back().breaks, state);
+        leave();
+    }
+
+    void Inferrer::visit(OpenStmt &stmt) {
+        expressions({stmt.path.get(), stmt.fileNumber.get()});
+    }
+
+    void Inferrer::visit(ReadLineStmt &stmt) {
+        expressions({stmt.fileNumber.get()});
+        assign(stmt.dstVar, StaticType::STRING);
+    }
+
+    void Inferrer::visit(WriteStmt &stmt) {
+        expressions({stmt.fileNumber.get(), stmt.expr.get()});
+    }
+
+    void Inferrer::visit(CloseStmt &stmt) {
+        expressions({stmt.fileNumber.get()});
+    }
+
+    uint64_t inferTypes(const std::vector<stmt_ptr> &statements) {
+        Inferrer inferrer;
+        for (auto &statement: statements) statement->accept(inferrer);
+        return inferrer.getSignature();
+    }
+
+    std::map<std::string, StaticType> provenAt(const std::vector<stmt_ptr> &statements, const Stmt &block) {
+        Inferrer inferrer;
+        inferrer.setTarget(block);
+        for (auto &statement: statements) statement->accept(inferrer);
+        return inferrer.getTargetVariables();
+    }
+}
@@ -0,0 +1,113 @@
+#ifndef BASICPLUSPLUS_TYPEINFERENCE_HPP
+#define BASICPLUSPLUS_TYPEINFERENCE_HPP
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "ExpressionsStatements.hpp"
+
+// Flow-sensitive pass annotating every expression with the type all its evaluations have (Expr::staticType),
+// so the interpreter can evaluate proven numbers and booleans without checking the type of every operand.
+//
+// Variables are tracked while they are definitely assigned on every path with the same type, IF branches are joined,
+// loops are iterated until the variables stop changing. FUNCTION bodies track only their local variables, because
+// they can be called at any point, and any CALL forgets all global variables, because the function may assign them.
+namespace TypeInference {
+    class Inferrer : public ExprStmt::AbstractExprVisitor, public ExprStmt::AbstractStmtVisitor {
+    private:
+        // Variables with proven type at a point of the program
+        struct State {
+            bool reachable = true;
+            std::map<std::string, ExprStmt::StaticType> variables;
+
+            bool operator==(const State &) const = default;
+        };
+
+        // States flowing to the end and to the beginning of the innermost loop by BREAK and CONTINUE
+        struct LoopExits {
+            State breaks{false, {}};
+            State continues{false, {}};
+        };
+
+        State state;
+        std::vector<LoopExits> loops;
+        bool inFunction = false;
+        bool sawCall = false;
+        uint64_t signature = 0;
+        // Block whose entry state is recorded, its last visit is with the state loops settled on
+        const ExprStmt::Stmt *target = nullptr;
+        std::map<std::string, ExprStmt::StaticType> targetVariables;
+
+        static State join(const State &a, const State &b);
+
+        // Inside FUNCTION only local variables are tracked
+        bool tracked(const ExprStmt::VarRef &var) const { return !inFunction || var.slot >= 0; }
+
+        void assign(const ExprStmt::VarRef &var, ExprStmt::StaticType type);
+
+        void assign(const std::string &name, ExprStmt::StaticType type);
+
+        // Types expressions of one statement, again with global variables forgotten when any of them calls a function
+        void expressions(const std::vector<ExprStmt::Expr *> &exprs);
+
+        void annotate(ExprStmt::Expr &expr, ExprStmt::StaticType type);
+
+        // Rest of the block after BREAK / CONTINUE / RETURN is typed with nothing known and stays unreachable
+        void leave();
+
+    public:
+        Tokenization::Literal visit(ExprStmt::UnaryExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::BinaryExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::GroupingExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::LiteralExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::VarExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::ArrayExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::ArrayFunctionExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::StringFunctionExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::CallExpr &expr) override;
+        Tokenization::Literal visit(ExprStmt::EofExpr &expr) override;
+
+        void visit(ExprStmt::PrintStmt &stmt) override;
+        void visit(ExprStmt::InputStmt &stmt) override;
+        void visit(ExprStmt::LetStmt &stmt) override;
+        void visit(ExprStmt::ArrayLetStmt &stmt) override;
+        void visit(ExprStmt::DimStmt &stmt) override;
+        void visit(ExprStmt::MapStmt &stmt) override;
+        void visit(ExprStmt::PutStmt &stmt) override;
+        void visit(ExprStmt::GetStmt &stmt) override;
+        void visit(ExprStmt::ToNumStmt &stmt) override;
+        void visit(ExprStmt::ToStrStmt &stmt) override;
+        void visit(ExprStmt::RndStmt &stmt) override;
+        void visit(ExprStmt::BlockStmt &stmt) override;
+        void visit(ExprStmt::IfStmt &stmt) override;
+        void visit(ExprStmt::WhileStmt &stmt) override;
+        void visit(ExprStmt::ParallelForStmt &stmt) override;
+        void visit(ExprStmt::FunctionStmt &stmt) override;
+        void visit(ExprStmt::CallStmt &stmt) override;
+        void visit(ExprStmt::ReturnStmt &stmt) override;
+        void visit(ExprStmt::ContinueStmt &stmt) override;
+        void visit(ExprStmt::BreakStmt &stmt) override;
+        void visit(ExprStmt::OpenStmt &stmt) override;
+        void visit(ExprStmt::ReadLineStmt &stmt) override;
+        void visit(ExprStmt::WriteStmt &stmt) override;
+        void visit(ExprStmt::CloseStmt &stmt) override;
+
+        // Hash of all annotations, programs of the same shape with different types get different signatures
+        uint64_t getSignature() const { return signature; }
+
+        void setTarget(const ExprStmt::Stmt &block) { target = &block; }
+
+        const std::map<std::string, ExprStmt::StaticType> &getTargetVariables() const { return targetVariables; }
+    };
+
+    // Annotates all expressions of the program, returns the signature of the annotations
+    uint64_t inferTypes(const std::vector<ExprStmt::stmt_ptr> &statements);
+
+    // Variables with proven type at the start of block, which reads after it rely on. Annotates the program again,
+    // the annotations come out the same as from inferTypes.
+    std::map<std::string, ExprStmt::StaticType> provenAt(const std::vector<ExprStmt::stmt_ptr> &statements,
+                                                        const ExprStmt::Stmt &block);
+}
+
+#endif //BASICPLUSPLUS_TYPEINFERENCE_HPP
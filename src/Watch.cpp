@@ -0,0 +1,522 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <poll.h>
+#include <sstream>
+#include <sys/inotify.h>
+#include <system_error>
+#include <unistd.h>
+#include "Watch.hpp"
+#include "TypeInference.hpp"
+
+namespace Watching {
+    using namespace ExprStmt;
+
+    // Moves every node of statements after an edit by the lines the edit added or removed
+    class LineShifter : public AbstractExprVisitor, public AbstractStmtVisitor {
+    private:
+        int64_t delta;
+
+        void shift(uint32_t &line) { line = static_cast<uint32_t>(line + delta); }
+
+    public:
+        explicit LineShifter(int64_t delta) : delta(delta) {}
+
+        Tokenization::Literal visit(UnaryExpr &expr) override {
+            shift(expr.line);
+            expr.right->accept(*this);
+            return false;
+        }
+
+        Tokenization::Literal visit(BinaryExpr &expr) override {
+            shift(expr.line);
+            expr.left->accept(*this);
+            expr.right->accept(*this);
+            return false;
+        }
+
+        Tokenization::Literal visit(GroupingExpr &expr) override {
+            shift(expr.line);
+            expr.expression->accept(*this);
+            return false;
+        }
+
+        Tokenization::Literal visit(LiteralExpr &expr) override {
+            shift(expr.line);
+            return false;
+        }
+
+        Tokenization::Literal visit(VarExpr &expr) override {
+            shift(expr.line);
+            return false;
+        }
+
+        Tokenization::Literal visit(ArrayExpr &expr) override {
+            shift(expr.line);
+            expr.index->accept(*this);
+            return false;
+        }
+
+        Tokenization::Literal visit(ArrayFunctionExpr &expr) override {
+            shift(expr.line);
+            expr.argument->accept(*this);
+            return false;
+        }
+
+        Tokenization::Literal visit(StringFunctionExpr &expr) override {
+            shift(expr.line);
+            for (auto &argument: expr.arguments) argument->accept(*this);
+            return false;
+        }
+
+        Tokenization::Literal visit(CallExpr &expr) override {
+            shift(expr.line);
+            for (auto &argument: expr.arguments) argument->accept(*this);
+            return false;
+        }
+
+        Tokenization::Literal visit(EofExpr &expr) override {
+            shift(expr.line);
+            expr.fileNumber->accept(*this);
+            return false;
+        }
+
+        void visit(PrintStmt &stmt) override {
+            shift(stmt.line);
+            for (auto &expr: stmt.expressions) expr->accept(*this);
+        }
+
+        void visit(InputStmt &stmt) override {
+            shift(stmt.line);
+            stmt.expr->accept(*this);
+        }
+
+        void visit(LetStmt &stmt) override {
+            shift(stmt.line);
+            stmt.expr->accept(*this);
+        }
+
+        void visit(ArrayLetStmt &stmt) override {
+            shift(stmt.line);
+            stmt.index->accept(*this);
+            stmt.expr->accept(*this);
+        }
+
+        void visit(DimStmt &stmt) override {
+            shift(stmt.line);
+            stmt.size->accept(*this);
+        }
+
+        void visit(MapStmt &stmt) override { shift(stmt.line); }
+
+        void visit(PutStmt &stmt) override {
+            shift(stmt.line);
+            stmt.key->accept(*this);
+            stmt.value->accept(*this);
+        }
+
+        void visit(GetStmt &stmt) override {
+            shift(stmt.line);
+            stmt.key->accept(*this);
+        }
+
+        void visit(ToNumStmt &stmt) override { shift(stmt.line); }
+
+        void visit(ToStrStmt &stmt) override { shift(stmt.line); }
+
+        void visit(RndStmt &stmt) override {
+            shift(stmt.line);
+            stmt.lowerBound->accept(*this);
+            stmt.upperBound->accept(*this);
+        }
+
+        void visit(BlockStmt &stmt) override {
+            shift(stmt.line);
+            for (auto &statement: stmt.statementsList) statement->accept(*this);
+        }
+
+        void visit(IfStmt &stmt) override {
+            shift(stmt.line);
+            stmt.conditionExpr->accept(*this);
+            stmt.thenBranch->accept(*this);
+            if (stmt.elseBranch.has_value()) stmt.elseBranch.value()->accept(*this);
+        }
+
+        void visit(WhileStmt &stmt) override {
+            shift(stmt.line);
+            stmt.conditionExpr->accept(*this);
+            stmt.thenBranch->accept(*this);
+        }
+
+        void visit(ParallelForStmt &stmt) override {
+            shift(stmt.line);
+            stmt.fromExpr->accept(*this);
+            stmt.toExpr->accept(*this);
+            stmt.body->accept(*this);
+        }
+
+        void visit(FunctionStmt &stmt) override {
+            shift(stmt.line);
+            stmt.body->accept(*this);
+        }
+
+        void visit(CallStmt &stmt) override {
+            shift(stmt.line);
+            stmt.call->accept(*this);
+        }
+
+        void visit(ReturnStmt &stmt) override {
+            shift(stmt.line);
+            if (stmt.value.has_value()) stmt.value.value()->accept(*this);
+        }
+
+        void visit(ContinueStmt &stmt) override { shift(stmt.line); }
+
+        void visit(BreakStmt &stmt) override { shift(stmt.line); }
+
+        void visit(OpenStmt &stmt) override {
+            shift(stmt.line);
+            stmt.path->accept(*this);
+            stmt.fileNumber->accept(*this);
+        }
+
+        void visit(ReadLineStmt &stmt) override {
+            shift(stmt.line);
+            stmt.fileNumber->accept(*this);
+        }
+
+        void visit(WriteStmt &stmt) override {
+            shift(stmt.line);
+            stmt.fileNumber->accept(*this);
+            stmt.expr->accept(*this);
+        }
+
+        void visit(CloseStmt &stmt) override {
+            shift(stmt.line);
+            stmt.fileNumber->accept(*this);
+        }
+    };
+
+    static uint32_t countLines(std::string_view text) {
+        return static_cast<uint32_t>(std::count(text.begin(), text.end(), '\n'));
+    }
+
+    // Offset of the first character of `line`, which is not after `positionLine`, the line of `position`
+    static size_t lineStartBefore(std::string_view text, size_t position, uint32_t positionLine, uint32_t line) {
+        for (; positionLine >= line; positionLine--) {
+            if (positionLine == 1) return 0;
+            position = static_cast<const char *>(memrchr(text.data(), '\n', position)) - text.data();
+        }
+        return position + 1;
+    }
+
+    // Offset of the first character of `line`, which is after `positionLine`, the line of `position`
+    static size_t lineStartAfter(std::string_view text, size_t position, uint32_t positionLine, uint32_t line) {
+        for (; positionLine < line; positionLine++) {
+            position = static_cast<const char *>(std::memchr(text.data() + position, '\n', text.size() - position))
+                       - text.data() + 1;
+        }
+        return position;
+    }
+
+    bool IncrementalCompiler::link(const std::vector<stmt_ptr> &program, const std::vector<Statement> &statements) {
+        std::map<std::string_view, FunctionStmt *> functions;
+        for (auto &statement: program) {
+            auto function = dynamic_cast<FunctionStmt *>(statement.get());
+            if (function && !functions.emplace(function->name, function).second) return false;
+        }
+        for (auto &statement: statements) {
+            for (CallExpr *call: statement.calls) {
+                auto function = functions.find(call->name);
+                if (function == functions.end() || call->arguments.size() != function->second->parameterCount) {
+                    return false;
+                }
+                call->function = function->second;
+            }
+        }
+        return true;
+    }
+
+    std::shared_ptr<const BasicPlusPlus::Program> IncrementalCompiler::compile(std::string &&newSource,
+                                                                               Timing::Timings *timings) {
+        std::optional<Timing::Timings> unusedTimings;
+        if (!timings) timings = &unusedTimings.emplace();
+
+        // Sources end before '\0' and a token parse() left after the last statement starts one when anything
+        // follows it, such edits are compiled whole
+        std::shared_ptr<BasicPlusPlus::Program> next;
+        if (program && program.use_count() == 1 && trailingTokens == 1
+            && !std::memchr(source.data(), '\0', source.size())
+            && !std::memchr(newSource.data(), '\0', newSource.size())) {
+            next = recompile(newSource, *timings);
+        }
+        if (!next) {
+            program.reset();
+            statements.clear();
+            reusedStatements = 0;
+            next = compileAll(newSource, *timings);
+        }
+        program = std::move(next);
+        source = std::move(newSource);
+        return program;
+    }
+
+    std::shared_ptr<BasicPlusPlus::Program> IncrementalCompiler::compileAll(const std::string &newSource,
+                                                                           Timing::Timings &timings) {
+        Tokenization::Tokenizer tokenizer{std::string_view(newSource)};
+        std::unique_ptr<std::vector<Tokenization::Token>> tokens;
+        try {
+            auto phase = timings.phase("tokenize");
+            tokenizer.scanTokens();
+            tokens = tokenizer.getTokens();
+        } catch (const Tokenization::TokenizationError &) {
+            throw BasicPlusPlus::Program::tokenizationError(tokenizer);
+        }
+        uint64_t tokenCount = tokens->size();
+        timings.tokenCount = tokenCount;
+
+        Parsing::Parser parser(std::move(tokens), maxDepth);
+        std::vector<Parsing::Parser::TopLevelStatement> parsed;
+        try {
+            auto phase = timings.phase("parse");
+            parsed = parser.parseTopLevel();
+            parser.resolveCalls();
+        } catch (const Parsing::ParsingError &) {
+            throw BasicPlusPlus::Program::parsingError(parser);
+        }
+
+        std::vector<stmt_ptr> program;
+        program.reserve(parsed.size());
+        trailingTokens = tokenCount;
+        for (auto &statement: parsed) {
+            program.push_back(std::move(statement.statement));
+            statements.push_back({statement.firstLine, statement.lastLine, statement.tokenCount,
+                                  std::move(statement.calls)});
+            trailingTokens -= statement.tokenCount;
+        }
+
+        uint64_t typeSignature;
+        {
+            auto phase = timings.phase("infer");
+            typeSignature = TypeInference::inferTypes(program);
+        }
+        return std::make_shared<BasicPlusPlus::Program>(BasicPlusPlus::Program::Private{}, std::move(program),
+                                                        tokenCount, typeSignature);
+    }
+
+    std::shared_ptr<BasicPlusPlus::Program> IncrementalCompiler::recompile(const std::string &newSource,
+                                                                          Timing::Timings &timings) {
+        // Bytes [prefix, oldEnd) of the old source were replaced by [prefix, newEnd) of the new one
+        size_t prefix = std::mismatch(source.begin(), source.end(), newSource.begin(), newSource.end()).first
+                        - source.begin();
+        if (prefix == source.size() && prefix == newSource.size()) {
+            reusedStatements = statements.size();
+            return program;
+        }
+        size_t suffix = 0;
+        size_t maxSuffix = std::min(source.size(), newSource.size()) - prefix;
+        while (suffix < maxSuffix && source[source.size() - 1 - suffix] == newSource[newSource.size() - 1 - suffix]) {
+            suffix++;
+        }
+        size_t oldEnd = source.size() - suffix;
+        size_t newEnd = newSource.size() - suffix;
+
+        // Lines of the old source the edit touched and how many lines it added
+        std::string_view oldText(source), newText(newSource);
+        uint32_t firstLine = 1 + countLines(oldText.substr(0, prefix));
+        uint32_t oldLines = countLines(oldText.substr(prefix, oldEnd - prefix));
+        uint32_t lastLine = firstLine + oldLines;
+        int64_t delta = static_cast<int64_t>(countLines(newText.substr(prefix, newEnd - prefix))) - oldLines;
+
+        // Statements kept before and after the edit, a statement sharing a line with a reparsed one is reparsed too
+        auto keptBefore = static_cast<size_t>(std::partition_point(
+            statements.begin(), statements.end(),
+            [&](const Statement &statement) { return statement.lastLine < firstLine; }) - statements.begin());
+        auto keptAfter = static_cast<size_t>(std::partition_point(
+            statements.begin(), statements.end(),
+            [&](const Statement &statement) { return statement.firstLine <= lastLine; }) - statements.begin());
+        while (keptBefore > 0 && keptBefore < keptAfter
+               && statements[keptBefore - 1].lastLine == statements[keptBefore].firstLine) {
+            keptBefore--;
+        }
+        while (keptAfter > keptBefore && keptAfter < statements.size()
+               && statements[keptAfter].firstLine == statements[keptAfter - 1].lastLine) {
+            keptAfter++;
+        }
+
+        // Whole lines between the kept statements, in the new source
+        uint32_t regionFirstLine = keptBefore > 0 ? statements[keptBefore - 1].lastLine + 1 : 1;
+        size_t regionStart = lineStartBefore(newText, prefix, firstLine, regionFirstLine);
+        size_t regionEnd = newText.size();
+        if (keptAfter < statements.size()) {
+            regionEnd = lineStartAfter(newText, newEnd, static_cast<uint32_t>(lastLine + delta),
+                                       static_cast<uint32_t>(statements[keptAfter].firstLine + delta));
+        }
+
+        Tokenization::Tokenizer tokenizer(newText.substr(regionStart, regionEnd - regionStart), regionFirstLine);
+        std::unique_ptr<std::vector<Tokenization::Token>> tokens;
+        try {
+            auto phase = timings.phase("tokenize");
+            tokenizer.scanTokens();
+            tokens = tokenizer.getTokens();
+        } catch (const Tokenization::TokenizationError &) {
+            return nullptr;
+        }
+
+        // Parsed statements have to end where the region ends, or the rest of the source would change them
+        Parsing::Parser parser(std::move(tokens), maxDepth);
+        std::vector<Parsing::Parser::TopLevelStatement> parsed;
+        try {
+            auto phase = timings.phase("parse");
+            parsed = parser.parseTopLevel();
+        } catch (const Parsing::ParsingError &) {
+            return nullptr;
+        }
+        if (!parser.parsedAll()) return nullptr;
+
+        std::vector<stmt_ptr> &oldProgram = program->statements;
+        std::vector<stmt_ptr> nextProgram;
+        std::vector<Statement> nextStatements;
+        size_t count = keptBefore + parsed.size() + (statements.size() - keptAfter);
+        nextProgram.reserve(count);
+        nextStatements.reserve(count);
+        for (size_t i = 0; i < keptBefore; i++) {
+            nextProgram.push_back(std::move(oldProgram[i]));
+            nextStatements.push_back(std::move(statements[i]));
+        }
+        for (auto &statement: parsed) {
+            nextProgram.push_back(std::move(statement.statement));
+            nextStatements.push_back({statement.firstLine, statement.lastLine, statement.tokenCount,
+                                      std::move(statement.calls)});
+        }
+        LineShifter shifter(delta);
+        for (size_t i = keptAfter; i < statements.size(); i++) {
+            if (delta != 0) {
+                oldProgram[i]->accept(shifter);
+                statements[i].firstLine += delta;
+                statements[i].lastLine += delta;
+            }
+            nextProgram.push_back(std::move(oldProgram[i]));
+            nextStatements.push_back(std::move(statements[i]));
+        }
+        statements = std::move(nextStatements);
+        reusedStatements = count - parsed.size();
+
+        uint64_t typeSignature;
+        {
+            auto phase = timings.phase("infer");
+            if (!link(nextProgram, statements)) return nullptr;
+            typeSignature = TypeInference::inferTypes(nextProgram);
+        }
+        uint64_t tokenCount = trailingTokens;
+        for (auto &statement: statements) tokenCount += statement.tokenCount;
+        timings.tokenCount = tokenCount;
+        return std::make_shared<BasicPlusPlus::Program>(BasicPlusPlus::Program::Private{}, std::move(nextProgram),
+                                                        tokenCount, typeSignature);
+    }
+
+    // Blocks until the file named `name` in the watched directory is written or replaced, then waits until
+    // the events stop for a moment, so a save writing the file in parts runs the script once
+    static void waitForChange(int fd, const std::string &name) {
+        alignas(inotify_event) char buffer[4096];
+        bool changed = false;
+        while (true) {
+            if (changed) {
+                pollfd pending{fd, POLLIN, 0};
+                if (poll(&pending, 1, 50) == 0) return;
+            }
+            ssize_t length = read(fd, buffer, sizeof(buffer));
+            if (length < 0) {
+                if (errno == EINTR) continue;
+                throw std::system_error(errno, std::generic_category(), "Failed to read file events");
+            }
+            for (ssize_t offset = 0; offset < length;) {
+                auto event = reinterpret_cast<const inotify_event *>(buffer + offset);
+                if (event->len > 0 && name == event->name) changed = true;
+                offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            }
+        }
+    }
+
+    // Runs the current version of the file once, returns exit code like a run without --watch
+    static int runOnce(const std::string &path, IncrementalCompiler &compiler, const BasicPlusPlus::Limits &limits,
+                       bool timingsEnabled, bool timingsJson) {
+        Timing::Timings timings;
+        struct TimingsReport {
+            Timing::Timings &timings;
+            bool enabled;
+            bool json;
+            ~TimingsReport() {
+                if (!enabled) return;
+                if (json) timings.printJson(std::cerr);
+                else timings.print(std::cerr);
+            }
+        } timingsReport{timings, timingsEnabled, timingsJson};
+
+        std::string source;
+        {
+            auto phase = timings.phase("read");
+            std::ifstream inStream(path);
+            if (inStream.fail()) {
+                std::cerr << "Error: Failed to open input file." << std::endl;
+                return 9;
+            }
+            std::ostringstream content;
+            content << inStream.rdbuf();
+            source = std::move(content).str();
+            timings.sourceBytes = source.size();
+        }
+
+        std::shared_ptr<const BasicPlusPlus::Program> program;
+        try {
+            program = compiler.compile(std::move(source), &timings);
+        } catch (const BasicPlusPlus::CompileError &e) {
+            std::cout << e.what() << std::endl;
+            return e.exitCode();
+        }
+        if (timingsEnabled) timings.astNodeCount = Timing::countAstNodes(program->getStatements());
+
+        BasicPlusPlus::Execution execution(std::move(program));
+        execution.setRandomSeed(std::time(0)).setLimits(limits);
+        int exitCode;
+        {
+            auto phase = timings.phase("interpret");
+            exitCode = execution.run();
+        }
+        timings.statementsExecuted = execution.getStatementsExecuted();
+        if (exitCode != 0) std::cout << execution.getErrorOutput() << std::endl;
+        return exitCode;
+    }
+
+    int watch(const std::string &path, const BasicPlusPlus::Limits &limits, bool timingsEnabled, bool timingsJson) {
+        // Editors often save by writing a new file and renaming it over the old one, so the directory is watched
+        std::filesystem::path file(path);
+        std::string directory = file.has_parent_path() ? file.parent_path().string() : ".";
+        std::string name = file.filename().string();
+        int fd = inotify_init1(IN_CLOEXEC);
+        if (fd < 0 || inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            std::cerr << "Error: Failed to watch '" << path << "': " << std::strerror(errno) << std::endl;
+            if (fd >= 0) close(fd);
+            return 9;
+        }
+        struct Close {
+            int fd;
+            ~Close() { close(fd); }
+        } closeFd{fd};
+
+        IncrementalCompiler compiler(limits.maxDepth);
+        while (true) {
+            int exitCode = runOnce(path, compiler, limits, timingsEnabled, timingsJson);
+            std::cout.flush();
+            std::cerr << "==> " << path << " (exit " << exitCode << ", " << compiler.getReusedStatements()
+                      << " statements reused) waiting for changes <==" << std::endl;
+            waitForChange(fd, name);
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef BASICPLUSPLUS_WATCH_HPP
+#define BASICPLUSPLUS_WATCH_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "BasicPlusPlus.hpp"
+
+// `--watch` runs a script again every time its file is saved, without restarting the process.
+//
+// Edits are compiled incrementally. The source is compared with the previous one from both ends, only the lines
+// between the unchanged beginning and end are tokenized again, and only the top level statements on them are parsed
+// again. All other statements keep their AST, statements after the edit get their lines moved when the edit added or
+// removed lines. Calls are linked and types inferred for the whole program again, both are cheap walks.
+// When the edit can not be parsed apart from the rest of the source, the whole source is compiled.
+namespace Watching {
+    class IncrementalCompiler {
+    private:
+        // Top level statement of the last program, in the same order
+        struct Statement {
+            uint32_t firstLine;
+            uint32_t lastLine;
+            uint32_t tokenCount;
+            std::vector<ExprStmt::CallExpr *> calls;
+        };
+
+        uint32_t maxDepth;
+        // Last program compiled by this compiler, nullptr after compile error
+        std::shared_ptr<BasicPlusPlus::Program> program;
+        std::string source;
+        std::vector<Statement> statements;
+        // Tokens after the last statement, including EOF
+        uint64_t trailingTokens = 0;
+        size_t reusedStatements = 0;
+
+        // Resolves calls of all statements, false when a function is missing, defined twice or called with wrong
+        // argument count, which compiling the whole source reports
+        static bool link(const std::vector<ExprStmt::stmt_ptr> &program, const std::vector<Statement> &statements);
+
+        // Compiles the lines the edit touched, nullptr when they can not be compiled alone
+        std::shared_ptr<BasicPlusPlus::Program> recompile(const std::string &newSource, Timing::Timings &timings);
+
+        // Throws CompileError
+        std::shared_ptr<BasicPlusPlus::Program> compileAll(const std::string &newSource, Timing::Timings &timings);
+
+    public:
+        explicit IncrementalCompiler(uint32_t maxDepth = Parsing::Parser::defaultMaxDepth) : maxDepth(maxDepth) {}
+
+        // Same program and errors as Program::compile(source), reusing unchanged statements of the previous program
+        // when no execution holds it anymore. Throws CompileError.
+        std::shared_ptr<const BasicPlusPlus::Program> compile(std::string &&source, Timing::Timings *timings = nullptr);
+
+        // Top level statements the last compile took over from the previous program
+        size_t getReusedStatements() const { return reusedStatements; }
+    };
+
+    // Runs the script, then again after every save of its file, until the process is interrupted.
+    // Returns 9 when the file can not be watched.
+    int watch(const std::string &path, const BasicPlusPlus::Limits &limits, bool timingsEnabled, bool timingsJson);
+}
+
+#endif //BASICPLUSPLUS_WATCH_HPP
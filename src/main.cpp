@@ -1,73 +1,345 @@
 #include <iostream>
 #include <memory>
 #include <fstream>
-#include "Tokenization.hpp"
-#include "Parser.hpp"
-#include "Interpreter.hpp"
+#include <sstream>
+#include "BasicPlusPlus.hpp"
+#include "CppEmitter.hpp"
+#include "Profiler.hpp"
+#include "Timings.hpp"
+#include "Batch.hpp"
+#include "Async.hpp"
+#include "Daemon.hpp"
+#include "ThreadPool.hpp"
+#include "Watch.hpp"
+
+void printUsage(const std::string &program) {
+    std::cout << "Usage: " << program << " [options] <input_file>" << std::endl
+              << "       " << program << " --batch <jobs_file> [-j <threads>]" << std::endl
+              << "       " << program << " --listen <socket> <input_file>" << std::endl
+              << "       " << program << " --serve <socket> [-j <threads>]" << std::endl
+              << "       " << program << " --connect <socket> [--arg <name>=<value>]... <input_file>" << std::endl
+              << "Options:" << std::endl
+              << "  --profile               Write per line profile to <input_file>.prof" << std::endl
+              << "                          and collapsed stacks for flamegraph.pl to <input_file>.folded" << std::endl
+              << "  --profile-period <n>    Sample time every n executed statements (default 64)" << std::endl
+              << "  --timings               Print time spent in each phase to stderr" << std::endl
+              << "  --timings=json          Print time spent in each phase to stderr as JSON" << std::endl
+              << "  --perf-counters         Print cycles, instructions, cache and branch misses of each phase to stderr" << std::endl
+              << "  --perf-counters=statements" << std::endl
+              << "                          Print them of each top level statement too" << std::endl
+              << "  --batch <jobs_file>     Run jobs listed in jobs_file, one '<script> [<stdin_file>]' per line" << std::endl
+              << "  -j <threads>            Number of threads running batch jobs (default hardware concurrency)" << std::endl
+              << "  --max-steps <n>         Stop with StepLimitExceeded error after about n executed statements" << std::endl
+              << "  --max-memory <bytes>    Stop with MemoryLimitExceeded error when values would take more memory," << std::endl
+              << "                          size may end with K, M or G" << std::endl
+              << "  --max-depth <n>         Fail to compile scripts nesting blocks and expressions deeper (default 1000)," << std::endl
+              << "                          deeper limit (at most 100000) runs on a larger stack" << std::endl
+              << "  --checkpoint-every <n>  Write state to <input_file>.ckpt about every n executed statements" << std::endl
+              << "  --resume <checkpoint>   Continue run of input_file from checkpoint written by --checkpoint-every" << std::endl
+              << "  --engine=closure        Run statements compiled to closures instead of walking the syntax tree," << std::endl
+              << "                          same output, not with --profile" << std::endl
+              << "  --engine=tree           Walk the syntax tree (default)" << std::endl
+              << "  --watch                 Run input_file again every time it is saved, recompiling only the edit" << std::endl
+              << "  --listen <socket>       Run input_file for every connection to Unix socket, all on one thread" << std::endl
+              << "  --serve <socket>        Run daemon keeping compiled scripts in memory, serving --connect requests" << std::endl
+              << "  --connect <socket>      Run input_file in daemon started by --serve, forwarding stdin and output" << std::endl
+              << "  --arg <name>=<value>    Set string variable before the script runs, with --connect" << std::endl
+              << "  --emit-cpp <out_file>   Write input_file as standalone C++ program to out_file instead of running it" << std::endl;
+}
+
+// Size in bytes with optional K, M or G suffix, 0 when invalid
+uint64_t parseSize(const std::string &text) {
+    char *end;
+    uint64_t size = std::strtoull(text.c_str(), &end, 10);
+    std::string suffix(end);
+    if (suffix == "K" || suffix == "k") return size << 10;
+    if (suffix == "M" || suffix == "m") return size << 20;
+    if (suffix == "G" || suffix == "g") return size << 30;
+    return suffix.empty() ? size : 0;
+}
+
+void writeProfile(Profiling::Profiler &profiler, const std::string &inputFilename) {
+    profiler.finish();
+
+    std::ifstream source(inputFilename);
+    std::ofstream listing(inputFilename + ".prof");
+    profiler.writeListing(source, listing);
+
+    std::ofstream collapsed(inputFilename + ".folded");
+    profiler.writeCollapsed(collapsed);
+
+    std::cerr << "Profile written to " << inputFilename << ".prof and " << inputFilename << ".folded" << std::endl;
+}
+
+int runBatch(const std::string &jobsFilename, unsigned threads, const BasicPlusPlus::Limits &limits) {
+    std::ifstream jobsStream(jobsFilename);
+    if (jobsStream.fail()) {
+        std::cerr << "Error: Failed to open jobs file." << std::endl;
+        return 9;
+    }
+
+    std::vector<Batch::Job> jobs = Batch::readJobs(jobsStream);
+    std::vector<Batch::JobResult> results = Batch::runJobs(jobs, threads, limits);
+
+    // Outputs are printed in the order of the jobs file
+    size_t failed = 0;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        std::cout << "==> " << jobs[i].scriptPath << " (exit " << results[i].exitCode << ") <==" << std::endl
+                  << results[i].output;
+        if (results[i].exitCode != 0) failed++;
+    }
+    std::cerr << jobs.size() << " jobs finished, " << failed << " failed." << std::endl;
+    return failed ? 14 : 0;
+}
 
 int main(int argc, char** argv) {
     try {
         std::vector<std::string> args(argv, argv + argc);
 
-        if (args.size() != 2) {
-            std::cout << "Usage: " << args[0] << " <input_file>" << std::endl;
-            return 10;
+        // Parse command line options
+        std::string inputFilename;
+        bool profile = false;
+        uint32_t profilePeriod = 64;
+        bool timingsEnabled = false;
+        bool timingsJson = false;
+        bool perfCountersEnabled = false;
+        bool statementCounters = false;
+        std::string batchFilename;
+        unsigned batchThreads = 0;
+        std::string listenSocket;
+        std::string serveSocket;
+        std::string connectSocket;
+        std::vector<std::string> scriptArguments;
+        BasicPlusPlus::Limits limits;
+        uint64_t checkpointEvery = 0;
+        std::string resumeFilename;
+        bool watch = false;
+        std::string emitFilename;
+        BasicPlusPlus::Engine engine = BasicPlusPlus::Engine::TREE_WALKER;
+        for (size_t i = 1; i < args.size(); i++) {
+            if (args[i] == "--profile") {
+                profile = true;
+            } else if (args[i] == "--timings" || args[i] == "--timings=json") {
+                timingsEnabled = true;
+                timingsJson = args[i] == "--timings=json";
+            } else if (args[i] == "--perf-counters" || args[i] == "--perf-counters=statements") {
+                perfCountersEnabled = true;
+                statementCounters = args[i] == "--perf-counters=statements";
+            } else if (args[i] == "--profile-period" && i + 1 < args.size()) {
+                profilePeriod = std::strtoul(args[++i].c_str(), nullptr, 10);
+                if (profilePeriod == 0) {
+                    printUsage(args[0]);
+                    return 10;
+                }
+            } else if (args[i] == "--max-steps" && i + 1 < args.size()) {
+                limits.maxSteps = std::strtoull(args[++i].c_str(), nullptr, 10);
+                if (limits.maxSteps == 0) {
+                    printUsage(args[0]);
+                    return 10;
+                }
+            } else if (args[i] == "--max-memory" && i + 1 < args.size()) {
+                limits.maxMemory = parseSize(args[++i]);
+                if (limits.maxMemory == 0) {
+                    printUsage(args[0]);
+                    return 10;
+                }
+            } else if (args[i] == "--max-depth" && i + 1 < args.size()) {
+                uint64_t maxDepth = std::strtoull(args[++i].c_str(), nullptr, 10);
+                if (maxDepth == 0) {
+                    printUsage(args[0]);
+                    return 10;
+                }
+                if (maxDepth > BasicPlusPlus::maxDepthLimit) {
+                    std::cerr << "Error: --max-depth must be at most " << BasicPlusPlus::maxDepthLimit << "." << std::endl;
+                    return 10;
+                }
+                limits.maxDepth = maxDepth;
+            } else if (args[i] == "--checkpoint-every" && i + 1 < args.size()) {
+                checkpointEvery = std::strtoull(args[++i].c_str(), nullptr, 10);
+                if (checkpointEvery == 0) {
+                    printUsage(args[0]);
+                    return 10;
+                }
+            } else if (args[i] == "--resume" && i + 1 < args.size()) {
+                resumeFilename = args[++i];
+            } else if (args[i] == "--engine=tree" || args[i] == "--engine=closure") {
+                engine = args[i] == "--engine=closure" ? BasicPlusPlus::Engine::CLOSURE
+                                                       : BasicPlusPlus::Engine::TREE_WALKER;
+            } else if (args[i] == "--watch") {
+                watch = true;
+            } else if (args[i] == "--emit-cpp" && i + 1 < args.size()) {
+                emitFilename = args[++i];
+            } else if (args[i] == "--batch" && i + 1 < args.size()) {
+                batchFilename = args[++i];
+            } else if (args[i] == "--listen" && i + 1 < args.size()) {
+                listenSocket = args[++i];
+            } else if (args[i] == "--serve" && i + 1 < args.size()) {
+                serveSocket = args[++i];
+            } else if (args[i] == "--connect" && i + 1 < args.size()) {
+                connectSocket = args[++i];
+            } else if (args[i] == "--arg" && i + 1 < args.size() && args[i + 1].find('=') != std::string::npos) {
+                scriptArguments.push_back(args[++i]);
+            } else if (args[i] == "-j" && i + 1 < args.size()) {
+                batchThreads = std::strtoul(args[++i].c_str(), nullptr, 10);
+            } else if (inputFilename.empty() && !args[i].starts_with("-")) {
+                inputFilename = args[i];
+            } else {
+                printUsage(args[0]);
+                return 10;
+            }
         }
 
-        // Open file with input
-        std::string inputFilename = args[1];
-        std::ifstream inStream(inputFilename);
-        if (inStream.fail()) {
-            std::cerr << "Error: Failed to open input file." << std::endl;
-            return 9;
-        }
+        // Everything after the options, run on a thread with larger stack when deeper nesting is allowed
+        auto command = [&]() -> int {
+            if (!batchFilename.empty() && inputFilename.empty()) {
+                return runBatch(batchFilename, batchThreads, limits);
+            }
 
+            if (!serveSocket.empty() && inputFilename.empty()) {
+                Daemon::Server server(batchThreads, std::time(0), limits);
+                server.serve(serveSocket);
+            }
 
-        // Tokenization
-        Tokenization::Tokenizer tokenizer(inStream);
-        std::unique_ptr<std::vector<Tokenization::Token>> tokens;
-        try {
-            tokenizer.scanTokens();
-            tokens = tokenizer.getTokens();
-        } catch (const Tokenization::TokenizationError &) {
-            std::cout << "[line " << tokenizer.getErrorLine() << "]"
-                      << " Tokenization error: " << tokenizer.getErrorMessage() << std::endl;
-            return 11;
-        }
+            if (!connectSocket.empty() && !inputFilename.empty()) {
+                try {
+                    return Daemon::runClient(connectSocket, inputFilename, scriptArguments,
+                                             std::cin, std::cout, std::cerr);
+                } catch (const std::system_error &e) {
+                    std::cerr << "Error: Failed to run script in daemon: " << e.what() << std::endl;
+                    return 9;
+                }
+            }
 
-        // Parsing
-        Parsing::Parser parser(std::move(tokens));
-        std::unique_ptr<std::vector<ExprStmt::stmt_ptr>> statements;
-        try {
-            statements = parser.parse();
-        } catch (const Parsing::ParsingError &) {
-            Tokenization::Token &errorToken = parser.getErrorToken();
-            if (errorToken.type == Tokenization::EOF_TOKEN) {
-                std::cout << "[line " << errorToken.line << " (at end of file)]"
-                          << " Parsing error: " << parser.getErrorMessage() << std::endl;
-            } else {
-                std::cout << "[line " << errorToken.line << "] (at '" << errorToken.lexeme << "')"
-                          << " Parsing error: " << parser.getErrorMessage() << std::endl;
+            if (inputFilename.empty() || !batchFilename.empty()) {
+                printUsage(args[0]);
+                return 10;
+            }
+
+            if (!emitFilename.empty() && (watch || profile || checkpointEvery || !resumeFilename.empty()
+                                          || !listenSocket.empty() || !serveSocket.empty() || !connectSocket.empty())) {
+                printUsage(args[0]);
+                return 10;
             }
-            return 12;
-        }
 
-        // Interpreting
-        Interpreting::Interpreter interpreter;
-        // Set seed for rnd generator
-        std::srand(std::time(0));
+            // Closures only run scripts directly
+            if (engine == BasicPlusPlus::Engine::CLOSURE && (profile || watch || !emitFilename.empty()
+                                                             || !listenSocket.empty() || !serveSocket.empty()
+                                                             || !connectSocket.empty())) {
+                printUsage(args[0]);
+                return 10;
+            }
 
-        try {
-            for (auto &statement: *statements) {
-                interpreter.interpret(statement);
+            if (watch) {
+                if (profile || perfCountersEnabled || checkpointEvery || !resumeFilename.empty() || !listenSocket.empty()
+                    || !serveSocket.empty() || !connectSocket.empty()) {
+                    printUsage(args[0]);
+                    return 10;
+                }
+                return Watching::watch(inputFilename, limits, timingsEnabled, timingsJson);
             }
-        } catch (const Interpreting::InterpreterError &) {
-            std::cout << "[line " << interpreter.getErrorLine() << "]"
-                      << " Interpreter error: " << interpreter.getErrorMessage() << std::endl;
-            return 13;
-        }
 
-        return 0;
+            Timing::Timings timings;
+            // Opened before anything runs, so threads started later are counted too
+            std::unique_ptr<Timing::PerfCounters> perfCounters;
+            if (perfCountersEnabled) {
+                perfCounters = std::make_unique<Timing::PerfCounters>();
+                timings.perfCounters = perfCounters.get();
+            }
+            // Prints timings on every exit after the file was read
+            struct TimingsReport {
+                Timing::Timings &timings;
+                bool enabled;
+                bool json;
+                bool counters;
+                ~TimingsReport() {
+                    if (enabled && json) timings.printJson(std::cerr);
+                    else if (enabled) timings.print(std::cerr);
+                    else if (counters) timings.printCounters(std::cerr);
+                }
+            } timingsReport{timings, timingsEnabled, timingsJson, perfCountersEnabled};
+
+            // Read whole input file
+            std::string source;
+            {
+                auto phase = timings.phase("read");
+                std::ifstream inStream(inputFilename);
+                if (inStream.fail()) {
+                    std::cerr << "Error: Failed to open input file." << std::endl;
+                    return 9;
+                }
+                std::ostringstream content;
+                content << inStream.rdbuf();
+                source = std::move(content).str();
+                timings.sourceBytes = source.size();
+            }
+
+            // Tokenization and parsing
+            std::shared_ptr<const BasicPlusPlus::Program> program;
+            try {
+                program = BasicPlusPlus::Program::compile(source, &timings, limits.maxDepth);
+            } catch (const BasicPlusPlus::CompileError &e) {
+                std::cout << e.what() << std::endl;
+                return e.exitCode();
+            }
+            if (timingsEnabled) timings.astNodeCount = Timing::countAstNodes(program->getStatements());
+
+            if (!emitFilename.empty()) {
+                std::string emitted;
+                try {
+                    auto phase = timings.phase("emit");
+                    emitted = Emitting::CppEmitter().emitProgram(program->getStatements(), inputFilename);
+                } catch (const Emitting::EmitError &e) {
+                    std::cout << "[line " << e.line() << "] Emit error: " << e.what() << std::endl;
+                    return 15;
+                }
+                std::ofstream outStream(emitFilename);
+                outStream << emitted;
+                outStream.close();
+                if (outStream.fail()) {
+                    std::cerr << "Error: Failed to write output file." << std::endl;
+                    return 9;
+                }
+                return 0;
+            }
+
+            if (!listenSocket.empty()) {
+                Async::EventLoop loop;
+                loop.listen(listenSocket, program, std::time(0), limits);
+                loop.run();
+                return 0;
+            }
+
+            // Interpreting
+            BasicPlusPlus::Execution execution(program);
+            // Set seed for rnd generator
+            execution.setRandomSeed(std::time(0)).setLimits(limits).setEngine(engine);
+            if (statementCounters) execution.setPerfCounters(perfCounters.get());
+            if (checkpointEvery) execution.setCheckpoints(inputFilename + ".ckpt", checkpointEvery);
+            if (!resumeFilename.empty()) execution.setResume(resumeFilename);
+
+            std::unique_ptr<Profiling::Profiler> profiler;
+            if (profile) {
+                profiler = std::make_unique<Profiling::Profiler>(profilePeriod);
+                execution.setProfiler(profiler.get());
+            }
+
+            int exitCode;
+            try {
+                auto phase = timings.phase("interpret");
+                exitCode = execution.run();
+            } catch (const Checkpointing::CheckpointError &e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return 9;
+            }
+            timings.statementsExecuted = execution.getStatementsExecuted();
+            if (exitCode != 0) std::cout << execution.getErrorOutput() << std::endl;
+
+            if (profiler) writeProfile(*profiler, inputFilename);
+
+            return exitCode;
+        };
+        if (limits.maxDepth <= Parsing::Parser::defaultMaxDepth) return command();
+        return Threading::runWithStack(BasicPlusPlus::stackSize(limits.maxDepth), command);
         
     } catch (const std::exception &e) {
         std::cerr << "Unexpected exception: " << e.what() << std::endl;